@@ -0,0 +1,798 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/vertex.h>
+#include <rf_sdk/sdk/face.h>
+#include <rf_sdk/sdk/daemon.h>
+#include <rf_sdk/sdk/object.h>
+#include <rf_sdk/sdk/realwave.h>
+#include <rf_sdk/sdk/nodeaccesor.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/daemons/daemonplgsdk.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "realwave_index.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+//--------------------------------------------------
+// Force and torque on a body, torque about its center of
+// mass. "volume" is the displaced volume seen by the
+// hydrostatic pressure alone, - int( depth * n_y dA ).
+//--------------------------------------------------
+struct Wrench
+{
+  float fx, fy, fz;
+  float tx, ty, tz;
+  float volume;
+
+  void clear( void )
+  {
+    fx = fy = fz = tx = ty = tz = volume = 0.0f;
+  }
+
+  void add( const Wrench& w )
+  {
+    fx += w.fx; fy += w.fy; fz += w.fz;
+    tx += w.tx; ty += w.ty; tz += w.tz;
+    volume += w.volume;
+  }
+};
+
+//--------------------------------------------------
+// Rigid body motion and the constants of the face loads.
+//--------------------------------------------------
+struct FaceLoadParams
+{
+  float comX, comY, comZ;
+  float velX, velY, velZ;
+  float angX, angY, angZ;
+
+  float density;
+  float gravity;
+  float dragCoefficient;
+  float frictionCoefficient;
+};
+
+//--------------------------------------------------
+// Function: addFaceLoads
+// Loads of the water on one outward facing triangle, given
+// the depth under the water surface at its corners ( > 0
+// submerged ) and the water velocity at them.
+//
+// The triangle is clipped at depth 0. The depth is linear
+// over what is left, so the hydrostatic pressure rho g d
+// integrates exactly per sub-triangle with the barycentric
+// moments int( l_i l_j dA ) = A / 12 ( 1 + delta_ij ):
+//
+//   F = - rho g ( d0 + d1 + d2 ) / 3 * A n
+//   T = - rho g / 12 ( sum d sum r + sum d_i r_i ) x A n
+//
+// with r the corners relative to the center of mass. A face
+// pushing into the water ( v.n > 0, v relative to the water
+// at the submerged centroid ) gets the pressure drag
+// - 1/2 rho Cd A ( v.n )^2 n, and every submerged face the
+// skin friction - 1/2 rho Cf A |v_t| v_t.
+//--------------------------------------------------
+static void addFaceLoads( const float* px, const float* py, const float* pz, const float* depth,
+                          const float* waterVel, const FaceLoadParams& params, Wrench& out )
+{
+  // Submerged polygon, at most a quad.
+  float qx[ 4 ], qy[ 4 ], qz[ 4 ], qd[ 4 ];
+  int count = 0;
+
+  for ( int i = 0; i < 3; ++i )
+  {
+    const int j = ( i + 1 ) % 3;
+    if ( depth[ i ] > 0.0f )
+    {
+      qx[ count ] = px[ i ]; qy[ count ] = py[ i ]; qz[ count ] = pz[ i ]; qd[ count ] = depth[ i ];
+      ++count;
+    }
+    if ( ( depth[ i ] > 0.0f ) != ( depth[ j ] > 0.0f ) )
+    {
+      const float t = depth[ i ] / ( depth[ i ] - depth[ j ] );
+      qx[ count ] = px[ i ] + t * ( px[ j ] - px[ i ] );
+      qy[ count ] = py[ i ] + t * ( py[ j ] - py[ i ] );
+      qz[ count ] = pz[ i ] + t * ( pz[ j ] - pz[ i ] );
+      qd[ count ] = 0.0f;
+      ++count;
+    }
+  }
+
+  if ( count < 3 )
+  {
+    return;
+  }
+
+  const float rhoG = params.density * params.gravity;
+
+  // Area vector and first moment of the submerged part.
+  float ax = 0.0f, ay = 0.0f, az = 0.0f;
+  float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+
+  for ( int k = 1; k + 1 < count; ++k )
+  {
+    const int a = 0, b = k, c = k + 1;
+
+    const float e1x = qx[ b ] - qx[ a ], e1y = qy[ b ] - qy[ a ], e1z = qz[ b ] - qz[ a ];
+    const float e2x = qx[ c ] - qx[ a ], e2y = qy[ c ] - qy[ a ], e2z = qz[ c ] - qz[ a ];
+
+    const float nx = 0.5f * ( e1y * e2z - e1z * e2y );
+    const float ny = 0.5f * ( e1z * e2x - e1x * e2z );
+    const float nz = 0.5f * ( e1x * e2y - e1y * e2x );
+
+    const float rax = qx[ a ] - params.comX, ray = qy[ a ] - params.comY, raz = qz[ a ] - params.comZ;
+    const float rbx = qx[ b ] - params.comX, rby = qy[ b ] - params.comY, rbz = qz[ b ] - params.comZ;
+    const float rcx = qx[ c ] - params.comX, rcy = qy[ c ] - params.comY, rcz = qz[ c ] - params.comZ;
+
+    const float sumD = qd[ a ] + qd[ b ] + qd[ c ];
+
+    // Hydrostatic force.
+    const float pressure = rhoG * sumD / 3.0f;
+    out.fx -= pressure * nx;
+    out.fy -= pressure * ny;
+    out.fz -= pressure * nz;
+    out.volume -= sumD / 3.0f * ny;
+
+    // Hydrostatic torque, m = 12 int( d r dA ) / A.
+    const float mx = sumD * ( rax + rbx + rcx ) + qd[ a ] * rax + qd[ b ] * rbx + qd[ c ] * rcx;
+    const float my = sumD * ( ray + rby + rcy ) + qd[ a ] * ray + qd[ b ] * rby + qd[ c ] * rcy;
+    const float mz = sumD * ( raz + rbz + rcz ) + qd[ a ] * raz + qd[ b ] * rbz + qd[ c ] * rcz;
+
+    const float scale = rhoG / 12.0f;
+    out.tx -= scale * ( my * nz - mz * ny );
+    out.ty -= scale * ( mz * nx - mx * nz );
+    out.tz -= scale * ( mx * ny - my * nx );
+
+    ax += nx; ay += ny; az += nz;
+
+    const float area = std::sqrt( nx * nx + ny * ny + nz * nz );
+    cx += area * ( qx[ a ] + qx[ b ] + qx[ c ] ) / 3.0f;
+    cy += area * ( qy[ a ] + qy[ b ] + qy[ c ] ) / 3.0f;
+    cz += area * ( qz[ a ] + qz[ b ] + qz[ c ] ) / 3.0f;
+  }
+
+  const float area = std::sqrt( ax * ax + ay * ay + az * az );
+  if ( area <= 0.0f || ( params.dragCoefficient <= 0.0f && params.frictionCoefficient <= 0.0f ) )
+  {
+    return;
+  }
+
+  cx /= area; cy /= area; cz /= area;
+
+  const float nx = ax / area, ny = ay / area, nz = az / area;
+  const float rx = cx - params.comX, ry = cy - params.comY, rz = cz - params.comZ;
+
+  // Velocity of the centroid relative to the water, v + w x r - v_water.
+  const float vx = params.velX + params.angY * rz - params.angZ * ry - ( waterVel[ 0 ] + waterVel[ 3 ] + waterVel[ 6 ] ) / 3.0f;
+  const float vy = params.velY + params.angZ * rx - params.angX * rz - ( waterVel[ 1 ] + waterVel[ 4 ] + waterVel[ 7 ] ) / 3.0f;
+  const float vz = params.velZ + params.angX * ry - params.angY * rx - ( waterVel[ 2 ] + waterVel[ 5 ] + waterVel[ 8 ] ) / 3.0f;
+
+  const float vn  = vx * nx + vy * ny + vz * nz;
+  const float vtx = vx - vn * nx, vty = vy - vn * ny, vtz = vz - vn * nz;
+  const float vt  = std::sqrt( vtx * vtx + vty * vty + vtz * vtz );
+
+  const float pressureDrag = ( vn > 0.0f ) ? 0.5f * params.density * params.dragCoefficient * area * vn * vn : 0.0f;
+  const float friction     = 0.5f * params.density * params.frictionCoefficient * area * vt;
+
+  const float fx = -pressureDrag * nx - friction * vtx;
+  const float fy = -pressureDrag * ny - friction * vty;
+  const float fz = -pressureDrag * nz - friction * vtz;
+
+  out.fx += fx; out.fy += fy; out.fz += fz;
+  out.tx += ry * fz - rz * fy;
+  out.ty += rz * fx - rx * fz;
+  out.tz += rx * fy - ry * fx;
+}
+
+
+//--------------------------------------------------
+// Buoyancy daemon.
+//
+// Integrates the hydrostatic pressure, pressure drag and
+// skin friction of the water over every face of the linked
+// rigid bodies, and applies the result through
+// Object::setForce( force, position ): the force at the
+// center of mass plus a couple for the torque. The water
+// surface is the "RealWave" mesh, looked up per object
+// vertex in a RealWaveIndex, or the "WaterLevel" plane
+// outside of it.
+//
+// The engine calls applyForceToBody once per body and step,
+// too little work to spread over threads for small debris.
+// The first call of a step computes every body linked in
+// the previous step in one batch instead: geometry is read
+// on this thread, then the faces of all bodies are split
+// over the pool with per thread wrenches. Bodies new to
+// this step are computed on their own call.
+//--------------------------------------------------
+class BuoyancyDaemonSDK : public DaemonPlgSdk
+{
+
+  // A linked body and its slice of the batch arrays.
+  struct Body
+  {
+    std::string name;
+    size_t      firstVertex;
+    size_t      firstFace;
+    size_t      numFaces;
+    bool        linked;
+    FaceLoadParams params;
+    Wrench      wrench;
+  };
+
+  // Triangles of an object, reloaded when the vertex count changes.
+  struct Topology
+  {
+    Topology() : numVertices( -1 ) {};
+
+    int                numVertices;
+    std::vector< int > triangles;
+  };
+
+  public:
+
+  /// Constructor.
+  BuoyancyDaemonSDK() : stepTime( 0.0f ), stepStarted( false ), stepMs( 0.0 ) {};
+
+  /// Destructor.
+  virtual ~BuoyancyDaemonSDK() {};
+
+  /// Class id.
+  virtual NL_INT32 getClassId() const
+  {
+    return ( 1737614029 );
+  };
+
+  // getSdkVersion
+  virtual NL_INDEX32 getSdkVersion() const
+  {
+    return ( SdkVersion::SDK_VERSION );
+  }
+
+  /// Threads are managed by the daemon itself.
+  virtual bool isMT( void ) const { return NL_false; };
+
+  /// Get plugin name.
+  virtual std::string getNameId() const
+  {
+    return ( "Buoyancy" );
+  };
+
+  // getCopyRight()
+  virtual std::string getCopyRight() const
+  {
+    return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+  }
+
+  // getCopyRight()
+  virtual std::string getLongDescription() const
+  {
+    return std::string( "Floats rigid bodies on a RealWave with per face buoyancy, drag and friction." );
+  }
+
+  // getCopyRight()
+  virtual std::string getShortDescription() const
+  {
+    return std::string( "Buoyancy" );
+  }
+
+  /// Initialize plugin, add properties, etc.
+  virtual void initialize( PlgDescriptor* plgDesc )
+  {
+    std::vector<std::string> noNodes;
+    Ppty realWave = Ppty::createPpty( "RealWave", noNodes, node_type::TYPE_REALWAVE, Ppty::SELECTION_UNIQUE );
+    plgDesc->addPpty( realWave );
+
+    // Flat water height without a RealWave and outside of it.
+    Ppty waterLevel = Ppty::createPpty( "WaterLevel", 0.0f );
+    plgDesc->addPpty( waterLevel );
+
+    Ppty density = Ppty::createPpty( "Density", 1000.0f, 0.0f );
+    plgDesc->addPpty( density );
+
+    Ppty gravity = Ppty::createPpty( "Gravity", 9.8f, 0.0f );
+    plgDesc->addPpty( gravity );
+
+    Ppty dragCoefficient = Ppty::createPpty( "DragCoefficient", 1.0f, 0.0f );
+    plgDesc->addPpty( dragCoefficient );
+
+    Ppty frictionCoefficient = Ppty::createPpty( "FrictionCoefficient", 0.01f, 0.0f );
+    plgDesc->addPpty( frictionCoefficient );
+
+    // Drag against the RealWave vertex velocities instead of still water.
+    Ppty useWaveVelocity = Ppty::createPpty( "UseWaveVelocity", true );
+    plgDesc->addPpty( useWaveVelocity );
+
+    Ppty reportStats = Ppty::createPpty( "ReportStats", false );
+    plgDesc->addPpty( reportStats );
+  }
+
+  //--------------------------------------------------
+  //  Function: applyForceToBody
+  //  Called once per step and body. Applies the wrench of
+  //  the step batch, or computes the body alone the first
+  //  step it shows up.
+  //--------------------------------------------------
+  virtual void applyForceToBody( Daemon* thisPlg, Object* obj )
+  {
+    Scene& scene = AppManager::instance()->getCurrentScene();
+
+    const float currTime = scene.getCurrentTime();
+    if ( !stepStarted || currTime != stepTime )
+    {
+      beginStep( thisPlg, scene, currTime );
+    }
+
+    const std::string name = obj->getName();
+
+    size_t index = 0;
+    std::map< std::string, size_t >::iterator found = bodyIndex.find( name );
+    if ( found != bodyIndex.end() && !bodies[ found->second ].linked )
+    {
+      index = found->second;
+    }
+    else
+    {
+      Stopwatch bodyTime;
+
+      index = addBody( name, *obj );
+      computeBodies( index, index + 1 );
+
+      stepMs += bodyTime.getElapsedMs();
+    }
+
+    Body& body = bodies[ index ];
+    body.linked = true;
+
+    applyWrench( *obj, body );
+  }
+
+  //--------------------------------------------------
+  // Function: onSimulationBegin
+  // Forgets the bodies and the water mesh of the last run.
+  //--------------------------------------------------
+  virtual void onSimulationBegin( Daemon* plgThis )
+  {
+    NL_VARIABLE_MAYBE_NOT_REFERENCED( plgThis );
+
+    bodies.clear();
+    objects.clear();
+    bodyIndex.clear();
+    topologies.clear();
+    waveIndex = RealWaveIndex();
+    stepStarted = false;
+  }
+
+  //--------------------------------------------------
+  // Function: onSimulationFrame
+  // Reports the last step when "ReportStats" is on.
+  //--------------------------------------------------
+  virtual void onSimulationFrame( Daemon* plgThis, const unsigned int& frame )
+  {
+    if ( !plgThis->getParameter<bool>( "ReportStats" ) || !stepStarted )
+    {
+      return;
+    }
+
+    float volume = 0.0f;
+    for ( size_t b = 0; b < bodies.size(); ++b )
+    {
+      volume += bodies[ b ].wrench.volume;
+    }
+
+    std::stringstream msg;
+    msg << "Buoyancy: frame " << frame << ", " << bodies.size() << " bodies, " << faceBody.size() << " faces, "
+        << pool.getNumThreads() << " threads, displaced volume " << volume << ", step " << stepMs << " ms";
+    AppManager::instance()->getCurrentScene().message( msg.str() );
+  }
+
+  protected:
+
+  //--------------------------------------------------
+  // Function: beginStep
+  // Drops the bodies the previous step did not call for,
+  // samples the water and computes all the others at once.
+  //--------------------------------------------------
+  void beginStep( Daemon* thisPlg, Scene& scene, const float currTime )
+  {
+    Stopwatch batchTime;
+
+    stepTime    = currTime;
+    stepStarted = true;
+
+    pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+
+    waterLevel = thisPlg->getParameter<float>( "WaterLevel" );
+    useWave    = updateWater( thisPlg );
+
+    size_t kept = 0;
+    bodyIndex.clear();
+    for ( size_t b = 0; b < bodies.size(); ++b )
+    {
+      if ( bodies[ b ].linked )
+      {
+        bodies[ kept ]  = bodies[ b ];
+        objects[ kept ] = objects[ b ];
+        bodies[ kept ].linked = false;
+        bodyIndex[ bodies[ kept ].name ] = kept;
+        ++kept;
+      }
+    }
+    bodies.resize( kept );
+    objects.erase( objects.begin() + kept, objects.end() );
+
+    density             = thisPlg->getParameter<float>( "Density" );
+    gravity             = thisPlg->getParameter<float>( "Gravity" );
+    dragCoefficient     = thisPlg->getParameter<float>( "DragCoefficient" );
+    frictionCoefficient = thisPlg->getParameter<float>( "FrictionCoefficient" );
+
+    computeBodies( 0, bodies.size() );
+
+    stepMs = batchTime.getElapsedMs();
+  }
+
+  //--------------------------------------------------
+  // Function: updateWater
+  // RealWave vertices and velocities of this step, and the
+  // index over them. False without a RealWave.
+  //--------------------------------------------------
+  bool updateWater( Daemon* thisPlg )
+  {
+    ArrSdkNodeAccesors nodes = thisPlg->getParameter<ArrSdkNodeAccesors>( "RealWave" );
+    if ( nodes.empty() || nodes[ 0 ].isNull() || nodes[ 0 ].getType() != node_type::TYPE_REALWAVE )
+    {
+      return ( false );
+    }
+
+    RealWave wave = nodes[ 0 ].asRFRealWave();
+
+    wave.getVertices( waveVertices );
+    const size_t n = waveVertices.size();
+    if ( n == 0 )
+    {
+      return ( false );
+    }
+
+    if ( waveIndex.needsTopology( n ) )
+    {
+      ArrSdkFaces faces;
+      wave.getFaces( faces );
+
+      std::vector< int > triangles( 3 * faces.size() );
+      for ( size_t f = 0; f < faces.size(); ++f )
+      {
+        triangles[ 3 * f + 0 ] = faces[ f ].getI();
+        triangles[ 3 * f + 1 ] = faces[ f ].getJ();
+        triangles[ 3 * f + 2 ] = faces[ f ].getK();
+      }
+      waveIndex.setTopology( n, triangles.data(), faces.size() );
+    }
+
+    waveX.resize( n ); waveY.resize( n ); waveZ.resize( n );
+    waveVel.resize( 3 * n );
+
+    pool.parallelFor( n, 4096, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        const Vector position = waveVertices[ i ].getPosition();
+        const Vector velocity = waveVertices[ i ].getVelocity();
+        waveX[ i ] = position.getX(); waveY[ i ] = position.getY(); waveZ[ i ] = position.getZ();
+        waveVel[ 3 * i + 0 ] = velocity.getX();
+        waveVel[ 3 * i + 1 ] = velocity.getY();
+        waveVel[ 3 * i + 2 ] = velocity.getZ();
+      }
+    } );
+
+    waveIndex.update( waveX.data(), waveY.data(), waveZ.data(), pool );
+    waveVelocity = thisPlg->getParameter<bool>( "UseWaveVelocity" );
+    return ( true );
+  }
+
+  // addBody: appends a body first seen in this step.
+  size_t addBody( const std::string& name, const Object& obj )
+  {
+    Body body;
+    body.name        = name;
+    body.firstVertex = 0;
+    body.firstFace   = 0;
+    body.numFaces    = 0;
+    body.linked      = false;
+    body.wrench.clear();
+
+    bodies.push_back( body );
+    objects.push_back( obj );
+
+    bodyIndex[ name ] = bodies.size() - 1;
+    return ( bodies.size() - 1 );
+  }
+
+  //--------------------------------------------------
+  // Function: computeBodies
+  // Wrenches of bodies [ first, last ). The SDK calls are
+  // made on this thread, the water lookups and the face
+  // loads on the pool.
+  //--------------------------------------------------
+  void computeBodies( const size_t first, const size_t last )
+  {
+    if ( first >= last )
+    {
+      return;
+    }
+
+    gatherBodies( first, last );
+    sampleWater();
+
+    const size_t numBodies = last - first;
+    const size_t numFaces  = faceBody.size();
+    const unsigned int numThreads = pool.getNumThreads();
+
+    partial.resize( numThreads * numBodies );
+    for ( size_t k = 0; k < partial.size(); ++k )
+    {
+      partial[ k ].clear();
+    }
+
+    pool.parallelFor( numFaces, 256, [&]( size_t begin, size_t end, unsigned int thread )
+    {
+      Wrench* local = &partial[ thread * numBodies ];
+
+      float px[ 3 ], py[ 3 ], pz[ 3 ], depth[ 3 ], velocity[ 9 ];
+      for ( size_t f = begin; f < end; ++f )
+      {
+        for ( int c = 0; c < 3; ++c )
+        {
+          const int v = triangles[ 3 * f + c ];
+          px[ c ] = vx[ v ]; py[ c ] = vy[ v ]; pz[ c ] = vz[ v ];
+          depth[ c ] = waterHeight[ v ] - vy[ v ];
+          velocity[ 3 * c + 0 ] = waterVelocity[ 3 * v + 0 ];
+          velocity[ 3 * c + 1 ] = waterVelocity[ 3 * v + 1 ];
+          velocity[ 3 * c + 2 ] = waterVelocity[ 3 * v + 2 ];
+        }
+
+        const unsigned int b = faceBody[ f ];
+        addFaceLoads( px, py, pz, depth, velocity, bodies[ first + b ].params, local[ b ] );
+      }
+    } );
+
+    for ( size_t b = 0; b < numBodies; ++b )
+    {
+      Wrench& wrench = bodies[ first + b ].wrench;
+      wrench.clear();
+      for ( unsigned int t = 0; t < numThreads; ++t )
+      {
+        wrench.add( partial[ t * numBodies + b ] );
+      }
+    }
+  }
+
+  //--------------------------------------------------
+  // Function: gatherBodies
+  // Global vertices, motion and triangles of the bodies
+  // into flat arrays, triangles offset to the flat vertex
+  // indices.
+  //--------------------------------------------------
+  void gatherBodies( const size_t first, const size_t last )
+  {
+    vx.clear(); vy.clear(); vz.clear();
+    triangles.clear();
+    faceBody.clear();
+
+    for ( size_t b = first; b < last; ++b )
+    {
+      Body&   body = bodies[ b ];
+      Object& obj  = objects[ b ];
+
+      obj.getVertices( vertices, REF_GLOBAL );
+      const Topology& topology = getTopology( body.name, obj, int( vertices.size() ) );
+
+      body.firstVertex = vx.size();
+      body.firstFace   = faceBody.size();
+      body.numFaces    = topology.triangles.size() / 3;
+
+      for ( size_t i = 0; i < vertices.size(); ++i )
+      {
+        const Vector position = vertices[ i ].getPosition();
+        vx.push_back( position.getX() );
+        vy.push_back( position.getY() );
+        vz.push_back( position.getZ() );
+      }
+
+      const int offset = int( body.firstVertex );
+      for ( size_t k = 0; k < topology.triangles.size(); ++k )
+      {
+        triangles.push_back( topology.triangles[ k ] + offset );
+      }
+      faceBody.resize( faceBody.size() + body.numFaces, static_cast< unsigned int >( b - first ) );
+
+      const Vector com      = obj.getCenterOfMass();
+      const Vector velocity = obj.getVelocity();
+      const Vector angular  = obj.getAngularVelocity();
+
+      FaceLoadParams& params = body.params;
+      params.comX = com.getX();      params.comY = com.getY();      params.comZ = com.getZ();
+      params.velX = velocity.getX(); params.velY = velocity.getY(); params.velZ = velocity.getZ();
+      params.angX = angular.getX();  params.angY = angular.getY();  params.angZ = angular.getZ();
+
+      params.density             = density;
+      params.gravity             = gravity;
+      params.dragCoefficient     = dragCoefficient;
+      params.frictionCoefficient = frictionCoefficient;
+    }
+  }
+
+  // getTopology: cached triangles of an object.
+  const Topology& getTopology( const std::string& name, Object& obj, const int numVertices )
+  {
+    Topology& topology = topologies[ name ];
+    if ( topology.numVertices != numVertices )
+    {
+      ArrSdkFaces faces;
+      obj.getFaces( faces );
+
+      topology.numVertices = numVertices;
+      topology.triangles.resize( 3 * faces.size() );
+      for ( size_t f = 0; f < faces.size(); ++f )
+      {
+        topology.triangles[ 3 * f + 0 ] = faces[ f ].getI();
+        topology.triangles[ 3 * f + 1 ] = faces[ f ].getJ();
+        topology.triangles[ 3 * f + 2 ] = faces[ f ].getK();
+      }
+    }
+    return ( topology );
+  }
+
+  //--------------------------------------------------
+  // Function: sampleWater
+  // Water height and velocity at every gathered vertex.
+  // Wave velocities are only looked up for vertices within
+  // a cell of the surface, the others cannot be part of a
+  // submerged face that close to it.
+  //--------------------------------------------------
+  void sampleWater( void )
+  {
+    const size_t n = vx.size();
+
+    waterHeight.resize( n );
+    waterVelocity.assign( 3 * n, 0.0f );
+
+    if ( !useWave )
+    {
+      std::fill( waterHeight.begin(), waterHeight.end(), waterLevel );
+      return;
+    }
+
+    const float reach = waveIndex.getCellSize();
+
+    pool.parallelFor( n, 256, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        float h = waterLevel;
+        if ( !waveIndex.height( vx[ i ], vz[ i ], h ) )
+        {
+          h = waterLevel;
+        }
+        waterHeight[ i ] = h;
+
+        if ( waveVelocity && vy[ i ] < h + reach )
+        {
+          const int nearest = waveIndex.nearestVertex( vx[ i ], vy[ i ], vz[ i ] );
+          if ( nearest >= 0 )
+          {
+            waterVelocity[ 3 * i + 0 ] = waveVel[ 3 * nearest + 0 ];
+            waterVelocity[ 3 * i + 1 ] = waveVel[ 3 * nearest + 1 ];
+            waterVelocity[ 3 * i + 2 ] = waveVel[ 3 * nearest + 2 ];
+          }
+        }
+      }
+    } );
+  }
+
+  //--------------------------------------------------
+  // Function: applyWrench
+  // The force at the center of mass and the torque T as a
+  // couple: +-f at com +- u, u a unit vector normal to T and
+  // f = ( T x u ) / 2, so 2 u x f = T.
+  //--------------------------------------------------
+  static void applyWrench( Object& obj, const Body& body )
+  {
+    const Wrench& w = body.wrench;
+    const Vector com( body.params.comX, body.params.comY, body.params.comZ );
+
+    obj.setForce( Vector( w.fx, w.fy, w.fz ), com );
+
+    const Vector torque( w.tx, w.ty, w.tz );
+    const float  magnitude = torque.module();
+    if ( magnitude <= 0.0f )
+    {
+      return;
+    }
+
+    // Axis least aligned with T.
+    const float ax = std::fabs( w.tx ), ay = std::fabs( w.ty ), az = std::fabs( w.tz );
+    const Vector axis = ( ax <= ay && ax <= az ) ? Vector( 1.0f, 0.0f, 0.0f ) :
+                        ( ( ay <= az ) ? Vector( 0.0f, 1.0f, 0.0f ) : Vector( 0.0f, 0.0f, 1.0f ) );
+
+    Vector u = Vector::cross( torque, axis );
+    u /= u.module();
+
+    const Vector f = Vector::cross( torque, u ) * 0.5f;
+    obj.setForce( f, com + u );
+    obj.setForce( -f, com - u );
+  }
+
+  protected:
+
+  ThreadPool    pool;
+  RealWaveIndex waveIndex;
+
+  // RealWave of the step.
+  ArrSdkVertex         waveVertices;
+  std::vector< float > waveX, waveY, waveZ;
+  std::vector< float > waveVel;
+
+  // Bodies of the step, objects[ b ] is bodies[ b ].
+  std::vector< Body >               bodies;
+  std::vector< Object >             objects;
+  std::map< std::string, size_t >   bodyIndex;
+  std::map< std::string, Topology > topologies;
+
+  // Batch arrays.
+  ArrSdkVertex                vertices;
+  std::vector< float >        vx, vy, vz;
+  std::vector< int >          triangles;
+  std::vector< unsigned int > faceBody;
+  std::vector< float >        waterHeight;
+  std::vector< float >        waterVelocity;
+  std::vector< Wrench >       partial;
+
+  float  stepTime;
+  bool   stepStarted;
+  double stepMs;
+
+  bool  useWave;
+  bool  waveVelocity;
+  float waterLevel;
+  float density;
+  float gravity;
+  float dragCoefficient;
+  float frictionCoefficient;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_DAEMON_PLUGIN( BuoyancyDaemonSDK );
+
+/////////////////////////////////////////////////////////////////////////////////////////
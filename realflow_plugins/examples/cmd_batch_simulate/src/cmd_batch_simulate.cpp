@@ -0,0 +1,646 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <cctype>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/nodeaccesor.h>
+#include <rf_sdk/sdk/pb_emitter.h>
+#include <rf_sdk/sdk/daemon.h>
+#include <rf_sdk/sdk/object.h>
+#include <rf_sdk/sdk/camera.h>
+#include <rf_sdk/sdk/group.h>
+#include <rf_sdk/sdk/realwave.h>
+#include <rf_sdk/sdk/hy_griddomain.h>
+#include <rf_sdk/sdk/hy_mesh.h>
+#include <rf_sdk/sdk/particlemesh.h>
+#include <rf_sdk/tasks/cmdplgsdk.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "stopwatch.h"
+#include "process_memory.h"
+#include "child_process.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// Class: CmdBatchSimulate
+// Runs a list of wedges and writes a CSV timing report.
+//
+// "WedgeFile" has one wedge per line, a scene and the
+// parameters to override, "#" starts a comment:
+//
+//   "/shots/tank.flw"  Circle01.Speed=2.5  Container.Position=0,1,0
+//
+// The wedges are loaded in place of the open scene, so the
+// command only runs with "ReplaceOpenScene" on: save your
+// scene first.
+//
+// With "Processes" at 1 every wedge is loaded and simulated
+// in this RealFlow, painting and GUI updates off, and the
+// report has a row per frame: simulateStep calls, frame and
+// slowest step time, resident memory after the frame and
+// particles.
+//
+// With more processes each wedge is saved with its overrides
+// next to the report and "WorkerCommand" runs it, at most
+// "Processes" at a time sharing "CoreBudget" threads. The
+// report then has a row per wedge with its wall time, exit
+// code and peak memory. The command line gets {scene},
+// {end}, {threads} and {log} replaced; it starts the worker
+// directly, not through a shell, with its output going to
+// the {log} file.
+//--------------------------------------------------
+class CmdBatchSimulate : public CmdPlgSdk
+{
+  // A scene and its overrides.
+  struct Wedge
+  {
+    std::string                scene;
+    std::vector< std::string > overrides;
+  };
+
+  public:
+
+    /// Constructor.
+    CmdBatchSimulate() {};
+
+    /// Destructor.
+    virtual ~CmdBatchSimulate( void ) {};
+
+    /// Class id.
+    virtual NL_INT32 getClassId() const
+    {
+      return ( 1529486372 );
+    };
+
+    // getSdkVersion
+    virtual NL_INDEX32 getSdkVersion() const
+    {
+      return ( SdkVersion::SDK_VERSION );
+    }
+
+    /// Get plugin name.
+    virtual std::string getNameId() const
+    {
+      return ( "CmdBatchSimulate" );
+    };
+
+    // getCopyRight()
+    virtual std::string getCopyRight() const
+    {
+      return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+    }
+
+    // getCopyRight()
+    virtual std::string getLongDescription() const
+    {
+      return std::string( "" );
+    }
+
+    // getCopyRight()
+    virtual std::string getShortDescription() const
+    {
+      return std::string( "" );
+    }
+
+    /// Initialize plugin, add properties, etc.
+    virtual void initialize( PlgDescriptor* plgDesc )
+    {
+      Ppty wedgeFile = Ppty::createPpty( "WedgeFile", std::string( "" ), Ppty::SELECTION_FILE );
+      plgDesc->addPpty( wedgeFile );
+
+      // .csv report.
+      Ppty reportFile = Ppty::createPpty( "ReportFile", std::string( "" ), Ppty::SELECTION_FILE );
+      plgDesc->addPpty( reportFile );
+
+      // Last frame, 0 for the scene's own.
+      Ppty endFrame = Ppty::createPpty( "EndFrame", 0, 0 );
+      plgDesc->addPpty( endFrame );
+
+      // Wedges simulated at once, 1 runs them here one by one.
+      Ppty processes = Ppty::createPpty( "Processes", 1, 1 );
+      plgDesc->addPpty( processes );
+
+      // Threads shared by the processes, 0 for all cores.
+      Ppty coreBudget = Ppty::createPpty( "CoreBudget", 0, 0 );
+      plgDesc->addPpty( coreBudget );
+
+      // Program and arguments, no shell syntax: the output goes to {log} anyway.
+      Ppty workerCommand = Ppty::createPpty( "WorkerCommand", std::string( "realflownode -threads {threads} -range 0 {end} \"{scene}\"" ) );
+      plgDesc->addPpty( workerCommand );
+
+      // The wedges replace the open scene, on to confirm it is saved.
+      Ppty replaceOpenScene = Ppty::createPpty( "ReplaceOpenScene", false );
+      plgDesc->addPpty( replaceOpenScene );
+    }
+
+    //--------------------------------------------------
+    // Function: readWedges
+    // Whitespace separated fields, double quotes for paths
+    // with spaces.
+    //--------------------------------------------------
+    static bool readWedges( const std::string& path, std::vector< Wedge >& wedges )
+    {
+      std::ifstream file( path.c_str() );
+      if ( !file )
+      {
+        return ( false );
+      }
+
+      std::string line;
+      while ( std::getline( file, line ) )
+      {
+        std::vector< std::string > fields;
+        size_t i = 0;
+        while ( i < line.size() && line[ i ] != '#' )
+        {
+          if ( isspace( static_cast< unsigned char >( line[ i ] ) ) )
+          {
+            ++i;
+            continue;
+          }
+
+          const bool   quoted = ( line[ i ] == '"' );
+          const size_t begin  = quoted ? i + 1 : i;
+          size_t       end    = begin;
+          while ( end < line.size() && ( quoted ? line[ end ] != '"' : !isspace( static_cast< unsigned char >( line[ end ] ) ) ) )
+          {
+            ++end;
+          }
+          fields.push_back( line.substr( begin, end - begin ) );
+          i = end + ( quoted ? 1 : 0 );
+        }
+
+        if ( !fields.empty() )
+        {
+          Wedge wedge;
+          wedge.scene = fields[ 0 ];
+          wedge.overrides.assign( fields.begin() + 1, fields.end() );
+          wedges.push_back( wedge );
+        }
+      }
+      return ( true );
+    }
+
+    //--------------------------------------------------
+    // Function: setValue
+    // "value" converted to the type of the parameter.
+    //--------------------------------------------------
+    template< class NODE >
+    static bool setValue( NODE node, const std::string& parameter, const std::string& value )
+    {
+      std::string spaced( value );
+      std::replace( spaced.begin(), spaced.end(), ',', ' ' );
+      std::istringstream in( spaced );
+
+      switch ( node.getParameterType( parameter ) )
+      {
+        case sdk_type::PARAM_TYPE_INT:
+        case sdk_type::PARAM_TYPE_BOOL:
+        case sdk_type::PARAM_TYPE_LIST:
+        {
+          int number = 0;
+          if ( !( in >> number ) )
+          {
+            return ( false );
+          }
+          node.setParameter( parameter, number );
+          return ( true );
+        }
+        case sdk_type::PARAM_TYPE_LONG:
+        {
+          long long number = 0;
+          if ( !( in >> number ) )
+          {
+            return ( false );
+          }
+          node.setParameter( parameter, int64_t( number ) );
+          return ( true );
+        }
+        case sdk_type::PARAM_TYPE_FLOAT:
+        {
+          float number = 0.0f;
+          if ( !( in >> number ) )
+          {
+            return ( false );
+          }
+          node.setParameter( parameter, number );
+          return ( true );
+        }
+        case sdk_type::PARAM_TYPE_DOUBLE:
+        {
+          double number = 0.0;
+          if ( !( in >> number ) )
+          {
+            return ( false );
+          }
+          node.setParameter( parameter, number );
+          return ( true );
+        }
+        case sdk_type::PARAM_TYPE_VECTOR:
+        {
+          float x = 0.0f, y = 0.0f, z = 0.0f;
+          if ( !( in >> x >> y >> z ) )
+          {
+            return ( false );
+          }
+          node.setParameter( parameter, Vector( x, y, z ) );
+          return ( true );
+        }
+        case sdk_type::PARAM_TYPE_EDIT:
+        case sdk_type::PARAM_TYPE_BROWSE:
+        {
+          node.setParameter( parameter, value );
+          return ( true );
+        }
+        default:
+          return ( false );
+      }
+    }
+
+    //--------------------------------------------------
+    // Function: applyOverride
+    // "Node.Parameter=value", false when the node, the
+    // parameter or the value is wrong.
+    //--------------------------------------------------
+    static bool applyOverride( Scene& scene, const std::string& assignment )
+    {
+      const size_t equals = assignment.find( '=' );
+      const size_t dot    = assignment.rfind( '.', equals );
+      if ( equals == std::string::npos || dot == std::string::npos || dot == 0 || dot + 1 == equals )
+      {
+        return ( false );
+      }
+
+      const std::string name      = assignment.substr( 0, dot );
+      const std::string parameter = assignment.substr( dot + 1, equals - dot - 1 );
+      const std::string value     = assignment.substr( equals + 1 );
+
+      NodeAccesor node = scene.getNode( name );
+      if ( node.isNull() )
+      {
+        return ( false );
+      }
+
+      const NL_UINT64 type = node.getType();
+      if ( type == node_type::TYPE_PB_EMITTER )
+      {
+        return ( setValue( node.asRFPB_Emitter(), parameter, value ) );
+      }
+      if ( type == node_type::TYPE_DAEMON )
+      {
+        return ( setValue( node.asRFDaemon(), parameter, value ) );
+      }
+      if ( type == node_type::TYPE_OBJECT )
+      {
+        return ( setValue( node.asRFObject(), parameter, value ) );
+      }
+      if ( type == node_type::TYPE_CAMERA )
+      {
+        return ( setValue( node.asRFCamera(), parameter, value ) );
+      }
+      if ( type == node_type::TYPE_GROUP )
+      {
+        return ( setValue( node.asRFGroup(), parameter, value ) );
+      }
+      if ( type == node_type::TYPE_REALWAVE )
+      {
+        return ( setValue( node.asRFRealWave(), parameter, value ) );
+      }
+      if ( type == node_type::TYPE_GRID_DOMAIN || type == node_type::TYPE_HY_DOMAIN )
+      {
+        return ( setValue( node.asRFGridDomain(), parameter, value ) );
+      }
+      if ( type == node_type::TYPE_HY_MESH || type == node_type::TYPE_GRID_MESH )
+      {
+        return ( setValue( node.asRFGridMesh(), parameter, value ) );
+      }
+      if ( type == node_type::TYPE_PARTICLE_MESH || type == node_type::TYPE_RENDERKIT_MESH )
+      {
+        return ( setValue( node.asRFRenderkitMesh(), parameter, value ) );
+      }
+      return ( false );
+    }
+
+    //--------------------------------------------------
+    // Function: loadWedge
+    // Loads the scene and applies the overrides, false with
+    // "status" set on failure.
+    //--------------------------------------------------
+    static bool loadWedge( Scene& scene, const Wedge& wedge, std::string& status )
+    {
+      if ( !scene.load( wedge.scene ) )
+      {
+        status = "cannot load scene";
+        return ( false );
+      }
+
+      for ( size_t k = 0; k < wedge.overrides.size(); ++k )
+      {
+        if ( !applyOverride( scene, wedge.overrides[ k ] ) )
+        {
+          status = "bad override " + wedge.overrides[ k ];
+          return ( false );
+        }
+      }
+      return ( true );
+    }
+
+    // countParticles: in every particle emitter.
+    static size_t countParticles( Scene& scene )
+    {
+      std::vector< PB_Emitter > emitters;
+      scene.get_PB_Emitters( emitters );
+
+      size_t count = 0;
+      for ( size_t k = 0; k < emitters.size(); ++k )
+      {
+        count += emitters[ k ].getNumberOfParticles();
+      }
+      return ( count );
+    }
+
+    // quote: a CSV field.
+    static std::string quote( const std::string& text )
+    {
+      std::string quoted( "\"" );
+      for ( size_t i = 0; i < text.size(); ++i )
+      {
+        quoted += ( text[ i ] == '"' ) ? std::string( "\"\"" ) : std::string( 1, text[ i ] );
+      }
+      return ( quoted + "\"" );
+    }
+
+    // describe: the first CSV fields of a wedge.
+    static std::string describe( size_t index, const Wedge& wedge )
+    {
+      std::string overrides;
+      for ( size_t k = 0; k < wedge.overrides.size(); ++k )
+      {
+        overrides += ( k > 0 ? " " : "" ) + wedge.overrides[ k ];
+      }
+
+      std::stringstream fields;
+      fields << index << "," << quote( wedge.scene ) << "," << quote( overrides );
+      return ( fields.str() );
+    }
+
+    //--------------------------------------------------
+    // Function: simulateHere
+    // Every wedge in this process, a report row per frame.
+    // Each frame is stepped with simulateStep() so its steps
+    // can be timed.
+    //--------------------------------------------------
+    void simulateHere( Scene& scene, const std::vector< Wedge >& wedges, int endFrame, std::ostream& report )
+    {
+      for ( size_t w = 0; w < wedges.size(); ++w )
+      {
+        std::string status;
+        if ( !loadWedge( scene, wedges[ w ], status ) )
+        {
+          report << describe( w, wedges[ w ] ) << ",,,,,,,," << status << "\n";
+          continue;
+        }
+
+        scene.enablePaint( false );
+        scene.enable_GUI_updates( false );
+        scene.reset();
+
+        const int last  = ( endFrame > 0 ) ? endFrame : scene.getMaxFrames();
+        int       frame = scene.getCurrentFrame();
+        SimulStatus step = SIM_STATUS_NORMAL;
+        while ( frame < last && step != SIM_STATUS_FINISHED )
+        {
+          Stopwatch    frameTime;
+          double       slowestMs = 0.0;
+          unsigned int steps     = 0;
+          do
+          {
+            Stopwatch stepTime;
+            step = scene.simulateStep();
+            slowestMs = std::max( slowestMs, stepTime.getElapsedMs() );
+            ++steps;
+          }
+          while ( step == SIM_STATUS_NORMAL );
+          const double frameMs = frameTime.getElapsedMs();
+
+          ++frame;
+          report << describe( w, wedges[ w ] ) << "," << frame << "," << steps << "," << frameMs << "," << slowestMs << ","
+                 << ProcessMemory::getRssMb() << "," << countParticles( scene ) << ",0,ok\n";
+        }
+        report.flush();
+
+        scene.enablePaint( true );
+        scene.enable_GUI_updates( true );
+      }
+    }
+
+    // expand: the worker command of a wedge.
+    static std::string expand( std::string command, const std::string& scene, int endFrame, unsigned int threads,
+                               const std::string& log )
+    {
+      const std::string keys[ 4 ] = { "{scene}", "{end}", "{threads}", "{log}" };
+      std::stringstream end, count;
+      end << endFrame;
+      count << threads;
+      const std::string values[ 4 ] = { scene, end.str(), count.str(), log };
+
+      for ( int k = 0; k < 4; ++k )
+      {
+        for ( size_t at = command.find( keys[ k ] ); at != std::string::npos; at = command.find( keys[ k ], at + values[ k ].size() ) )
+        {
+          command.replace( at, keys[ k ].size(), values[ k ] );
+        }
+      }
+      return ( command );
+    }
+
+    //--------------------------------------------------
+    // Function: simulateInProcesses
+    // Saves every wedge with its overrides, then keeps up to
+    // "processes" workers running until all have ended. An
+    // "endFrame" of 0 is each scene's own last frame.
+    //--------------------------------------------------
+    void simulateInProcesses( Scene& scene, const std::vector< Wedge >& wedges, int endFrame, unsigned int processes,
+                              unsigned int threads, const std::string& stem, const std::string& command,
+                              std::ostream& report )
+    {
+      std::vector< std::string > scenes( wedges.size() );
+      std::vector< int >         lastFrames( wedges.size(), endFrame );
+      for ( size_t w = 0; w < wedges.size(); ++w )
+      {
+        std::stringstream path;
+        path << stem << "_wedge" << w << ".flw";
+
+        std::string status;
+        if ( !loadWedge( scene, wedges[ w ], status ) || !scene.save( path.str() ) )
+        {
+          report << describe( w, wedges[ w ] ) << ",,,,,,,," << ( status.empty() ? "cannot save scene" : status ) << "\n";
+          continue;
+        }
+        scenes[ w ] = path.str();
+        if ( endFrame <= 0 )
+        {
+          lastFrames[ w ] = scene.getMaxFrames();
+        }
+      }
+
+      std::vector< std::unique_ptr< ChildProcess > > workers( processes );
+      std::vector< size_t >                          running( processes, 0 );
+      std::vector< Stopwatch >                       started( processes );
+      for ( size_t p = 0; p < processes; ++p )
+      {
+        workers[ p ].reset( new ChildProcess() );
+      }
+
+      size_t next = 0;
+      for ( ;; )
+      {
+        bool busy = false;
+        for ( size_t p = 0; p < processes; ++p )
+        {
+          ChildProcess& worker = *workers[ p ];
+          if ( worker.poll() )
+          {
+            busy = true;
+            continue;
+          }
+
+          // Running holds the wedge + 1, 0 when idle.
+          if ( running[ p ] > 0 )
+          {
+            const size_t w = running[ p ] - 1;
+            report << describe( w, wedges[ w ] ) << ",,," << started[ p ].getElapsedMs() << ",," << worker.getPeakRssMb()
+                   << ",," << worker.getExitCode() << ","
+                   << ( worker.getExitCode() == 0 ? "ok" : "failed" ) << "\n";
+            report.flush();
+            running[ p ] = 0;
+          }
+
+          while ( next < wedges.size() && scenes[ next ].empty() )
+          {
+            ++next;
+          }
+          if ( next < wedges.size() )
+          {
+            std::stringstream log;
+            log << stem << "_wedge" << next << ".log";
+
+            started[ p ].restart();
+            if ( worker.start( expand( command, scenes[ next ], lastFrames[ next ], threads, log.str() ), log.str() ) )
+            {
+              running[ p ] = next + 1;
+              busy         = true;
+            }
+            else
+            {
+              report << describe( next, wedges[ next ] ) << ",,,,,,,,cannot start worker\n";
+            }
+            ++next;
+          }
+        }
+
+        if ( !busy && next >= wedges.size() )
+        {
+          break;
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+      }
+    }
+
+    // run
+    virtual void run ( Cmd* rfEvntCmd )
+    {
+      Scene& scene = AppManager::instance()->getCurrentScene();
+
+      const std::string wedgeFile  = rfEvntCmd->getParameter< std::string >( "WedgeFile" );
+      const std::string reportFile = rfEvntCmd->getParameter< std::string >( "ReportFile" );
+      const int         endFrame   = rfEvntCmd->getParameter< int >( "EndFrame" );
+
+      if ( !rfEvntCmd->getParameter< bool >( "ReplaceOpenScene" ) )
+      {
+        scene.message( "CmdBatchSimulate: the wedges are loaded in place of the open scene, save it and turn \"ReplaceOpenScene\" on to run them." );
+        return;
+      }
+
+      std::vector< Wedge > wedges;
+      if ( wedgeFile.empty() || !readWedges( wedgeFile, wedges ) || wedges.empty() )
+      {
+        scene.message( "CmdBatchSimulate: no wedges in \"" + wedgeFile + "\"." );
+        return;
+      }
+
+      std::ofstream report( reportFile.c_str() );
+      if ( reportFile.empty() || !report )
+      {
+        scene.message( "CmdBatchSimulate: cannot write the report \"" + reportFile + "\"." );
+        return;
+      }
+      unsigned int budget = static_cast< unsigned int >( std::max( 0, rfEvntCmd->getParameter< int >( "CoreBudget" ) ) );
+      if ( budget == 0 )
+      {
+        budget = std::max( 1u, std::thread::hardware_concurrency() );
+      }
+      const unsigned int processes = std::min( std::min( budget, static_cast< unsigned int >( wedges.size() ) ),
+                                               static_cast< unsigned int >( std::max( 1, rfEvntCmd->getParameter< int >( "Processes" ) ) ) );
+
+      // In process the memory is sampled after each frame, a peak would be the whole session's.
+      report << "wedge,scene,overrides,frame,steps,frame_ms,slowest_step_ms," << ( processes == 1 ? "rss_mb" : "peak_rss_mb" )
+             << ",particles,exit_code,status\n";
+
+      Stopwatch batchTime;
+      if ( processes == 1 )
+      {
+        simulateHere( scene, wedges, endFrame, report );
+      }
+      else
+      {
+        const size_t dot = reportFile.find_last_of( '.' );
+        const std::string stem = ( dot == std::string::npos || reportFile.find_first_of( "/\\", dot ) != std::string::npos ) ?
+                                 reportFile : reportFile.substr( 0, dot );
+        simulateInProcesses( scene, wedges, endFrame, processes, std::max( 1u, budget / processes ), stem,
+                             rfEvntCmd->getParameter< std::string >( "WorkerCommand" ), report );
+      }
+
+      std::stringstream msg;
+      msg << "CmdBatchSimulate: " << wedges.size() << " wedges in " << batchTime.getElapsedMs() / 1000.0 << " s on "
+          << processes << " process" << ( processes > 1 ? "es" : "" ) << ", report written to " << reportFile
+          << ". The last wedge loaded is now the open scene.";
+      scene.message( msg.str() );
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_CMD_PLUGIN( CmdBatchSimulate );
+
+/////////////////////////////////////////////////////////////////////////////////////////
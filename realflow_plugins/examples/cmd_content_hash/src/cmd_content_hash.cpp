@@ -0,0 +1,219 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/tasks/cmdplgsdk.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "content_hash_manifest.h"
+#include "scene_content_hash.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// Class: CmdContentHash
+// 128 bit content hashes of the scene inputs, so caches are
+// only rebuilt when something changed; see SceneContentHash
+// for what each node hashes, the "Parameters" listed by name
+// included.
+//
+// The hashes are compared with the manifest in "Directory",
+// written by the cache producer ( ParticleCacheExport ) when
+// its simulation begins, so run the check on the reset scene.
+// Nodes in the manifest but no longer in the scene are
+// reported as removed. The manifest records which settings
+// ( "Geometry", "Particles", "Parameters" ) its hashes were
+// taken with; when they differ from the check's, nodes are
+// not compared and only the mismatch is reported. Checking leaves the manifest alone;
+// "Update" rewrites it with the scene hashes, to accept the
+// current scene without simulating again.
+//--------------------------------------------------
+class CmdContentHash : public CmdPlgSdk
+{
+  public:
+
+    /// Constructor.
+    CmdContentHash() {};
+
+    /// Destructor.
+    virtual ~CmdContentHash( void ) {};
+
+    /// Class id.
+    virtual NL_INT32 getClassId() const
+    {
+      return ( 1529486374 );
+    };
+
+    // getSdkVersion
+    virtual NL_INDEX32 getSdkVersion() const
+    {
+      return ( SdkVersion::SDK_VERSION );
+    }
+
+    /// Get plugin name.
+    virtual std::string getNameId() const
+    {
+      return ( "CmdContentHash" );
+    };
+
+    // getCopyRight()
+    virtual std::string getCopyRight() const
+    {
+      return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+    }
+
+    // getCopyRight()
+    virtual std::string getLongDescription() const
+    {
+      return std::string( "" );
+    }
+
+    // getCopyRight()
+    virtual std::string getShortDescription() const
+    {
+      return std::string( "" );
+    }
+
+    /// Initialize plugin, add properties, etc.
+    virtual void initialize( PlgDescriptor* plgDesc )
+    {
+      // Cache directory holding the manifest.
+      Ppty directory = Ppty::createPpty( "Directory", std::string( "" ), Ppty::SELECTION_DIRECTORY );
+      plgDesc->addPpty( directory );
+
+      // Parameter names hashed for every node, missing ones are skipped.
+      Ppty parameters = Ppty::createPpty( "Parameters", std::string( "Position Rotation Scale" ) );
+      plgDesc->addPpty( parameters );
+
+      Ppty geometry = Ppty::createPpty( "Geometry", true );
+      plgDesc->addPpty( geometry );
+
+      Ppty particles = Ppty::createPpty( "Particles", true );
+      plgDesc->addPpty( particles );
+
+      // Replace the manifest with the scene hashes.
+      Ppty update = Ppty::createPpty( "Update", false );
+      plgDesc->addPpty( update );
+    }
+
+    // run
+    virtual void run ( Cmd* rfEvntCmd )
+    {
+      Scene& scene = AppManager::instance()->getCurrentScene();
+
+      const std::string directory = rfEvntCmd->getParameter< std::string >( "Directory" );
+      const bool        geometry  = rfEvntCmd->getParameter< bool >( "Geometry" );
+      const bool        particles = rfEvntCmd->getParameter< bool >( "Particles" );
+      const bool        update    = rfEvntCmd->getParameter< bool >( "Update" );
+
+      const std::vector< std::string > parameters = SceneContentHash::parseParameters( rfEvntCmd->getParameter< std::string >( "Parameters" ) );
+
+      if ( directory.empty() )
+      {
+        scene.message( "CmdContentHash: no cache directory selected." );
+        return;
+      }
+
+      Stopwatch hashTime;
+
+      std::vector< SceneContentHash::NodeHash > hashes;
+      SceneContentHash::hashScene( scene, parameters, geometry, particles, pool, hashes );
+
+      const double hashMs = hashTime.getElapsedMs();
+
+      const std::string   path     = ContentHashManifest::getPath( directory );
+      const std::string   settings = SceneContentHash::getSettings( parameters, geometry, particles );
+      ContentHashManifest manifest;
+      const bool          hadManifest = manifest.load( path );
+
+      if ( hadManifest && manifest.getSettings() != settings )
+      {
+        std::stringstream msg;
+        msg << "CmdContentHash: the manifest was hashed with \"" << manifest.getSettings() << "\", this check uses \""
+            << settings << "\"; match \"Geometry\", \"Particles\" and \"Parameters\" to the cache producer.";
+        if ( update )
+        {
+          SceneContentHash::toManifest( hashes, settings, manifest );
+          msg << ( manifest.save( path ) ? " Manifest replaced." : " Cannot write " + path + "." );
+        }
+        scene.message( msg.str() );
+        return;
+      }
+
+      std::stringstream table;
+      size_t changed = 0;
+      size_t bytes   = 0;
+      for ( size_t k = 0; k < hashes.size(); ++k )
+      {
+        ContentHash128 stored;
+        const bool   known = manifest.find( hashes[ k ].name, stored );
+        const char*  state = !known ? "new" : ( stored == hashes[ k ].hash ? "unchanged" : "changed" );
+        changed += ( !known || stored != hashes[ k ].hash ) ? 1 : 0;
+        bytes   += hashes[ k ].bytes;
+
+        table << hashes[ k ].hash.toString() << "  " << std::left << std::setw( 10 ) << state << hashes[ k ].name
+              << " ( " << hashes[ k ].elements << " elements )\n";
+        manifest.erase( hashes[ k ].name );
+      }
+
+      // What is left in the manifest is not in the scene any more.
+      std::vector< std::string > removed;
+      manifest.getNames( removed );
+      for ( size_t k = 0; k < removed.size(); ++k )
+      {
+        table << std::string( 32, ' ' ) << "  " << std::left << std::setw( 10 ) << "removed" << removed[ k ] << "\n";
+      }
+
+      std::stringstream msg;
+      msg << "CmdContentHash: " << hashes.size() << " nodes, " << changed << " changed or new and " << removed.size()
+          << " removed since " << ( hadManifest ? "the manifest" : "no manifest" ) << ", " << bytes / 1048576.0 << " MB hashed in " << hashMs << " ms\n"
+          << table.str();
+
+      if ( update )
+      {
+        SceneContentHash::toManifest( hashes, settings, manifest );
+        if ( !manifest.save( path ) )
+        {
+          msg << "cannot write " << path;
+        }
+      }
+      scene.message( msg.str() );
+    }
+
+  protected:
+
+    ThreadPool pool;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_CMD_PLUGIN( CmdContentHash );
+
+/////////////////////////////////////////////////////////////////////////////////////////
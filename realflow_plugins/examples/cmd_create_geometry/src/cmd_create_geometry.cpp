@@ -13,6 +13,9 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <climits>
 
 #include <rf_sdk/sdk/appmanager.h>
 #include <rf_sdk/sdk/scene.h>
@@ -22,6 +25,10 @@
 #include <rf_sdk/sdk/rfsdklibdefs.h>
 #include <rf_sdk/sdk/sdkversion.h>
 
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "primitive_generator.h"
+
 /////////////////////////////////////////////////////////////////////////////////////////
 
 using namespace std;
@@ -38,10 +45,33 @@ class CmdCreateGeometry : public CmdPlgSdk
     STYLE_MSG_NBD_AND_QTD
   };
 
+  enum CreateMode
+  {
+    MODE_PER_OBJECT ,
+    MODE_MERGED
+  };
+
+  enum Shape
+  {
+    SHAPE_CUBE       ,
+    SHAPE_SPHERE     ,
+    SHAPE_GEOSPHERE  ,
+    SHAPE_CYLINDER   ,
+    SHAPE_TORUS      ,
+    SHAPE_GRID       ,
+    SHAPE_ROCK
+  };
+
+  enum CubeSize
+  {
+    CUBE_VERTICES = 8 ,
+    CUBE_FACES    = 12
+  };
+
   public:
 
     /// Constructor.
-    CmdCreateGeometry() {};
+    CmdCreateGeometry() : generator( pool ), templateShape( -1 ), templateResolution( -1 ) {};
 
     /// Destructor.
     virtual ~CmdCreateGeometry( void ) {};
@@ -85,122 +115,333 @@ class CmdCreateGeometry : public CmdPlgSdk
     /// Initialize plugin, add properties, etc.
     virtual void initialize( PlgDescriptor* plgDesc )
     {
+      // Number of objects, any shape.
       Ppty cubes = Ppty::createPpty( "Cubes", 10 );  
       plgDesc->addPpty( cubes );
 
       Ppty offset = Ppty::createPpty( "Offset", Vector( 1.0f, 1.0f, 1.0f ) );  
       plgDesc->addPpty( offset );
 
+      // One object per copy, or all of them merged in a single object.
+      std::vector<std::string> lstNames;
+      lstNames.push_back( "PerObject" );
+      lstNames.push_back( "Merged" );
+
+      std::vector<int> lstValues;
+      lstValues.push_back( MODE_PER_OBJECT );
+      lstValues.push_back( MODE_MERGED );
+
+      Ppty mode = Ppty::createPpty( "Mode", lstNames, lstValues );
+      plgDesc->addPpty( mode );
+
+      std::vector<std::string> shapeNames;
+      shapeNames.push_back( "Cube" );
+      shapeNames.push_back( "Sphere" );
+      shapeNames.push_back( "GeoSphere" );
+      shapeNames.push_back( "Cylinder" );
+      shapeNames.push_back( "Torus" );
+      shapeNames.push_back( "Grid" );
+      shapeNames.push_back( "Rock" );
+
+      std::vector<int> shapeValues;
+      shapeValues.push_back( SHAPE_CUBE );
+      shapeValues.push_back( SHAPE_SPHERE );
+      shapeValues.push_back( SHAPE_GEOSPHERE );
+      shapeValues.push_back( SHAPE_CYLINDER );
+      shapeValues.push_back( SHAPE_TORUS );
+      shapeValues.push_back( SHAPE_GRID );
+      shapeValues.push_back( SHAPE_ROCK );
+
+      Ppty shape = Ppty::createPpty( "Shape", shapeNames, shapeValues );
+      plgDesc->addPpty( shape );
+
+      // Rings of spheres, geosphere frequency, grid divisions... see buildTemplate().
+      Ppty resolution = Ppty::createPpty( "Resolution", 16, 1 );
+      plgDesc->addPpty( resolution );
+
+      // Rock radius displacement, fraction of the radius.
+      Ppty roughness = Ppty::createPpty( "Roughness", 0.3f, 0.0f );
+      plgDesc->addPpty( roughness );
     }
 
-    // createCube
-    void createCube( const Vector& position )
+    //--------------------------------------------------
+    // Function: buildCubeTemplate
+    // Unit cube vertices and faces with their texture
+    // coordinates.
+    //--------------------------------------------------
+    void buildCubeTemplate( void )
     {
-      Scene& scene =  AppManager::instance()->getCurrentScene();
-      
-      std::vector< Vertex > vertices;
-      vertices.push_back( Vertex( Vector( -0.5f, -0.5f, -0.5f ) ) );
-      vertices.push_back( Vertex( Vector( 0.5f, -0.5f, -0.5f ) ) );
-      vertices.push_back( Vertex( Vector( 0.5f, -0.5f, 0.5f ) ) );
-      vertices.push_back( Vertex( Vector( -0.5f, -0.5f, 0.5f ) ) );
-      vertices.push_back( Vertex( Vector( -0.5f, 0.5f, -0.5f ) ) );
-      vertices.push_back( Vertex( Vector( 0.5f, 0.5f, -0.5f ) ) );
-      vertices.push_back( Vertex( Vector( 0.5f, 0.5f, 0.5f ) ) );
-      vertices.push_back( Vertex( Vector( -0.5f, 0.5f, 0.5f ) ) );
-
-      std::vector< Face > faces;
-      faces.push_back( Face( 1, 2, 0 ) );
-      faces.push_back( Face( 2, 3, 0 ) );
-      faces.push_back( Face( 6, 5, 4 ) );
-      faces.push_back( Face( 7, 6, 4 ) );
-      faces.push_back( Face( 5, 1, 0 ) );
-      faces.push_back( Face( 4, 5, 0 ) );
-      faces.push_back( Face( 6, 2, 1 ) );
-      faces.push_back( Face( 5, 6, 1 ) );
-      faces.push_back( Face( 7, 3, 2 ) );
-      faces.push_back( Face( 6, 7, 2 ) );
-      faces.push_back( Face( 4, 0, 3 ) );
-      faces.push_back( Face( 7, 4, 3 ) );
+      static const float corners[ 8 ][ 3 ] =
+      {
+        { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, 0.5f }, { -0.5f, -0.5f, 0.5f },
+        { -0.5f,  0.5f, -0.5f }, { 0.5f,  0.5f, -0.5f }, { 0.5f,  0.5f, 0.5f }, { -0.5f,  0.5f, 0.5f }
+      };
+
+      static const int indices[ 12 ][ 3 ] =
+      {
+        { 1, 2, 0 }, { 2, 3, 0 }, { 6, 5, 4 }, { 7, 6, 4 }, { 5, 1, 0 }, { 4, 5, 0 },
+        { 6, 2, 1 }, { 5, 6, 1 }, { 7, 3, 2 }, { 6, 7, 2 }, { 4, 0, 3 }, { 7, 4, 3 }
+      };
+
+      // ( u, v ) of the i, j and k vertices.
+      static const float uvs[ 12 ][ 6 ] =
+      {
+        { 1, 0, 1, 1, 0, 0 }, { 1, 1, 0, 1, 0, 0 }, { 1, 1, 1, 0, 0, 0 }, { 0, 1, 1, 1, 0, 0 },
+        { 1, 1, 1, 0, 0, 0 }, { 0, 1, 1, 1, 0, 0 }, { 1, 1, 1, 0, 0, 0 }, { 0, 1, 1, 1, 0, 0 },
+        { 1, 1, 1, 0, 0, 0 }, { 0, 1, 1, 1, 0, 0 }, { 1, 1, 1, 0, 0, 0 }, { 0, 1, 1, 1, 0, 0 }
+      };
 
+      templateVertices.clear();
+      for ( int v = 0; v < CUBE_VERTICES; ++v )
+      {
+        templateVertices.push_back( Vertex( Vector( corners[ v ][ 0 ], corners[ v ][ 1 ], corners[ v ][ 2 ] ) ) );
+      }
+
+      templateFaces.clear();
       std::vector< Vector > txt( 3 );
+      for ( int f = 0; f < CUBE_FACES; ++f )
+      {
+        Face face( indices[ f ][ 0 ], indices[ f ][ 1 ], indices[ f ][ 2 ] );
+        for ( int c = 0; c < 3; ++c )
+        {
+          txt[ c ].set( uvs[ f ][ 2 * c ], uvs[ f ][ 2 * c + 1 ], 0.0f );
+        }
+        face.setTextureCoordinates( txt );
+        templateFaces.push_back( face );
+      }
+    }
+
+    //--------------------------------------------------
+    // Function: buildTemplate
+    // Mesh copied for every object, about one unit across,
+    // rebuilt when the shape or the resolution change. The
+    // resolution r gives a 2r x r UV sphere, a frequency r
+    // geosphere, a 2r sided cylinder, a 2r x r torus and an
+    // r x r grid; rocks use frequency r / 4 and are made per
+    // object.
+    //--------------------------------------------------
+    void buildTemplate( const int shape, const int resolution )
+    {
+      if ( shape == templateShape && resolution == templateResolution )
+      {
+        return;
+      }
+
+      templateVertices.clear();
+      templateFaces.clear();
+
+      const Vector origin( 0.0f, 0.0f, 0.0f );
+      switch ( shape )
+      {
+        case SHAPE_SPHERE:
+          generator.addSphere( origin, 0.5f, std::max( 3, 2 * resolution ), std::max( 2, resolution ), templateVertices, templateFaces );
+          break;
+        case SHAPE_GEOSPHERE:
+          generator.addGeoSphere( origin, 0.5f, resolution, templateVertices, templateFaces );
+          break;
+        case SHAPE_CYLINDER:
+          generator.addCylinder( origin, 0.5f, 1.0f, std::max( 3, 2 * resolution ), 1, true, templateVertices, templateFaces );
+          break;
+        case SHAPE_TORUS:
+          generator.addTorus( origin, 0.35f, 0.15f, std::max( 3, 2 * resolution ), std::max( 3, resolution ), templateVertices, templateFaces );
+          break;
+        case SHAPE_GRID:
+          generator.addGrid( origin, 1.0f, 1.0f, resolution, resolution, templateVertices, templateFaces );
+          break;
+        default:
+          buildCubeTemplate();
+          break;
+      }
 
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 1.0f, 0.0f );
-      txt[ 0 ].set( 1.0f, 0.0f, 0.0f );
-      faces[ 0 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 0.0f, 1.0f, 0.0f );
-      txt[ 0 ].set( 1.0f, 1.0f, 0.0f );
-      faces[ 1 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 0.0f, 0.0f );
-      txt[ 0 ].set( 1.0f, 1.0f, 0.0f );
-      faces[ 2 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 1.0f, 0.0f );
-      txt[ 0 ].set( 0.0f, 1.0f, 0.0f );
-      faces[ 3 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 0.0f, 0.0f );
-      txt[ 0 ].set( 1.0f, 1.0f, 0.0f );
-      faces[ 4 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 1.0f, 0.0f );
-      txt[ 0 ].set( 0.0f, 1.0f, 0.0f );
-      faces[ 5 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 0.0f, 0.0f );
-      txt[ 0 ].set( 1.0f, 1.0f, 0.0f );
-      faces[ 6 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 1.0f, 0.0f );
-      txt[ 0 ].set( 0.0f, 1.0f, 0.0f );
-      faces[ 7 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 0.0f, 0.0f );
-      txt[ 0 ].set( 1.0f, 1.0f, 0.0f );
-      faces[ 8 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 1.0f, 0.0f );
-      txt[ 0 ].set( 0.0f, 1.0f, 0.0f );
-      faces[ 9 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 0.0f, 0.0f );
-      txt[ 0 ].set( 1.0f, 1.0f, 0.0f );
-      faces[ 10 ].setTextureCoordinates( txt );
-
-      txt[ 2 ].set( 0.0f, 0.0f, 0.0f );
-      txt[ 1 ].set( 1.0f, 1.0f, 0.0f );
-      txt[ 0 ].set( 0.0f, 1.0f, 0.0f );
-      faces[ 11 ].setTextureCoordinates( txt );
-
-      Object object = scene.addObject( "Cube", vertices, faces );
+      templateShape      = shape;
+      templateResolution = resolution;
+    }
+
+    // rockFrequency
+    static int rockFrequency( const int resolution )
+    {
+      return ( std::max( 1, resolution / 4 ) );
+    }
+
+    // createObject: one object per copy of the template, placed with its "Position".
+    void createObject( Scene& scene, const std::string& name, const Vector& position )
+    {
+      Object object = scene.addObject( name, templateVertices, templateFaces );
       object.setParameter( "Position", position );
     }
 
+    // createRock: a different rock per object, "index" picks it.
+    void createRock( Scene& scene, const int index, const int resolution, const float roughness, const Vector& position )
+    {
+      std::vector< Vector > positions( 1, Vector( 0.0f, 0.0f, 0.0f ) );
+
+      rockVertices.clear();
+      rockFaces.clear();
+      generator.addRocks( positions, 0.5f, rockFrequency( resolution ), roughness, static_cast< unsigned int >( index ), rockVertices, rockFaces );
+
+      Object object = scene.addObject( "Rock", rockVertices, rockFaces );
+      object.setParameter( "Position", position );
+    }
+
+    //--------------------------------------------------
+    // Function: createMerged
+    // All the copies as a single object. The arrays are sized
+    // up front with template copies, then every thread
+    // writes the vertices and faces of its own copies:
+    // positions moved by the offset, indices shifted by the
+    // template size. Copying a template face over a template
+    // face keeps the storage, so the parallel part does not
+    // allocate.
+    //--------------------------------------------------
+    void createMerged( Scene& scene, const std::string& name, const int count, const Vector& offset )
+    {
+      const size_t n = size_t( count );
+      const size_t numVertices = templateVertices.size();
+      const size_t numFaces    = templateFaces.size();
+
+      if ( n * numVertices > size_t( INT_MAX ) )
+      {
+        scene.message( "CmdCreateGeometry: too many vertices for a single object." );
+        return;
+      }
+
+      std::vector< Vertex > vertices( numVertices * n, templateVertices[ 0 ] );
+      std::vector< Face >   faces( numFaces * n, templateFaces[ 0 ] );
+
+      pool.parallelFor( n, 256, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t i = begin; i < end; ++i )
+        {
+          const Vector shift = offset * float( i );
+          const int    first = int( numVertices * i );
+
+          for ( size_t v = 0; v < numVertices; ++v )
+          {
+            vertices[ first + v ].setPosition( templateVertices[ v ].getPosition() + shift );
+          }
+
+          for ( size_t f = 0; f < numFaces; ++f )
+          {
+            Face& face = faces[ numFaces * i + f ];
+            face = templateFaces[ f ];
+
+            const std::vector< int >& ijk = templateFaces[ f ].getIndices();
+            face.setIndices( first + ijk[ 0 ], first + ijk[ 1 ], first + ijk[ 2 ] );
+          }
+        }
+      } );
+
+      scene.addObject( name, vertices, faces );
+    }
+
+    // createMergedRocks: every rock different, generated in place.
+    void createMergedRocks( Scene& scene, const int count, const int resolution, const float roughness, const Vector& offset )
+    {
+      std::vector< Vector > positions( count );
+      for ( int i = 0; i < count; ++i )
+      {
+        positions[ i ] = offset * float( i );
+      }
+
+      std::vector< Vertex > vertices;
+      std::vector< Face >   faces;
+      if ( generator.addRocks( positions, 0.5f, rockFrequency( resolution ), roughness, 0, vertices, faces ) )
+      {
+        scene.addObject( "Rocks", vertices, faces );
+      }
+      else
+      {
+        scene.message( "CmdCreateGeometry: too many vertices for a single object." );
+      }
+    }
+
     // run
     virtual void run ( Cmd* rfEvntCmd )
     {
-      const int cubes     = rfEvntCmd->getParameter< int >( "Cubes" );
-      const Vector offset = rfEvntCmd->getParameter< Vector >( "Offset" );
+      Scene& scene = AppManager::instance()->getCurrentScene();
+
+      const int cubes       = rfEvntCmd->getParameter< int >( "Cubes" );
+      const Vector offset   = rfEvntCmd->getParameter< Vector >( "Offset" );
+      const int mode        = rfEvntCmd->getParameter< int >( "Mode" );
+      const int shape       = rfEvntCmd->getParameter< int >( "Shape" );
+      const int resolution  = std::max( 1, rfEvntCmd->getParameter< int >( "Resolution" ) );
+      const float roughness = rfEvntCmd->getParameter< float >( "Roughness" );
+
+      if ( cubes <= 0 )
+      {
+        return;
+      }
+
+      pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+
+      Stopwatch createTime;
 
-      Vector position( 0.0f, 0.0f, 0.0f );
-      for( int i = 0; i < cubes; ++i )
+      const std::string name = shapeName( shape );
+      if ( shape == SHAPE_ROCK )
+      {
+        if ( mode == MODE_MERGED )
+        {
+          createMergedRocks( scene, cubes, resolution, roughness, offset );
+        }
+        else
+        {
+          for ( int i = 0; i < cubes; ++i )
+          {
+            createRock( scene, i, resolution, roughness, offset * float( i ) );
+          }
+        }
+      }
+      else
       {
-        createCube( position );
-        position += offset;
+        buildTemplate( shape, resolution );
+        if ( templateVertices.empty() )
+        {
+          scene.message( "CmdCreateGeometry: resolution too high for a single object." );
+          return;
+        }
+
+        if ( mode == MODE_MERGED )
+        {
+          createMerged( scene, name + "s", cubes, offset );
+        }
+        else
+        {
+          Vector position( 0.0f, 0.0f, 0.0f );
+          for( int i = 0; i < cubes; ++i )
+          {
+            createObject( scene, name, position );
+            position += offset;
+          }
+        }
       }
+
+      const double ms = createTime.getElapsedMs();
+
+      std::stringstream msg;
+      msg << "CmdCreateGeometry: " << cubes << ( mode == MODE_MERGED ? " merged " : " " ) << name << " objects in " << ms << " ms, "
+          << ( ms > 0.0 ? 1000.0 * cubes / ms : 0.0 ) << " objects/s";
+      scene.message( msg.str() );
+    }
+
+    // shapeName: object name of a shape.
+    static std::string shapeName( const int shape )
+    {
+      static const char* names[] = { "Cube", "Sphere", "GeoSphere", "Cylinder", "Torus", "Grid", "Rock" };
+      return ( ( shape >= SHAPE_CUBE && shape <= SHAPE_ROCK ) ? names[ shape ] : names[ SHAPE_CUBE ] );
     }
+
+  protected:
+
+    ThreadPool         pool;
+    PrimitiveGenerator generator;
+
+    std::vector< Vertex > templateVertices;
+    std::vector< Face >   templateFaces;
+    int                   templateShape;
+    int                   templateResolution;
+
+    std::vector< Vertex > rockVertices;
+    std::vector< Face >   rockFaces;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,315 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/vertex.h>
+#include <rf_sdk/sdk/face.h>
+#include <rf_sdk/sdk/object.h>
+#include <rf_sdk/sdk/curve.h>
+#include <rf_sdk/sdk/key.h>
+#include <rf_sdk/sdk/nodeaccesor.h>
+#include <rf_sdk/tasks/cmdplgsdk.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "mesh_decimator.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// Class: CmdDecimateMesh
+// Collision proxies: every selected object is decimated
+// with quadric error metrics, down to "TargetFaces" faces,
+// or "Ratio" of its faces when that is 0, and no further
+// than "MaxError" units from its surface when that
+// is not 0.
+//
+// The proxy is named after the object plus "Suffix". It is
+// decimated in the local coordinates of the object, so
+// "MaxError" is in local units, and gets the transform of
+// the object: the values and animation curves of Position,
+// Rotation, Scale, Shear and Pivot, so it follows an
+// animated object. A proxy left by an earlier run gets the
+// new geometry through setGeometry(), so its other settings
+// are kept; otherwise a new object is added.
+//--------------------------------------------------
+class CmdDecimateMesh : public CmdPlgSdk
+{
+  public:
+
+    /// Constructor.
+    CmdDecimateMesh() : decimator( pool ) {};
+
+    /// Destructor.
+    virtual ~CmdDecimateMesh( void ) {};
+
+    /// Class id.
+    virtual NL_INT32 getClassId() const
+    {
+      return ( 1529486375 );
+    };
+
+    // getSdkVersion
+    virtual NL_INDEX32 getSdkVersion() const
+    {
+      return ( SdkVersion::SDK_VERSION );
+    }
+
+    /// Get plugin name.
+    virtual std::string getNameId() const
+    {
+      return ( "CmdDecimateMesh" );
+    };
+
+    // getCopyRight()
+    virtual std::string getCopyRight() const
+    {
+      return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+    }
+
+    // getCopyRight()
+    virtual std::string getLongDescription() const
+    {
+      return std::string( "" );
+    }
+
+    // getCopyRight()
+    virtual std::string getShortDescription() const
+    {
+      return std::string( "" );
+    }
+
+    /// Initialize plugin, add properties, etc.
+    virtual void initialize( PlgDescriptor* plgDesc )
+    {
+      std::vector<std::string> noNodes;
+      Ppty objects = Ppty::createPpty( "Objects", noNodes, node_type::TYPE_OBJECT, Ppty::SELECTION_MULTIPLE );
+      plgDesc->addPpty( objects );
+
+      // Faces of each proxy, 0 to use "Ratio".
+      Ppty targetFaces = Ppty::createPpty( "TargetFaces", 0, 0 );
+      plgDesc->addPpty( targetFaces );
+
+      // Fraction of the faces kept, 0 for no count limit.
+      Ppty ratio = Ppty::createPpty( "Ratio", 0.1f, 0.0f, 1.0f );
+      plgDesc->addPpty( ratio );
+
+      // Largest distance from the surface, 0 for no bound.
+      Ppty maxError = Ppty::createPpty( "MaxError", 0.0f, 0.0f );
+      plgDesc->addPpty( maxError );
+
+      Ppty suffix = Ppty::createPpty( "Suffix", std::string( "_proxy" ) );
+      plgDesc->addPpty( suffix );
+    }
+
+    //--------------------------------------------------
+    // Function: readObject
+    // Local positions and indices as the flat arrays the
+    // decimator takes, each thread converting its own range.
+    //--------------------------------------------------
+    void readObject( Object& object, std::vector< float >& positions, std::vector< int >& triangles )
+    {
+      ArrSdkVertex vertices;
+      ArrSdkFaces  faces;
+      object.getVertices( vertices, REF_LOCAL );
+      object.getFaces( faces );
+
+      positions.resize( 3 * vertices.size() );
+      triangles.resize( 3 * faces.size() );
+
+      pool.parallelFor( vertices.size(), 16384, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t v = begin; v < end; ++v )
+        {
+          const Vector position = vertices[ v ].getPosition();
+          positions[ 3 * v ]     = position.getX();
+          positions[ 3 * v + 1 ] = position.getY();
+          positions[ 3 * v + 2 ] = position.getZ();
+        }
+      } );
+
+      pool.parallelFor( faces.size(), 16384, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t f = begin; f < end; ++f )
+        {
+          triangles[ 3 * f ]     = faces[ f ].getI();
+          triangles[ 3 * f + 1 ] = faces[ f ].getJ();
+          triangles[ 3 * f + 2 ] = faces[ f ].getK();
+        }
+      } );
+    }
+
+    // buildProxy: SDK arrays from the decimator output.
+    void buildProxy( ArrSdkVertex& vertices, ArrSdkFaces& faces )
+    {
+      const std::vector< float >& positions = decimator.getPositions();
+      const std::vector< int >&   triangles = decimator.getTriangles();
+
+      vertices.assign( decimator.getNumVertices(), Vertex( Vector( 0.0f, 0.0f, 0.0f ) ) );
+      faces.assign( decimator.getNumTriangles(), Face( 0, 0, 0 ) );
+
+      pool.parallelFor( vertices.size(), 16384, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t v = begin; v < end; ++v )
+        {
+          vertices[ v ].setPosition( Vector( positions[ 3 * v ], positions[ 3 * v + 1 ], positions[ 3 * v + 2 ] ) );
+        }
+      } );
+
+      pool.parallelFor( faces.size(), 16384, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t f = begin; f < end; ++f )
+        {
+          faces[ f ].setIndices( triangles[ 3 * f ], triangles[ 3 * f + 1 ], triangles[ 3 * f + 2 ] );
+        }
+      } );
+    }
+
+    //--------------------------------------------------
+    // Function: copyTransform
+    // The transform parameters of "source" and, per
+    // component, their curves: keys, expression and
+    // behaviours. Parameters the object lacks are skipped.
+    //--------------------------------------------------
+    static void copyTransform( Object& source, Object& target )
+    {
+      static const char* const names[]      = { "Position", "Rotation", "Scale", "Shear", "Pivot" };
+      static const char* const components[] = { ".x", ".y", ".z" };
+
+      for ( size_t k = 0; k < sizeof( names ) / sizeof( names[ 0 ] ); ++k )
+      {
+        const std::string name( names[ k ] );
+        if ( source.getParameterType( name ) != sdk_type::PARAM_TYPE_VECTOR || target.getParameterType( name ) != sdk_type::PARAM_TYPE_VECTOR )
+        {
+          continue;
+        }
+        target.setParameter( name, source.getParameter< Vector >( name ) );
+
+        for ( int c = 0; c < 3; ++c )
+        {
+          Curve from = source.getParameterCurve( name + components[ c ] );
+          Curve to   = target.getParameterCurve( name + components[ c ] );
+
+          std::vector< Key > keys;
+          from.getKeys( keys );
+          to.removeAllKeys();
+          for ( size_t i = 0; i < keys.size(); ++i )
+          {
+            to.addKey( keys[ i ] );
+          }
+          to.setExpression( from.getExpression() );
+          to.setSplineAndExpression( from.isSplineAndExpression() );
+          to.setPreBehaviour( from.getPreBehaviour() );
+          to.setPostBehaviour( from.getPostBehaviour() );
+        }
+      }
+    }
+
+    // run
+    virtual void run ( Cmd* rfEvntCmd )
+    {
+      Scene& scene = AppManager::instance()->getCurrentScene();
+
+      ArrSdkNodeAccesors nodes    = rfEvntCmd->getParameter< ArrSdkNodeAccesors >( "Objects" );
+      const int          faces    = rfEvntCmd->getParameter< int >( "TargetFaces" );
+      const float        ratio    = rfEvntCmd->getParameter< float >( "Ratio" );
+      const float        maxError = rfEvntCmd->getParameter< float >( "MaxError" );
+      const std::string  suffix   = rfEvntCmd->getParameter< std::string >( "Suffix" );
+
+      if ( nodes.empty() )
+      {
+        scene.message( "CmdDecimateMesh: no objects selected." );
+        return;
+      }
+      if ( faces == 0 && ratio <= 0.0f && maxError <= 0.0f )
+      {
+        scene.message( "CmdDecimateMesh: no face count, ratio or error bound given." );
+        return;
+      }
+
+      pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+
+      std::stringstream msg;
+      msg << "CmdDecimateMesh:\n";
+      for ( size_t n = 0; n < nodes.size(); ++n )
+      {
+        Object object = nodes[ n ].asRFObject();
+        if ( object.isNull() )
+        {
+          continue;
+        }
+
+        Stopwatch decimateTime;
+        std::vector< float > positions;
+        std::vector< int >   triangles;
+        readObject( object, positions, triangles );
+
+        const size_t numTriangles = triangles.size() / 3;
+        const size_t target       = faces > 0 ? size_t( faces ) : static_cast< size_t >( std::ceil( ratio * numTriangles ) );
+        if ( !decimator.decimate( positions, triangles, target, maxError ) )
+        {
+          msg << object.getName() << ": " << decimator.getError() << "\n";
+          continue;
+        }
+
+        ArrSdkVertex vertices;
+        ArrSdkFaces  proxyFaces;
+        buildProxy( vertices, proxyFaces );
+
+        const std::string name  = object.getName() + suffix;
+        Object            proxy = scene.getObject( name );
+        if ( proxy.isNull() )
+        {
+          proxy = scene.addObject( name, vertices, proxyFaces );
+        }
+        else
+        {
+          proxy.setGeometry( vertices, proxyFaces );
+        }
+        copyTransform( object, proxy );
+
+        const MeshDecimator::Stats& stats = decimator.getStats();
+        msg << name << ": " << numTriangles << " -> " << decimator.getNumTriangles() << " faces, " << stats.clusters << " clusters, "
+            << stats.passes << " passes, " << stats.lockedVertices << " border vertices, " << decimateTime.getElapsedMs() << " ms\n";
+      }
+      scene.message( msg.str() );
+    }
+
+  protected:
+
+    ThreadPool    pool;
+    MeshDecimator decimator;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_CMD_PLUGIN( CmdDecimateMesh );
+
+/////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,219 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/tasks/cmdplgsdk.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "mesh_file_reader.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// Class: CmdImportMesh
+// Imports an OBJ or PLY file as one object. The file is
+// parsed by MeshFileReader on the scene threads, then the
+// SDK vertices and faces are filled in parallel and handed
+// to a single Scene::addObject call.
+//--------------------------------------------------
+class CmdImportMesh : public CmdPlgSdk
+{
+  public:
+
+    /// Constructor.
+    CmdImportMesh() : reader( pool ) {};
+
+    /// Destructor.
+    virtual ~CmdImportMesh( void ) {};
+
+    /// Class id.
+    virtual NL_INT32 getClassId() const
+    {
+      return ( 1529486371 );
+    };
+
+    // getSdkVersion
+    virtual NL_INDEX32 getSdkVersion() const
+    {
+      return ( SdkVersion::SDK_VERSION );
+    }
+
+    /// Get plugin name.
+    virtual std::string getNameId() const
+    {
+      return ( "CmdImportMesh" );
+    };
+
+    // getCopyRight()
+    virtual std::string getCopyRight() const
+    {
+      return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+    }
+
+    // getCopyRight()
+    virtual std::string getLongDescription() const
+    {
+      return std::string( "" );
+    }
+
+    // getCopyRight()
+    virtual std::string getShortDescription() const
+    {
+      return std::string( "" );
+    }
+
+    /// Initialize plugin, add properties, etc.
+    virtual void initialize( PlgDescriptor* plgDesc )
+    {
+      // .obj or .ply file.
+      Ppty file = Ppty::createPpty( "File", std::string( "" ), Ppty::SELECTION_FILE );
+      plgDesc->addPpty( file );
+
+      // Object name, the file name when empty.
+      Ppty name = Ppty::createPpty( "Name", std::string( "" ) );
+      plgDesc->addPpty( name );
+
+      Ppty textureCoordinates = Ppty::createPpty( "TextureCoordinates", true );
+      plgDesc->addPpty( textureCoordinates );
+    }
+
+    //--------------------------------------------------
+    // Function: buildObject
+    // SDK arrays from the reader output. The arrays are sized
+    // with copies of one vertex and one face, then each
+    // thread sets the positions, indices and texture
+    // coordinates of its own range.
+    //--------------------------------------------------
+    void buildObject( ArrSdkVertex& vertices, ArrSdkFaces& faces )
+    {
+      const std::vector< float >& positions = reader.getPositions();
+      const std::vector< float >& uvs       = reader.getTextureCoordinates();
+      const std::vector< int >&   triangles = reader.getTriangles();
+
+      const size_t numVertices  = reader.getNumVertices();
+      const size_t numTriangles = reader.getNumTriangles();
+
+      vertices.assign( numVertices, Vertex( Vector( 0.0f, 0.0f, 0.0f ) ) );
+      faces.assign( numTriangles, Face( 0, 0, 0 ) );
+
+      pool.parallelFor( numVertices, 16384, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t v = begin; v < end; ++v )
+        {
+          vertices[ v ].setPosition( Vector( positions[ 3 * v ], positions[ 3 * v + 1 ], positions[ 3 * v + 2 ] ) );
+          if ( !uvs.empty() )
+          {
+            vertices[ v ].setTextureCoordinates( Vector( uvs[ 2 * v ], uvs[ 2 * v + 1 ], 0.0f ) );
+          }
+        }
+      } );
+
+      pool.parallelFor( numTriangles, 16384, [&]( size_t begin, size_t end, unsigned int )
+      {
+        std::vector< Vector > txt( 3 );
+        for ( size_t f = begin; f < end; ++f )
+        {
+          const int* ijk = &triangles[ 3 * f ];
+          faces[ f ].setIndices( ijk[ 0 ], ijk[ 1 ], ijk[ 2 ] );
+          if ( !uvs.empty() )
+          {
+            for ( int c = 0; c < 3; ++c )
+            {
+              txt[ c ].set( uvs[ 2 * ijk[ c ] ], uvs[ 2 * ijk[ c ] + 1 ], 0.0f );
+            }
+            faces[ f ].setTextureCoordinates( txt );
+          }
+        }
+      } );
+    }
+
+    // objectName: "name", or the file name without folder and extension.
+    static std::string objectName( const std::string& name, const std::string& path )
+    {
+      if ( !name.empty() )
+      {
+        return ( name );
+      }
+
+      const size_t slash = path.find_last_of( "/\\" );
+      std::string stem = ( slash == std::string::npos ) ? path : path.substr( slash + 1 );
+      const size_t dot = stem.find_last_of( '.' );
+      return ( dot == std::string::npos ? stem : stem.substr( 0, dot ) );
+    }
+
+    // run
+    virtual void run ( Cmd* rfEvntCmd )
+    {
+      Scene& scene = AppManager::instance()->getCurrentScene();
+
+      const std::string path = rfEvntCmd->getParameter< std::string >( "File" );
+      const std::string name = rfEvntCmd->getParameter< std::string >( "Name" );
+      const bool textureCoordinates = rfEvntCmd->getParameter< bool >( "TextureCoordinates" );
+
+      if ( path.empty() )
+      {
+        scene.message( "CmdImportMesh: no file selected." );
+        return;
+      }
+
+      pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+
+      Stopwatch parseTime;
+      if ( !reader.read( path, textureCoordinates ) )
+      {
+        scene.message( "CmdImportMesh: " + reader.getError() );
+        return;
+      }
+      const double parseMs = parseTime.getElapsedMs();
+
+      Stopwatch objectTime;
+      ArrSdkVertex vertices;
+      ArrSdkFaces  faces;
+      buildObject( vertices, faces );
+      scene.addObject( objectName( name, path ), vertices, faces );
+      const double objectMs = objectTime.getElapsedMs();
+
+      std::stringstream msg;
+      msg << "CmdImportMesh: " << reader.getNumVertices() << " vertices, " << reader.getNumTriangles() << " triangles. Parsed in "
+          << parseMs << " ms ( " << ( parseMs > 0.0 ? reader.getFileSize() / ( 1000.0 * parseMs ) : 0.0 ) << " MB/s ), object built in "
+          << objectMs << " ms";
+      scene.message( msg.str() );
+    }
+
+  protected:
+
+    ThreadPool     pool;
+    MeshFileReader reader;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_CMD_PLUGIN( CmdImportMesh );
+
+/////////////////////////////////////////////////////////////////////////////////////////
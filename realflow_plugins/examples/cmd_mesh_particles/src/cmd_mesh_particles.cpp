@@ -0,0 +1,248 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/vertex.h>
+#include <rf_sdk/sdk/face.h>
+#include <rf_sdk/sdk/pb_emitter.h>
+#include <rf_sdk/sdk/pb_particle.h>
+#include <rf_sdk/sdk/hy_mesh.h>
+#include <rf_sdk/sdk/nodeaccesor.h>
+#include <rf_sdk/tasks/cmdplgsdk.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "sparse_block_mesher.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// Class: CmdMeshParticles
+// Meshes the particles of the selected emitters into one
+// surface, through SparseBlockMesher: a density field kept
+// only in the 8x8x8 blocks the particles reach, meshed
+// block by block on the pool.
+//
+// "Radius" is the particle radius, "CellSize" the sample
+// spacing, 0 for half the radius, and "Threshold" the
+// density of the surface. The result goes to the "Mesh"
+// node through setGeometry(), or to a new mesh when none is
+// picked.
+//--------------------------------------------------
+class CmdMeshParticles : public CmdPlgSdk
+{
+  public:
+
+    /// Constructor.
+    CmdMeshParticles() : mesher( pool ) {};
+
+    /// Destructor.
+    virtual ~CmdMeshParticles( void ) {};
+
+    /// Class id.
+    virtual NL_INT32 getClassId() const
+    {
+      return ( 1529486376 );
+    };
+
+    // getSdkVersion
+    virtual NL_INDEX32 getSdkVersion() const
+    {
+      return ( SdkVersion::SDK_VERSION );
+    }
+
+    /// Get plugin name.
+    virtual std::string getNameId() const
+    {
+      return ( "CmdMeshParticles" );
+    };
+
+    // getCopyRight()
+    virtual std::string getCopyRight() const
+    {
+      return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+    }
+
+    // getCopyRight()
+    virtual std::string getLongDescription() const
+    {
+      return std::string( "" );
+    }
+
+    // getCopyRight()
+    virtual std::string getShortDescription() const
+    {
+      return std::string( "" );
+    }
+
+    /// Initialize plugin, add properties, etc.
+    virtual void initialize( PlgDescriptor* plgDesc )
+    {
+      std::vector<std::string> noNodes;
+      Ppty emitters = Ppty::createPpty( "Emitters", noNodes, node_type::TYPE_PB_EMITTER, Ppty::SELECTION_MULTIPLE );
+      plgDesc->addPpty( emitters );
+
+      // Mesh node to write, none to add one.
+      Ppty mesh = Ppty::createPpty( "Mesh", noNodes, node_type::TYPE_GRID_MESH, Ppty::SELECTION_UNIQUE );
+      plgDesc->addPpty( mesh );
+
+      Ppty radius = Ppty::createPpty( "Radius", 0.05f, 0.0f );
+      plgDesc->addPpty( radius );
+
+      // Sample spacing, 0 for half the radius.
+      Ppty cellSize = Ppty::createPpty( "CellSize", 0.0f, 0.0f );
+      plgDesc->addPpty( cellSize );
+
+      // Density of the surface, about 1 deep inside the fluid.
+      Ppty threshold = Ppty::createPpty( "Threshold", 0.15f, 0.0f, 1.0f );
+      plgDesc->addPpty( threshold );
+    }
+
+    //--------------------------------------------------
+    // Function: readParticles
+    // Positions of every emitter appended as the flat array
+    // the mesher takes, each thread converting its own range.
+    //--------------------------------------------------
+    void readParticles( ArrSdkNodeAccesors& nodes, std::vector< float >& positions )
+    {
+      std::vector< PB_Particle > particles;
+      for ( size_t n = 0; n < nodes.size(); ++n )
+      {
+        if ( nodes[ n ].isNull() )
+        {
+          continue;
+        }
+        PB_Emitter emitter = nodes[ n ].asRFPB_Emitter();
+        particles.clear();
+        emitter.getParticles( particles );
+
+        const size_t first = positions.size() / 3;
+        positions.resize( positions.size() + 3 * particles.size() );
+
+        pool.parallelFor( particles.size(), 16384, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t p = begin; p < end; ++p )
+          {
+            const Vector position = particles[ p ].getPosition();
+            float*       out      = &positions[ 3 * ( first + p ) ];
+            out[ 0 ] = position.getX();
+            out[ 1 ] = position.getY();
+            out[ 2 ] = position.getZ();
+          }
+        } );
+      }
+    }
+
+    // buildGeometry: SDK arrays from the mesher output.
+    void buildGeometry( ArrSdkVertex& vertices, ArrSdkFaces& faces )
+    {
+      const std::vector< float >& positions = mesher.getPositions();
+      const std::vector< int >&   triangles = mesher.getTriangles();
+
+      vertices.assign( mesher.getNumVertices(), Vertex( Vector( 0.0f, 0.0f, 0.0f ) ) );
+      faces.assign( mesher.getNumTriangles(), Face( 0, 0, 0 ) );
+
+      pool.parallelFor( vertices.size(), 16384, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t v = begin; v < end; ++v )
+        {
+          vertices[ v ].setPosition( Vector( positions[ 3 * v ], positions[ 3 * v + 1 ], positions[ 3 * v + 2 ] ) );
+        }
+      } );
+
+      pool.parallelFor( faces.size(), 16384, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t f = begin; f < end; ++f )
+        {
+          faces[ f ].setIndices( triangles[ 3 * f ], triangles[ 3 * f + 1 ], triangles[ 3 * f + 2 ] );
+        }
+      } );
+    }
+
+    // run
+    virtual void run ( Cmd* rfEvntCmd )
+    {
+      Scene& scene = AppManager::instance()->getCurrentScene();
+
+      ArrSdkNodeAccesors emitters  = rfEvntCmd->getParameter< ArrSdkNodeAccesors >( "Emitters" );
+      ArrSdkNodeAccesors meshes    = rfEvntCmd->getParameter< ArrSdkNodeAccesors >( "Mesh" );
+      const float        radius    = rfEvntCmd->getParameter< float >( "Radius" );
+      const float        cellSize  = rfEvntCmd->getParameter< float >( "CellSize" );
+      const float        threshold = rfEvntCmd->getParameter< float >( "Threshold" );
+
+      if ( emitters.empty() )
+      {
+        scene.message( "CmdMeshParticles: no emitters selected." );
+        return;
+      }
+
+      pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+
+      Stopwatch            meshTime;
+      std::vector< float > positions;
+      readParticles( emitters, positions );
+      if ( positions.empty() )
+      {
+        scene.message( "CmdMeshParticles: the emitters have no particles." );
+        return;
+      }
+
+      if ( !mesher.build( positions, radius, cellSize > 0.0f ? cellSize : 0.5f * radius, threshold ) )
+      {
+        scene.message( "CmdMeshParticles: " + mesher.getError() );
+        return;
+      }
+
+      ArrSdkVertex vertices;
+      ArrSdkFaces  faces;
+      buildGeometry( vertices, faces );
+
+      HY_Mesh mesh = ( !meshes.empty() && !meshes[ 0 ].isNull() ) ? meshes[ 0 ].asRFGridMesh() : scene.add_HY_Mesh();
+      mesh.setGeometry( vertices, faces );
+
+      const SparseBlockMesher::Stats& stats = mesher.getStats();
+      std::stringstream msg;
+      msg << "CmdMeshParticles: " << positions.size() / 3 << " particles -> " << mesher.getNumVertices() << " vertices, "
+          << mesher.getNumTriangles() << " faces in " << mesh.getName() << "\n"
+          << "cell " << mesher.getCellSize() << ", " << stats.surfaceBlocks << " of " << stats.blocks << " blocks on the surface, "
+          << double( stats.surfaceBytes ) / ( 1024.0 * 1024.0 ) << " MB of surface, " << meshTime.getElapsedMs() << " ms";
+      scene.message( msg.str() );
+    }
+
+  protected:
+
+    ThreadPool        pool;
+    SparseBlockMesher mesher;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_CMD_PLUGIN( CmdMeshParticles );
+
+/////////////////////////////////////////////////////////////////////////////////////////
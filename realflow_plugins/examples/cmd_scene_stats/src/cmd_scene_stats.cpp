@@ -0,0 +1,400 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/nodeaccesor.h>
+#include <rf_sdk/sdk/pb_emitter.h>
+#include <rf_sdk/sdk/hy_griddomain.h>
+#include <rf_sdk/sdk/object.h>
+#include <rf_sdk/sdk/hy_mesh.h>
+#include <rf_sdk/sdk/hy_mesh_vdb.h>
+#include <rf_sdk/tasks/cmdplgsdk.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "stopwatch.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// Class: CmdSceneStats
+// How heavy a scene is before it goes to the farm: the
+// particles, vertices and faces of every emitter, domain,
+// object and mesh with an estimate of their memory and of
+// the cache written per frame. Everything is printed as one
+// table.
+//
+// The SDK is only called from the thread running the
+// command, so the walk over the nodes is serial; turning
+// the counts into estimates is a few multiplications per
+// row and stays on the same loop.
+//
+// Custom particle attributes cannot be listed through the
+// SDK, "Attributes" names the ones to look for as "id:type"
+// pairs like ParticleCacheExport, e.g. "3:float 4:vector".
+//--------------------------------------------------
+class CmdSceneStats : public CmdPlgSdk
+{
+  // Per element estimates, in bytes.
+  enum
+  {
+    PARTICLE_MEMORY    = 192,
+    PARTICLE_DISK      = 110,
+    HY_PARTICLE_MEMORY = 96,
+    HY_PARTICLE_DISK   = 40,
+    VERTEX_MEMORY      = 32,
+    VERTEX_DISK        = 12,
+    FACE_MEMORY        = 16,
+    FACE_DISK          = 12,
+    NAME_WIDTH         = 24
+  };
+
+  // A row of the table.
+  struct NodeStats
+  {
+    NodeStats() : type( "" ), particles( 0 ), vertices( 0 ), faces( 0 ), attributeBytes( 0 ), particleMemory( 0 ), particleDisk( 0 ),
+                  memoryBytes( 0.0 ), diskBytes( 0.0 ) {};
+
+    std::string name;
+    const char* type;
+    size_t      particles;
+    size_t      vertices;
+    size_t      faces;
+    size_t      attributeBytes;
+    size_t      particleMemory;
+    size_t      particleDisk;
+    double      memoryBytes;
+    double      diskBytes;
+  };
+
+  // A custom attribute to look for.
+  struct AttributeSpec
+  {
+    int    id;
+    size_t size;
+  };
+
+  public:
+
+    /// Constructor.
+    CmdSceneStats() {};
+
+    /// Destructor.
+    virtual ~CmdSceneStats( void ) {};
+
+    /// Class id.
+    virtual NL_INT32 getClassId() const
+    {
+      return ( 1529486373 );
+    };
+
+    // getSdkVersion
+    virtual NL_INDEX32 getSdkVersion() const
+    {
+      return ( SdkVersion::SDK_VERSION );
+    }
+
+    /// Get plugin name.
+    virtual std::string getNameId() const
+    {
+      return ( "CmdSceneStats" );
+    };
+
+    // getCopyRight()
+    virtual std::string getCopyRight() const
+    {
+      return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+    }
+
+    // getCopyRight()
+    virtual std::string getLongDescription() const
+    {
+      return std::string( "" );
+    }
+
+    // getCopyRight()
+    virtual std::string getShortDescription() const
+    {
+      return std::string( "" );
+    }
+
+    /// Initialize plugin, add properties, etc.
+    virtual void initialize( PlgDescriptor* plgDesc )
+    {
+      // Custom particle attributes, "id:type" separated by spaces.
+      Ppty attributes = Ppty::createPpty( "Attributes", std::string( "" ) );
+      plgDesc->addPpty( attributes );
+
+      // Fetch the mesh geometry to count vertices and faces, can be slow.
+      Ppty meshes = Ppty::createPpty( "Meshes", false );
+      plgDesc->addPpty( meshes );
+    }
+
+    //--------------------------------------------------
+    // Function: parseAttributes
+    // "id:type" pairs, false for anything else.
+    //--------------------------------------------------
+    static bool parseAttributes( const std::string& text, std::vector< AttributeSpec >& attributes )
+    {
+      std::string spaced( text );
+      std::replace( spaced.begin(), spaced.end(), ',', ' ' );
+      std::replace( spaced.begin(), spaced.end(), ':', ' ' );
+
+      const char*  names[] = { "float", "double", "int", "char", "bool", "vector" };
+      const size_t sizes[] = { 4, 8, 4, 1, 1, 12 };
+
+      std::istringstream words( spaced );
+      int         id = 0;
+      std::string type;
+      while ( words >> id )
+      {
+        if ( !( words >> type ) )
+        {
+          return ( false );
+        }
+
+        const size_t k = std::find( names, names + 6, type ) - names;
+        if ( k == 6 )
+        {
+          return ( false );
+        }
+
+        AttributeSpec spec;
+        spec.id   = id;
+        spec.size = sizes[ k ];
+        attributes.push_back( spec );
+      }
+      return ( words.eof() );
+    }
+
+    // emitterStats
+    static void emitterStats( PB_Emitter& emitter, const std::vector< AttributeSpec >& attributes, NodeStats& stats )
+    {
+      stats.name      = emitter.getName();
+      stats.type      = "Particles";
+      stats.particles = emitter.getNumberOfParticles();
+      for ( size_t a = 0; a < attributes.size(); ++a )
+      {
+        stats.attributeBytes += emitter.queryParticlesAttribute( attributes[ a ].id ) ? attributes[ a ].size : 0;
+      }
+      stats.particleMemory = PARTICLE_MEMORY + stats.attributeBytes;
+      stats.particleDisk   = PARTICLE_DISK + stats.attributeBytes;
+    }
+
+    // domainStats
+    static void domainStats( HY_GridDomain& domain, NodeStats& stats )
+    {
+      stats.name           = domain.getName();
+      stats.type           = "Domain";
+      stats.particles      = domain.getNumberOfParticles();
+      stats.particleMemory = HY_PARTICLE_MEMORY;
+      stats.particleDisk   = HY_PARTICLE_DISK;
+    }
+
+    // objectStats: the disk column is the geometry of an animated export.
+    static void objectStats( Object& object, NodeStats& stats )
+    {
+      stats.name     = object.getName();
+      stats.type     = "Object";
+      stats.vertices = size_t( std::max( 0, object.getNumVertices() ) );
+      stats.faces    = size_t( std::max( 0, object.getNumFaces() ) );
+    }
+
+    // meshStats: the geometry is only fetched when "build" is on.
+    template< class MESH >
+    static void meshStats( MESH& mesh, const char* type, bool build, NodeStats& stats )
+    {
+      stats.name = mesh.getName();
+      stats.type = type;
+      if ( build )
+      {
+        std::pair< ArrSdkVertex, ArrSdkFaces > geometry;
+        mesh.getGeometry( geometry );
+        stats.vertices = geometry.first.size();
+        stats.faces    = geometry.second.size();
+      }
+    }
+
+    // estimate: memory and disk of a row from its counts, no SDK calls.
+    static void estimate( NodeStats& stats )
+    {
+      stats.memoryBytes = double( stats.particles ) * double( stats.particleMemory ) +
+                          double( stats.vertices ) * VERTEX_MEMORY + double( stats.faces ) * FACE_MEMORY;
+      stats.diskBytes   = double( stats.particles ) * double( stats.particleDisk ) +
+                          double( stats.vertices ) * VERTEX_DISK + double( stats.faces ) * FACE_DISK;
+    }
+
+    // countNodes: "n label" for the nodes of "types", empty for none.
+    static std::string countNodes( const std::vector< NL_UINT64 >& nodeTypes, const std::vector< NL_UINT64 >& types, const char* label,
+                                   size_t& counted )
+    {
+      size_t count = 0;
+      for ( size_t k = 0; k < nodeTypes.size(); ++k )
+      {
+        count += ( std::find( types.begin(), types.end(), nodeTypes[ k ] ) != types.end() ) ? 1 : 0;
+      }
+      counted += count;
+
+      std::stringstream text;
+      if ( count > 0 )
+      {
+        text << ", " << count << " " << label;
+      }
+      return ( text.str() );
+    }
+
+    // writeRow: one line of the table.
+    static void writeRow( std::ostream& table, const std::string& name, const std::string& type, size_t particles,
+                          size_t vertices, size_t faces, size_t attributeBytes, double memoryBytes, double diskBytes )
+    {
+      const std::string shortName = ( name.size() > NAME_WIDTH ) ? name.substr( 0, NAME_WIDTH - 3 ) + "..." : name;
+      table << std::left << std::setw( NAME_WIDTH + 2 ) << shortName << std::setw( 11 ) << type << std::right
+            << std::setw( 12 ) << particles << std::setw( 12 ) << vertices << std::setw( 12 ) << faces
+            << std::setw( 8 ) << attributeBytes << std::fixed << std::setprecision( 1 )
+            << std::setw( 12 ) << memoryBytes / 1048576.0 << std::setw( 12 ) << diskBytes / 1048576.0 << "\n";
+    }
+
+    // run
+    virtual void run ( Cmd* rfEvntCmd )
+    {
+      Scene& scene = AppManager::instance()->getCurrentScene();
+
+      std::vector< AttributeSpec > attributes;
+      if ( !parseAttributes( rfEvntCmd->getParameter< std::string >( "Attributes" ), attributes ) )
+      {
+        scene.message( "CmdSceneStats: \"Attributes\" must be \"id:type\" pairs, type float, double, int, char, bool or vector." );
+        return;
+      }
+      const bool buildMeshes = rfEvntCmd->getParameter< bool >( "Meshes" );
+
+      Stopwatch gatherTime;
+
+      std::vector< PB_Emitter >    emitters;
+      std::vector< HY_GridDomain > domains;
+      std::vector< Object >        objects;
+      std::vector< HY_Mesh >       meshes;
+      std::vector< HY_Mesh_VDB >   vdbMeshes;
+      scene.get_PB_Emitters( emitters );
+      scene.get_HY_GridDomains( domains );
+      scene.getObjects( objects );
+      scene.get_HY_Meshes( meshes );
+      scene.get_HY_Meshes_VDB( vdbMeshes );
+
+      // The counts, from the SDK on this thread.
+      std::vector< NodeStats > rows( emitters.size() + domains.size() + objects.size() + meshes.size() + vdbMeshes.size() );
+      size_t row = 0;
+      for ( size_t k = 0; k < emitters.size(); ++k )
+      {
+        emitterStats( emitters[ k ], attributes, rows[ row++ ] );
+      }
+      for ( size_t k = 0; k < domains.size(); ++k )
+      {
+        domainStats( domains[ k ], rows[ row++ ] );
+      }
+      for ( size_t k = 0; k < objects.size(); ++k )
+      {
+        objectStats( objects[ k ], rows[ row++ ] );
+      }
+      for ( size_t k = 0; k < meshes.size(); ++k )
+      {
+        meshStats( meshes[ k ], "Mesh", buildMeshes, rows[ row++ ] );
+      }
+      for ( size_t k = 0; k < vdbMeshes.size(); ++k )
+      {
+        meshStats( vdbMeshes[ k ], "VDB mesh", buildMeshes, rows[ row++ ] );
+      }
+
+      ArrSdkNodeAccesors nodes;
+      scene.getNodes( nodes );
+      std::vector< NL_UINT64 > nodeTypes( nodes.size() );
+      for ( size_t k = 0; k < nodes.size(); ++k )
+      {
+        nodeTypes[ k ] = nodes[ k ].getType();
+      }
+
+      for ( size_t k = 0; k < rows.size(); ++k )
+      {
+        estimate( rows[ k ] );
+      }
+
+      const double gatherMs = gatherTime.getElapsedMs();
+
+      std::stringstream table;
+      table << "CmdSceneStats: " << nodes.size() << " nodes";
+      size_t counted = 0;
+      std::vector< NL_UINT64 > emitterTypes( 1, node_type::TYPE_PB_EMITTER );
+      std::vector< NL_UINT64 > domainTypes( 1, node_type::TYPE_GRID_DOMAIN );
+      std::vector< NL_UINT64 > objectTypes( 1, node_type::TYPE_OBJECT );
+      std::vector< NL_UINT64 > meshTypes( 1, node_type::TYPE_GRID_MESH );
+      std::vector< NL_UINT64 > daemonTypes( 1, node_type::TYPE_DAEMON );
+      domainTypes.push_back( node_type::TYPE_HY_DOMAIN );
+      meshTypes.push_back( node_type::TYPE_HY_MESH );
+      meshTypes.push_back( node_type::TYPE_HY_MESH_VDB );
+
+      table << countNodes( nodeTypes, emitterTypes, "particle emitters", counted )
+            << countNodes( nodeTypes, domainTypes, "domains", counted )
+            << countNodes( nodeTypes, objectTypes, "objects", counted )
+            << countNodes( nodeTypes, meshTypes, "meshes", counted )
+            << countNodes( nodeTypes, daemonTypes, "daemons", counted );
+      if ( counted < nodes.size() )
+      {
+        table << ", " << nodes.size() - counted << " other";
+      }
+      table << ", gathered in " << gatherMs << " ms\n\n";
+
+      table << std::left << std::setw( NAME_WIDTH + 2 ) << "Node" << std::setw( 11 ) << "Type" << std::right
+            << std::setw( 12 ) << "Particles" << std::setw( 12 ) << "Vertices" << std::setw( 12 ) << "Faces"
+            << std::setw( 8 ) << "Attr B" << std::setw( 12 ) << "Memory MB" << std::setw( 12 ) << "Disk MB/fr" << "\n";
+
+      NodeStats total;
+      for ( size_t k = 0; k < rows.size(); ++k )
+      {
+        const NodeStats& row = rows[ k ];
+        writeRow( table, row.name, row.type, row.particles, row.vertices, row.faces, row.attributeBytes, row.memoryBytes, row.diskBytes );
+
+        total.particles   += row.particles;
+        total.vertices    += row.vertices;
+        total.faces       += row.faces;
+        total.memoryBytes += row.memoryBytes;
+        total.diskBytes   += row.diskBytes;
+      }
+      writeRow( table, "Total", "", total.particles, total.vertices, total.faces, 0, total.memoryBytes, total.diskBytes );
+
+      const int frames = std::max( 0, scene.getMaxFrames() - scene.getMinFrame() );
+      table << "\n" << frames << " frames, about " << std::setprecision( 2 ) << total.diskBytes * frames / 1073741824.0
+            << " GB of caches at the current counts. Memory and disk are estimates per element"
+            << ( buildMeshes ? "." : ", meshes not counted." );
+
+      scene.message( table.str() );
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_CMD_PLUGIN( CmdSceneStats );
+
+/////////////////////////////////////////////////////////////////////////////////////////
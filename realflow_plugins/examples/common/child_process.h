@@ -0,0 +1,266 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_CHILD_PROCESS_H
+#define _RF_EXAMPLES_CHILD_PROCESS_H
+
+#include <string>
+#include <vector>
+#include <cctype>
+
+#include "process_memory.h"
+
+#ifndef _WIN32
+  #include <spawn.h>
+  #include <fcntl.h>
+  #include <cerrno>
+  #include <sys/types.h>
+  #include <sys/wait.h>
+  #include <sys/resource.h>
+
+  extern char** environ;
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: ChildProcess
+    // A program started directly, not through a shell, so the
+    // exit code and peak resident memory kept when it ends
+    // are its own. Polled without blocking, the destructor
+    // waits for it.
+    //--------------------------------------------------
+    class ChildProcess
+    {
+    public:
+
+      /// Constructor.
+      ChildProcess( void ) : running_( false ), exitCode_( -1 ), peakRssMb_( 0.0 )
+      {
+      #ifdef _WIN32
+        process_ = 0;
+      #else
+        pid_ = 0;
+      #endif
+      };
+
+      /// Destructor.
+      ~ChildProcess( void )
+      {
+        wait();
+      }
+
+      //--------------------------------------------------
+      // Function: start
+      // Runs "commandLine", the program and its arguments
+      // separated by spaces, double quotes around an argument
+      // with spaces. The program is searched in the PATH.
+      // Standard output and error go to "logPath" unless it is
+      // empty. False if it cannot be started.
+      //--------------------------------------------------
+      bool start( const std::string& commandLine, const std::string& logPath )
+      {
+        wait();
+        exitCode_  = -1;
+        peakRssMb_ = 0.0;
+
+      #ifdef _WIN32
+        std::vector< char > buffer( commandLine.begin(), commandLine.end() );
+        buffer.push_back( 0 );
+
+        STARTUPINFOA        startup;
+        PROCESS_INFORMATION info;
+        ZeroMemory( &startup, sizeof( startup ) );
+        startup.cb = sizeof( startup );
+
+        HANDLE log = INVALID_HANDLE_VALUE;
+        if ( !logPath.empty() )
+        {
+          SECURITY_ATTRIBUTES inheritable;
+          ZeroMemory( &inheritable, sizeof( inheritable ) );
+          inheritable.nLength        = sizeof( inheritable );
+          inheritable.bInheritHandle = TRUE;
+
+          log = CreateFileA( logPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &inheritable, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0 );
+          if ( log == INVALID_HANDLE_VALUE )
+          {
+            return ( false );
+          }
+          startup.dwFlags    = STARTF_USESTDHANDLES;
+          startup.hStdInput  = GetStdHandle( STD_INPUT_HANDLE );
+          startup.hStdOutput = log;
+          startup.hStdError  = log;
+        }
+
+        const BOOL started = CreateProcessA( 0, buffer.data(), 0, 0, log != INVALID_HANDLE_VALUE, CREATE_NO_WINDOW, 0, 0, &startup, &info );
+        if ( log != INVALID_HANDLE_VALUE )
+        {
+          CloseHandle( log );
+        }
+        if ( !started )
+        {
+          return ( false );
+        }
+        CloseHandle( info.hThread );
+        process_ = info.hProcess;
+      #else
+        const std::vector< std::string > words = splitCommandLine( commandLine );
+        if ( words.empty() )
+        {
+          return ( false );
+        }
+
+        std::vector< char* > argv;
+        for ( size_t k = 0; k < words.size(); ++k )
+        {
+          argv.push_back( const_cast< char* >( words[ k ].c_str() ) );
+        }
+        argv.push_back( 0 );
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init( &actions );
+        if ( !logPath.empty() )
+        {
+          posix_spawn_file_actions_addopen( &actions, 1, logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+          posix_spawn_file_actions_adddup2( &actions, 1, 2 );
+        }
+        const int error = posix_spawnp( &pid_, argv[ 0 ], &actions, 0, argv.data(), environ );
+        posix_spawn_file_actions_destroy( &actions );
+        if ( error != 0 )
+        {
+          return ( false );
+        }
+      #endif
+
+        running_ = true;
+        return ( true );
+      }
+
+      // splitCommandLine: the words of a command line, double quotes group.
+      static std::vector< std::string > splitCommandLine( const std::string& commandLine )
+      {
+        std::vector< std::string > words;
+        size_t i = 0;
+        while ( i < commandLine.size() )
+        {
+          if ( isspace( static_cast< unsigned char >( commandLine[ i ] ) ) )
+          {
+            ++i;
+            continue;
+          }
+
+          std::string word;
+          bool        quoted = false;
+          for ( ; i < commandLine.size() && ( quoted || !isspace( static_cast< unsigned char >( commandLine[ i ] ) ) ); ++i )
+          {
+            if ( commandLine[ i ] == '"' )
+            {
+              quoted = !quoted;
+            }
+            else
+            {
+              word += commandLine[ i ];
+            }
+          }
+          words.push_back( word );
+        }
+        return ( words );
+      }
+
+      // poll: true while the process runs.
+      bool poll( void )
+      {
+        return ( running_ && !reap( false ) );
+      }
+
+      // wait: until the process ends.
+      void wait( void )
+      {
+        if ( running_ )
+        {
+          reap( true );
+        }
+      }
+
+      bool   isRunning( void ) const    { return ( running_ ); }
+      int    getExitCode( void ) const  { return ( exitCode_ ); }
+      double getPeakRssMb( void ) const { return ( peakRssMb_ ); }
+
+    private:
+
+      // reap: collects the process if it has ended, or waits for it when "block".
+      bool reap( bool block )
+      {
+      #ifdef _WIN32
+        if ( WaitForSingleObject( process_, block ? INFINITE : 0 ) != WAIT_OBJECT_0 )
+        {
+          return ( false );
+        }
+
+        DWORD code = 0;
+        exitCode_  = GetExitCodeProcess( process_, &code ) ? int( code ) : -1;
+        peakRssMb_ = ProcessMemory::getPeakRssMb( process_ );
+        CloseHandle( process_ );
+        process_ = 0;
+      #else
+        int           status = 0;
+        struct rusage usage;
+        pid_t         done;
+        do
+        {
+          done = wait4( pid_, &status, block ? 0 : WNOHANG, &usage );
+        }
+        while ( done < 0 && errno == EINTR );
+
+        if ( done == 0 )
+        {
+          return ( false );
+        }
+
+        if ( done == pid_ )
+        {
+          exitCode_  = WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+          peakRssMb_ = ProcessMemory::fromRusage( usage );
+        }
+        pid_ = 0;
+      #endif
+
+        running_ = false;
+        return ( true );
+      }
+
+    private:
+
+      ChildProcess( const ChildProcess& );
+      ChildProcess& operator =( const ChildProcess& );
+
+    private:
+
+      bool   running_;
+      int    exitCode_;
+      double peakRssMb_;
+
+    #ifdef _WIN32
+      HANDLE process_;
+    #else
+      pid_t  pid_;
+    #endif
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_CHILD_PROCESS_H
@@ -0,0 +1,376 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_CONTENT_HASH_H
+#define _RF_EXAMPLES_CONTENT_HASH_H
+
+#include <string>
+#include <cstring>
+#include <cstddef>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define RF_CONTENT_HASH_SSE2
+#include <emmintrin.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Struct: ContentHash128
+    // A 128 bit content hash, written as 32 hex digits.
+    //--------------------------------------------------
+    struct ContentHash128
+    {
+      ContentHash128() : low( 0 ), high( 0 ) {};
+
+      bool operator ==( const ContentHash128& other ) const { return ( low == other.low && high == other.high ); }
+      bool operator !=( const ContentHash128& other ) const { return ( !( *this == other ) ); }
+
+      // toString: high word first.
+      std::string toString( void ) const
+      {
+        static const char digits[] = "0123456789abcdef";
+        std::string text( 32, '0' );
+        for ( int k = 0; k < 16; ++k )
+        {
+          text[ 15 - k ] = digits[ ( high >> ( 4 * k ) ) & 15 ];
+          text[ 31 - k ] = digits[ ( low >> ( 4 * k ) ) & 15 ];
+        }
+        return ( text );
+      }
+
+      // fromString: false unless "text" is 32 hex digits.
+      bool fromString( const std::string& text )
+      {
+        if ( text.size() != 32 )
+        {
+          return ( false );
+        }
+
+        unsigned long long words[ 2 ] = { 0, 0 };
+        for ( size_t i = 0; i < 32; ++i )
+        {
+          const char c = text[ i ];
+          const int  digit = ( c >= '0' && c <= '9' ) ? c - '0' : ( c >= 'a' && c <= 'f' ) ? c - 'a' + 10 :
+                             ( c >= 'A' && c <= 'F' ) ? c - 'A' + 10 : -1;
+          if ( digit < 0 )
+          {
+            return ( false );
+          }
+          words[ i / 16 ] = ( words[ i / 16 ] << 4 ) | static_cast< unsigned long long >( digit );
+        }
+        high = words[ 0 ];
+        low  = words[ 1 ];
+        return ( true );
+      }
+
+      unsigned long long low;
+      unsigned long long high;
+    };
+
+    //--------------------------------------------------
+    // Class: ContentHasher
+    // Streaming 128 bit hash for cache invalidation, not for
+    // security. Input is consumed in 64 byte stripes: eight
+    // 64 bit lanes each add a 32 x 32 bit product of the data
+    // mixed with a key, and the neighbour lane adds the raw
+    // data so no input bit is lost. Every 16 stripes the
+    // lanes are scrambled. The last partial stripe is zero
+    // padded, the total length goes into the final mix.
+    //
+    // The stripe loop runs on SSE2 when the plugin is built
+    // with it, and gives the same hashes as the scalar loop,
+    // so stored hashes stay valid across builds. Byte order
+    // is little endian.
+    //--------------------------------------------------
+    class ContentHasher
+    {
+      enum
+      {
+        LANES             = 8,
+        STRIPE            = 64,
+        STRIPES_PER_BLOCK = 16,
+        SCRAMBLE_KEY      = 24
+      };
+
+    public:
+
+      /// Constructor.
+      ContentHasher( void )
+      {
+        reset();
+      };
+
+      // reset: back to the empty input.
+      void reset( void )
+      {
+        const unsigned long long* key = getSecret();
+        for ( int j = 0; j < LANES; ++j )
+        {
+          acc_[ j ] = key[ j + 4 ];
+        }
+        buffered_ = 0;
+        stripe_   = 0;
+        length_   = 0;
+      }
+
+      //--------------------------------------------------
+      // Function: update
+      // Appends "size" bytes. Whole stripes are hashed from
+      // "data" directly, only a tail is buffered.
+      //--------------------------------------------------
+      void update( const void* data, size_t size )
+      {
+        if ( size == 0 )
+        {
+          return;
+        }
+
+        const unsigned char* p = static_cast< const unsigned char* >( data );
+        length_ += size;
+
+        if ( buffered_ > 0 )
+        {
+          const size_t take = ( size < STRIPE - buffered_ ) ? size : STRIPE - buffered_;
+          std::memcpy( buffer_ + buffered_, p, take );
+          buffered_ += take;
+          p         += take;
+          size      -= take;
+          if ( buffered_ < STRIPE )
+          {
+            return;
+          }
+          consume( buffer_, 1 );
+          buffered_ = 0;
+        }
+
+        const size_t stripes = size / STRIPE;
+        if ( stripes > 0 )
+        {
+          consume( p, stripes );
+          p    += stripes * STRIPE;
+          size -= stripes * STRIPE;
+        }
+
+        if ( size > 0 )
+        {
+          std::memcpy( buffer_, p, size );
+          buffered_ = size;
+        }
+      }
+
+      // updateString: length prefixed, so ( "ab", "c" ) and ( "a", "bc" ) differ.
+      void updateString( const std::string& text )
+      {
+        const unsigned long long size = text.size();
+        update( &size, sizeof( size ) );
+        update( text.data(), text.size() );
+      }
+
+      // updateValue: the bytes of a plain value.
+      template< class T >
+      void updateValue( const T& value )
+      {
+        update( &value, sizeof( T ) );
+      }
+
+      //--------------------------------------------------
+      // Function: finish
+      // Hash of everything so far, more can still be added.
+      //--------------------------------------------------
+      ContentHash128 finish( void ) const
+      {
+        const unsigned long long* key = getSecret();
+
+        unsigned long long acc[ LANES ];
+        std::memcpy( acc, acc_, sizeof( acc ) );
+        if ( buffered_ > 0 )
+        {
+          unsigned char last[ STRIPE ];
+          std::memset( last, 0, sizeof( last ) );
+          std::memcpy( last, buffer_, buffered_ );
+          accumulate( acc, last, 1, key + stripe_ );
+        }
+
+        ContentHash128 hash;
+        hash.low  = length_ * 0x9E3779B185EBCA87ull;
+        hash.high = ~( length_ * 0xC2B2AE3D27D4EB4Full );
+        for ( int j = 0; j < LANES; j += 2 )
+        {
+          hash.low  += mulFold( acc[ j ] ^ key[ j + 1 ], acc[ j + 1 ] ^ key[ j + 2 ] );
+          hash.high += mulFold( acc[ j ] ^ key[ j + 13 ], acc[ j + 1 ] ^ key[ j + 14 ] );
+        }
+        hash.low  = avalanche( hash.low );
+        hash.high = avalanche( hash.high );
+        return ( hash );
+      }
+
+      // hash: of one buffer.
+      static ContentHash128 hash( const void* data, size_t size )
+      {
+        ContentHasher hasher;
+        hasher.update( data, size );
+        return ( hasher.finish() );
+      }
+
+    private:
+
+      static const unsigned long long* getSecret( void )
+      {
+        static const unsigned long long secret[ 32 ] =
+        {
+          0x3C73C479548B5F6Bull, 0xC0697E23B928989Aull, 0xADD7DB17873E28A3ull, 0xCDDC71337C9C8288ull,
+          0x505F25E07ADF35B8ull, 0x6FFB89F27D68A5DFull, 0xA805A8CD9E24EB51ull, 0xA407006B7612CE51ull,
+          0x40D1FA0402A252A7ull, 0xF8BB81126A15DE63ull, 0xBAEFBA040F479006ull, 0x722B97A33DC952F3ull,
+          0x99512602C83B2C00ull, 0xD382DD8F82167F20ull, 0x30740FC289F4CAC2ull, 0xBF798F6463E764AEull,
+          0x6AF11A0C091A06F8ull, 0x97C56F2232D5C0D6ull, 0xD4C1F09B5253BF20ull, 0x12DF2513FB9A5039ull,
+          0xF51D2E0836AA1637ull, 0x7ACDE23EB5C2F8BDull, 0x14E5092861303963ull, 0x9E9F0EBF92EA08FAull,
+          0x7461E34F3539E12Bull, 0xA9BCAC06BAEBD91Aull, 0xE8D18815474EB1ABull, 0x43ADF7AEBF69171Eull,
+          0x54F4901C0870FE3Cull, 0x8D793AEA1CB58000ull, 0xF5EFEFBD857C1FFCull, 0x6D0C5A9E3ADF331Dull
+        };
+        return ( secret );
+      }
+
+      // consume: whole stripes, scrambling at every block end.
+      void consume( const unsigned char* p, size_t stripes )
+      {
+        const unsigned long long* key = getSecret();
+        while ( stripes > 0 )
+        {
+          const size_t run = ( stripes < size_t( STRIPES_PER_BLOCK - stripe_ ) ) ? stripes : size_t( STRIPES_PER_BLOCK - stripe_ );
+          accumulate( acc_, p, run, key + stripe_ );
+          p       += run * STRIPE;
+          stripes -= run;
+          stripe_ += static_cast< unsigned int >( run );
+          if ( stripe_ == STRIPES_PER_BLOCK )
+          {
+            scramble( acc_, key + SCRAMBLE_KEY );
+            stripe_ = 0;
+          }
+        }
+      }
+
+    #if defined( RF_CONTENT_HASH_SSE2 )
+
+      // accumulate: "stripes" stripes, the key moves one word per stripe.
+      static void accumulate( unsigned long long* acc, const unsigned char* p, size_t stripes, const unsigned long long* key )
+      {
+        __m128i* lanes = reinterpret_cast< __m128i* >( acc );
+        __m128i  a0 = _mm_loadu_si128( lanes );
+        __m128i  a1 = _mm_loadu_si128( lanes + 1 );
+        __m128i  a2 = _mm_loadu_si128( lanes + 2 );
+        __m128i  a3 = _mm_loadu_si128( lanes + 3 );
+
+        for ( size_t s = 0; s < stripes; ++s, p += STRIPE, ++key )
+        {
+          const __m128i* data = reinterpret_cast< const __m128i* >( p );
+          const __m128i* k    = reinterpret_cast< const __m128i* >( key );
+          a0 = accumulateLanes( a0, _mm_loadu_si128( data ),     _mm_loadu_si128( k ) );
+          a1 = accumulateLanes( a1, _mm_loadu_si128( data + 1 ), _mm_loadu_si128( k + 1 ) );
+          a2 = accumulateLanes( a2, _mm_loadu_si128( data + 2 ), _mm_loadu_si128( k + 2 ) );
+          a3 = accumulateLanes( a3, _mm_loadu_si128( data + 3 ), _mm_loadu_si128( k + 3 ) );
+        }
+
+        _mm_storeu_si128( lanes,     a0 );
+        _mm_storeu_si128( lanes + 1, a1 );
+        _mm_storeu_si128( lanes + 2, a2 );
+        _mm_storeu_si128( lanes + 3, a3 );
+      }
+
+      // accumulateLanes: two lanes, the product of the mixed halves and the swapped data.
+      static __m128i accumulateLanes( __m128i acc, __m128i data, __m128i key )
+      {
+        const __m128i mixed   = _mm_xor_si128( data, key );
+        const __m128i product = _mm_mul_epu32( mixed, _mm_shuffle_epi32( mixed, _MM_SHUFFLE( 0, 3, 0, 1 ) ) );
+        const __m128i swapped = _mm_shuffle_epi32( data, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+        return ( _mm_add_epi64( acc, _mm_add_epi64( product, swapped ) ) );
+      }
+
+      static void scramble( unsigned long long* acc, const unsigned long long* key )
+      {
+        const __m128i prime = _mm_set1_epi32( static_cast< int >( 0x9E3779B1u ) );
+        for ( int i = 0; i < 4; ++i )
+        {
+          __m128i x = _mm_loadu_si128( reinterpret_cast< const __m128i* >( acc ) + i );
+          x = _mm_xor_si128( _mm_xor_si128( x, _mm_srli_epi64( x, 47 ) ),
+                             _mm_loadu_si128( reinterpret_cast< const __m128i* >( key + 2 * i ) ) );
+
+          // 64 x 32 bit multiply from two 32 x 32 products.
+          const __m128i low  = _mm_mul_epu32( x, prime );
+          const __m128i high = _mm_mul_epu32( _mm_srli_epi64( x, 32 ), prime );
+          _mm_storeu_si128( reinterpret_cast< __m128i* >( acc ) + i, _mm_add_epi64( low, _mm_slli_epi64( high, 32 ) ) );
+        }
+      }
+
+    #else
+
+      static void accumulate( unsigned long long* acc, const unsigned char* p, size_t stripes, const unsigned long long* key )
+      {
+        for ( size_t s = 0; s < stripes; ++s, p += STRIPE, ++key )
+        {
+          for ( int j = 0; j < LANES; ++j )
+          {
+            unsigned long long data;
+            std::memcpy( &data, p + 8 * j, 8 );
+            const unsigned long long mixed = data ^ key[ j ];
+            acc[ j ^ 1 ] += data;
+            acc[ j ]     += ( mixed & 0xFFFFFFFFull ) * ( mixed >> 32 );
+          }
+        }
+      }
+
+      static void scramble( unsigned long long* acc, const unsigned long long* key )
+      {
+        for ( int j = 0; j < LANES; ++j )
+        {
+          acc[ j ] = ( acc[ j ] ^ ( acc[ j ] >> 47 ) ^ key[ j ] ) * 0x9E3779B1ull;
+        }
+      }
+
+    #endif
+
+      // mulFold: the 128 bit product of "a" and "b", its halves xor'ed.
+      static unsigned long long mulFold( unsigned long long a, unsigned long long b )
+      {
+        const unsigned long long mask    = 0xFFFFFFFFull;
+        const unsigned long long lowLow  = ( a & mask ) * ( b & mask );
+        const unsigned long long highLow = ( a >> 32 ) * ( b & mask );
+        const unsigned long long lowHigh = ( a & mask ) * ( b >> 32 );
+        const unsigned long long cross   = ( lowLow >> 32 ) + ( highLow & mask ) + lowHigh;
+        const unsigned long long upper   = ( highLow >> 32 ) + ( cross >> 32 ) + ( a >> 32 ) * ( b >> 32 );
+        return ( ( ( cross << 32 ) | ( lowLow & mask ) ) ^ upper );
+      }
+
+      static unsigned long long avalanche( unsigned long long h )
+      {
+        h ^= h >> 37;
+        h *= 0x165667919E3779F9ull;
+        return ( h ^ ( h >> 32 ) );
+      }
+
+    private:
+
+      unsigned long long acc_[ LANES ];
+      unsigned char      buffer_[ STRIPE ];
+      size_t             buffered_;
+      unsigned int       stripe_;
+      unsigned long long length_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_CONTENT_HASH_H
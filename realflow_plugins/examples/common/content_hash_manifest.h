@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_CONTENT_HASH_MANIFEST_H
+#define _RF_EXAMPLES_CONTENT_HASH_MANIFEST_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+#include "content_hash.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: ContentHashManifest
+    // Node content hashes stored next to a cache, one
+    // "<hash> <node name>" line each. A step that finds the
+    // hashes of its inputs unchanged can keep its output.
+    // Nodes that are gone from the scene have to be erased,
+    // or they would stay in the file forever. A first
+    // "# settings <text>" line records what the hashes cover,
+    // hashes taken with other settings are not comparable.
+    //--------------------------------------------------
+    class ContentHashManifest
+    {
+    public:
+
+      // getPath: the manifest of a cache directory.
+      static std::string getPath( const std::string& directory )
+      {
+        return ( directory + "/content_hashes.txt" );
+      }
+
+      // load: false if the file cannot be read, malformed lines are skipped.
+      bool load( const std::string& path )
+      {
+        hashes_.clear();
+        settings_.clear();
+
+        std::ifstream file( path.c_str() );
+        if ( !file )
+        {
+          return ( false );
+        }
+
+        std::string line;
+        static const std::string SETTINGS( "# settings " );
+        while ( std::getline( file, line ) )
+        {
+          if ( line.compare( 0, SETTINGS.size(), SETTINGS ) == 0 )
+          {
+            settings_ = line.substr( SETTINGS.size() );
+            continue;
+          }
+
+          ContentHash128 hash;
+          if ( line.size() > 33 && line[ 32 ] == ' ' && hash.fromString( line.substr( 0, 32 ) ) )
+          {
+            hashes_[ line.substr( 33 ) ] = hash;
+          }
+        }
+        return ( true );
+      }
+
+      // save: false if the file cannot be written.
+      bool save( const std::string& path ) const
+      {
+        std::ofstream file( path.c_str() );
+        file << "# settings " << settings_ << "\n";
+        for ( std::map< std::string, ContentHash128 >::const_iterator it = hashes_.begin(); it != hashes_.end(); ++it )
+        {
+          file << it->second.toString() << " " << it->first << "\n";
+        }
+        return ( bool( file ) );
+      }
+
+      // find: false when "name" has no hash.
+      bool find( const std::string& name, ContentHash128& hash ) const
+      {
+        std::map< std::string, ContentHash128 >::const_iterator it = hashes_.find( name );
+        if ( it == hashes_.end() )
+        {
+          return ( false );
+        }
+        hash = it->second;
+        return ( true );
+      }
+
+      // getNames: every node with a hash, sorted.
+      void getNames( std::vector< std::string >& names ) const
+      {
+        names.clear();
+        for ( std::map< std::string, ContentHash128 >::const_iterator it = hashes_.begin(); it != hashes_.end(); ++it )
+        {
+          names.push_back( it->first );
+        }
+      }
+
+      void set( const std::string& name, const ContentHash128& hash ) { hashes_[ name ] = hash; }
+      void erase( const std::string& name )                            { hashes_.erase( name ); }
+      void clear( void )                                               { hashes_.clear(); settings_.clear(); }
+      size_t size( void ) const                                        { return ( hashes_.size() ); }
+
+      void               setSettings( const std::string& settings ) { settings_ = settings; }
+      const std::string& getSettings( void ) const                  { return ( settings_ ); }
+
+    private:
+
+      std::map< std::string, ContentHash128 > hashes_;
+      std::string                             settings_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_CONTENT_HASH_MANIFEST_H
@@ -0,0 +1,501 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_FAST_MATH_H
+#define _RF_EXAMPLES_FAST_MATH_H
+
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define RF_FAST_MATH_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined( __AVX2__ )
+#define RF_FAST_MATH_AVX2
+#include <immintrin.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    namespace fast_math_detail
+    {
+
+      //--------------------------------------------------
+      // Struct: ScalarOps
+      // One lane. With SSE2 the rounding and the rsqrt estimate
+      // go through the same instructions as the vector paths,
+      // so a scalar tail matches the vector body bit for bit.
+      //--------------------------------------------------
+      struct ScalarOps
+      {
+        typedef float F;
+        typedef int   I;
+        enum { WIDTH = 1 };
+
+        static F load( const float* p ) { return ( *p ); }
+        static void store( float* p, F v ) { *p = v; }
+        static F set( float v ) { return ( v ); }
+        static I seti( int v ) { return ( v ); }
+
+        static F add( F a, F b ) { return ( a + b ); }
+        static F sub( F a, F b ) { return ( a - b ); }
+        static F mul( F a, F b ) { return ( a * b ); }
+        static F div( F a, F b ) { return ( a / b ); }
+        static F neg( F a ) { return ( -a ); }
+        static F minimum( F a, F b ) { return ( a < b ? a : b ); }
+        static F maximum( F a, F b ) { return ( a > b ? a : b ); }
+        static F sqrt( F a ) { return ( std::sqrt( a ) ); }
+
+        static F rsqrtEstimate( F a )
+        {
+#if defined( RF_FAST_MATH_SSE2 )
+          return ( _mm_cvtss_f32( _mm_rsqrt_ss( _mm_set_ss( a ) ) ) );
+#else
+          // Magic constant estimate and one Newton step, ~1.8e-3 relative.
+          I bits = asInt( a );
+          F y    = asFloat( 0x5f375a86 - ( bits >> 1 ) );
+          return ( y * ( 1.5f - 0.5f * a * y * y ) );
+#endif
+        }
+
+        static I roundToInt( F a )
+        {
+#if defined( RF_FAST_MATH_SSE2 )
+          return ( _mm_cvtss_si32( _mm_set_ss( a ) ) );
+#else
+          return ( I( a + ( a >= 0.0f ? 0.5f : -0.5f ) ) );
+#endif
+        }
+
+        static F toFloat( I a ) { return ( F( a ) ); }
+        static I iand( I a, I b ) { return ( a & b ); }
+        static I iadd( I a, I b ) { return ( a + b ); }
+        static I shiftExponent( I a ) { return ( a << 23 ); }
+        static I cmpeq( I a, I b ) { return ( a == b ? -1 : 0 ); }
+        static F select( I mask, F a, F b ) { return ( mask ? a : b ); }
+
+        static F asFloat( I a ) { F f; std::memcpy( &f, &a, sizeof( f ) ); return ( f ); }
+        static I asInt( F a ) { I i; std::memcpy( &i, &a, sizeof( i ) ); return ( i ); }
+      };
+
+#if defined( RF_FAST_MATH_SSE2 )
+
+      // SseOps: four lanes.
+      struct SseOps
+      {
+        typedef __m128  F;
+        typedef __m128i I;
+        enum { WIDTH = 4 };
+
+        static F load( const float* p ) { return ( _mm_loadu_ps( p ) ); }
+        static void store( float* p, F v ) { _mm_storeu_ps( p, v ); }
+        static F set( float v ) { return ( _mm_set1_ps( v ) ); }
+        static I seti( int v ) { return ( _mm_set1_epi32( v ) ); }
+
+        static F add( F a, F b ) { return ( _mm_add_ps( a, b ) ); }
+        static F sub( F a, F b ) { return ( _mm_sub_ps( a, b ) ); }
+        static F mul( F a, F b ) { return ( _mm_mul_ps( a, b ) ); }
+        static F div( F a, F b ) { return ( _mm_div_ps( a, b ) ); }
+        static F neg( F a ) { return ( _mm_xor_ps( a, _mm_set1_ps( -0.0f ) ) ); }
+        static F minimum( F a, F b ) { return ( _mm_min_ps( a, b ) ); }
+        static F maximum( F a, F b ) { return ( _mm_max_ps( a, b ) ); }
+        static F sqrt( F a ) { return ( _mm_sqrt_ps( a ) ); }
+        static F rsqrtEstimate( F a ) { return ( _mm_rsqrt_ps( a ) ); }
+
+        static I roundToInt( F a ) { return ( _mm_cvtps_epi32( a ) ); }
+        static F toFloat( I a ) { return ( _mm_cvtepi32_ps( a ) ); }
+        static I iand( I a, I b ) { return ( _mm_and_si128( a, b ) ); }
+        static I iadd( I a, I b ) { return ( _mm_add_epi32( a, b ) ); }
+        static I shiftExponent( I a ) { return ( _mm_slli_epi32( a, 23 ) ); }
+        static I cmpeq( I a, I b ) { return ( _mm_cmpeq_epi32( a, b ) ); }
+
+        static F select( I mask, F a, F b )
+        {
+          const F m = _mm_castsi128_ps( mask );
+          return ( _mm_or_ps( _mm_and_ps( m, a ), _mm_andnot_ps( m, b ) ) );
+        }
+
+        static F asFloat( I a ) { return ( _mm_castsi128_ps( a ) ); }
+      };
+
+#endif
+
+#if defined( RF_FAST_MATH_AVX2 )
+
+      // Avx2Ops: eight lanes.
+      struct Avx2Ops
+      {
+        typedef __m256  F;
+        typedef __m256i I;
+        enum { WIDTH = 8 };
+
+        static F load( const float* p ) { return ( _mm256_loadu_ps( p ) ); }
+        static void store( float* p, F v ) { _mm256_storeu_ps( p, v ); }
+        static F set( float v ) { return ( _mm256_set1_ps( v ) ); }
+        static I seti( int v ) { return ( _mm256_set1_epi32( v ) ); }
+
+        static F add( F a, F b ) { return ( _mm256_add_ps( a, b ) ); }
+        static F sub( F a, F b ) { return ( _mm256_sub_ps( a, b ) ); }
+        static F mul( F a, F b ) { return ( _mm256_mul_ps( a, b ) ); }
+        static F div( F a, F b ) { return ( _mm256_div_ps( a, b ) ); }
+        static F neg( F a ) { return ( _mm256_xor_ps( a, _mm256_set1_ps( -0.0f ) ) ); }
+        static F minimum( F a, F b ) { return ( _mm256_min_ps( a, b ) ); }
+        static F maximum( F a, F b ) { return ( _mm256_max_ps( a, b ) ); }
+        static F sqrt( F a ) { return ( _mm256_sqrt_ps( a ) ); }
+        static F rsqrtEstimate( F a ) { return ( _mm256_rsqrt_ps( a ) ); }
+
+        static I roundToInt( F a ) { return ( _mm256_cvtps_epi32( a ) ); }
+        static F toFloat( I a ) { return ( _mm256_cvtepi32_ps( a ) ); }
+        static I iand( I a, I b ) { return ( _mm256_and_si256( a, b ) ); }
+        static I iadd( I a, I b ) { return ( _mm256_add_epi32( a, b ) ); }
+        static I shiftExponent( I a ) { return ( _mm256_slli_epi32( a, 23 ) ); }
+        static I cmpeq( I a, I b ) { return ( _mm256_cmpeq_epi32( a, b ) ); }
+        static F select( I mask, F a, F b ) { return ( _mm256_blendv_ps( b, a, _mm256_castsi256_ps( mask ) ) ); }
+
+        static F asFloat( I a ) { return ( _mm256_castsi256_ps( a ) ); }
+      };
+
+#endif
+
+      //--------------------------------------------------
+      // Struct: Kernels
+      // The polynomials, written once over the lane type V.
+      // P is the FastMath::Precision tier, resolved at compile
+      // time.
+      //--------------------------------------------------
+      template < class V >
+      struct Kernels
+      {
+        typedef typename V::F F;
+        typedef typename V::I I;
+
+        // sinCos: reduction by PI/2 to [-PI/4, PI/4], then the quadrant picks sin / cos and signs.
+        template < int P >
+        static void sinCos( F x, F& s, F& c )
+        {
+          const I q = V::roundToInt( V::mul( x, V::set( 0.636619772f ) ) );
+          const F j = V::toFloat( q );
+
+          // FAST: float PI/2 plus its rounding error. BALANCED: cephes,
+          // exact products up to |x| ~ 8192. PRECISE: 8 bit pieces,
+          // exact products up to |x| ~ 1e5.
+          F r;
+          if ( P == 0 )
+          {
+            r = V::sub( V::sub( x, V::mul( j, V::set( 1.57079637f ) ) ), V::mul( j, V::set( -4.37113883e-8f ) ) );
+          }
+          else if ( P == 1 )
+          {
+            r = V::sub( x, V::mul( j, V::set( 1.5703125f ) ) );
+            r = V::sub( r, V::mul( j, V::set( 4.837512969970703125e-4f ) ) );
+            r = V::sub( r, V::mul( j, V::set( 7.54978995489188216e-8f ) ) );
+          }
+          else
+          {
+            r = V::sub( x, V::mul( j, V::set( 1.5703125f ) ) );
+            r = V::sub( r, V::mul( j, V::set( 4.825592041015625e-4f ) ) );
+            r = V::sub( r, V::mul( j, V::set( 1.26659870147705078125e-6f ) ) );
+            r = V::sub( r, V::mul( j, V::set( 9.920935796805404e-10f ) ) );
+          }
+
+          const F r2 = V::mul( r, r );
+          F sr, cr;
+
+          if ( P == 0 )
+          {
+            // Fitted degree 5 / 4.
+            sr = V::mul( r, V::add( V::set( 0.99999849289f ), V::mul( r2, V::add( V::set( -0.16662382309f ), V::mul( r2, V::set( 0.0081500565536f ) ) ) ) ) );
+            cr = V::add( V::set( 0.99998821692f ), V::mul( r2, V::add( V::set( -0.49968548471f ), V::mul( r2, V::set( 0.040362293915f ) ) ) ) );
+          }
+          else if ( P == 1 )
+          {
+            // Cephes sinf / cosf, degree 7 / 8.
+            sr = V::add( r, V::mul( V::mul( r, r2 ), V::add( V::set( -1.6666654611e-1f ), V::mul( r2, V::add( V::set( 8.3321608736e-3f ), V::mul( r2, V::set( -1.9515295891e-4f ) ) ) ) ) ) );
+            cr = V::add( V::sub( V::set( 1.0f ), V::mul( V::set( 0.5f ), r2 ) ),
+                         V::mul( V::mul( r2, r2 ), V::add( V::set( 4.166664568298827e-2f ), V::mul( r2, V::add( V::set( -1.388731625493765e-3f ), V::mul( r2, V::set( 2.443315711809948e-5f ) ) ) ) ) ) );
+          }
+          else
+          {
+            // Taylor, degree 9 / 10.
+            sr = V::add( r, V::mul( V::mul( r, r2 ), V::add( V::set( -1.66666667e-1f ), V::mul( r2, V::add( V::set( 8.33333333e-3f ),
+                 V::mul( r2, V::add( V::set( -1.98412698e-4f ), V::mul( r2, V::set( 2.75573192e-6f ) ) ) ) ) ) ) ) );
+            cr = V::add( V::sub( V::set( 1.0f ), V::mul( V::set( 0.5f ), r2 ) ),
+                         V::mul( V::mul( r2, r2 ), V::add( V::set( 4.16666667e-2f ), V::mul( r2, V::add( V::set( -1.38888889e-3f ),
+                         V::mul( r2, V::add( V::set( 2.48015873e-5f ), V::mul( r2, V::set( -2.75573192e-7f ) ) ) ) ) ) ) ) );
+          }
+
+          const I one = V::seti( 1 );
+          const I two = V::seti( 2 );
+
+          const I swap = V::cmpeq( V::iand( q, one ), one );
+          const F sq   = V::select( swap, cr, sr );
+          const F cq   = V::select( swap, sr, cr );
+
+          s = V::select( V::cmpeq( V::iand( q, two ), two ), V::neg( sq ), sq );
+          c = V::select( V::cmpeq( V::iand( V::iadd( q, one ), two ), two ), V::neg( cq ), cq );
+        }
+
+        // exp: e^x = 2^n e^f, f in [-ln2/2, ln2/2].
+        template < int P >
+        static F exp( F x )
+        {
+          x = V::minimum( V::maximum( x, V::set( -87.0f ) ), V::set( 88.0f ) );
+
+          const I n  = V::roundToInt( V::mul( x, V::set( 1.44269504f ) ) );
+          const F fn = V::toFloat( n );
+          const F f  = V::sub( V::sub( x, V::mul( fn, V::set( 0.693359375f ) ) ), V::mul( fn, V::set( -2.12194440e-4f ) ) );
+
+          F p;
+          if ( P == 0 )
+          {
+            // Fitted degree 3.
+            p = V::add( V::set( 0.99992807358f ), V::mul( f, V::add( V::set( 1.0001641869f ),
+                V::mul( f, V::add( V::set( 0.50496326352f ), V::mul( f, V::set( 0.16566841103f ) ) ) ) ) ) );
+          }
+          else if ( P == 1 )
+          {
+            // Fitted degree 5.
+            p = V::add( V::set( 1.0000000717f ), V::mul( f, V::add( V::set( 0.99999969199f ),
+                V::mul( f, V::add( V::set( 0.49998894851f ), V::mul( f, V::add( V::set( 0.16667574733f ),
+                V::mul( f, V::add( V::set( 0.041915381976f ), V::mul( f, V::set( 0.0082976547931f ) ) ) ) ) ) ) ) ) ) );
+          }
+          else
+          {
+            // Cephes expf, 1 + f + f^2 P( f ).
+            const F poly = V::add( V::set( 5.0000001201e-1f ), V::mul( f, V::add( V::set( 1.6666665459e-1f ),
+                           V::mul( f, V::add( V::set( 4.1665795894e-2f ), V::mul( f, V::add( V::set( 8.3334519073e-3f ),
+                           V::mul( f, V::add( V::set( 1.3981999507e-3f ), V::mul( f, V::set( 1.9875691500e-4f ) ) ) ) ) ) ) ) ) ) );
+            p = V::add( V::add( V::mul( V::mul( f, f ), poly ), f ), V::set( 1.0f ) );
+          }
+
+          return ( V::mul( p, V::asFloat( V::shiftExponent( V::iadd( n, V::seti( 127 ) ) ) ) ) );
+        }
+
+        // rsqrt: hardware estimate, estimate plus one Newton step, or sqrt and divide.
+        template < int P >
+        static F rsqrt( F x )
+        {
+          if ( P == 0 )
+          {
+            return ( V::rsqrtEstimate( x ) );
+          }
+          if ( P == 1 )
+          {
+            const F y = V::rsqrtEstimate( x );
+            return ( V::mul( y, V::sub( V::set( 1.5f ), V::mul( V::mul( V::set( 0.5f ), x ), V::mul( y, y ) ) ) ) );
+          }
+          return ( V::div( V::set( 1.0f ), V::sqrt( x ) ) );
+        }
+
+        // Array loops, whole vectors only; the caller finishes the tail.
+        template < int P >
+        static size_t sinCosArray( const float* x, float* s, float* c, size_t n )
+        {
+          size_t i = 0;
+          for ( ; i + V::WIDTH <= n; i += V::WIDTH )
+          {
+            F vs, vc;
+            sinCos< P >( V::load( x + i ), vs, vc );
+            V::store( s + i, vs );
+            V::store( c + i, vc );
+          }
+          return ( i );
+        }
+
+        template < int P >
+        static size_t expArray( const float* x, float* y, size_t n )
+        {
+          size_t i = 0;
+          for ( ; i + V::WIDTH <= n; i += V::WIDTH )
+          {
+            V::store( y + i, exp< P >( V::load( x + i ) ) );
+          }
+          return ( i );
+        }
+
+        template < int P >
+        static size_t rsqrtArray( const float* x, float* y, size_t n )
+        {
+          size_t i = 0;
+          for ( ; i + V::WIDTH <= n; i += V::WIDTH )
+          {
+            V::store( y + i, rsqrt< P >( V::load( x + i ) ) );
+          }
+          return ( i );
+        }
+      };
+
+#if defined( RF_FAST_MATH_AVX2 )
+      typedef Avx2Ops WideOps;
+#elif defined( RF_FAST_MATH_SSE2 )
+      typedef SseOps WideOps;
+#else
+      typedef ScalarOps WideOps;
+#endif
+
+    } // NameSpace fast_math_detail...
+
+
+    //--------------------------------------------------
+    // Class: FastMath
+    // Float sin / cos, exp and 1/sqrt in three precision
+    // tiers, for wave and force kernels that do not need
+    // libm's double precision. The array versions run 8 lanes
+    // with AVX2 ( when the plugin is built with it ), 4 with
+    // SSE2 and a scalar loop otherwise; the per element
+    // versions inline into plugin loops.
+    //
+    // Max errors against libm in double, measured by
+    // fast_math_bench ( ulp of the exact result in float;
+    // near the zeros of sin / cos the ulp gets tiny, so past
+    // [ -PI, PI ] the absolute error is the useful figure ):
+    //
+    //   sinCos  FAST      200 ulp on [ -PI, PI ], 2.4e-4 abs up to |x| = 8192
+    //           BALANCED  1.6 ulp on [ -PI, PI ], 9.2e-8 abs up to |x| = 8192
+    //           PRECISE   1.6 ulp on [ -PI, PI ], 1.1e-7 abs up to |x| = 1e5
+    //   exp     FAST      1230 ulp ( 7.5e-5 relative )
+    //           BALANCED  2.8 ulp
+    //           PRECISE   1.0 ulp
+    //   rsqrt   FAST      5000 ulp ( 3.3e-4 relative, hardware estimate )
+    //           BALANCED  3.5 ulp ( estimate and one Newton step )
+    //           PRECISE   1.5 ulp ( sqrt and divide )
+    //
+    // exp clamps its input to [ -87, 88 ] ( no denormals, no
+    // infinity ). The rsqrt estimate is vendor specific, so
+    // FAST results differ slightly between CPUs.
+    //--------------------------------------------------
+    class FastMath
+    {
+    public:
+
+      enum Precision
+      {
+        PRECISION_FAST     ,
+        PRECISION_BALANCED ,
+        PRECISION_PRECISE
+      };
+
+    public:
+
+      // sinCos, per element.
+      template < int P >
+      static void sinCos( float x, float& s, float& c )
+      {
+        fast_math_detail::Kernels< fast_math_detail::ScalarOps >::template sinCos< P >( x, s, c );
+      }
+
+      // exp, per element.
+      template < int P >
+      static float exp( float x )
+      {
+        return ( fast_math_detail::Kernels< fast_math_detail::ScalarOps >::template exp< P >( x ) );
+      }
+
+      // rsqrt, per element.
+      template < int P >
+      static float rsqrt( float x )
+      {
+        return ( fast_math_detail::Kernels< fast_math_detail::ScalarOps >::template rsqrt< P >( x ) );
+      }
+
+      //--------------------------------------------------
+      // Function: sinCos
+      // s[ i ] = sin( x[ i ] ), c[ i ] = cos( x[ i ] ). "x" may
+      // be the same array as "s" or "c".
+      //--------------------------------------------------
+      static void sinCos( const float* x, float* s, float* c, size_t n, Precision precision )
+      {
+        switch ( precision )
+        {
+          case PRECISION_FAST:     sinCosArray< PRECISION_FAST >    ( x, s, c, n ); break;
+          case PRECISION_PRECISE:  sinCosArray< PRECISION_PRECISE > ( x, s, c, n ); break;
+          default:                 sinCosArray< PRECISION_BALANCED >( x, s, c, n ); break;
+        }
+      }
+
+      // exp: y[ i ] = e^x[ i ], "y" may be "x".
+      static void exp( const float* x, float* y, size_t n, Precision precision )
+      {
+        switch ( precision )
+        {
+          case PRECISION_FAST:     expArray< PRECISION_FAST >    ( x, y, n ); break;
+          case PRECISION_PRECISE:  expArray< PRECISION_PRECISE > ( x, y, n ); break;
+          default:                 expArray< PRECISION_BALANCED >( x, y, n ); break;
+        }
+      }
+
+      // rsqrt: y[ i ] = 1 / sqrt( x[ i ] ), "y" may be "x".
+      static void rsqrt( const float* x, float* y, size_t n, Precision precision )
+      {
+        switch ( precision )
+        {
+          case PRECISION_FAST:     rsqrtArray< PRECISION_FAST >    ( x, y, n ); break;
+          case PRECISION_PRECISE:  rsqrtArray< PRECISION_PRECISE > ( x, y, n ); break;
+          default:                 rsqrtArray< PRECISION_BALANCED >( x, y, n ); break;
+        }
+      }
+
+      // getPrecisionName
+      static const char* getPrecisionName( Precision precision )
+      {
+        switch ( precision )
+        {
+          case PRECISION_FAST:    return ( "Fast" );
+          case PRECISION_PRECISE: return ( "Precise" );
+          default:                return ( "Balanced" );
+        }
+      }
+
+    private:
+
+      template < int P >
+      static void sinCosArray( const float* x, float* s, float* c, size_t n )
+      {
+        size_t i = fast_math_detail::Kernels< fast_math_detail::WideOps >::template sinCosArray< P >( x, s, c, n );
+        for ( ; i < n; ++i )
+        {
+          sinCos< P >( x[ i ], s[ i ], c[ i ] );
+        }
+      }
+
+      template < int P >
+      static void expArray( const float* x, float* y, size_t n )
+      {
+        size_t i = fast_math_detail::Kernels< fast_math_detail::WideOps >::template expArray< P >( x, y, n );
+        for ( ; i < n; ++i )
+        {
+          y[ i ] = exp< P >( x[ i ] );
+        }
+      }
+
+      template < int P >
+      static void rsqrtArray( const float* x, float* y, size_t n )
+      {
+        size_t i = fast_math_detail::Kernels< fast_math_detail::WideOps >::template rsqrtArray< P >( x, y, n );
+        for ( ; i < n; ++i )
+        {
+          y[ i ] = rsqrt< P >( x[ i ] );
+        }
+      }
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_FAST_MATH_H
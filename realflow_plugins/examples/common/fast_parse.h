@@ -0,0 +1,295 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_FAST_PARSE_H
+#define _RF_EXAMPLES_FAST_PARSE_H
+
+#include <cmath>
+#include <cstring>
+#include <climits>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: FastParse
+    // Number parsing for text mesh formats over a mapped
+    // buffer [ p, end ), without the locale and the zero
+    // terminator strtod needs. Digits are consumed eight at
+    // a time as one 64 bit word ( SWAR ): a word is checked
+    // to be all digits with two masks and turned into its
+    // value with three multiplies, so a typical coordinate
+    // costs two or three word steps instead of a loop per
+    // character. The mantissa keeps 19 significant digits
+    // and is scaled by an exact power of ten, which matches
+    // strtof for every float a mesh exporter writes.
+    //
+    // The functions skip leading blanks, advance "p" past the
+    // number and return false when there is none.
+    //--------------------------------------------------
+    class FastParse
+    {
+    public:
+
+      // isBlank: space or tab.
+      static bool isBlank( char c )
+      {
+        return ( c == ' ' || c == '\t' );
+      }
+
+      // skipBlanks
+      static void skipBlanks( const char*& p, const char* end )
+      {
+        while ( p < end && isBlank( *p ) )
+        {
+          ++p;
+        }
+      }
+
+      // nextLine: "p" after the next line feed, or "end".
+      static const char* nextLine( const char* p, const char* end )
+      {
+        const void* feed = ( p < end ) ? std::memchr( p, '\n', size_t( end - p ) ) : 0;
+        return ( feed ? static_cast< const char* >( feed ) + 1 : end );
+      }
+
+      //--------------------------------------------------
+      // Function: parseInt
+      // Optionally signed decimal integer, false when there
+      // are no digits or the value does not fit a long long.
+      //--------------------------------------------------
+      static bool parseInt( const char*& p, const char* end, long long& value )
+      {
+        skipBlanks( p, end );
+
+        const char* q = p;
+        const bool negative = ( q < end && *q == '-' );
+        if ( q < end && ( *q == '-' || *q == '+' ) )
+        {
+          ++q;
+        }
+
+        unsigned long long mantissa    = 0;
+        int                significant = 0;
+        int                digits      = 0;
+        int                dropped     = 0;
+        q = readDigits( q, end, mantissa, significant, digits, dropped );
+        const unsigned long long limit = (unsigned long long)( LLONG_MAX ) + ( negative ? 1u : 0u );
+        if ( digits == 0 || dropped > 0 || mantissa > limit )
+        {
+          return ( false );
+        }
+
+        p = q;
+        value = !negative ? (long long)( mantissa ) : ( mantissa == limit ? LLONG_MIN : -(long long)( mantissa ) );
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: parseFloat
+      // [-+]digits[.digits][(e|E)[-+]digits], also ".5" and
+      // "5.". inf / nan are not accepted.
+      //--------------------------------------------------
+      static bool parseFloat( const char*& p, const char* end, float& value )
+      {
+        double result = 0.0;
+        if ( !parseDouble( p, end, result ) )
+        {
+          return ( false );
+        }
+        value = float( result );
+        return ( true );
+      }
+
+      static bool parseDouble( const char*& p, const char* end, double& value )
+      {
+        skipBlanks( p, end );
+
+        const char* q = p;
+        const bool negative = ( q < end && *q == '-' );
+        if ( q < end && ( *q == '-' || *q == '+' ) )
+        {
+          ++q;
+        }
+
+        unsigned long long mantissa = 0;
+        int significant = 0;
+        int digits      = 0;
+        int dropped     = 0;
+
+        // Integer part, digits past the 19th only scale.
+        q = readDigits( q, end, mantissa, significant, digits, dropped );
+        int exponent   = dropped;
+        int readDigitCount = digits + dropped;
+
+        if ( q < end && *q == '.' )
+        {
+          ++q;
+          int fractionDigits  = 0;
+          int fractionDropped = 0;
+          q = readDigits( q, end, mantissa, significant, fractionDigits, fractionDropped );
+          exponent       -= fractionDigits;
+          readDigitCount += fractionDigits + fractionDropped;
+        }
+
+        if ( readDigitCount == 0 )
+        {
+          return ( false );
+        }
+
+        if ( q < end && ( *q == 'e' || *q == 'E' ) )
+        {
+          const char* e = q + 1;
+          const bool negativeExponent = ( e < end && *e == '-' );
+          if ( e < end && ( *e == '-' || *e == '+' ) )
+          {
+            ++e;
+          }
+
+          int power = 0;
+          const char* start = e;
+          while ( e < end && isDigit( *e ) )
+          {
+            power = ( power < 100000 ) ? power * 10 + ( *e - '0' ) : power;
+            ++e;
+          }
+
+          if ( e > start )
+          {
+            exponent += negativeExponent ? -power : power;
+            q = e;
+          }
+        }
+
+        double result = double( mantissa );
+        if ( mantissa != 0 )
+        {
+          result = scale( result, exponent );
+        }
+
+        p = q;
+        value = negative ? -result : result;
+        return ( true );
+      }
+
+    private:
+
+      static bool isDigit( char c )
+      {
+        return ( unsigned( c - '0' ) < 10u );
+      }
+
+      // isEightDigits: all eight bytes of the word in '0' .. '9'.
+      static bool isEightDigits( unsigned long long word )
+      {
+        return ( ( ( word & 0xF0F0F0F0F0F0F0F0ull ) | ( ( ( word + 0x0606060606060606ull ) & 0xF0F0F0F0F0F0F0F0ull ) >> 4 ) ) ==
+                 0x3333333333333333ull );
+      }
+
+      // eightDigits: value of eight ascii digits, first digit in the lowest byte.
+      static unsigned int eightDigits( unsigned long long word )
+      {
+        word  = ( word & 0x0F0F0F0F0F0F0F0Full ) * 2561 >> 8;
+        word  = ( word & 0x00FF00FF00FF00FFull ) * 6553601 >> 16;
+        return ( static_cast< unsigned int >( ( word & 0x0000FFFF0000FFFFull ) * 42949672960001ull >> 32 ) );
+      }
+
+      static bool littleEndian( void )
+      {
+        const unsigned int one = 1;
+        unsigned char first;
+        std::memcpy( &first, &one, 1 );
+        return ( first == 1 );
+      }
+
+      //--------------------------------------------------
+      // Function: readDigits
+      // Appends a run of digits to "mantissa" while it has
+      // fewer than 19 "significant" ones; the rest are
+      // "dropped". "digits" counts the appended ones, leading
+      // zeros included.
+      //--------------------------------------------------
+      static const char* readDigits( const char* q, const char* end, unsigned long long& mantissa,
+                                     int& significant, int& digits, int& dropped )
+      {
+        // Leading zeros are not significant.
+        if ( mantissa == 0 )
+        {
+          while ( q < end && *q == '0' )
+          {
+            ++q;
+            ++digits;
+          }
+        }
+
+        static const bool swar = littleEndian();
+        while ( swar && end - q >= 8 && significant + 8 <= 19 )
+        {
+          unsigned long long word;
+          std::memcpy( &word, q, 8 );
+          if ( !isEightDigits( word ) )
+          {
+            break;
+          }
+          mantissa = mantissa * 100000000ull + eightDigits( word );
+          significant += ( mantissa != 0 ) ? 8 : 0;
+          digits += 8;
+          q += 8;
+        }
+
+        while ( q < end && isDigit( *q ) )
+        {
+          if ( significant < 19 )
+          {
+            mantissa = mantissa * 10 + unsigned( *q - '0' );
+            significant += ( mantissa != 0 ) ? 1 : 0;
+            ++digits;
+          }
+          else
+          {
+            ++dropped;
+          }
+          ++q;
+        }
+        return ( q );
+      }
+
+      // scale: value * 10^exponent, exact powers up to 10^22.
+      static double scale( double value, int exponent )
+      {
+        static const double powers[] =
+        {
+          1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        while ( exponent > 22 )
+        {
+          value *= 1e22;
+          exponent -= 22;
+        }
+        while ( exponent < -22 )
+        {
+          value /= 1e22;
+          exponent += 22;
+        }
+        return ( exponent >= 0 ? value * powers[ exponent ] : value / powers[ -exponent ] );
+      }
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_FAST_PARSE_H
@@ -0,0 +1,210 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_FFT_H
+#define _RF_EXAMPLES_FFT_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "thread_pool.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Struct: FftComplex
+    // Plain pair of floats. std::complex< float > products go
+    // through the NaN checking library call unless the
+    // compiler runs with fast math, this one inlines.
+    //--------------------------------------------------
+    struct FftComplex
+    {
+      float re, im;
+
+      FftComplex() : re( 0.0f ), im( 0.0f ) {};
+      FftComplex( float re_, float im_ ) : re( re_ ), im( im_ ) {};
+
+      FftComplex operator +( const FftComplex& b ) const { return ( FftComplex( re + b.re, im + b.im ) ); }
+      FftComplex operator -( const FftComplex& b ) const { return ( FftComplex( re - b.re, im - b.im ) ); }
+      FftComplex operator *( const FftComplex& b ) const { return ( FftComplex( re * b.re - im * b.im, re * b.im + im * b.re ) ); }
+      FftComplex operator *( float s ) const { return ( FftComplex( re * s, im * s ) ); }
+
+      FftComplex conj( void ) const { return ( FftComplex( re, -im ) ); }
+    };
+
+
+    //--------------------------------------------------
+    // Class: Fft2D
+    // In place radix-2 transform of a square N x N grid stored
+    // row major, N a power of two. Rows go in parallel, then
+    // columns, gathered in blocks of 8 so every row read moves
+    // whole cache lines. No normalization: inverse() is the
+    // plain sum over e^( +i k x ), the way ocean spectra are
+    // written.
+    //--------------------------------------------------
+    class Fft2D
+    {
+      enum { COLUMN_BLOCK = 8 };
+
+    public:
+
+      /// Constructor.
+      Fft2D() : size_( 0 ), log2Size_( 0 ) {};
+
+      // setSize: tables for "size" points, a power of two.
+      void setSize( size_t size )
+      {
+        if ( size == size_ )
+        {
+          return;
+        }
+
+        size_     = size;
+        log2Size_ = 0;
+        while ( ( size_t( 1 ) << log2Size_ ) < size_ )
+        {
+          ++log2Size_;
+        }
+
+        bitReverse_.resize( size_ );
+        for ( size_t i = 0; i < size_; ++i )
+        {
+          size_t r = 0;
+          for ( unsigned int b = 0; b < log2Size_; ++b )
+          {
+            r |= ( ( i >> b ) & 1 ) << ( log2Size_ - 1 - b );
+          }
+          bitReverse_[ i ] = static_cast< unsigned int >( r );
+        }
+
+        // e^( +2 PI i k / N ), computed in double.
+        twiddles_.resize( size_ / 2 );
+        for ( size_t k = 0; k < size_ / 2; ++k )
+        {
+          const double angle = 2.0 * 3.14159265358979323846 * double( k ) / double( size_ );
+          twiddles_[ k ] = FftComplex( float( std::cos( angle ) ), float( std::sin( angle ) ) );
+        }
+      }
+
+      size_t getSize( void ) const { return ( size_ ); }
+
+      static bool isPowerOfTwo( size_t n )
+      {
+        return ( n != 0 && ( n & ( n - 1 ) ) == 0 );
+      }
+
+      //--------------------------------------------------
+      // Function: inverse
+      // data[ z * N + x ] = sum data[ kz * N + kx ] e^( +2 PI i ( kx x + kz z ) / N ).
+      //--------------------------------------------------
+      void inverse( FftComplex* data, ThreadPool& pool )
+      {
+        const size_t n = size_;
+
+        pool.parallelFor( n, 4, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t row = begin; row < end; ++row )
+          {
+            transform( data + row * n );
+          }
+        } );
+
+        scratch_.resize( pool.getNumThreads() );
+
+        pool.parallelFor( n / COLUMN_BLOCK + ( n % COLUMN_BLOCK ? 1 : 0 ), 1, [&]( size_t begin, size_t end, unsigned int thread )
+        {
+          std::vector< FftComplex >& scratch = scratch_[ thread ];
+          scratch.resize( COLUMN_BLOCK * n );
+
+          for ( size_t block = begin; block < end; ++block )
+          {
+            const size_t firstColumn = block * COLUMN_BLOCK;
+            const size_t numColumns  = std::min< size_t >( COLUMN_BLOCK, n - firstColumn );
+
+            for ( size_t row = 0; row < n; ++row )
+            {
+              const FftComplex* src = data + row * n + firstColumn;
+              for ( size_t c = 0; c < numColumns; ++c )
+              {
+                scratch[ c * n + row ] = src[ c ];
+              }
+            }
+
+            for ( size_t c = 0; c < numColumns; ++c )
+            {
+              transform( scratch.data() + c * n );
+            }
+
+            for ( size_t row = 0; row < n; ++row )
+            {
+              FftComplex* dst = data + row * n + firstColumn;
+              for ( size_t c = 0; c < numColumns; ++c )
+              {
+                dst[ c ] = scratch[ c * n + row ];
+              }
+            }
+          }
+        } );
+      }
+
+    private:
+
+      // transform: 1D iterative decimation in time.
+      void transform( FftComplex* x ) const
+      {
+        const size_t n = size_;
+
+        for ( size_t i = 0; i < n; ++i )
+        {
+          const size_t j = bitReverse_[ i ];
+          if ( i < j )
+          {
+            std::swap( x[ i ], x[ j ] );
+          }
+        }
+
+        for ( size_t half = 1, stride = n / 2; half < n; half <<= 1, stride >>= 1 )
+        {
+          for ( size_t start = 0; start < n; start += 2 * half )
+          {
+            for ( size_t k = 0; k < half; ++k )
+            {
+              const FftComplex t = x[ start + k + half ] * twiddles_[ k * stride ];
+              const FftComplex u = x[ start + k ];
+              x[ start + k ]        = u + t;
+              x[ start + k + half ] = u - t;
+            }
+          }
+        }
+      }
+
+    private:
+
+      size_t       size_;
+      unsigned int log2Size_;
+
+      std::vector< unsigned int > bitReverse_;
+      std::vector< FftComplex >   twiddles_;
+
+      // Per thread column blocks.
+      std::vector< std::vector< FftComplex > > scratch_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_FFT_H
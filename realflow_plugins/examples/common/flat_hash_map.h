@@ -0,0 +1,176 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_FLAT_HASH_MAP_H
+#define _RF_EXAMPLES_FLAT_HASH_MAP_H
+
+#include <vector>
+#include <cstddef>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: FlatIndexMap
+    // 64 bit key to unsigned int map in one open addressed
+    // array with linear probing: a lookup is a hash and a
+    // short scan of adjacent slots, no node allocations.
+    // Kept at most half full. All keys but EMPTY_KEY are
+    // valid. No erase, clear() keeps the capacity.
+    //--------------------------------------------------
+    class FlatIndexMap
+    {
+    public:
+
+      static const unsigned long long EMPTY_KEY = ~0ull;
+      static const unsigned int       NOT_FOUND = ~0u;
+
+    public:
+
+      /// Constructor.
+      FlatIndexMap() : size_( 0 ), mask_( 0 ) {};
+
+      // reserve: room for "count" keys without growing.
+      void reserve( size_t count )
+      {
+        size_t capacity = 16;
+        while ( capacity < 2 * count )
+        {
+          capacity *= 2;
+        }
+        if ( capacity > slots_.size() )
+        {
+          rehash( capacity );
+        }
+      }
+
+      // clear
+      void clear( void )
+      {
+        for ( size_t s = 0; s < slots_.size(); ++s )
+        {
+          slots_[ s ].key = EMPTY_KEY;
+        }
+        size_ = 0;
+      }
+
+      size_t size( void ) const { return ( size_ ); }
+
+      //--------------------------------------------------
+      // Function: insert
+      // Value of "key", inserting "value" for a new key.
+      // "inserted" tells which of the two happened.
+      //--------------------------------------------------
+      unsigned int insert( unsigned long long key, unsigned int value, bool& inserted )
+      {
+        if ( 2 * ( size_ + 1 ) > slots_.size() )
+        {
+          rehash( slots_.empty() ? 16 : 2 * slots_.size() );
+        }
+
+        for ( size_t s = hash( key ) & mask_; ; s = ( s + 1 ) & mask_ )
+        {
+          Slot& slot = slots_[ s ];
+          if ( slot.key == key )
+          {
+            inserted = false;
+            return ( slot.value );
+          }
+          if ( slot.key == EMPTY_KEY )
+          {
+            slot.key   = key;
+            slot.value = value;
+            ++size_;
+            inserted = true;
+            return ( value );
+          }
+        }
+      }
+
+      // find: NOT_FOUND for a missing key.
+      unsigned int find( unsigned long long key ) const
+      {
+        if ( slots_.empty() )
+        {
+          return ( NOT_FOUND );
+        }
+
+        for ( size_t s = hash( key ) & mask_; ; s = ( s + 1 ) & mask_ )
+        {
+          const Slot& slot = slots_[ s ];
+          if ( slot.key == key )
+          {
+            return ( slot.value );
+          }
+          if ( slot.key == EMPTY_KEY )
+          {
+            return ( NOT_FOUND );
+          }
+        }
+      }
+
+      // hash: 64 bit finalizer, every key bit reaches the low bits.
+      static unsigned long long hash( unsigned long long key )
+      {
+        key ^= key >> 33; key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33; key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33;
+        return ( key );
+      }
+
+    private:
+
+      struct Slot
+      {
+        unsigned long long key;
+        unsigned int       value;
+      };
+
+      void rehash( size_t capacity )
+      {
+        std::vector< Slot > old;
+        old.swap( slots_ );
+
+        Slot empty;
+        empty.key   = EMPTY_KEY;
+        empty.value = 0;
+        slots_.assign( capacity, empty );
+        mask_ = capacity - 1;
+
+        for ( size_t s = 0; s < old.size(); ++s )
+        {
+          if ( old[ s ].key != EMPTY_KEY )
+          {
+            size_t t = hash( old[ s ].key ) & mask_;
+            while ( slots_[ t ].key != EMPTY_KEY )
+            {
+              t = ( t + 1 ) & mask_;
+            }
+            slots_[ t ] = old[ s ];
+          }
+        }
+      }
+
+    private:
+
+      std::vector< Slot > slots_;
+      size_t              size_;
+      size_t              mask_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_FLAT_HASH_MAP_H
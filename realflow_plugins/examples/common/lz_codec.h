@@ -0,0 +1,326 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_LZ_CODEC_H
+#define _RF_EXAMPLES_LZ_CODEC_H
+
+#include <vector>
+#include <cstring>
+#include <cstddef>
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: LzCodec
+    // Byte oriented LZ77 in the LZ4 block layout: sequences
+    // of a token ( literal length : match length, 4 bits
+    // each ), 255-extended lengths, the literals and a 16 bit
+    // match offset. The compressor is greedy with one hash
+    // probe per position and skips faster through data that
+    // does not match, so incompressible input costs little;
+    // decompression is copies only. Tuned for speed, not
+    // ratio: feed it data that is already transformed to
+    // repeat ( deltas, shuffled bytes ).
+    //
+    // decompress() checks every length and offset against
+    // both buffers, a corrupt block returns false.
+    //--------------------------------------------------
+    class LzCodec
+    {
+      enum
+      {
+        HASH_BITS     = 14,
+        MIN_MATCH     = 4,
+        MAX_OFFSET    = 65535,
+        LAST_LITERALS = 5,
+        MATCH_LIMIT   = 12,
+        SKIP_SHIFT    = 6
+      };
+
+    public:
+
+      // getBound: worst case compressed size of "size" bytes.
+      static size_t getBound( size_t size )
+      {
+        return ( size + size / 255 + 16 );
+      }
+
+      //--------------------------------------------------
+      // Function: compress
+      // Replaces "dst" with the compressed block, returns its
+      // size.
+      //--------------------------------------------------
+      static size_t compress( const unsigned char* src, size_t size, std::vector< unsigned char >& dst )
+      {
+        dst.resize( getBound( size ) );
+        unsigned char* op = dst.data();
+
+        size_t anchor = 0;
+        if ( size > MATCH_LIMIT )
+        {
+          // Positions + 1, 0 is empty.
+          std::vector< unsigned int > table( size_t( 1 ) << HASH_BITS, 0 );
+
+          const size_t matchLimit = size - MATCH_LIMIT;
+          const size_t matchEnd   = size - LAST_LITERALS;
+
+          size_t ip = 1;
+          while ( ip < matchLimit )
+          {
+            const unsigned int sequence = read32( src + ip );
+            unsigned int& slot = table[ hash( sequence ) ];
+            size_t ref = size_t( slot ) - 1;
+            slot = static_cast< unsigned int >( ip + 1 );
+
+            if ( ref == size_t( -1 ) || ip - ref > MAX_OFFSET || read32( src + ref ) != sequence )
+            {
+              ip += 1 + ( ( ip - anchor ) >> SKIP_SHIFT );
+              continue;
+            }
+
+            while ( ip > anchor && ref > 0 && src[ ip - 1 ] == src[ ref - 1 ] )
+            {
+              --ip;
+              --ref;
+            }
+
+            const size_t length = MIN_MATCH + matchLength( src + ip + MIN_MATCH, src + ref + MIN_MATCH, src + matchEnd );
+            op = writeSequence( op, src + anchor, ip - anchor, ip - ref, length );
+
+            ip    += length;
+            anchor = ip;
+
+            if ( ip < matchLimit )
+            {
+              table[ hash( read32( src + ip - 2 ) ) ] = static_cast< unsigned int >( ip - 1 );
+            }
+          }
+        }
+
+        op = writeLiterals( op, src + anchor, size - anchor );
+        dst.resize( size_t( op - dst.data() ) );
+        return ( dst.size() );
+      }
+
+      //--------------------------------------------------
+      // Function: decompress
+      // Exactly "dstSize" bytes into "dst", false when the
+      // block is corrupt or does not decode to that size.
+      //--------------------------------------------------
+      static bool decompress( const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize )
+      {
+        const unsigned char* ip    = src;
+        const unsigned char* ipEnd = src + srcSize;
+        unsigned char*       op    = dst;
+        unsigned char*       opEnd = dst + dstSize;
+
+        while ( ip < ipEnd )
+        {
+          const unsigned int token = *ip++;
+
+          size_t literals = token >> 4;
+          if ( literals == 15 && !readLength( ip, ipEnd, literals ) )
+          {
+            return ( false );
+          }
+          if ( literals > size_t( ipEnd - ip ) || literals > size_t( opEnd - op ) )
+          {
+            return ( false );
+          }
+          std::memcpy( op, ip, literals );
+          ip += literals;
+          op += literals;
+
+          // The last sequence has no match.
+          if ( ip == ipEnd )
+          {
+            break;
+          }
+
+          if ( ipEnd - ip < 2 )
+          {
+            return ( false );
+          }
+          const size_t offset = size_t( ip[ 0 ] ) | ( size_t( ip[ 1 ] ) << 8 );
+          ip += 2;
+
+          size_t length = token & 15;
+          if ( length == 15 && !readLength( ip, ipEnd, length ) )
+          {
+            return ( false );
+          }
+          length += MIN_MATCH;
+
+          if ( offset == 0 || offset > size_t( op - dst ) || length > size_t( opEnd - op ) )
+          {
+            return ( false );
+          }
+
+          const unsigned char* match = op - offset;
+          if ( offset >= length )
+          {
+            std::memcpy( op, match, length );
+          }
+          else
+          {
+            // Overlapping copy repeats the last "offset" bytes.
+            for ( size_t k = 0; k < length; ++k )
+            {
+              op[ k ] = match[ k ];
+            }
+          }
+          op += length;
+        }
+        return ( op == opEnd );
+      }
+
+    private:
+
+      static unsigned int read32( const unsigned char* p )
+      {
+        unsigned int value;
+        std::memcpy( &value, p, 4 );
+        return ( value );
+      }
+
+      static unsigned int hash( unsigned int sequence )
+      {
+        return ( ( sequence * 2654435761u ) >> ( 32 - HASH_BITS ) );
+      }
+
+      // countTrailingZeros: of a non zero 64 bit word.
+      static unsigned int countTrailingZeros( unsigned long long word )
+      {
+      #ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64( &index, word );
+        return ( static_cast< unsigned int >( index ) );
+      #else
+        return ( static_cast< unsigned int >( __builtin_ctzll( word ) ) );
+      #endif
+      }
+
+      // isLittleEndian: a constant once compiled.
+      static bool isLittleEndian( void )
+      {
+        const unsigned int one = 1;
+        unsigned char      first;
+        std::memcpy( &first, &one, 1 );
+        return ( first == 1 );
+      }
+
+      // matchLength: equal bytes of "p" and "ref" before "end", eight at a time.
+      static size_t matchLength( const unsigned char* p, const unsigned char* ref, const unsigned char* end )
+      {
+        const unsigned char* start = p;
+        while ( end - p >= 8 )
+        {
+          unsigned long long a, b;
+          std::memcpy( &a, p, 8 );
+          std::memcpy( &b, ref, 8 );
+          if ( a != b )
+          {
+            // Little endian: the first differing byte is the lowest, otherwise the byte loop below finds it.
+            if ( isLittleEndian() )
+            {
+              return ( size_t( p - start ) + countTrailingZeros( a ^ b ) / 8 );
+            }
+            break;
+          }
+          p   += 8;
+          ref += 8;
+        }
+        while ( p < end && *p == *ref )
+        {
+          ++p;
+          ++ref;
+        }
+        return ( size_t( p - start ) );
+      }
+
+      static unsigned char* writeLength( unsigned char* op, size_t length )
+      {
+        while ( length >= 255 )
+        {
+          *op++ = 255;
+          length -= 255;
+        }
+        *op++ = static_cast< unsigned char >( length );
+        return ( op );
+      }
+
+      static bool readLength( const unsigned char*& ip, const unsigned char* ipEnd, size_t& length )
+      {
+        unsigned int byte = 255;
+        while ( byte == 255 )
+        {
+          if ( ip == ipEnd )
+          {
+            return ( false );
+          }
+          byte    = *ip++;
+          length += byte;
+        }
+        return ( true );
+      }
+
+      static unsigned char* writeSequence( unsigned char* op, const unsigned char* literals, size_t numLiterals,
+                                           size_t offset, size_t length )
+      {
+        const size_t matchCode = length - MIN_MATCH;
+        unsigned char* token = op++;
+        *token = static_cast< unsigned char >( ( ( numLiterals < 15 ? numLiterals : 15 ) << 4 ) | ( matchCode < 15 ? matchCode : 15 ) );
+
+        if ( numLiterals >= 15 )
+        {
+          op = writeLength( op, numLiterals - 15 );
+        }
+        std::memcpy( op, literals, numLiterals );
+        op += numLiterals;
+
+        *op++ = static_cast< unsigned char >( offset & 255 );
+        *op++ = static_cast< unsigned char >( offset >> 8 );
+
+        if ( matchCode >= 15 )
+        {
+          op = writeLength( op, matchCode - 15 );
+        }
+        return ( op );
+      }
+
+      static unsigned char* writeLiterals( unsigned char* op, const unsigned char* literals, size_t numLiterals )
+      {
+        *op++ = static_cast< unsigned char >( ( numLiterals < 15 ? numLiterals : 15 ) << 4 );
+        if ( numLiterals >= 15 )
+        {
+          op = writeLength( op, numLiterals - 15 );
+        }
+        if ( numLiterals > 0 )
+        {
+          std::memcpy( op, literals, numLiterals );
+        }
+        return ( op + numLiterals );
+      }
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_LZ_CODEC_H
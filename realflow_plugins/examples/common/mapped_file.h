@@ -0,0 +1,306 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_MAPPED_FILE_H
+#define _RF_EXAMPLES_MAPPED_FILE_H
+
+#include <string>
+#include <sstream>
+#include <cstddef>
+#include <cstdio>
+
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: MappedFile
+    // A whole file mapped in memory, read only or created
+    // with a fixed size for writing. Pages are loaded by the
+    // OS when first touched, so a reader only pays for what
+    // it samples. Not copyable, close() or the destructor
+    // unmaps. A file mapped read only stays open for writing
+    // to others, so a writer can keep appending to it.
+    //
+    // A created file is written under a temporary name in the
+    // same directory and only replaces its target in commit(),
+    // with a rename. A reader that still maps the old file
+    // keeps its pages: truncating a mapped file in place would
+    // make the reader fault ( SIGBUS ) on the pages cut off.
+    // Closing a created file without commit() deletes it.
+    //--------------------------------------------------
+    class MappedFile
+    {
+    public:
+
+      /// Constructor.
+      MappedFile() : data_( 0 ), size_( 0 ), writable_( false )
+      {
+      #ifdef _WIN32
+        file_    = INVALID_HANDLE_VALUE;
+        mapping_ = 0;
+      #else
+        file_    = -1;
+      #endif
+      };
+
+      /// Destructor.
+      ~MappedFile( void )
+      {
+        close();
+      }
+
+      // openRead: maps an existing file, false if it cannot be.
+      bool openRead( const std::string& path )
+      {
+        close();
+
+      #ifdef _WIN32
+        file_ = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+        if ( file_ == INVALID_HANDLE_VALUE )
+        {
+          return ( false );
+        }
+
+        LARGE_INTEGER fileSize;
+        if ( !GetFileSizeEx( file_, &fileSize ) || fileSize.QuadPart == 0 )
+        {
+          close();
+          return ( false );
+        }
+        size_ = size_t( fileSize.QuadPart );
+
+        mapping_ = CreateFileMappingA( file_, 0, PAGE_READONLY, 0, 0, 0 );
+        data_    = mapping_ ? static_cast< char* >( MapViewOfFile( mapping_, FILE_MAP_READ, 0, 0, 0 ) ) : 0;
+      #else
+        file_ = ::open( path.c_str(), O_RDONLY );
+        if ( file_ < 0 )
+        {
+          return ( false );
+        }
+
+        struct stat info;
+        if ( fstat( file_, &info ) != 0 || info.st_size == 0 )
+        {
+          close();
+          return ( false );
+        }
+        size_ = size_t( info.st_size );
+
+        void* address = mmap( 0, size_, PROT_READ, MAP_SHARED, file_, 0 );
+        data_ = ( address == MAP_FAILED ) ? 0 : static_cast< char* >( address );
+      #endif
+
+        if ( !data_ )
+        {
+          close();
+          return ( false );
+        }
+
+        writable_ = false;
+        return ( true );
+      }
+
+      // create: maps a new "size" byte file for writing, published as "path" by commit().
+      bool create( const std::string& path, size_t size )
+      {
+        close();
+
+        if ( size == 0 )
+        {
+          return ( false );
+        }
+
+        std::stringstream temporary;
+      #ifdef _WIN32
+        temporary << path << "." << GetCurrentProcessId() << ".tmp";
+      #else
+        temporary << path << "." << getpid() << ".tmp";
+      #endif
+        target_    = path;
+        temporary_ = temporary.str();
+
+      #ifdef _WIN32
+        file_ = CreateFileA( temporary_.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0 );
+        if ( file_ == INVALID_HANDLE_VALUE )
+        {
+          return ( false );
+        }
+
+        const unsigned long long bytes = size;
+        mapping_ = CreateFileMappingA( file_, 0, PAGE_READWRITE, DWORD( bytes >> 32 ), DWORD( bytes & 0xffffffffull ), 0 );
+        data_    = mapping_ ? static_cast< char* >( MapViewOfFile( mapping_, FILE_MAP_WRITE, 0, 0, 0 ) ) : 0;
+      #else
+        file_ = ::open( temporary_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+        if ( file_ < 0 )
+        {
+          temporary_.clear();
+          return ( false );
+        }
+
+        if ( ftruncate( file_, off_t( size ) ) != 0 )
+        {
+          close();
+          return ( false );
+        }
+
+        void* address = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, file_, 0 );
+        data_ = ( address == MAP_FAILED ) ? 0 : static_cast< char* >( address );
+      #endif
+
+        size_ = size;
+
+        if ( !data_ )
+        {
+          close();
+          return ( false );
+        }
+
+        writable_ = true;
+        return ( true );
+      }
+
+      // flush: writes the dirty pages back, blocking.
+      bool flush( void )
+      {
+        if ( !data_ || !writable_ )
+        {
+          return ( false );
+        }
+
+      #ifdef _WIN32
+        return ( FlushViewOfFile( data_, 0 ) != 0 && FlushFileBuffers( file_ ) != 0 );
+      #else
+        return ( msync( data_, size_, MS_SYNC ) == 0 );
+      #endif
+      }
+
+      //--------------------------------------------------
+      // Function: commit
+      // Flushes and unmaps a created file, then renames it over
+      // its target. False, with the temporary file deleted, if
+      // any step fails; on Windows that includes a target some
+      // process still has mapped.
+      //--------------------------------------------------
+      bool commit( void )
+      {
+        if ( !data_ || !writable_ )
+        {
+          return ( false );
+        }
+
+        const bool        flushed   = flush();
+        const std::string target    = target_;
+        const std::string temporary = temporary_;
+        temporary_.clear();
+        close();
+
+      #ifdef _WIN32
+        const bool renamed = flushed && MoveFileExA( temporary.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+      #else
+        const bool renamed = flushed && ::rename( temporary.c_str(), target.c_str() ) == 0;
+      #endif
+        if ( !renamed )
+        {
+          std::remove( temporary.c_str() );
+        }
+        return ( renamed );
+      }
+
+      // close: a created file that was not committed is deleted.
+      void close( void )
+      {
+      #ifdef _WIN32
+        if ( data_ )
+        {
+          UnmapViewOfFile( data_ );
+        }
+        if ( mapping_ )
+        {
+          CloseHandle( mapping_ );
+        }
+        if ( file_ != INVALID_HANDLE_VALUE )
+        {
+          CloseHandle( file_ );
+        }
+        mapping_ = 0;
+        file_    = INVALID_HANDLE_VALUE;
+      #else
+        if ( data_ )
+        {
+          munmap( data_, size_ );
+        }
+        if ( file_ >= 0 )
+        {
+          ::close( file_ );
+        }
+        file_ = -1;
+      #endif
+
+        data_     = 0;
+        size_     = 0;
+        writable_ = false;
+
+        if ( !temporary_.empty() )
+        {
+          std::remove( temporary_.c_str() );
+          temporary_.clear();
+        }
+        target_.clear();
+      }
+
+      bool        isOpen( void ) const  { return ( data_ != 0 ); }
+      size_t      getSize( void ) const { return ( size_ ); }
+      const char* getData( void ) const { return ( data_ ); }
+
+      // getWritableData: null unless the file was created.
+      char* getWritableData( void ) { return ( writable_ ? data_ : 0 ); }
+
+    private:
+
+      MappedFile( const MappedFile& );
+      MappedFile& operator =( const MappedFile& );
+
+    private:
+
+      char*       data_;
+      size_t      size_;
+      bool        writable_;
+      std::string target_;
+      std::string temporary_;
+
+    #ifdef _WIN32
+      HANDLE      file_;
+      HANDLE      mapping_;
+    #else
+      int         file_;
+    #endif
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_MAPPED_FILE_H
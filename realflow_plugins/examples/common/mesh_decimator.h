@@ -0,0 +1,1001 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_MESH_DECIMATOR_H
+#define _RF_EXAMPLES_MESH_DECIMATOR_H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <cmath>
+#include <iterator>
+#include <algorithm>
+
+#include "thread_pool.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: MeshDecimator
+    // Quadric error edge collapse of a triangle mesh given as
+    // flat arrays, xyz per vertex and index triplets, down to
+    // a triangle count, an error bound or both.
+    //
+    // Every vertex carries the sum of the squared distance
+    // quadrics of the planes of its triangles, plus planes
+    // normal to the open borders so they keep their shape.
+    // Collapsing an edge merges the quadrics and moves the
+    // kept vertex to the point of least error. The error is a
+    // sum of squared distances, so "maxError" bounds it in
+    // scene units. A collapse is rejected when it makes the
+    // surface non manifold or flips a triangle.
+    //
+    // Large meshes are split in a grid of clusters by triangle
+    // centroid and the clusters are decimated in parallel,
+    // each one down to its share of the target. Vertices used
+    // by triangles of several clusters are locked: the others
+    // may collapse onto them but they never move, so the
+    // clusters are stitched by construction, every vertex keeps
+    // its global index. A second pass with the grid shifted by
+    // half a cell decimates the old borders, which are then
+    // inside the clusters.
+    //
+    // A cluster's share of the count keeps the triangles on
+    // its border and those already decimated by an earlier
+    // pass, and the rest at the ratio of the whole mesh, so
+    // the clusters end at the same density instead of paying
+    // for their borders with their insides. What the borders
+    // leave over the count is collapsed by a last pass over
+    // the whole, by then small, mesh.
+    //
+    // Quadrics are kept across passes, so the error bound holds
+    // for the whole run, not each pass.
+    //--------------------------------------------------
+    class MeshDecimator
+    {
+    public:
+
+      // Run statistics.
+      struct Stats
+      {
+        Stats() : passes( 0 ), clusters( 0 ), lockedVertices( 0 ), collapses( 0 ) {};
+
+        unsigned int passes;
+        size_t       clusters;
+        size_t       lockedVertices;
+        size_t       collapses;
+      };
+
+      /// Constructor, the pool is borrowed.
+      explicit MeshDecimator( ThreadPool& pool ) : pool_( pool ) {};
+
+      //--------------------------------------------------
+      // Function: decimate
+      // "targetTriangles" 0 means no count limit and
+      // "maxError" 0 no error bound; with neither the mesh is
+      // returned as it is. Degenerate triangles are dropped and
+      // unused vertices removed. False with getError() set on
+      // an index out of range.
+      //--------------------------------------------------
+      bool decimate( const std::vector< float >& positions, const std::vector< int >& triangles, size_t targetTriangles, float maxError )
+      {
+        stats_ = Stats();
+        error_.clear();
+        positions_ = positions;
+        triangles_.clear();
+        triangles_.reserve( triangles.size() );
+
+        const int numVertices = static_cast< int >( positions.size() / 3 );
+        for ( size_t t = 0; t + 2 < triangles.size(); t += 3 )
+        {
+          const int a = triangles[ t ];
+          const int b = triangles[ t + 1 ];
+          const int c = triangles[ t + 2 ];
+          if ( a < 0 || b < 0 || c < 0 || a >= numVertices || b >= numVertices || c >= numVertices )
+          {
+            error_ = "vertex index out of range";
+            triangles_.clear();
+            positions_.clear();
+            return ( false );
+          }
+          if ( a != b && b != c && c != a )
+          {
+            triangles_.push_back( a );
+            triangles_.push_back( b );
+            triangles_.push_back( c );
+          }
+        }
+
+        maxCost_ = double( maxError ) * double( maxError );
+        if ( targetTriangles > 0 || maxError > 0.0f )
+        {
+          initQuadrics();
+          settled_.assign( getNumVertices(), 0 );
+
+          const double ratio = double( targetTriangles ) / std::max< size_t >( getNumTriangles(), 1 );
+          for ( unsigned int pass = 0; pass < NUM_PASSES; ++pass )
+          {
+            // The last pass takes the whole mesh to land on the
+            // count, with an error bound only there is nothing to do.
+            const bool whole = pass + 1 == NUM_PASSES;
+            if ( ( targetTriangles > 0 && getNumTriangles() <= targetTriangles ) || ( whole && targetTriangles == 0 ) )
+            {
+              break;
+            }
+
+            const size_t clusters = runPass( pass, whole, targetTriangles, ratio );
+            ++stats_.passes;
+
+            // A single cluster leaves no borders behind.
+            if ( clusters <= 1 )
+            {
+              break;
+            }
+          }
+          quadrics_.clear();
+          settled_.clear();
+        }
+
+        compact();
+        return ( true );
+      }
+
+      const std::string&          getError( void ) const        { return ( error_ ); }
+      const Stats&                getStats( void ) const        { return ( stats_ ); }
+      size_t                      getNumVertices( void ) const  { return ( positions_.size() / 3 ); }
+      size_t                      getNumTriangles( void ) const { return ( triangles_.size() / 3 ); }
+      const std::vector< float >& getPositions( void ) const    { return ( positions_ ); }
+      const std::vector< int >&   getTriangles( void ) const    { return ( triangles_ ); }
+
+    private:
+
+      enum
+      {
+        NUM_PASSES            = 3,
+        CLUSTERS_PER_THREAD   = 4,
+        MIN_CLUSTER_TRIANGLES = 2048,
+        QUADRIC_SIZE          = 10
+      };
+
+      // A candidate collapse; stale once either version moved on.
+      struct Collapse
+      {
+        double       cost;
+        int          a;
+        int          b;
+        unsigned int versionA;
+        unsigned int versionB;
+
+        bool operator>( const Collapse& other ) const { return ( cost > other.cost ); }
+      };
+
+      typedef std::priority_queue< Collapse, std::vector< Collapse >, std::greater< Collapse > > CollapseQueue;
+
+      // The triangles of a cluster with local vertex numbers.
+      struct ClusterMesh
+      {
+        std::vector< int >                global;
+        std::vector< double >             position;
+        std::vector< double >             quadric;
+        std::vector< unsigned char >      locked;
+        std::vector< unsigned char >      boundary;
+        std::vector< unsigned char >      removed;
+        std::vector< unsigned int >       version;
+        std::vector< int >                triangles;
+        std::vector< unsigned char >      dead;
+        std::vector< std::vector< int > > vertexTriangles;
+        size_t                            alive;
+      };
+
+      // What a cluster hands back: triangles in global numbers and
+      // the quadric added to each locked vertex that absorbed others.
+      struct ClusterResult
+      {
+        ClusterResult() : collapses( 0 ) {};
+
+        std::vector< int >    triangles;
+        std::vector< int >    lockedIds;
+        std::vector< double > lockedQuadrics;
+        size_t                collapses;
+      };
+
+      //--------------------------------------------------
+      // Quadric helpers, the upper triangle of the 4x4 plane
+      // product: aa ab ac ad bb bc bd cc cd dd.
+      //--------------------------------------------------
+      static void addPlane( double* q, double a, double b, double c, double d )
+      {
+        q[ 0 ] += a * a; q[ 1 ] += a * b; q[ 2 ] += a * c; q[ 3 ] += a * d;
+        q[ 4 ] += b * b; q[ 5 ] += b * c; q[ 6 ] += b * d;
+        q[ 7 ] += c * c; q[ 8 ] += c * d;
+        q[ 9 ] += d * d;
+      }
+
+      static double evaluate( const double* q, const double* p )
+      {
+        const double x = p[ 0 ], y = p[ 1 ], z = p[ 2 ];
+        const double e = q[ 0 ] * x * x + 2.0 * q[ 1 ] * x * y + 2.0 * q[ 2 ] * x * z + 2.0 * q[ 3 ] * x
+                       + q[ 4 ] * y * y + 2.0 * q[ 5 ] * y * z + 2.0 * q[ 6 ] * y
+                       + q[ 7 ] * z * z + 2.0 * q[ 8 ] * z
+                       + q[ 9 ];
+        return ( std::max( e, 0.0 ) );
+      }
+
+      static void cross( const double* u, const double* v, double* n )
+      {
+        n[ 0 ] = u[ 1 ] * v[ 2 ] - u[ 2 ] * v[ 1 ];
+        n[ 1 ] = u[ 2 ] * v[ 0 ] - u[ 0 ] * v[ 2 ];
+        n[ 2 ] = u[ 0 ] * v[ 1 ] - u[ 1 ] * v[ 0 ];
+      }
+
+      static double dot( const double* u, const double* v )
+      {
+        return ( u[ 0 ] * v[ 0 ] + u[ 1 ] * v[ 1 ] + u[ 2 ] * v[ 2 ] );
+      }
+
+      // triangleNormal: not normalized, twice the area long.
+      static void triangleNormal( const double* p0, const double* p1, const double* p2, double* n )
+      {
+        const double u[ 3 ] = { p1[ 0 ] - p0[ 0 ], p1[ 1 ] - p0[ 1 ], p1[ 2 ] - p0[ 2 ] };
+        const double v[ 3 ] = { p2[ 0 ] - p0[ 0 ], p2[ 1 ] - p0[ 1 ], p2[ 2 ] - p0[ 2 ] };
+        cross( u, v, n );
+      }
+
+      static unsigned long long edgeKey( int a, int b )
+      {
+        const unsigned int lo = static_cast< unsigned int >( std::min( a, b ) );
+        const unsigned int hi = static_cast< unsigned int >( std::max( a, b ) );
+        return ( ( static_cast< unsigned long long >( lo ) << 32 ) | hi );
+      }
+
+      //--------------------------------------------------
+      // Function: initQuadrics
+      // Unit planes of the triangles, and for every edge used
+      // by one triangle only the plane through the edge normal
+      // to that triangle.
+      //--------------------------------------------------
+      void initQuadrics( void )
+      {
+        const size_t numVertices  = getNumVertices();
+        const size_t numTriangles = getNumTriangles();
+        quadrics_.assign( QUADRIC_SIZE * numVertices, 0.0 );
+
+        std::vector< double > planes( 4 * numTriangles, 0.0 );
+        pool_.parallelFor( numTriangles, 1024, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t t = begin; t < end; ++t )
+          {
+            double p[ 3 ][ 3 ];
+            loadTriangle( t, p );
+
+            double n[ 3 ];
+            triangleNormal( p[ 0 ], p[ 1 ], p[ 2 ], n );
+            const double length = std::sqrt( dot( n, n ) );
+            if ( length > 0.0 )
+            {
+              planes[ 4 * t ]     = n[ 0 ] / length;
+              planes[ 4 * t + 1 ] = n[ 1 ] / length;
+              planes[ 4 * t + 2 ] = n[ 2 ] / length;
+              planes[ 4 * t + 3 ] = -dot( &planes[ 4 * t ], p[ 0 ] );
+            }
+          }
+        } );
+
+        std::vector< std::pair< unsigned long long, size_t > > edges( triangles_.size() );
+        for ( size_t t = 0; t < numTriangles; ++t )
+        {
+          const double* plane = &planes[ 4 * t ];
+          for ( int k = 0; k < 3; ++k )
+          {
+            const int v = triangles_[ 3 * t + k ];
+            addPlane( &quadrics_[ QUADRIC_SIZE * v ], plane[ 0 ], plane[ 1 ], plane[ 2 ], plane[ 3 ] );
+            edges[ 3 * t + k ] = std::make_pair( edgeKey( v, triangles_[ 3 * t + ( k + 1 ) % 3 ] ), t );
+          }
+        }
+
+        std::sort( edges.begin(), edges.end() );
+        for ( size_t e = 0; e < edges.size(); )
+        {
+          size_t run = e + 1;
+          while ( run < edges.size() && edges[ run ].first == edges[ e ].first )
+          {
+            ++run;
+          }
+          if ( run == e + 1 )
+          {
+            const int     a     = static_cast< int >( edges[ e ].first >> 32 );
+            const int     b     = static_cast< int >( edges[ e ].first & 0xffffffffULL );
+            const double* plane = &planes[ 4 * edges[ e ].second ];
+            const double  pa[ 3 ] = { positions_[ 3 * a ], positions_[ 3 * a + 1 ], positions_[ 3 * a + 2 ] };
+            const double  d[ 3 ]  = { positions_[ 3 * b ] - pa[ 0 ], positions_[ 3 * b + 1 ] - pa[ 1 ], positions_[ 3 * b + 2 ] - pa[ 2 ] };
+
+            double n[ 3 ];
+            cross( d, plane, n );
+            const double length = std::sqrt( dot( n, n ) );
+            if ( length > 0.0 )
+            {
+              n[ 0 ] /= length; n[ 1 ] /= length; n[ 2 ] /= length;
+              const double w = -dot( n, pa );
+              addPlane( &quadrics_[ QUADRIC_SIZE * a ], n[ 0 ], n[ 1 ], n[ 2 ], w );
+              addPlane( &quadrics_[ QUADRIC_SIZE * b ], n[ 0 ], n[ 1 ], n[ 2 ], w );
+            }
+          }
+          e = run;
+        }
+      }
+
+      void loadTriangle( size_t t, double p[ 3 ][ 3 ] ) const
+      {
+        for ( int k = 0; k < 3; ++k )
+        {
+          const float* v = &positions_[ 3 * triangles_[ 3 * t + k ] ];
+          p[ k ][ 0 ] = v[ 0 ];
+          p[ k ][ 1 ] = v[ 1 ];
+          p[ k ][ 2 ] = v[ 2 ];
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: runPass
+      // Clusters the triangles, decimates the clusters in
+      // parallel and gathers them back, "whole" in a single
+      // cluster. Returns the number of non empty clusters.
+      //--------------------------------------------------
+      size_t runPass( unsigned int pass, bool whole, size_t targetTriangles, double ratio )
+      {
+        const size_t numTriangles = getNumTriangles();
+        const size_t numVertices  = getNumVertices();
+
+        // Cluster grid over the bounds, cells as cubic as the extents allow.
+        float lo[ 3 ] = {  1e30f,  1e30f,  1e30f };
+        float hi[ 3 ] = { -1e30f, -1e30f, -1e30f };
+        for ( size_t v = 0; v < numVertices; ++v )
+        {
+          for ( int k = 0; k < 3; ++k )
+          {
+            lo[ k ] = std::min( lo[ k ], positions_[ 3 * v + k ] );
+            hi[ k ] = std::max( hi[ k ], positions_[ 3 * v + k ] );
+          }
+        }
+
+        const size_t wanted = whole ? 1 : std::min< size_t >( size_t( CLUSTERS_PER_THREAD ) * pool_.getNumThreads(), numTriangles / MIN_CLUSTER_TRIANGLES );
+        const float  extent = std::max( std::max( hi[ 0 ] - lo[ 0 ], hi[ 1 ] - lo[ 1 ] ), std::max( hi[ 2 ] - lo[ 2 ], 1e-20f ) );
+
+        int dims[ 3 ] = { 1, 1, 1 };
+        for ( int m = 1; m <= 64 && size_t( dims[ 0 ] ) * dims[ 1 ] * dims[ 2 ] < wanted; ++m )
+        {
+          for ( int k = 0; k < 3; ++k )
+          {
+            dims[ k ] = std::max( 1, static_cast< int >( std::ceil( m * ( hi[ k ] - lo[ k ] ) / extent ) ) );
+          }
+        }
+
+        float cell[ 3 ];
+        float origin[ 3 ];
+        for ( int k = 0; k < 3; ++k )
+        {
+          cell[ k ]   = std::max( ( hi[ k ] - lo[ k ] ) / dims[ k ], 1e-20f );
+          origin[ k ] = lo[ k ];
+          if ( pass % 2 == 1 && dims[ k ] > 1 )
+          {
+            origin[ k ] -= 0.5f * cell[ k ];
+            dims[ k ]   += 1;
+          }
+        }
+        const size_t numCells = size_t( dims[ 0 ] ) * dims[ 1 ] * dims[ 2 ];
+
+        // Cluster of every triangle, then the vertices shared by two clusters.
+        std::vector< int > clusterOf( numTriangles );
+        pool_.parallelFor( numTriangles, 4096, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t t = begin; t < end; ++t )
+          {
+            int index = 0;
+            for ( int k = 2; k >= 0; --k )
+            {
+              const float centroid = ( positions_[ 3 * triangles_[ 3 * t ] + k ] + positions_[ 3 * triangles_[ 3 * t + 1 ] + k ]
+                                     + positions_[ 3 * triangles_[ 3 * t + 2 ] + k ] ) / 3.0f;
+              const int   c = std::min( dims[ k ] - 1, std::max( 0, static_cast< int >( ( centroid - origin[ k ] ) / cell[ k ] ) ) );
+              index = index * dims[ k ] + c;
+            }
+            clusterOf[ t ] = index;
+          }
+        } );
+
+        std::vector< int >           owner( numVertices, -1 );
+        std::vector< unsigned char > locked( numVertices, 0 );
+        std::vector< size_t >        start( numCells + 1, 0 );
+        for ( size_t t = 0; t < numTriangles; ++t )
+        {
+          const int c = clusterOf[ t ];
+          ++start[ c + 1 ];
+          for ( int k = 0; k < 3; ++k )
+          {
+            const int v = triangles_[ 3 * t + k ];
+            if ( owner[ v ] < 0 )
+            {
+              owner[ v ] = c;
+            }
+            else if ( owner[ v ] != c )
+            {
+              locked[ v ] = 1;
+            }
+          }
+        }
+        for ( size_t c = 0; c < numCells; ++c )
+        {
+          start[ c + 1 ] += start[ c ];
+        }
+
+        std::vector< size_t > members( numTriangles );
+        {
+          std::vector< size_t > fill( start.begin(), start.end() - 1 );
+          for ( size_t t = 0; t < numTriangles; ++t )
+          {
+            members[ fill[ clusterOf[ t ] ]++ ] = t;
+          }
+        }
+
+        // Largest clusters first, so the threads finish together.
+        std::vector< size_t > order;
+        for ( size_t c = 0; c < numCells; ++c )
+        {
+          if ( start[ c + 1 ] > start[ c ] )
+          {
+            order.push_back( c );
+          }
+        }
+        std::sort( order.begin(), order.end(), [&]( size_t x, size_t y )
+        {
+          return ( start[ x + 1 ] - start[ x ] > start[ y + 1 ] - start[ y ] );
+        } );
+
+        std::vector< ClusterResult > results( order.size() );
+        pool_.parallelFor( order.size(), 1, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t k = begin; k < end; ++k )
+          {
+            const size_t c     = order[ k ];
+            const size_t count = start[ c + 1 ] - start[ c ];
+            const size_t share = order.size() == 1 ? targetTriangles : getShare( &members[ start[ c ] ], count, locked, targetTriangles, ratio );
+            decimateCluster( &members[ start[ c ] ], count, locked, share, results[ k ] );
+          }
+        } );
+
+        // Gather in cluster order; locked vertices get what they absorbed.
+        triangles_.clear();
+        for ( size_t k = 0; k < results.size(); ++k )
+        {
+          const ClusterResult& result = results[ k ];
+          triangles_.insert( triangles_.end(), result.triangles.begin(), result.triangles.end() );
+          for ( size_t i = 0; i < result.lockedIds.size(); ++i )
+          {
+            double* q = &quadrics_[ QUADRIC_SIZE * result.lockedIds[ i ] ];
+            for ( int j = 0; j < QUADRIC_SIZE; ++j )
+            {
+              q[ j ] += result.lockedQuadrics[ QUADRIC_SIZE * i + j ];
+            }
+          }
+          stats_.collapses += result.collapses;
+        }
+
+        stats_.clusters = std::max( stats_.clusters, order.size() );
+        if ( pass == 0 )
+        {
+          stats_.lockedVertices = static_cast< size_t >( std::count( locked.begin(), locked.end(), 1 ) );
+        }
+        return ( order.size() );
+      }
+
+      // getShare: border and settled triangles stay, the rest goes down to "ratio".
+      size_t getShare( const size_t* members, size_t count, const std::vector< unsigned char >& locked, size_t targetTriangles, double ratio ) const
+      {
+        if ( targetTriangles == 0 )
+        {
+          return ( 0 );
+        }
+
+        double share = 0.0;
+        for ( size_t t = 0; t < count; ++t )
+        {
+          const int* tri = &triangles_[ 3 * members[ t ] ];
+          const bool border  = locked[ tri[ 0 ] ] || locked[ tri[ 1 ] ] || locked[ tri[ 2 ] ];
+          const bool settled = settled_[ tri[ 0 ] ] && settled_[ tri[ 1 ] ] && settled_[ tri[ 2 ] ];
+          share += border || settled ? 1.0 : ratio;
+        }
+        return ( static_cast< size_t >( std::ceil( share ) ) );
+      }
+
+      //--------------------------------------------------
+      // Function: decimateCluster
+      // Runs on a pool thread. Reads the positions, quadrics
+      // and settled flags of every cluster vertex but writes
+      // only those of its own, unlocked ones, which no other
+      // cluster touches.
+      //--------------------------------------------------
+      void decimateCluster( const size_t* members, size_t count, const std::vector< unsigned char >& locked, size_t target, ClusterResult& result )
+      {
+        ClusterMesh mesh;
+        buildCluster( members, count, locked, mesh );
+
+        const size_t numLocal = mesh.global.size();
+        const std::vector< double > initialQuadric( mesh.quadric );
+
+        CollapseQueue queue;
+        {
+          std::vector< unsigned long long > edges;
+          edges.reserve( 3 * count );
+          for ( size_t t = 0; t < count; ++t )
+          {
+            for ( int k = 0; k < 3; ++k )
+            {
+              edges.push_back( edgeKey( mesh.triangles[ 3 * t + k ], mesh.triangles[ 3 * t + ( k + 1 ) % 3 ] ) );
+            }
+          }
+          std::sort( edges.begin(), edges.end() );
+          edges.erase( std::unique( edges.begin(), edges.end() ), edges.end() );
+          for ( size_t e = 0; e < edges.size(); ++e )
+          {
+            push( mesh, static_cast< int >( edges[ e ] >> 32 ), static_cast< int >( edges[ e ] & 0xffffffffULL ), queue );
+          }
+        }
+
+        while ( !queue.empty() && ( target == 0 || mesh.alive > target ) )
+        {
+          const Collapse top = queue.top();
+          queue.pop();
+
+          if ( mesh.removed[ top.a ] || mesh.removed[ top.b ] || mesh.version[ top.a ] != top.versionA || mesh.version[ top.b ] != top.versionB )
+          {
+            continue;
+          }
+          if ( maxCost_ > 0.0 && top.cost > maxCost_ )
+          {
+            break;
+          }
+
+          // The locked end, if any, is the one kept.
+          int keep = top.a;
+          int gone = top.b;
+          if ( mesh.locked[ gone ] )
+          {
+            std::swap( keep, gone );
+          }
+
+          double target3[ 3 ];
+          optimalPosition( mesh, keep, gone, target3 );
+          if ( !canCollapse( mesh, keep, gone, target3 ) )
+          {
+            continue;
+          }
+          collapse( mesh, keep, gone, target3, queue );
+          ++result.collapses;
+        }
+
+        // Back to global numbers.
+        result.triangles.reserve( 3 * mesh.alive );
+        for ( size_t t = 0; t < count; ++t )
+        {
+          if ( !mesh.dead[ t ] )
+          {
+            for ( int k = 0; k < 3; ++k )
+            {
+              result.triangles.push_back( mesh.global[ mesh.triangles[ 3 * t + k ] ] );
+            }
+          }
+        }
+
+        for ( size_t v = 0; v < numLocal; ++v )
+        {
+          const int     g = mesh.global[ v ];
+          const double* q = &mesh.quadric[ QUADRIC_SIZE * v ];
+          if ( mesh.removed[ v ] )
+          {
+            continue;
+          }
+          if ( !mesh.locked[ v ] )
+          {
+            positions_[ 3 * g ]     = static_cast< float >( mesh.position[ 3 * v ] );
+            positions_[ 3 * g + 1 ] = static_cast< float >( mesh.position[ 3 * v + 1 ] );
+            positions_[ 3 * g + 2 ] = static_cast< float >( mesh.position[ 3 * v + 2 ] );
+            std::copy( q, q + QUADRIC_SIZE, &quadrics_[ QUADRIC_SIZE * g ] );
+            settled_[ g ] = 1;
+          }
+          else if ( !std::equal( q, q + QUADRIC_SIZE, &initialQuadric[ QUADRIC_SIZE * v ] ) )
+          {
+            result.lockedIds.push_back( g );
+            for ( int j = 0; j < QUADRIC_SIZE; ++j )
+            {
+              result.lockedQuadrics.push_back( q[ j ] - initialQuadric[ QUADRIC_SIZE * v + j ] );
+            }
+          }
+        }
+      }
+
+      // buildCluster: local copies of the cluster triangles and their vertices.
+      void buildCluster( const size_t* members, size_t count, const std::vector< unsigned char >& locked, ClusterMesh& mesh ) const
+      {
+        mesh.global.resize( 3 * count );
+        for ( size_t t = 0; t < count; ++t )
+        {
+          for ( int k = 0; k < 3; ++k )
+          {
+            mesh.global[ 3 * t + k ] = triangles_[ 3 * members[ t ] + k ];
+          }
+        }
+        std::sort( mesh.global.begin(), mesh.global.end() );
+        mesh.global.erase( std::unique( mesh.global.begin(), mesh.global.end() ), mesh.global.end() );
+
+        const size_t numLocal = mesh.global.size();
+        mesh.position.resize( 3 * numLocal );
+        mesh.quadric.resize( QUADRIC_SIZE * numLocal );
+        mesh.locked.resize( numLocal );
+        mesh.boundary.assign( numLocal, 0 );
+        mesh.removed.assign( numLocal, 0 );
+        mesh.version.assign( numLocal, 0 );
+        mesh.vertexTriangles.assign( numLocal, std::vector< int >() );
+        for ( size_t v = 0; v < numLocal; ++v )
+        {
+          const int g = mesh.global[ v ];
+          mesh.position[ 3 * v ]     = positions_[ 3 * g ];
+          mesh.position[ 3 * v + 1 ] = positions_[ 3 * g + 1 ];
+          mesh.position[ 3 * v + 2 ] = positions_[ 3 * g + 2 ];
+          std::copy( &quadrics_[ QUADRIC_SIZE * g ], &quadrics_[ QUADRIC_SIZE * g ] + QUADRIC_SIZE, &mesh.quadric[ QUADRIC_SIZE * v ] );
+          mesh.locked[ v ] = locked[ g ];
+        }
+
+        mesh.triangles.resize( 3 * count );
+        mesh.dead.assign( count, 0 );
+        mesh.alive = count;
+        std::vector< unsigned long long > edges;
+        edges.reserve( 3 * count );
+        for ( size_t t = 0; t < count; ++t )
+        {
+          for ( int k = 0; k < 3; ++k )
+          {
+            const int v = static_cast< int >( std::lower_bound( mesh.global.begin(), mesh.global.end(), triangles_[ 3 * members[ t ] + k ] ) - mesh.global.begin() );
+            mesh.triangles[ 3 * t + k ] = v;
+            mesh.vertexTriangles[ v ].push_back( static_cast< int >( t ) );
+          }
+          for ( int k = 0; k < 3; ++k )
+          {
+            edges.push_back( edgeKey( mesh.triangles[ 3 * t + k ], mesh.triangles[ 3 * t + ( k + 1 ) % 3 ] ) );
+          }
+        }
+
+        // Open border vertices. Locked ones count as border: their
+        // triangles in other clusters are not known here.
+        std::sort( edges.begin(), edges.end() );
+        for ( size_t e = 0; e < edges.size(); )
+        {
+          size_t run = e + 1;
+          while ( run < edges.size() && edges[ run ] == edges[ e ] )
+          {
+            ++run;
+          }
+          if ( run == e + 1 )
+          {
+            mesh.boundary[ edges[ e ] >> 32 ]             = 1;
+            mesh.boundary[ edges[ e ] & 0xffffffffULL ] = 1;
+          }
+          e = run;
+        }
+        for ( size_t v = 0; v < numLocal; ++v )
+        {
+          mesh.boundary[ v ] |= mesh.locked[ v ];
+        }
+      }
+
+      // push: queues the collapse of edge ( a, b ) unless both ends are locked.
+      static void push( const ClusterMesh& mesh, int a, int b, CollapseQueue& queue )
+      {
+        if ( mesh.locked[ a ] && mesh.locked[ b ] )
+        {
+          return;
+        }
+
+        int keep = a;
+        int gone = b;
+        if ( mesh.locked[ gone ] )
+        {
+          std::swap( keep, gone );
+        }
+
+        double p[ 3 ];
+        Collapse collapse;
+        collapse.cost     = optimalPosition( mesh, keep, gone, p );
+        collapse.a        = a;
+        collapse.b        = b;
+        collapse.versionA = mesh.version[ a ];
+        collapse.versionB = mesh.version[ b ];
+        queue.push( collapse );
+      }
+
+      //--------------------------------------------------
+      // Function: optimalPosition
+      // Onto "keep" when it is locked. Otherwise the minimum of
+      // the summed quadric, when the system is well conditioned
+      // and the point stays near the edge, or the best of the
+      // ends and the midpoint. Returns the error there.
+      //--------------------------------------------------
+      static double optimalPosition( const ClusterMesh& mesh, int keep, int gone, double* p )
+      {
+        double q[ QUADRIC_SIZE ];
+        for ( int j = 0; j < QUADRIC_SIZE; ++j )
+        {
+          q[ j ] = mesh.quadric[ QUADRIC_SIZE * keep + j ] + mesh.quadric[ QUADRIC_SIZE * gone + j ];
+        }
+
+        const double* pk = &mesh.position[ 3 * keep ];
+        const double* pg = &mesh.position[ 3 * gone ];
+        if ( mesh.locked[ keep ] )
+        {
+          p[ 0 ] = pk[ 0 ]; p[ 1 ] = pk[ 1 ]; p[ 2 ] = pk[ 2 ];
+          return ( evaluate( q, p ) );
+        }
+
+        const double c00 = q[ 4 ] * q[ 7 ] - q[ 5 ] * q[ 5 ];
+        const double c01 = q[ 2 ] * q[ 5 ] - q[ 1 ] * q[ 7 ];
+        const double c02 = q[ 1 ] * q[ 5 ] - q[ 2 ] * q[ 4 ];
+        const double det = q[ 0 ] * c00 + q[ 1 ] * c01 + q[ 2 ] * c02;
+        const double scale = q[ 0 ] + q[ 4 ] + q[ 7 ];
+
+        const double mid[ 3 ] = { 0.5 * ( pk[ 0 ] + pg[ 0 ] ), 0.5 * ( pk[ 1 ] + pg[ 1 ] ), 0.5 * ( pk[ 2 ] + pg[ 2 ] ) };
+        const double d[ 3 ]   = { pg[ 0 ] - pk[ 0 ], pg[ 1 ] - pk[ 1 ], pg[ 2 ] - pk[ 2 ] };
+        const double length2  = dot( d, d );
+
+        if ( std::fabs( det ) > 1e-9 * scale * scale * scale )
+        {
+          const double c11 = q[ 0 ] * q[ 7 ] - q[ 2 ] * q[ 2 ];
+          const double c12 = q[ 1 ] * q[ 2 ] - q[ 0 ] * q[ 5 ];
+          const double c22 = q[ 0 ] * q[ 4 ] - q[ 1 ] * q[ 1 ];
+          const double b[ 3 ] = { -q[ 3 ], -q[ 6 ], -q[ 8 ] };
+          const double x[ 3 ] = { ( c00 * b[ 0 ] + c01 * b[ 1 ] + c02 * b[ 2 ] ) / det,
+                                  ( c01 * b[ 0 ] + c11 * b[ 1 ] + c12 * b[ 2 ] ) / det,
+                                  ( c02 * b[ 0 ] + c12 * b[ 1 ] + c22 * b[ 2 ] ) / det };
+          const double o[ 3 ] = { x[ 0 ] - mid[ 0 ], x[ 1 ] - mid[ 1 ], x[ 2 ] - mid[ 2 ] };
+          if ( dot( o, o ) <= length2 )
+          {
+            p[ 0 ] = x[ 0 ]; p[ 1 ] = x[ 1 ]; p[ 2 ] = x[ 2 ];
+            return ( evaluate( q, p ) );
+          }
+        }
+
+        const double* candidates[ 3 ] = { mid, pk, pg };
+        double best = -1.0;
+        for ( int k = 0; k < 3; ++k )
+        {
+          const double e = evaluate( q, candidates[ k ] );
+          if ( best < 0.0 || e < best )
+          {
+            best   = e;
+            p[ 0 ] = candidates[ k ][ 0 ]; p[ 1 ] = candidates[ k ][ 1 ]; p[ 2 ] = candidates[ k ][ 2 ];
+          }
+        }
+        return ( best );
+      }
+
+      //--------------------------------------------------
+      // Function: canCollapse
+      // The link condition: the only neighbours the ends share
+      // are the third corners of the triangles on the edge, and
+      // two border vertices only collapse along a border edge.
+      // And no triangle left may turn over or degenerate.
+      //--------------------------------------------------
+      static bool canCollapse( const ClusterMesh& mesh, int keep, int gone, const double* p )
+      {
+        std::vector< int > rings[ 2 ];
+        int shared = 0;
+
+        for ( int end = 0; end < 2; ++end )
+        {
+          const int                 v      = end == 0 ? keep : gone;
+          const std::vector< int >& around = mesh.vertexTriangles[ v ];
+          for ( size_t i = 0; i < around.size(); ++i )
+          {
+            const int  t   = around[ i ];
+            const int* tri = &mesh.triangles[ 3 * t ];
+            if ( mesh.dead[ t ] )
+            {
+              continue;
+            }
+
+            for ( int k = 0; k < 3; ++k )
+            {
+              if ( tri[ k ] != keep && tri[ k ] != gone )
+              {
+                rings[ end ].push_back( tri[ k ] );
+              }
+            }
+
+            const bool both = ( tri[ 0 ] == keep || tri[ 1 ] == keep || tri[ 2 ] == keep )
+                           && ( tri[ 0 ] == gone || tri[ 1 ] == gone || tri[ 2 ] == gone );
+            if ( both )
+            {
+              shared += end == 0 ? 1 : 0;
+              continue;
+            }
+
+            // The triangle before and after the move.
+            double p0[ 3 ][ 3 ];
+            double p1[ 3 ][ 3 ];
+            for ( int k = 0; k < 3; ++k )
+            {
+              const double* position = &mesh.position[ 3 * tri[ k ] ];
+              const double* moved    = tri[ k ] == v ? p : position;
+              std::copy( position, position + 3, p0[ k ] );
+              std::copy( moved, moved + 3, p1[ k ] );
+            }
+            double n0[ 3 ];
+            double n1[ 3 ];
+            triangleNormal( p0[ 0 ], p0[ 1 ], p0[ 2 ], n0 );
+            triangleNormal( p1[ 0 ], p1[ 1 ], p1[ 2 ], n1 );
+            const double l0 = dot( n0, n0 );
+            if ( l0 > 0.0 && ( dot( n1, n1 ) <= 1e-12 * l0 || dot( n0, n1 ) <= 0.0 ) )
+            {
+              return ( false );
+            }
+          }
+        }
+
+        if ( shared == 0 || shared > 2 || ( shared == 2 && mesh.boundary[ keep ] && mesh.boundary[ gone ] ) )
+        {
+          return ( false );
+        }
+
+        for ( int end = 0; end < 2; ++end )
+        {
+          std::sort( rings[ end ].begin(), rings[ end ].end() );
+          rings[ end ].erase( std::unique( rings[ end ].begin(), rings[ end ].end() ), rings[ end ].end() );
+        }
+        std::vector< int > common;
+        std::set_intersection( rings[ 0 ].begin(), rings[ 0 ].end(), rings[ 1 ].begin(), rings[ 1 ].end(), std::back_inserter( common ) );
+        if ( common.size() != size_t( shared ) )
+        {
+          return ( false );
+        }
+
+        // A locked "keep" may have neighbours in other clusters, any
+        // locked vertex around "gone" could be one of them.
+        if ( mesh.locked[ keep ] )
+        {
+          for ( size_t i = 0; i < rings[ 1 ].size(); ++i )
+          {
+            if ( mesh.locked[ rings[ 1 ][ i ] ] && !std::binary_search( common.begin(), common.end(), rings[ 1 ][ i ] ) )
+            {
+              return ( false );
+            }
+          }
+        }
+        return ( true );
+      }
+
+      // collapse: "gone" merges into "keep", which moves to "p".
+      static void collapse( ClusterMesh& mesh, int keep, int gone, const double* p, CollapseQueue& queue )
+      {
+        mesh.position[ 3 * keep ]     = p[ 0 ];
+        mesh.position[ 3 * keep + 1 ] = p[ 1 ];
+        mesh.position[ 3 * keep + 2 ] = p[ 2 ];
+        for ( int j = 0; j < QUADRIC_SIZE; ++j )
+        {
+          mesh.quadric[ QUADRIC_SIZE * keep + j ] += mesh.quadric[ QUADRIC_SIZE * gone + j ];
+        }
+        mesh.boundary[ keep ] |= mesh.boundary[ gone ];
+        mesh.removed[ gone ] = 1;
+        ++mesh.version[ keep ];
+        ++mesh.version[ gone ];
+
+        std::vector< int >& keepTriangles = mesh.vertexTriangles[ keep ];
+        std::vector< int >& goneTriangles = mesh.vertexTriangles[ gone ];
+        for ( size_t i = 0; i < goneTriangles.size(); ++i )
+        {
+          const int t   = goneTriangles[ i ];
+          int*      tri = &mesh.triangles[ 3 * t ];
+          if ( mesh.dead[ t ] )
+          {
+            continue;
+          }
+          if ( tri[ 0 ] == keep || tri[ 1 ] == keep || tri[ 2 ] == keep )
+          {
+            mesh.dead[ t ] = 1;
+            --mesh.alive;
+            continue;
+          }
+          for ( int k = 0; k < 3; ++k )
+          {
+            tri[ k ] = tri[ k ] == gone ? keep : tri[ k ];
+          }
+          keepTriangles.push_back( t );
+        }
+        std::vector< int >().swap( goneTriangles );
+
+        size_t live = 0;
+        for ( size_t i = 0; i < keepTriangles.size(); ++i )
+        {
+          if ( !mesh.dead[ keepTriangles[ i ] ] )
+          {
+            keepTriangles[ live++ ] = keepTriangles[ i ];
+          }
+        }
+        keepTriangles.resize( live );
+
+        // The edges around "keep" changed cost.
+        for ( size_t i = 0; i < keepTriangles.size(); ++i )
+        {
+          const int* tri = &mesh.triangles[ 3 * keepTriangles[ i ] ];
+          for ( int k = 0; k < 3; ++k )
+          {
+            if ( tri[ k ] != keep )
+            {
+              push( mesh, keep, tri[ k ], queue );
+            }
+          }
+        }
+      }
+
+      // compact: drops the vertices no triangle uses any more.
+      void compact( void )
+      {
+        const size_t numVertices = getNumVertices();
+        std::vector< int > remap( numVertices, -1 );
+        for ( size_t i = 0; i < triangles_.size(); ++i )
+        {
+          remap[ triangles_[ i ] ] = 0;
+        }
+
+        int next = 0;
+        for ( size_t v = 0; v < numVertices; ++v )
+        {
+          if ( remap[ v ] == 0 )
+          {
+            remap[ v ] = next;
+            positions_[ 3 * next ]     = positions_[ 3 * v ];
+            positions_[ 3 * next + 1 ] = positions_[ 3 * v + 1 ];
+            positions_[ 3 * next + 2 ] = positions_[ 3 * v + 2 ];
+            ++next;
+          }
+        }
+        positions_.resize( 3 * size_t( next ) );
+
+        for ( size_t i = 0; i < triangles_.size(); ++i )
+        {
+          triangles_[ i ] = remap[ triangles_[ i ] ];
+        }
+      }
+
+      // Not copyable.
+      MeshDecimator( const MeshDecimator& );
+      MeshDecimator& operator=( const MeshDecimator& );
+
+    private:
+
+      ThreadPool& pool_;
+
+      std::vector< float >         positions_;
+      std::vector< int >           triangles_;
+      std::vector< double >        quadrics_;
+      std::vector< unsigned char > settled_;
+      double                       maxCost_;
+
+      Stats       stats_;
+      std::string error_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_MESH_DECIMATOR_H
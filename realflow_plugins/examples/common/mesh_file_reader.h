@@ -0,0 +1,1430 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_MESH_FILE_READER_H
+#define _RF_EXAMPLES_MESH_FILE_READER_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "fast_parse.h"
+#include "flat_hash_map.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: MeshFileReader
+    // Triangle meshes from Wavefront OBJ and ASCII or binary
+    // PLY files, as flat arrays: xyz per vertex, uv per vertex
+    // when asked for and present, and vertex index triplets.
+    // Polygons are split in fans.
+    //
+    // The file is mapped, not read, and every pass over it is
+    // split in chunks that start at a line ( or, for binary
+    // PLY, an element ) boundary:
+    //
+    //   1. count the records of each chunk,
+    //   2. prefix sums give every chunk its output offsets,
+    //   3. parse the chunks in parallel straight into place.
+    //
+    // Numbers go through FastParse. OBJ faces index positions
+    // and texture coordinates separately; with texture
+    // coordinates the ( position, uv ) pairs become the
+    // vertices, numbered through flat hash maps, one per
+    // thread over a hash partition of the pairs, so they are
+    // built in parallel without locks. Without them faces
+    // keep the position indices as they are.
+    //
+    // read() returns false with getError() set on a missing
+    // or malformed file, an index out of range or a mesh too
+    // large for int indices.
+    //--------------------------------------------------
+    class MeshFileReader
+    {
+    public:
+
+      /// Constructor, the pool is borrowed.
+      explicit MeshFileReader( ThreadPool& pool ) : pool_( pool ), fileSize_( 0 ) {};
+
+      //--------------------------------------------------
+      // Function: read
+      // Format from the extension, ".obj" or ".ply".
+      //--------------------------------------------------
+      bool read( const std::string& path, bool textureCoordinates )
+      {
+        positions_.clear();
+        uvs_.clear();
+        triangles_.clear();
+        error_.clear();
+        fileSize_ = 0;
+
+        MappedFile file;
+        if ( !file.openRead( path ) )
+        {
+          return ( fail( "cannot open " + path ) );
+        }
+        fileSize_ = file.getSize();
+
+        const char* begin = file.getData();
+        const char* end   = begin + file.getSize();
+
+        const std::string extension = lowerExtension( path );
+        if ( extension == "obj" )
+        {
+          return ( readObj( begin, end, textureCoordinates ) );
+        }
+        if ( extension == "ply" )
+        {
+          return ( readPly( begin, end, textureCoordinates ) );
+        }
+        return ( fail( "unknown mesh format: " + path ) );
+      }
+
+      const std::string&          getError( void ) const              { return ( error_ ); }
+      size_t                      getFileSize( void ) const           { return ( fileSize_ ); }
+      size_t                      getNumVertices( void ) const        { return ( positions_.size() / 3 ); }
+      size_t                      getNumTriangles( void ) const       { return ( triangles_.size() / 3 ); }
+      const std::vector< float >& getPositions( void ) const          { return ( positions_ ); }
+      const std::vector< float >& getTextureCoordinates( void ) const { return ( uvs_ ); }
+      const std::vector< int >&   getTriangles( void ) const          { return ( triangles_ ); }
+
+    private:
+
+      enum
+      {
+        CHUNKS_PER_THREAD = 8,
+        MIN_CHUNK_BYTES   = 1 << 20,
+        FACE_BLOCK        = 4096
+      };
+
+      enum PlyType
+      {
+        PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID
+      };
+
+      enum PlyFormat
+      {
+        PLY_ASCII, PLY_BINARY_LE, PLY_BINARY_BE
+      };
+
+      struct PlyProperty
+      {
+        std::string name;
+        PlyType     type;
+        PlyType     countType;
+        bool        list;
+      };
+
+      struct PlyElement
+      {
+        std::string                name;
+        size_t                     count;
+        std::vector< PlyProperty > properties;
+      };
+
+      // Records of a chunk and where its output starts.
+      struct Chunk
+      {
+        const char* begin;
+        const char* end;
+        size_t      lines;
+        size_t      positions, uvs, triangles;
+        size_t      firstLine, firstPosition, firstUv, firstTriangle;
+        bool        error;
+      };
+
+      bool fail( const std::string& message )
+      {
+        error_ = message;
+        positions_.clear();
+        uvs_.clear();
+        triangles_.clear();
+        return ( false );
+      }
+
+      static std::string lowerExtension( const std::string& path )
+      {
+        const size_t dot = path.find_last_of( '.' );
+        std::string extension = ( dot == std::string::npos ) ? std::string() : path.substr( dot + 1 );
+        for ( size_t c = 0; c < extension.size(); ++c )
+        {
+          extension[ c ] = char( ::tolower( extension[ c ] ) );
+        }
+        return ( extension );
+      }
+
+      static bool isSpace( char c )
+      {
+        return ( c == ' ' || c == '\t' || c == '\r' || c == '\n' );
+      }
+
+      //--------------------------------------------------
+      // Function: splitChunks
+      // [ begin, end ) in chunks of at least MIN_CHUNK_BYTES,
+      // each moved forward to the start of a line.
+      //--------------------------------------------------
+      void splitChunks( const char* begin, const char* end, std::vector< Chunk >& chunks ) const
+      {
+        const size_t bytes     = size_t( end - begin );
+        const size_t maxChunks = std::max< size_t >( 1, pool_.getNumThreads() * CHUNKS_PER_THREAD );
+        const size_t count     = std::max< size_t >( 1, std::min( maxChunks, bytes / MIN_CHUNK_BYTES ) );
+
+        Chunk empty;
+        std::memset( &empty, 0, sizeof( empty ) );
+        chunks.assign( count, empty );
+
+        const char* start = begin;
+        for ( size_t k = 0; k < count; ++k )
+        {
+          const char* stop = ( k + 1 == count ) ? end : FastParse::nextLine( std::max( start, begin + bytes * ( k + 1 ) / count ), end );
+          chunks[ k ].begin = start;
+          chunks[ k ].end   = std::max( start, stop );
+          start = chunks[ k ].end;
+        }
+      }
+
+      // checkSizes: false when the counts pass the int index range.
+      bool checkSizes( size_t vertices, size_t triangles )
+      {
+        if ( vertices > size_t( INT_MAX ) || triangles > size_t( INT_MAX ) / 3 )
+        {
+          return ( fail( "mesh too large for int indices" ) );
+        }
+        return ( true );
+      }
+
+      ///////////////////////////////////////////////////////////////////////////////////
+      // OBJ
+
+      // Line kind of an OBJ record.
+      enum ObjRecord
+      {
+        OBJ_OTHER, OBJ_POSITION, OBJ_UV, OBJ_FACE
+      };
+
+      static ObjRecord objRecord( const char*& p, const char* lineEnd )
+      {
+        FastParse::skipBlanks( p, lineEnd );
+        if ( lineEnd - p < 2 )
+        {
+          return ( OBJ_OTHER );
+        }
+        if ( p[ 0 ] == 'v' && FastParse::isBlank( p[ 1 ] ) )
+        {
+          p += 2;
+          return ( OBJ_POSITION );
+        }
+        if ( p[ 0 ] == 'f' && FastParse::isBlank( p[ 1 ] ) )
+        {
+          p += 2;
+          return ( OBJ_FACE );
+        }
+        if ( p[ 0 ] == 'v' && p[ 1 ] == 't' && lineEnd - p > 2 && FastParse::isBlank( p[ 2 ] ) )
+        {
+          p += 3;
+          return ( OBJ_UV );
+        }
+        return ( OBJ_OTHER );
+      }
+
+      // countCorners: whitespace separated tokens up to the line end.
+      static size_t countCorners( const char* p, const char* lineEnd )
+      {
+        size_t corners = 0;
+        bool   inToken = false;
+        for ( ; p < lineEnd; ++p )
+        {
+          const bool space = isSpace( *p );
+          corners += ( !space && !inToken ) ? 1 : 0;
+          inToken  = !space;
+        }
+        return ( corners );
+      }
+
+      //--------------------------------------------------
+      // Function: readObj
+      // "v", "vt" and "f" records, the rest is skipped. Face
+      // corners are v, v/vt, v//vn or v/vt/vn, negative
+      // indices count back from the last record read.
+      //--------------------------------------------------
+      bool readObj( const char* begin, const char* end, bool textureCoordinates )
+      {
+        std::vector< Chunk > chunks;
+        splitChunks( begin, end, chunks );
+
+        pool_.parallelFor( chunks.size(), 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t k = first; k < last; ++k )
+          {
+            Chunk& chunk = chunks[ k ];
+            for ( const char* line = chunk.begin; line < chunk.end; )
+            {
+              const char* lineEnd = FastParse::nextLine( line, chunk.end );
+              const char* p = line;
+              switch ( objRecord( p, lineEnd ) )
+              {
+                case OBJ_POSITION: ++chunk.positions; break;
+                case OBJ_UV:       ++chunk.uvs;       break;
+                case OBJ_FACE:
+                {
+                  const size_t corners = countCorners( p, lineEnd );
+                  chunk.triangles += ( corners >= 3 ) ? corners - 2 : 0;
+                  break;
+                }
+                default: break;
+              }
+              line = lineEnd;
+            }
+          }
+        } );
+
+        size_t numPositions = 0, numUvs = 0, numTriangles = 0;
+        for ( size_t k = 0; k < chunks.size(); ++k )
+        {
+          chunks[ k ].firstPosition = numPositions;
+          chunks[ k ].firstUv       = numUvs;
+          chunks[ k ].firstTriangle = numTriangles;
+          numPositions += chunks[ k ].positions;
+          numUvs       += chunks[ k ].uvs;
+          numTriangles += chunks[ k ].triangles;
+        }
+
+        if ( numPositions == 0 || numTriangles == 0 )
+        {
+          return ( fail( "no faces in OBJ file" ) );
+        }
+        if ( !checkSizes( std::max( numPositions, 3 * numTriangles ), numTriangles ) )
+        {
+          return ( false );
+        }
+
+        const bool withUvs = textureCoordinates && numUvs > 0;
+
+        std::vector< float > positions( 3 * numPositions );
+        std::vector< float > uvs( withUvs ? 2 * numUvs : 0 );
+        triangles_.resize( 3 * numTriangles );
+        cornerUvs_.assign( withUvs ? 3 * numTriangles : 0, -1 );
+
+        pool_.parallelFor( chunks.size(), 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t k = first; k < last; ++k )
+          {
+            parseObjChunk( chunks[ k ], numPositions, numUvs, withUvs, positions.data(), uvs.data() );
+          }
+        } );
+
+        for ( size_t k = 0; k < chunks.size(); ++k )
+        {
+          if ( chunks[ k ].error )
+          {
+            return ( fail( "malformed OBJ record or face index out of range" ) );
+          }
+        }
+
+        if ( withUvs )
+        {
+          weldCorners( positions, uvs );
+        }
+        else
+        {
+          positions_.swap( positions );
+        }
+        cornerUvs_.clear();
+        return ( true );
+      }
+
+      // parseObjChunk: records of a chunk into their slots.
+      void parseObjChunk( Chunk& chunk, const size_t numPositions, const size_t numUvs, const bool withUvs,
+                          float* positions, float* uvs )
+      {
+        size_t position = chunk.firstPosition;
+        size_t uv       = chunk.firstUv;
+        size_t corner   = 3 * chunk.firstTriangle;
+
+        for ( const char* line = chunk.begin; line < chunk.end; )
+        {
+          const char* lineEnd = FastParse::nextLine( line, chunk.end );
+          const char* p = line;
+
+          switch ( objRecord( p, lineEnd ) )
+          {
+            case OBJ_POSITION:
+            {
+              float* xyz = positions + 3 * position++;
+              if ( !FastParse::parseFloat( p, lineEnd, xyz[ 0 ] ) || !FastParse::parseFloat( p, lineEnd, xyz[ 1 ] ) ||
+                   !FastParse::parseFloat( p, lineEnd, xyz[ 2 ] ) )
+              {
+                chunk.error = true;
+                return;
+              }
+              break;
+            }
+
+            case OBJ_UV:
+            {
+              float u = 0.0f, v = 0.0f;
+              FastParse::parseFloat( p, lineEnd, u );
+              FastParse::parseFloat( p, lineEnd, v );
+              if ( withUvs )
+              {
+                uvs[ 2 * uv ] = u; uvs[ 2 * uv + 1 ] = v;
+              }
+              ++uv;
+              break;
+            }
+
+            case OBJ_FACE:
+            {
+              int  firstV = 0, firstT = -1, prevV = 0, prevT = -1;
+              int  corners = 0;
+              long long v = 0, t = 0;
+              const char* items = p;
+
+              while ( FastParse::parseInt( p, lineEnd, v ) )
+              {
+                t = 0;
+                if ( p < lineEnd && *p == '/' )
+                {
+                  ++p;
+                  bool valid = true;
+                  if ( p < lineEnd && *p != '/' )
+                  {
+                    valid = FastParse::parseInt( p, lineEnd, t );
+                  }
+                  if ( valid && p < lineEnd && *p == '/' )
+                  {
+                    ++p;
+                    long long n = 0;
+                    valid = FastParse::parseInt( p, lineEnd, n );
+                  }
+                  if ( !valid )
+                  {
+                    chunk.error = true;
+                    return;
+                  }
+                }
+
+                const long long vi = ( v < 0 ) ? (long long)( position ) + v : v - 1;
+                const long long ti = ( t < 0 ) ? (long long)( uv ) + t : ( t > 0 ? t - 1 : -1 );
+                if ( vi < 0 || vi >= (long long)( numPositions ) || ti >= (long long)( numUvs ) || ( t != 0 && ti < 0 ) )
+                {
+                  chunk.error = true;
+                  return;
+                }
+
+                if ( corners == 0 )
+                {
+                  firstV = int( vi ); firstT = int( ti );
+                }
+                else if ( corners >= 2 )
+                {
+                  int* tri = &triangles_[ corner ];
+                  tri[ 0 ] = firstV; tri[ 1 ] = prevV; tri[ 2 ] = int( vi );
+                  if ( withUvs )
+                  {
+                    int* triUv = &cornerUvs_[ corner ];
+                    triUv[ 0 ] = firstT; triUv[ 1 ] = prevT; triUv[ 2 ] = int( ti );
+                  }
+                  corner += 3;
+                }
+
+                prevV = int( vi ); prevT = int( ti );
+                ++corners;
+              }
+
+              // A corner that is not a number, or does not fit one, stops the loop early.
+              if ( size_t( corners ) != countCorners( items, lineEnd ) )
+              {
+                chunk.error = true;
+                return;
+              }
+              break;
+            }
+
+            default:
+              break;
+          }
+
+          line = lineEnd;
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: weldCorners
+      // One vertex per distinct ( position, uv ) pair. Pair
+      // keys are split over P partitions by hash, and the
+      // corners bucketed by partition in one counting sort:
+      // P ranges of corners count their partitions, then
+      // scatter their corner indices, so each bucket keeps
+      // the corner order. Partition p numbers the pairs of
+      // its bucket in its own FlatIndexMap, in that order,
+      // and its vertices follow those of partitions
+      // 0 .. p - 1. A last pass maps each corner.
+      //--------------------------------------------------
+      void weldCorners( const std::vector< float >& positions, const std::vector< float >& uvs )
+      {
+        const size_t numCorners = triangles_.size();
+        const size_t partitions = std::max< unsigned int >( 1, pool_.getNumThreads() );
+
+        maps_.resize( partitions );
+        keys_.resize( partitions );
+        cornerParts_.resize( numCorners );
+        buckets_.resize( numCorners );
+
+        // counts[ r * P + p ]: corners of range r in partition p, then where they go.
+        std::vector< size_t > counts( partitions * partitions, 0 );
+        pool_.parallelFor( partitions, 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t range = first; range < last; ++range )
+          {
+            size_t* count = counts.data() + range * partitions;
+            for ( size_t c = numCorners * range / partitions; c < numCorners * ( range + 1 ) / partitions; ++c )
+            {
+              const size_t part = partitionOf( cornerKey( c ), partitions );
+              cornerParts_[ c ] = static_cast< unsigned int >( part );
+              ++count[ part ];
+            }
+          }
+        } );
+
+        std::vector< size_t > bucket( partitions + 1, 0 );
+        size_t offset = 0;
+        for ( size_t part = 0; part < partitions; ++part )
+        {
+          bucket[ part ] = offset;
+          for ( size_t range = 0; range < partitions; ++range )
+          {
+            const size_t count = counts[ range * partitions + part ];
+            counts[ range * partitions + part ] = offset;
+            offset += count;
+          }
+        }
+        bucket[ partitions ] = offset;
+
+        pool_.parallelFor( partitions, 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t range = first; range < last; ++range )
+          {
+            size_t* next = counts.data() + range * partitions;
+            for ( size_t c = numCorners * range / partitions; c < numCorners * ( range + 1 ) / partitions; ++c )
+            {
+              buckets_[ next[ cornerParts_[ c ] ]++ ] = static_cast< unsigned int >( c );
+            }
+          }
+        } );
+
+        pool_.parallelFor( partitions, 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t part = first; part < last; ++part )
+          {
+            FlatIndexMap&                     map  = maps_[ part ];
+            std::vector< unsigned long long >& keys = keys_[ part ];
+
+            map.clear();
+            keys.clear();
+            map.reserve( ( positions.size() / 3 + positions.size() / 12 ) / partitions );
+
+            for ( size_t b = bucket[ part ]; b < bucket[ part + 1 ]; ++b )
+            {
+              const unsigned long long key = cornerKey( buckets_[ b ] );
+              bool inserted = false;
+              map.insert( key, static_cast< unsigned int >( keys.size() ), inserted );
+              if ( inserted )
+              {
+                keys.push_back( key );
+              }
+            }
+          }
+        } );
+
+        std::vector< size_t > base( partitions + 1, 0 );
+        for ( size_t part = 0; part < partitions; ++part )
+        {
+          base[ part + 1 ] = base[ part ] + keys_[ part ].size();
+        }
+
+        positions_.resize( 3 * base[ partitions ] );
+        uvs_.resize( 2 * base[ partitions ] );
+
+        pool_.parallelFor( partitions, 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t part = first; part < last; ++part )
+          {
+            const std::vector< unsigned long long >& keys = keys_[ part ];
+            for ( size_t k = 0; k < keys.size(); ++k )
+            {
+              const size_t vertex = base[ part ] + k;
+              const size_t p = size_t( keys[ k ] >> 32 );
+              const int    t = int( static_cast< unsigned int >( keys[ k ] ) );
+
+              positions_[ 3 * vertex ]     = positions[ 3 * p ];
+              positions_[ 3 * vertex + 1 ] = positions[ 3 * p + 1 ];
+              positions_[ 3 * vertex + 2 ] = positions[ 3 * p + 2 ];
+              uvs_[ 2 * vertex ]     = ( t >= 0 ) ? uvs[ 2 * t ] : 0.0f;
+              uvs_[ 2 * vertex + 1 ] = ( t >= 0 ) ? uvs[ 2 * t + 1 ] : 0.0f;
+            }
+          }
+        } );
+
+        pool_.parallelFor( numCorners, 16384, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t c = first; c < last; ++c )
+          {
+            const size_t part = cornerParts_[ c ];
+            triangles_[ c ] = int( base[ part ] + maps_[ part ].find( cornerKey( c ) ) );
+          }
+        } );
+      }
+
+      unsigned long long cornerKey( size_t c ) const
+      {
+        return ( ( (unsigned long long)( unsigned( triangles_[ c ] ) ) << 32 ) | unsigned( cornerUvs_[ c ] ) );
+      }
+
+      static size_t partitionOf( unsigned long long key, size_t partitions )
+      {
+        return ( size_t( ( FlatIndexMap::hash( key ) >> 40 ) % partitions ) );
+      }
+
+      ///////////////////////////////////////////////////////////////////////////////////
+      // PLY
+
+      static PlyType plyType( const std::string& name )
+      {
+        if ( name == "char"   || name == "int8"    ) return ( PLY_INT8 );
+        if ( name == "uchar"  || name == "uint8"   ) return ( PLY_UINT8 );
+        if ( name == "short"  || name == "int16"   ) return ( PLY_INT16 );
+        if ( name == "ushort" || name == "uint16"  ) return ( PLY_UINT16 );
+        if ( name == "int"    || name == "int32"   ) return ( PLY_INT32 );
+        if ( name == "uint"   || name == "uint32"  ) return ( PLY_UINT32 );
+        if ( name == "float"  || name == "float32" ) return ( PLY_FLOAT32 );
+        if ( name == "double" || name == "float64" ) return ( PLY_FLOAT64 );
+        return ( PLY_INVALID );
+      }
+
+      static size_t plySize( PlyType type )
+      {
+        static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+        return ( sizes[ type ] );
+      }
+
+      //--------------------------------------------------
+      // Function: readPlyHeader
+      // Elements and format, "dataStart" after end_header.
+      //--------------------------------------------------
+      bool readPlyHeader( const char* begin, const char* end, PlyFormat& format,
+                          std::vector< PlyElement >& elements, const char*& dataStart )
+      {
+        const char* line = begin;
+        bool        magic = false, formatSeen = false;
+
+        while ( line < end )
+        {
+          const char* lineEnd = FastParse::nextLine( line, end );
+          std::istringstream words( std::string( line, lineEnd ) );
+          line = lineEnd;
+
+          std::string keyword;
+          words >> keyword;
+
+          if ( !magic )
+          {
+            if ( keyword != "ply" )
+            {
+              return ( fail( "not a PLY file" ) );
+            }
+            magic = true;
+          }
+          else if ( keyword == "format" )
+          {
+            std::string name;
+            words >> name;
+            if ( name == "ascii" )                     format = PLY_ASCII;
+            else if ( name == "binary_little_endian" ) format = PLY_BINARY_LE;
+            else if ( name == "binary_big_endian" )    format = PLY_BINARY_BE;
+            else return ( fail( "unknown PLY format " + name ) );
+            formatSeen = true;
+          }
+          else if ( keyword == "element" )
+          {
+            PlyElement element;
+            words >> element.name >> element.count;
+            elements.push_back( element );
+          }
+          else if ( keyword == "property" )
+          {
+            if ( elements.empty() )
+            {
+              return ( fail( "PLY property outside an element" ) );
+            }
+
+            PlyProperty property;
+            std::string type;
+            words >> type;
+            property.list = ( type == "list" );
+            if ( property.list )
+            {
+              std::string countType, itemType;
+              words >> countType >> itemType >> property.name;
+              property.countType = plyType( countType );
+              property.type      = plyType( itemType );
+            }
+            else
+            {
+              words >> property.name;
+              property.countType = PLY_INVALID;
+              property.type      = plyType( type );
+            }
+
+            if ( property.type == PLY_INVALID || ( property.list && property.countType == PLY_INVALID ) )
+            {
+              return ( fail( "unknown PLY property type" ) );
+            }
+            elements.back().properties.push_back( property );
+          }
+          else if ( keyword == "end_header" )
+          {
+            dataStart = line;
+            return ( formatSeen ? true : fail( "PLY header without format" ) );
+          }
+        }
+        return ( fail( "PLY header without end_header" ) );
+      }
+
+      // Property slots of the vertex and face elements.
+      struct PlyLayout
+      {
+        int x, y, z, u, v;
+        int indices;
+      };
+
+      static int findProperty( const PlyElement& element, const char* const* names )
+      {
+        for ( const char* const* name = names; *name; ++name )
+        {
+          for ( size_t p = 0; p < element.properties.size(); ++p )
+          {
+            if ( element.properties[ p ].name == *name )
+            {
+              return ( int( p ) );
+            }
+          }
+        }
+        return ( -1 );
+      }
+
+      //--------------------------------------------------
+      // Function: readPly
+      // "vertex" x, y, z and optional u / v ( or s / t,
+      // texture_u / texture_v ), "face" vertex_indices. Other
+      // elements and properties are skipped.
+      //--------------------------------------------------
+      bool readPly( const char* begin, const char* end, bool textureCoordinates )
+      {
+        PlyFormat format = PLY_ASCII;
+        std::vector< PlyElement > elements;
+        const char* data = 0;
+        if ( !readPlyHeader( begin, end, format, elements, data ) )
+        {
+          return ( false );
+        }
+
+        int vertexElement = -1, faceElement = -1;
+        for ( size_t e = 0; e < elements.size(); ++e )
+        {
+          vertexElement = ( elements[ e ].name == "vertex" ) ? int( e ) : vertexElement;
+          faceElement   = ( elements[ e ].name == "face" )   ? int( e ) : faceElement;
+        }
+        if ( vertexElement < 0 || faceElement < 0 )
+        {
+          return ( fail( "PLY file without vertex or face element" ) );
+        }
+
+        static const char* const xNames[] = { "x", 0 };
+        static const char* const yNames[] = { "y", 0 };
+        static const char* const zNames[] = { "z", 0 };
+        static const char* const uNames[] = { "u", "s", "texture_u", "texture_s", 0 };
+        static const char* const vNames[] = { "v", "t", "texture_v", "texture_t", 0 };
+        static const char* const iNames[] = { "vertex_indices", "vertex_index", 0 };
+
+        PlyLayout layout;
+        layout.x = findProperty( elements[ vertexElement ], xNames );
+        layout.y = findProperty( elements[ vertexElement ], yNames );
+        layout.z = findProperty( elements[ vertexElement ], zNames );
+        layout.u = textureCoordinates ? findProperty( elements[ vertexElement ], uNames ) : -1;
+        layout.v = textureCoordinates ? findProperty( elements[ vertexElement ], vNames ) : -1;
+        layout.indices = findProperty( elements[ faceElement ], iNames );
+
+        if ( layout.x < 0 || layout.y < 0 || layout.z < 0 || layout.indices < 0 ||
+             !elements[ faceElement ].properties[ layout.indices ].list )
+        {
+          return ( fail( "PLY file without x, y, z or vertex_indices" ) );
+        }
+        const std::vector< PlyProperty >& vertexProperties = elements[ vertexElement ].properties;
+        if ( vertexProperties[ layout.x ].list || vertexProperties[ layout.y ].list || vertexProperties[ layout.z ].list ||
+             ( layout.u >= 0 && vertexProperties[ layout.u ].list ) || ( layout.v >= 0 && vertexProperties[ layout.v ].list ) )
+        {
+          return ( fail( "PLY vertex x, y, z, u or v is a list" ) );
+        }
+        if ( layout.u < 0 || layout.v < 0 )
+        {
+          layout.u = layout.v = -1;
+        }
+
+        const size_t numVertices = elements[ vertexElement ].count;
+        if ( !checkSizes( numVertices, 0 ) )
+        {
+          return ( false );
+        }
+
+        positions_.resize( 3 * numVertices );
+        uvs_.resize( layout.u >= 0 ? 2 * numVertices : 0 );
+
+        return ( format == PLY_ASCII ?
+                 readPlyAscii( data, end, elements, size_t( vertexElement ), size_t( faceElement ), layout ) :
+                 readPlyBinary( data, end, format == PLY_BINARY_BE, elements, size_t( vertexElement ), size_t( faceElement ), layout ) );
+      }
+
+      //--------------------------------------------------
+      // Function: readPlyValue
+      // Binary value of a type, byte swapped for big endian
+      // files, as a double.
+      //--------------------------------------------------
+      static double readPlyValue( const char* p, PlyType type, bool swap )
+      {
+        unsigned char bytes[ 8 ];
+        const size_t size = plySize( type );
+        std::memcpy( bytes, p, size );
+        if ( swap )
+        {
+          std::reverse( bytes, bytes + size );
+        }
+
+        switch ( type )
+        {
+          case PLY_INT8:    { signed char v;    std::memcpy( &v, bytes, 1 ); return ( v ); }
+          case PLY_UINT8:   { unsigned char v;  std::memcpy( &v, bytes, 1 ); return ( v ); }
+          case PLY_INT16:   { short v;          std::memcpy( &v, bytes, 2 ); return ( v ); }
+          case PLY_UINT16:  { unsigned short v; std::memcpy( &v, bytes, 2 ); return ( v ); }
+          case PLY_INT32:   { int v;            std::memcpy( &v, bytes, 4 ); return ( v ); }
+          case PLY_UINT32:  { unsigned int v;   std::memcpy( &v, bytes, 4 ); return ( v ); }
+          case PLY_FLOAT32: { float v;          std::memcpy( &v, bytes, 4 ); return ( v ); }
+          case PLY_FLOAT64: { double v;         std::memcpy( &v, bytes, 8 ); return ( v ); }
+          default:          return ( 0.0 );
+        }
+      }
+
+      // plyCount: a list count, false when it is negative, not whole or past the uint32 range.
+      static bool plyCount( double value, size_t& count )
+      {
+        if ( !( value >= 0.0 && value <= 4294967295.0 ) || value != std::floor( value ) )
+        {
+          return ( false );
+        }
+        count = size_t( value );
+        return ( true );
+      }
+
+      // readPlyCount: a binary list count, checked by plyCount.
+      static bool readPlyCount( const char* p, PlyType type, bool swap, size_t& count )
+      {
+        return ( plyCount( readPlyValue( p, type, swap ), count ) );
+      }
+
+      //--------------------------------------------------
+      // Function: plyItemSize
+      // Bytes of one binary element item starting at "p", 0
+      // when it runs past "end" or has an invalid list count.
+      //--------------------------------------------------
+      static size_t plyItemSize( const PlyElement& element, const char* p, const char* end, bool swap )
+      {
+        size_t size = 0;
+        for ( size_t k = 0; k < element.properties.size(); ++k )
+        {
+          const PlyProperty& property = element.properties[ k ];
+          if ( property.list )
+          {
+            size_t count = 0;
+            if ( size + plySize( property.countType ) > size_t( end - p ) || !readPlyCount( p + size, property.countType, swap, count ) )
+            {
+              return ( 0 );
+            }
+            size += plySize( property.countType ) + count * plySize( property.type );
+          }
+          else
+          {
+            size += plySize( property.type );
+          }
+        }
+        return ( size <= size_t( end - p ) ? size : 0 );
+      }
+
+      //--------------------------------------------------
+      // Function: readPlyBinary
+      // Fixed size elements are addressed directly and the
+      // vertices parsed in parallel; vertices with list
+      // properties are found by a serial walk first, then
+      // parsed in parallel the same way. Face lists vary in size:
+      // when every face of the expected all triangle layout
+      // starts with 3 they are addressed directly too,
+      // otherwise one serial walk records where each block of
+      // FACE_BLOCK faces starts and how many triangles it has.
+      //--------------------------------------------------
+      bool readPlyBinary( const char* data, const char* end, bool swap, const std::vector< PlyElement >& elements,
+                          size_t vertexElement, size_t faceElement, const PlyLayout& layout )
+      {
+        const char* p = data;
+
+        for ( size_t e = 0; e < elements.size(); ++e )
+        {
+          const PlyElement& element = elements[ e ];
+
+          bool   fixed  = true;
+          size_t stride = 0;
+          for ( size_t k = 0; k < element.properties.size(); ++k )
+          {
+            fixed   = fixed && !element.properties[ k ].list;
+            stride += plySize( element.properties[ k ].type );
+          }
+
+          if ( e == faceElement )
+          {
+            p = readPlyBinaryFaces( p, end, swap, element, layout.indices, elements[ vertexElement ].count );
+            if ( !p )
+            {
+              return ( false );
+            }
+            continue;
+          }
+
+          if ( fixed )
+          {
+            if ( size_t( end - p ) / std::max< size_t >( stride, 1 ) < element.count )
+            {
+              return ( fail( "PLY file shorter than its header" ) );
+            }
+
+            if ( e == vertexElement )
+            {
+              std::vector< size_t > offsets( element.properties.size(), 0 );
+              for ( size_t k = 1; k < offsets.size(); ++k )
+              {
+                offsets[ k ] = offsets[ k - 1 ] + plySize( element.properties[ k - 1 ].type );
+              }
+
+              const char* base = p;
+              pool_.parallelFor( element.count, 16384, [&]( size_t first, size_t last, unsigned int )
+              {
+                for ( size_t i = first; i < last; ++i )
+                {
+                  readPlyVertex( i, base + i * stride, element, offsets.data(), layout, swap );
+                }
+              } );
+            }
+
+            p += element.count * stride;
+          }
+          else
+          {
+            // Items vary in size: one serial walk finds where each starts.
+            std::vector< const char* > items( e == vertexElement ? element.count : 0 );
+            for ( size_t i = 0; i < element.count; ++i )
+            {
+              const size_t size = plyItemSize( element, p, end, swap );
+              if ( size == 0 )
+              {
+                return ( fail( "PLY file shorter than its header or with an invalid list count" ) );
+              }
+              if ( e == vertexElement )
+              {
+                items[ i ] = p;
+              }
+              p += size;
+            }
+
+            if ( e == vertexElement )
+            {
+              pool_.parallelFor( element.count, 16384, [&]( size_t first, size_t last, unsigned int )
+              {
+                std::vector< size_t > offsets( element.properties.size(), 0 );
+                for ( size_t i = first; i < last; ++i )
+                {
+                  for ( size_t k = 1; k < offsets.size(); ++k )
+                  {
+                    offsets[ k ] = offsets[ k - 1 ] + propertySize( element.properties[ k - 1 ], items[ i ] + offsets[ k - 1 ], swap );
+                  }
+                  readPlyVertex( i, items[ i ], element, offsets.data(), layout, swap );
+                }
+              } );
+            }
+          }
+        }
+        return ( true );
+      }
+
+      // readPlyVertex: position and uv of vertex i from its item, "offsets" of each property in it.
+      void readPlyVertex( size_t i, const char* item, const PlyElement& element, const size_t* offsets, const PlyLayout& layout, bool swap )
+      {
+        const PlyProperty* props = element.properties.data();
+        positions_[ 3 * i ]     = float( readPlyValue( item + offsets[ layout.x ], props[ layout.x ].type, swap ) );
+        positions_[ 3 * i + 1 ] = float( readPlyValue( item + offsets[ layout.y ], props[ layout.y ].type, swap ) );
+        positions_[ 3 * i + 2 ] = float( readPlyValue( item + offsets[ layout.z ], props[ layout.z ].type, swap ) );
+        if ( layout.u >= 0 )
+        {
+          uvs_[ 2 * i ]     = float( readPlyValue( item + offsets[ layout.u ], props[ layout.u ].type, swap ) );
+          uvs_[ 2 * i + 1 ] = float( readPlyValue( item + offsets[ layout.v ], props[ layout.v ].type, swap ) );
+        }
+      }
+
+      // readPlyBinaryFaces: end of the face element, 0 on error.
+      const char* readPlyBinaryFaces( const char* p, const char* end, bool swap, const PlyElement& element,
+                                      int indexProperty, size_t numVertices )
+      {
+        const size_t numFaces = element.count;
+        const bool   single   = ( element.properties.size() == 1 );
+        const PlyProperty& list = element.properties[ indexProperty ];
+        const size_t countSize = plySize( list.countType ), indexSize = plySize( list.type );
+
+        // Direct addressing when all faces are triangles.
+        const size_t triangleStride = countSize + 3 * indexSize;
+        bool allTriangles = single && size_t( end - p ) / triangleStride >= numFaces;
+        if ( allTriangles )
+        {
+          std::vector< PaddedAccumulator< int > > others( pool_.getNumThreads() );
+          pool_.parallelFor( numFaces, 65536, [&]( size_t first, size_t last, unsigned int thread )
+          {
+            int found = 0;
+            for ( size_t f = first; f < last; ++f )
+            {
+              found += ( readPlyValue( p + f * triangleStride, list.countType, swap ) != 3.0 ) ? 1 : 0;
+            }
+            others[ thread ].value += found;
+          } );
+
+          for ( size_t t = 0; t < others.size(); ++t )
+          {
+            allTriangles = allTriangles && others[ t ].value == 0;
+          }
+        }
+
+        // Block starts and triangle offsets.
+        const size_t numBlocks = ( numFaces + FACE_BLOCK - 1 ) / FACE_BLOCK;
+        std::vector< const char* > blockStart( numBlocks + 1 );
+        std::vector< size_t >      blockTriangle( numBlocks + 1 );
+
+        if ( allTriangles )
+        {
+          for ( size_t b = 0; b <= numBlocks; ++b )
+          {
+            const size_t face = std::min( b * FACE_BLOCK, numFaces );
+            blockStart[ b ]    = p + face * triangleStride;
+            blockTriangle[ b ] = face;
+          }
+        }
+        else
+        {
+          const char* q = p;
+          size_t triangles = 0;
+          for ( size_t f = 0; f < numFaces; ++f )
+          {
+            if ( f % FACE_BLOCK == 0 )
+            {
+              blockStart[ f / FACE_BLOCK ]    = q;
+              blockTriangle[ f / FACE_BLOCK ] = triangles;
+            }
+
+            size_t corners = 0;
+            size_t size    = 0;
+            if ( single )
+            {
+              if ( q + countSize > end )
+              {
+                return ( failNull( "PLY file shorter than its header" ) );
+              }
+              if ( !readPlyCount( q, list.countType, swap, corners ) )
+              {
+                return ( failNull( "invalid PLY list count" ) );
+              }
+              size = countSize + corners * indexSize;
+              if ( size > size_t( end - q ) )
+              {
+                return ( failNull( "PLY file shorter than its header" ) );
+              }
+            }
+            else
+            {
+              size = plyItemSize( element, q, end, swap );
+              if ( size == 0 )
+              {
+                return ( failNull( "PLY file shorter than its header or with an invalid list count" ) );
+              }
+              corners = listCount( element, indexProperty, q, swap );
+            }
+
+            triangles += ( corners >= 3 ) ? corners - 2 : 0;
+            q += size;
+          }
+          blockStart[ numBlocks ]    = q;
+          blockTriangle[ numBlocks ] = triangles;
+        }
+
+        const size_t numTriangles = blockTriangle[ numBlocks ];
+        if ( !checkSizes( numVertices, numTriangles ) )
+        {
+          return ( 0 );
+        }
+        triangles_.resize( 3 * numTriangles );
+
+        std::vector< char > blockError( numBlocks, 0 );
+        pool_.parallelFor( numBlocks, 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t b = first; b < last; ++b )
+          {
+            const char* q = blockStart[ b ];
+            int* out = triangles_.data() + 3 * blockTriangle[ b ];
+            const size_t faces = std::min< size_t >( FACE_BLOCK, numFaces - b * FACE_BLOCK );
+
+            for ( size_t f = 0; f < faces; ++f )
+            {
+              const char* items = q;
+              for ( int k = 0; k < indexProperty; ++k )
+              {
+                items += propertySize( element.properties[ k ], items, swap );
+              }
+              // Counts were checked by the walk above, or are all 3.
+              size_t corners = 0;
+              readPlyCount( items, list.countType, swap, corners );
+              items += countSize;
+
+              long long firstIndex = 0, prevIndex = 0;
+              for ( size_t c = 0; c < corners; ++c )
+              {
+                const double value = readPlyValue( items + c * indexSize, list.type, swap );
+                if ( !( value >= 0.0 && value < double( numVertices ) ) )
+                {
+                  blockError[ b ] = 1;
+                  break;
+                }
+                const long long index = (long long)( value );
+                if ( c == 0 )
+                {
+                  firstIndex = index;
+                }
+                else if ( c >= 2 )
+                {
+                  out[ 0 ] = int( firstIndex ); out[ 1 ] = int( prevIndex ); out[ 2 ] = int( index );
+                  out += 3;
+                }
+                prevIndex = index;
+              }
+
+              q += single ? countSize + corners * indexSize : plyItemSize( element, q, end, swap );
+            }
+          }
+        } );
+
+        for ( size_t b = 0; b < numBlocks; ++b )
+        {
+          if ( blockError[ b ] )
+          {
+            return ( failNull( "PLY face index out of range" ) );
+          }
+        }
+        return ( blockStart[ numBlocks ] );
+      }
+
+      const char* failNull( const std::string& message )
+      {
+        fail( message );
+        return ( 0 );
+      }
+
+      static size_t propertySize( const PlyProperty& property, const char* p, bool swap )
+      {
+        if ( !property.list )
+        {
+          return ( plySize( property.type ) );
+        }
+        size_t count = 0;
+        readPlyCount( p, property.countType, swap, count );
+        return ( plySize( property.countType ) + count * plySize( property.type ) );
+      }
+
+      static size_t listCount( const PlyElement& element, int listProperty, const char* p, bool swap )
+      {
+        for ( int k = 0; k < listProperty; ++k )
+        {
+          p += propertySize( element.properties[ k ], p, swap );
+        }
+        size_t count = 0;
+        readPlyCount( p, element.properties[ listProperty ].countType, swap, count );
+        return ( count );
+      }
+
+      //--------------------------------------------------
+      // Function: readPlyAscii
+      // One item per line, elements in header order. Chunks
+      // count their lines first, so each knows the global
+      // line, and so the element, it starts at; then count
+      // the triangles of their face lines; then parse.
+      //--------------------------------------------------
+      bool readPlyAscii( const char* data, const char* end, const std::vector< PlyElement >& elements,
+                         size_t vertexElement, size_t faceElement, const PlyLayout& layout )
+      {
+        std::vector< size_t > elementLine( elements.size() + 1, 0 );
+        for ( size_t e = 0; e < elements.size(); ++e )
+        {
+          elementLine[ e + 1 ] = elementLine[ e ] + elements[ e ].count;
+        }
+
+        std::vector< Chunk > chunks;
+        splitChunks( data, end, chunks );
+
+        pool_.parallelFor( chunks.size(), 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t k = first; k < last; ++k )
+          {
+            for ( const char* line = chunks[ k ].begin; line < chunks[ k ].end; line = FastParse::nextLine( line, chunks[ k ].end ) )
+            {
+              ++chunks[ k ].lines;
+            }
+          }
+        } );
+
+        size_t lines = 0;
+        for ( size_t k = 0; k < chunks.size(); ++k )
+        {
+          chunks[ k ].firstLine = lines;
+          lines += chunks[ k ].lines;
+        }
+        if ( lines < elementLine[ elements.size() ] )
+        {
+          return ( fail( "PLY file shorter than its header" ) );
+        }
+
+        const size_t faceBegin = elementLine[ faceElement ], faceEnd = elementLine[ faceElement + 1 ];
+        const PlyElement& faces = elements[ faceElement ];
+
+        pool_.parallelFor( chunks.size(), 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          for ( size_t k = first; k < last; ++k )
+          {
+            Chunk& chunk = chunks[ k ];
+            size_t lineIndex = chunk.firstLine;
+            for ( const char* line = chunk.begin; line < chunk.end; ++lineIndex )
+            {
+              const char* lineEnd = FastParse::nextLine( line, chunk.end );
+              if ( lineIndex >= faceBegin && lineIndex < faceEnd )
+              {
+                const char* p = line;
+                size_t corners = 0;
+                chunk.error = chunk.error || !skipToList( faces, layout.indices, p, lineEnd, corners );
+                chunk.triangles += ( corners >= 3 ) ? corners - 2 : 0;
+              }
+              line = lineEnd;
+            }
+          }
+        } );
+
+        size_t numTriangles = 0;
+        for ( size_t k = 0; k < chunks.size(); ++k )
+        {
+          chunks[ k ].firstTriangle = numTriangles;
+          numTriangles += chunks[ k ].triangles;
+        }
+
+        const size_t numVertices = elements[ vertexElement ].count;
+        if ( !checkSizes( numVertices, numTriangles ) )
+        {
+          return ( false );
+        }
+        triangles_.resize( 3 * numTriangles );
+
+        const size_t vertexBegin = elementLine[ vertexElement ], vertexEnd = elementLine[ vertexElement + 1 ];
+        const PlyElement& vertex = elements[ vertexElement ];
+
+        pool_.parallelFor( chunks.size(), 1, [&]( size_t first, size_t last, unsigned int )
+        {
+          std::vector< double > values;
+          for ( size_t k = first; k < last; ++k )
+          {
+            Chunk& chunk = chunks[ k ];
+            int*   out   = triangles_.data() + 3 * chunk.firstTriangle;
+
+            size_t lineIndex = chunk.firstLine;
+            for ( const char* line = chunk.begin; line < chunk.end && !chunk.error; ++lineIndex )
+            {
+              const char* lineEnd = FastParse::nextLine( line, chunk.end );
+              const char* p = line;
+
+              if ( lineIndex >= vertexBegin && lineIndex < vertexEnd )
+              {
+                const size_t i = lineIndex - vertexBegin;
+                if ( !readAsciiValues( vertex, p, lineEnd, values ) )
+                {
+                  chunk.error = true;
+                  break;
+                }
+                positions_[ 3 * i ]     = float( values[ layout.x ] );
+                positions_[ 3 * i + 1 ] = float( values[ layout.y ] );
+                positions_[ 3 * i + 2 ] = float( values[ layout.z ] );
+                if ( layout.u >= 0 )
+                {
+                  uvs_[ 2 * i ]     = float( values[ layout.u ] );
+                  uvs_[ 2 * i + 1 ] = float( values[ layout.v ] );
+                }
+              }
+              else if ( lineIndex >= faceBegin && lineIndex < faceEnd )
+              {
+                size_t corners = 0;
+                if ( !skipToList( faces, layout.indices, p, lineEnd, corners ) )
+                {
+                  chunk.error = true;
+                  break;
+                }
+                long long firstIndex = 0, prevIndex = 0, index = 0;
+                for ( size_t c = 0; c < corners; ++c )
+                {
+                  if ( !FastParse::parseInt( p, lineEnd, index ) || index < 0 || index >= (long long)( numVertices ) )
+                  {
+                    chunk.error = true;
+                    break;
+                  }
+                  if ( c == 0 )
+                  {
+                    firstIndex = index;
+                  }
+                  else if ( c >= 2 )
+                  {
+                    out[ 0 ] = int( firstIndex ); out[ 1 ] = int( prevIndex ); out[ 2 ] = int( index );
+                    out += 3;
+                  }
+                  prevIndex = index;
+                }
+              }
+
+              line = lineEnd;
+            }
+          }
+        } );
+
+        for ( size_t k = 0; k < chunks.size(); ++k )
+        {
+          if ( chunks[ k ].error )
+          {
+            return ( fail( "malformed PLY line or face index out of range" ) );
+          }
+        }
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: readAsciiValues
+      // The scalar properties of an ASCII item in order, list
+      // values are read past. A list property stores its count.
+      //--------------------------------------------------
+      static bool readAsciiValues( const PlyElement& element, const char*& p, const char* lineEnd, std::vector< double >& values )
+      {
+        values.resize( element.properties.size() );
+        for ( size_t k = 0; k < element.properties.size(); ++k )
+        {
+          if ( !FastParse::parseDouble( p, lineEnd, values[ k ] ) )
+          {
+            return ( false );
+          }
+          if ( element.properties[ k ].list )
+          {
+            double ignored = 0.0;
+            size_t count   = 0;
+            if ( !plyCount( values[ k ], count ) )
+            {
+              return ( false );
+            }
+            for ( size_t c = count; c > 0; --c )
+            {
+              if ( !FastParse::parseDouble( p, lineEnd, ignored ) )
+              {
+                return ( false );
+              }
+            }
+          }
+        }
+        return ( true );
+      }
+
+      // skipToList: moves "p" to the items of list property "listProperty" and reads its count, false if malformed.
+      static bool skipToList( const PlyElement& element, int listProperty, const char*& p, const char* lineEnd, size_t& count )
+      {
+        double value = 0.0;
+        for ( int k = 0; k < listProperty; ++k )
+        {
+          size_t items = 0;
+          if ( !FastParse::parseDouble( p, lineEnd, value ) || ( element.properties[ k ].list && !plyCount( value, items ) ) )
+          {
+            return ( false );
+          }
+          for ( ; items > 0; --items )
+          {
+            if ( !FastParse::parseDouble( p, lineEnd, value ) )
+            {
+              return ( false );
+            }
+          }
+        }
+
+        long long items = 0;
+        if ( !FastParse::parseInt( p, lineEnd, items ) || items < 0 || items > 4294967295ll )
+        {
+          return ( false );
+        }
+        count = size_t( items );
+        return ( true );
+      }
+
+    private:
+
+      MeshFileReader( const MeshFileReader& );
+      MeshFileReader& operator =( const MeshFileReader& );
+
+    private:
+
+      ThreadPool& pool_;
+
+      std::vector< float > positions_;
+      std::vector< float > uvs_;
+      std::vector< int >   triangles_;
+      std::vector< int >   cornerUvs_;
+
+      std::vector< FlatIndexMap >                        maps_;
+      std::vector< std::vector< unsigned long long > >   keys_;
+      std::vector< unsigned int >                        cornerParts_;
+      std::vector< unsigned int >                        buckets_;
+
+      std::string error_;
+      size_t      fileSize_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_MESH_FILE_READER_H
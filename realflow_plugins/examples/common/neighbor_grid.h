@@ -0,0 +1,267 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_NEIGHBOR_GRID_H
+#define _RF_EXAMPLES_NEIGHBOR_GRID_H
+
+#include <vector>
+#include <cmath>
+
+#include "thread_pool.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: NeighborGrid
+    // Hashed uniform grid over SoA positions. build() sorts
+    // the points by bucket ( counting sort ), and
+    // buildNeighborLists() flattens the neighbors of every
+    // point inside a radius into one CSR array, so solver
+    // passes that iterate several times per step read
+    // contiguous indices instead of querying the grid again.
+    // Arrays are reused between steps and only grow.
+    //--------------------------------------------------
+    class NeighborGrid
+    {
+    public:
+
+      /// Constructor.
+      NeighborGrid() : cellSize_( 1.0f ), invCellSize_( 1.0f ), tableMask_( 0 ), count_( 0 ) {};
+
+      /// Destructor.
+      ~NeighborGrid( void ) {};
+
+      //--------------------------------------------------
+      // Function: build
+      // cellSize should be at least the query radius, so a
+      // query only has to visit the 27 surrounding cells.
+      //--------------------------------------------------
+      void build( const float* x, const float* y, const float* z,
+                  size_t count, float cellSize, ThreadPool& pool )
+      {
+        count_       = count;
+        cellSize_    = cellSize;
+        invCellSize_ = 1.0f / cellSize;
+
+        size_t tableSize = 1;
+        while ( tableSize < 2 * count )
+        {
+          tableSize <<= 1;
+        }
+        tableMask_ = tableSize - 1;
+
+        bucketOfPoint_.resize( count );
+        sortedPoints_.resize( count );
+        bucketStart_.assign( tableSize + 1, 0 );
+
+        pool.parallelFor( count, 4096, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            bucketOfPoint_[ i ] = bucketOf( cellCoord( x[ i ] ), cellCoord( y[ i ] ), cellCoord( z[ i ] ) );
+          }
+        } );
+
+        // Counting sort: histogram, exclusive prefix sum, scatter.
+        for ( size_t i = 0; i < count; ++i )
+        {
+          ++bucketStart_[ bucketOfPoint_[ i ] + 1 ];
+        }
+        for ( size_t b = 0; b < tableSize; ++b )
+        {
+          bucketStart_[ b + 1 ] += bucketStart_[ b ];
+        }
+
+        fillCursor_.assign( bucketStart_.begin(), bucketStart_.end() - 1 );
+        for ( size_t i = 0; i < count; ++i )
+        {
+          sortedPoints_[ fillCursor_[ bucketOfPoint_[ i ] ]++ ] = static_cast< unsigned int >( i );
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: forEachCandidate
+      // Calls visitor( j ) for every point in the 27 cells around
+      // ( px, py, pz ). Buckets shared by several of those cells
+      // after hashing are visited once, so no point is repeated.
+      //--------------------------------------------------
+      template < class VISITOR >
+      void forEachCandidate( float px, float py, float pz, VISITOR& visitor ) const
+      {
+        const int cx = cellCoord( px );
+        const int cy = cellCoord( py );
+        const int cz = cellCoord( pz );
+
+        unsigned int visited[ 27 ];
+        int numVisited = 0;
+
+        for ( int dz = -1; dz <= 1; ++dz )
+        {
+          for ( int dy = -1; dy <= 1; ++dy )
+          {
+            for ( int dx = -1; dx <= 1; ++dx )
+            {
+              const unsigned int bucket = bucketOf( cx + dx, cy + dy, cz + dz );
+
+              bool seen = false;
+              for ( int v = 0; v < numVisited && !seen; ++v )
+              {
+                seen = ( visited[ v ] == bucket );
+              }
+              if ( seen )
+              {
+                continue;
+              }
+              visited[ numVisited++ ] = bucket;
+
+              for ( unsigned int k = bucketStart_[ bucket ], end = bucketStart_[ bucket + 1 ]; k < end; ++k )
+              {
+                visitor( sortedPoints_[ k ] );
+              }
+            }
+          }
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: buildNeighborLists
+      // Two parallel passes ( count, then fill ) around a serial
+      // prefix sum. The point itself is not in its own list.
+      //--------------------------------------------------
+      void buildNeighborLists( const float* x, const float* y, const float* z,
+                               float radius, ThreadPool& pool )
+      {
+        const float radius2 = radius * radius;
+
+        neighborStart_.resize( count_ + 1 );
+        neighborStart_[ 0 ] = 0;
+
+        pool.parallelFor( count_, 256, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            CountVisitor visitor( x, y, z, i, radius2 );
+            forEachCandidate( x[ i ], y[ i ], z[ i ], visitor );
+            neighborStart_[ i + 1 ] = visitor.count;
+          }
+        } );
+
+        for ( size_t i = 0; i < count_; ++i )
+        {
+          neighborStart_[ i + 1 ] += neighborStart_[ i ];
+        }
+
+        neighbors_.resize( neighborStart_[ count_ ] );
+
+        pool.parallelFor( count_, 256, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            FillVisitor visitor( x, y, z, i, radius2, neighbors_.data() + neighborStart_[ i ] );
+            forEachCandidate( x[ i ], y[ i ], z[ i ], visitor );
+          }
+        } );
+      }
+
+      // Neighbor list of point i: [ getNeighborsBegin( i ), getNeighborsEnd( i ) ).
+      const unsigned int* getNeighborsBegin( size_t i ) const { return ( neighbors_.data() + neighborStart_[ i ] ); }
+      const unsigned int* getNeighborsEnd( size_t i ) const { return ( neighbors_.data() + neighborStart_[ i + 1 ] ); }
+      unsigned int getNumNeighbors( size_t i ) const { return ( static_cast< unsigned int >( neighborStart_[ i + 1 ] - neighborStart_[ i ] ) ); }
+      size_t getTotalNeighbors( void ) const { return ( neighbors_.size() ); }
+
+      size_t getNumPoints( void ) const { return ( count_ ); }
+      float getCellSize( void ) const { return ( cellSize_ ); }
+
+      // Points in bucket order, handy to walk the grid cache-friendly.
+      const std::vector< unsigned int >& getSortedPoints( void ) const { return ( sortedPoints_ ); }
+
+      // cellCoord
+      int cellCoord( float v ) const
+      {
+        return ( int( std::floor( v * invCellSize_ ) ) );
+      }
+
+    private:
+
+      // bucketOf: spatial hash of integer cell coordinates.
+      unsigned int bucketOf( int cx, int cy, int cz ) const
+      {
+        const unsigned int h = ( static_cast< unsigned int >( cx ) * 73856093u ) ^
+                               ( static_cast< unsigned int >( cy ) * 19349663u ) ^
+                               ( static_cast< unsigned int >( cz ) * 83492791u );
+        return ( h & static_cast< unsigned int >( tableMask_ ) );
+      }
+
+      struct CountVisitor
+      {
+        CountVisitor( const float* x_, const float* y_, const float* z_, size_t i_, float radius2_ )
+          : x( x_ ), y( y_ ), z( z_ ), i( i_ ), radius2( radius2_ ), count( 0 ) {};
+
+        void operator()( unsigned int j )
+        {
+          const float dx = x[ j ] - x[ i ], dy = y[ j ] - y[ i ], dz = z[ j ] - z[ i ];
+          if ( j != i && dx * dx + dy * dy + dz * dz < radius2 )
+          {
+            ++count;
+          }
+        }
+
+        const float* x; const float* y; const float* z;
+        size_t       i;
+        float        radius2;
+        unsigned int count;
+      };
+
+      struct FillVisitor
+      {
+        FillVisitor( const float* x_, const float* y_, const float* z_, size_t i_, float radius2_, unsigned int* out_ )
+          : x( x_ ), y( y_ ), z( z_ ), i( i_ ), radius2( radius2_ ), out( out_ ) {};
+
+        void operator()( unsigned int j )
+        {
+          const float dx = x[ j ] - x[ i ], dy = y[ j ] - y[ i ], dz = z[ j ] - z[ i ];
+          if ( j != i && dx * dx + dy * dy + dz * dz < radius2 )
+          {
+            *out++ = j;
+          }
+        }
+
+        const float*  x; const float* y; const float* z;
+        size_t        i;
+        float         radius2;
+        unsigned int* out;
+      };
+
+    private:
+
+      float                       cellSize_;
+      float                       invCellSize_;
+      size_t                      tableMask_;
+      size_t                      count_;
+
+      std::vector< unsigned int > bucketOfPoint_;
+      std::vector< unsigned int > bucketStart_;
+      std::vector< unsigned int > fillCursor_;
+      std::vector< unsigned int > sortedPoints_;
+
+      std::vector< size_t >       neighborStart_;
+      std::vector< unsigned int > neighbors_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_NEIGHBOR_GRID_H
@@ -0,0 +1,705 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_PARTICLE_CACHE_FORMAT_H
+#define _RF_EXAMPLES_PARTICLE_CACHE_FORMAT_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include "lz_codec.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Columnar particle cache frame, an emitter at a frame:
+    //
+    //   ParticleCacheHeader | numColumns ParticleCacheColumn |
+    //   column blocks
+    //
+    // Column offsets are relative to the frame header. The
+    // frames of an emitter are kept in one container file,
+    // see ParticleCacheContainer.
+    //
+    // Particles are stored in ascending id order. Column 0
+    // holds the ids, the others one scalar attribute each
+    // ( a vector is three columns ). Every column is turned
+    // into residuals, byte shuffled ( byte b of every value,
+    // then byte b + 1... ) and LZ compressed, or stored
+    // shuffled when that does not pay:
+    //
+    //   KIND_ID         difference to the previous id
+    //   KIND_QUANTIZED  round( value / scale ) as int32
+    //   KIND_FLOAT      float bits, lossless
+    //   KIND_DOUBLE     double bits, lossless
+    //   KIND_INT        int32
+    //   KIND_CHAR       int8
+    //
+    // A keyframe ( reference == NO_REFERENCE ) stores the
+    // values themselves. Any other frame stores them against
+    // the particle with the same id in the "reference" frame:
+    // differences for integers and quantized values, XOR of
+    // the bits for lossless floats. New particles compare
+    // against 0. Quantized frames decode to exactly the same
+    // integers, so the error never accumulates over a chain.
+    //
+    // Every written frame gets a "stamp" no other write
+    // shares, and a delta frame keeps the stamp of its
+    // reference in "referenceStamp". Re-simulating frame N
+    // gives it a new stamp, so the old frames after it, still
+    // encoded against the old N, no longer match and are
+    // rejected instead of decoded against the wrong values.
+    //--------------------------------------------------
+
+    enum ParticleCacheKind
+    {
+      KIND_ID,
+      KIND_QUANTIZED,
+      KIND_FLOAT,
+      KIND_DOUBLE,
+      KIND_INT,
+      KIND_CHAR
+    };
+
+    enum ParticleCacheCodecType
+    {
+      CODEC_NONE,
+      CODEC_LZ
+    };
+
+    // Attribute ids of the built in columns, custom attributes keep their own.
+    enum ParticleCacheAttribute
+    {
+      ATTRIBUTE_ID       = -1,
+      ATTRIBUTE_POSITION = -2,
+      ATTRIBUTE_VELOCITY = -3
+    };
+
+    struct ParticleCacheHeader
+    {
+      enum { VERSION = 2, NO_REFERENCE = 0xFFFFFFFFu };
+
+      char               magic[ 4 ];
+      unsigned int       version;
+      unsigned int       frame;
+      unsigned int       reference;
+      unsigned long long count;
+      unsigned int       numColumns;
+      unsigned int       reserved;
+      unsigned long long stamp;
+      unsigned long long referenceStamp;
+
+      static const char* getMagic( void ) { return ( "RFPC" ); }
+    };
+
+    struct ParticleCacheColumn
+    {
+      int                attribute;
+      unsigned char      component;
+      unsigned char      kind;
+      unsigned char      codec;
+      unsigned char      width;
+      double             scale;
+      unsigned long long rawSize;
+      unsigned long long storedSize;
+      unsigned long long offset;
+    };
+
+    // Where a frame is in its container.
+    struct ParticleCacheIndexEntry
+    {
+      unsigned int       frame;
+      unsigned int       reserved;
+      unsigned long long offset;
+      unsigned long long size;
+      unsigned long long stamp;
+    };
+
+    struct ParticleCacheFooter
+    {
+      enum { VERSION = 1 };
+
+      char               magic[ 4 ];
+      unsigned int       version;
+      unsigned long long indexOffset;
+      unsigned long long numFrames;
+      unsigned long long checksum;
+
+      static const char* getMagic( void ) { return ( "RFPX" ); }
+    };
+
+    static_assert( sizeof( ParticleCacheHeader ) == 48, "ParticleCacheHeader layout" );
+    static_assert( sizeof( ParticleCacheColumn ) == 40, "ParticleCacheColumn layout" );
+    static_assert( sizeof( ParticleCacheIndexEntry ) == 32, "ParticleCacheIndexEntry layout" );
+    static_assert( sizeof( ParticleCacheFooter ) == 32, "ParticleCacheFooter layout" );
+
+    //--------------------------------------------------
+    // Struct: ParticleCacheColumnData
+    // Decoded values of a column, "width" bytes per particle.
+    // To write, "kind" is KIND_FLOAT with "scale" > 0 for a
+    // quantized float; the codec falls back to lossless when
+    // a value does not fit the int32 range.
+    //--------------------------------------------------
+    struct ParticleCacheColumnData
+    {
+      ParticleCacheColumnData() : attribute( 0 ), component( 0 ), kind( KIND_FLOAT ), width( 4 ), scale( 0.0 ) {};
+
+      int                          attribute;
+      unsigned char                component;
+      unsigned char                kind;
+      unsigned char                width;
+      double                       scale;
+      std::vector< unsigned char > values;
+
+      // sameLayout: a delta against "other" is possible.
+      bool sameLayout( const ParticleCacheColumnData& other ) const
+      {
+        return ( attribute == other.attribute && component == other.component && kind == other.kind &&
+                 width == other.width && scale == other.scale );
+      }
+    };
+
+    // A frame of an emitter, ids and one entry per column.
+    struct ParticleCacheFrame
+    {
+      ParticleCacheFrame() : frame( 0 ) {};
+
+      unsigned int                            frame;
+      std::vector< long long >                ids;
+      std::vector< ParticleCacheColumnData >  columns;
+    };
+
+    //--------------------------------------------------
+    // Class: ParticleCacheCodec
+    // Column transforms shared by the writer and the reader.
+    // A column "state" is what the next frame is compared
+    // against: the quantized integers or the raw bits, one
+    // "width" wide value per particle.
+    //--------------------------------------------------
+    class ParticleCacheCodec
+    {
+    public:
+
+      static const unsigned int NO_MATCH = 0xFFFFFFFFu;
+
+      //--------------------------------------------------
+      // Function: sortById
+      // Reorders ids and columns by ascending id.
+      //--------------------------------------------------
+      static void sortById( ParticleCacheFrame& frame, std::vector< std::pair< long long, unsigned int > >& order,
+                            std::vector< unsigned char >& scratch )
+      {
+        const size_t count = frame.ids.size();
+
+        bool sorted = true;
+        for ( size_t i = 1; i < count && sorted; ++i )
+        {
+          sorted = frame.ids[ i - 1 ] < frame.ids[ i ];
+        }
+        if ( sorted )
+        {
+          return;
+        }
+
+        order.resize( count );
+        for ( size_t i = 0; i < count; ++i )
+        {
+          order[ i ] = std::make_pair( frame.ids[ i ], static_cast< unsigned int >( i ) );
+        }
+        std::sort( order.begin(), order.end() );
+
+        for ( size_t i = 0; i < count; ++i )
+        {
+          frame.ids[ i ] = order[ i ].first;
+        }
+
+        for ( size_t c = 0; c < frame.columns.size(); ++c )
+        {
+          std::vector< unsigned char >& values = frame.columns[ c ].values;
+          const size_t width = frame.columns[ c ].width;
+
+          scratch.resize( values.size() );
+          for ( size_t i = 0; i < count; ++i )
+          {
+            std::memcpy( &scratch[ i * width ], &values[ order[ i ].second * width ], width );
+          }
+          values.swap( scratch );
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: matchIds
+      // For every id, its index in the sorted "previous" ids
+      // or NO_MATCH, in one merge walk.
+      //--------------------------------------------------
+      static void matchIds( const std::vector< long long >& previous, const std::vector< long long >& ids,
+                            std::vector< unsigned int >& match )
+      {
+        match.resize( ids.size() );
+
+        size_t p = 0;
+        for ( size_t i = 0; i < ids.size(); ++i )
+        {
+          while ( p < previous.size() && previous[ p ] < ids[ i ] )
+          {
+            ++p;
+          }
+          match[ i ] = ( p < previous.size() && previous[ p ] == ids[ i ] ) ? static_cast< unsigned int >( p ) : NO_MATCH;
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: encodeIds
+      // Column 0, ids as in-frame differences.
+      //--------------------------------------------------
+      static void encodeIds( const std::vector< long long >& ids, ParticleCacheColumn& header,
+                             std::vector< unsigned char >& scratch, std::vector< unsigned char >& stored )
+      {
+        const size_t count = ids.size();
+
+        std::vector< unsigned char > residuals( count * 8 );
+        unsigned long long* out = reinterpret_cast< unsigned long long* >( residuals.data() );
+        for ( size_t i = 0; i < count; ++i )
+        {
+          out[ i ] = static_cast< unsigned long long >( ids[ i ] ) - ( i > 0 ? static_cast< unsigned long long >( ids[ i - 1 ] ) : 0ull );
+        }
+
+        initHeader( header, ATTRIBUTE_ID, 0, KIND_ID, 8, 0.0 );
+        pack( residuals, 8, count, header, scratch, stored );
+      }
+
+      // decodeIds: false for a corrupt block.
+      static bool decodeIds( const ParticleCacheColumn& header, const unsigned char* stored, size_t count,
+                             std::vector< unsigned char >& scratch, std::vector< long long >& ids )
+      {
+        std::vector< unsigned char > residuals;
+        if ( header.kind != KIND_ID || header.width != 8 || !unpack( header, stored, count, scratch, residuals ) )
+        {
+          return ( false );
+        }
+
+        ids.resize( count );
+        const unsigned long long* in = reinterpret_cast< const unsigned long long* >( residuals.data() );
+        unsigned long long id = 0;
+        for ( size_t i = 0; i < count; ++i )
+        {
+          id += in[ i ];
+          ids[ i ] = static_cast< long long >( id );
+        }
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: encodeColumn
+      // "match" from matchIds(), empty for a keyframe, indexes
+      // "previousState". Leaves this frame's state in "state".
+      //--------------------------------------------------
+      static void encodeColumn( const ParticleCacheColumnData& column, size_t count, const std::vector< unsigned int >& match,
+                                const std::vector< unsigned char >& previousState, std::vector< unsigned char >& state,
+                                ParticleCacheColumn& header, std::vector< unsigned char >& scratch,
+                                std::vector< unsigned char >& stored )
+      {
+        unsigned char kind = column.kind;
+        if ( kind == KIND_FLOAT && column.scale > 0.0 && quantize( column, count, state ) )
+        {
+          kind = KIND_QUANTIZED;
+        }
+        else
+        {
+          state = column.values;
+        }
+
+        initHeader( header, column.attribute, column.component, kind, column.width, kind == KIND_QUANTIZED ? column.scale : 0.0 );
+
+        std::vector< unsigned char > residuals( state.size() );
+        switch ( column.width )
+        {
+          case 1:  toResiduals< unsigned char >( kind, state, previousState, match, residuals );      break;
+          case 4:  toResiduals< unsigned int >( kind, state, previousState, match, residuals );       break;
+          default: toResiduals< unsigned long long >( kind, state, previousState, match, residuals ); break;
+        }
+        pack( residuals, column.width, count, header, scratch, stored );
+      }
+
+      //--------------------------------------------------
+      // Function: decodeColumn
+      // Inverse of encodeColumn(), "column" gets the values
+      // and "state" the state for the next frame.
+      //--------------------------------------------------
+      static bool decodeColumn( const ParticleCacheColumn& header, const unsigned char* stored, size_t count,
+                                const std::vector< unsigned int >& match, const std::vector< unsigned char >& previousState,
+                                std::vector< unsigned char >& state, std::vector< unsigned char >& scratch,
+                                ParticleCacheColumnData& column )
+      {
+        if ( header.kind == KIND_ID || header.kind > KIND_CHAR || header.width != kindWidth( header.kind ) ||
+             !unpack( header, stored, count, scratch, state ) )
+        {
+          return ( false );
+        }
+
+        switch ( header.width )
+        {
+          case 1:  fromResiduals< unsigned char >( header.kind, state, previousState, match );      break;
+          case 4:  fromResiduals< unsigned int >( header.kind, state, previousState, match );       break;
+          default: fromResiduals< unsigned long long >( header.kind, state, previousState, match ); break;
+        }
+
+        column.attribute = header.attribute;
+        column.component = header.component;
+        column.width     = header.width;
+        column.scale     = header.scale;
+        column.kind      = ( header.kind == KIND_QUANTIZED ) ? static_cast< unsigned char >( KIND_FLOAT ) : header.kind;
+
+        if ( header.kind == KIND_QUANTIZED )
+        {
+          column.values.resize( count * 4 );
+          const int* q   = reinterpret_cast< const int* >( state.data() );
+          float*     out = reinterpret_cast< float* >( column.values.data() );
+          for ( size_t i = 0; i < count; ++i )
+          {
+            out[ i ] = float( double( q[ i ] ) * header.scale );
+          }
+        }
+        else
+        {
+          column.values = state;
+        }
+        return ( true );
+      }
+
+      // kindWidth: bytes per value of a stored kind.
+      static unsigned char kindWidth( unsigned char kind )
+      {
+        static const unsigned char widths[] = { 8, 4, 4, 8, 4, 1 };
+        return ( kind <= KIND_CHAR ? widths[ kind ] : 0 );
+      }
+
+    private:
+
+      static void initHeader( ParticleCacheColumn& header, int attribute, unsigned char component, unsigned char kind,
+                              unsigned char width, double scale )
+      {
+        std::memset( &header, 0, sizeof( header ) );
+        header.attribute = attribute;
+        header.component = component;
+        header.kind      = kind;
+        header.width     = width;
+        header.scale     = scale;
+      }
+
+      // quantize: int32 steps of a float column, false when one does not fit.
+      static bool quantize( const ParticleCacheColumnData& column, size_t count, std::vector< unsigned char >& state )
+      {
+        const double inverse = 1.0 / column.scale;
+        const float* values  = reinterpret_cast< const float* >( column.values.data() );
+
+        state.resize( count * 4 );
+        int* q = reinterpret_cast< int* >( state.data() );
+        for ( size_t i = 0; i < count; ++i )
+        {
+          const double steps = std::floor( double( values[ i ] ) * inverse + 0.5 );
+          if ( !( std::fabs( steps ) < 1073741824.0 ) )
+          {
+            return ( false );
+          }
+          q[ i ] = int( steps );
+        }
+        return ( true );
+      }
+
+      template < class T >
+      static T zigzag( T value )
+      {
+        return ( T( value << 1 ) ^ T( T( 0 ) - T( value >> ( 8 * sizeof( T ) - 1 ) ) ) );
+      }
+
+      template < class T >
+      static T unzigzag( T value )
+      {
+        return ( T( value >> 1 ) ^ T( T( 0 ) - T( value & 1 ) ) );
+      }
+
+      template < class T >
+      static void toResiduals( unsigned char kind, const std::vector< unsigned char >& state, const std::vector< unsigned char >& previousState,
+                               const std::vector< unsigned int >& match, std::vector< unsigned char >& residuals )
+      {
+        const size_t count    = state.size() / sizeof( T );
+        const T*     current  = reinterpret_cast< const T* >( state.data() );
+        const T*     previous = reinterpret_cast< const T* >( previousState.data() );
+        T*           out      = reinterpret_cast< T* >( residuals.data() );
+        const bool   bits     = ( kind == KIND_FLOAT || kind == KIND_DOUBLE );
+
+        for ( size_t i = 0; i < count; ++i )
+        {
+          const T reference = ( !match.empty() && match[ i ] != NO_MATCH ) ? previous[ match[ i ] ] : T( 0 );
+          out[ i ] = bits ? T( current[ i ] ^ reference ) : zigzag< T >( T( current[ i ] - reference ) );
+        }
+      }
+
+      template < class T >
+      static void fromResiduals( unsigned char kind, std::vector< unsigned char >& state, const std::vector< unsigned char >& previousState,
+                                 const std::vector< unsigned int >& match )
+      {
+        const size_t count    = state.size() / sizeof( T );
+        const T*     previous = reinterpret_cast< const T* >( previousState.data() );
+        T*           values   = reinterpret_cast< T* >( state.data() );
+        const bool   bits     = ( kind == KIND_FLOAT || kind == KIND_DOUBLE );
+
+        for ( size_t i = 0; i < count; ++i )
+        {
+          const T reference = ( !match.empty() && match[ i ] != NO_MATCH ) ? previous[ match[ i ] ] : T( 0 );
+          values[ i ] = bits ? T( values[ i ] ^ reference ) : T( unzigzag< T >( values[ i ] ) + reference );
+        }
+      }
+
+      // pack: shuffles "residuals" into "scratch" and compresses it into "stored".
+      static void pack( const std::vector< unsigned char >& residuals, size_t width, size_t count, ParticleCacheColumn& header,
+                        std::vector< unsigned char >& scratch, std::vector< unsigned char >& stored )
+      {
+        scratch.resize( residuals.size() );
+        for ( size_t b = 0; b < width; ++b )
+        {
+          unsigned char* plane = scratch.data() + b * count;
+          for ( size_t i = 0; i < count; ++i )
+          {
+            plane[ i ] = residuals[ i * width + b ];
+          }
+        }
+
+        header.rawSize = scratch.size();
+        if ( LzCodec::compress( scratch.data(), scratch.size(), stored ) < scratch.size() )
+        {
+          header.codec = CODEC_LZ;
+        }
+        else
+        {
+          header.codec = CODEC_NONE;
+          stored = scratch;
+        }
+        header.storedSize = stored.size();
+      }
+
+      // unpack: inverse of pack(), false for a corrupt block.
+      static bool unpack( const ParticleCacheColumn& header, const unsigned char* stored, size_t count,
+                          std::vector< unsigned char >& scratch, std::vector< unsigned char >& residuals )
+      {
+        const size_t width = header.width;
+        if ( header.rawSize != count * width )
+        {
+          return ( false );
+        }
+
+        scratch.resize( size_t( header.rawSize ) );
+        if ( header.codec == CODEC_LZ )
+        {
+          if ( !LzCodec::decompress( stored, size_t( header.storedSize ), scratch.data(), scratch.size() ) )
+          {
+            return ( false );
+          }
+        }
+        else if ( header.codec == CODEC_NONE && header.storedSize == header.rawSize )
+        {
+          if ( !scratch.empty() )
+          {
+            std::memcpy( scratch.data(), stored, scratch.size() );
+          }
+        }
+        else
+        {
+          return ( false );
+        }
+
+        residuals.resize( scratch.size() );
+        for ( size_t b = 0; b < width; ++b )
+        {
+          const unsigned char* plane = scratch.data() + b * count;
+          for ( size_t i = 0; i < count; ++i )
+          {
+            residuals[ i * width + b ] = plane[ i ];
+          }
+        }
+        return ( true );
+      }
+    };
+
+    //--------------------------------------------------
+    // Class: ParticleCacheContainer
+    // The frames of an emitter in one file, "<name>.rfpc":
+    //
+    //   frame | frame | ... | index | ParticleCacheFooter
+    //
+    // Every frame is padded to 8 bytes. The index has one
+    // ParticleCacheIndexEntry per frame in ascending frame
+    // order and the footer, always the last bytes of the
+    // file, says where the index is and checksums it.
+    //
+    // A frame is added by writing it over the old index and
+    // the new index and footer after it. The file never
+    // shrinks, a shorter index leaves a gap before the
+    // footer, and written frames are never touched again, so
+    // a reader mapping the file keeps valid pages while it
+    // grows. Adding frame N drops N and every later frame
+    // from the index, they belong to the run being
+    // re-simulated. When the footer or the index do not check
+    // out ( an interrupted write ) the frames are found again
+    // by walking the frame headers from the start.
+    //--------------------------------------------------
+    class ParticleCacheContainer
+    {
+    public:
+
+      typedef std::vector< ParticleCacheIndexEntry > Index;
+
+      // padded: frame bytes rounded up to the 8 byte alignment of the next frame.
+      static unsigned long long padded( unsigned long long size )
+      {
+        return ( ( size + 7 ) & ~7ull );
+      }
+
+      //--------------------------------------------------
+      // Function: frameSize
+      // Bytes of the frame at "offset", 0 when there is no
+      // complete frame there.
+      //--------------------------------------------------
+      static unsigned long long frameSize( const char* data, unsigned long long size, unsigned long long offset )
+      {
+        if ( offset > size || size - offset < sizeof( ParticleCacheHeader ) )
+        {
+          return ( 0 );
+        }
+
+        const ParticleCacheHeader& h = *reinterpret_cast< const ParticleCacheHeader* >( data + offset );
+        const unsigned long long available = size - offset;
+        if ( std::memcmp( h.magic, ParticleCacheHeader::getMagic(), sizeof( h.magic ) ) != 0 ||
+             h.version != ParticleCacheHeader::VERSION || h.numColumns == 0 ||
+             ( available - sizeof( ParticleCacheHeader ) ) / sizeof( ParticleCacheColumn ) < h.numColumns )
+        {
+          return ( 0 );
+        }
+
+        const ParticleCacheColumn* table = reinterpret_cast< const ParticleCacheColumn* >( data + offset + sizeof( ParticleCacheHeader ) );
+        unsigned long long end = sizeof( ParticleCacheHeader ) + h.numColumns * sizeof( ParticleCacheColumn );
+        for ( unsigned int c = 0; c < h.numColumns; ++c )
+        {
+          if ( table[ c ].offset > available || table[ c ].storedSize > available - table[ c ].offset )
+          {
+            return ( 0 );
+          }
+          end = std::max( end, table[ c ].offset + table[ c ].storedSize );
+        }
+        return ( end );
+      }
+
+      // addFrame: "entry" replaces its frame and every later one.
+      static void addFrame( Index& index, const ParticleCacheIndexEntry& entry )
+      {
+        index.erase( std::lower_bound( index.begin(), index.end(), entry, byFrame ), index.end() );
+        index.push_back( entry );
+      }
+
+      // findFrame: entry of "frame", 0 if it is not in the index.
+      static const ParticleCacheIndexEntry* findFrame( const Index& index, unsigned int frame )
+      {
+        ParticleCacheIndexEntry key;
+        std::memset( &key, 0, sizeof( key ) );
+        key.frame = frame;
+
+        Index::const_iterator it = std::lower_bound( index.begin(), index.end(), key, byFrame );
+        return ( it != index.end() && it->frame == frame ? &*it : 0 );
+      }
+
+      //--------------------------------------------------
+      // Function: readIndex
+      // Index of a mapped container and in "dataEnd" the end
+      // of its last frame, where the next one goes. False when
+      // the index had to be rebuilt from the frame headers.
+      //--------------------------------------------------
+      static bool readIndex( const char* data, unsigned long long size, Index& index, unsigned long long& dataEnd )
+      {
+        index.clear();
+        dataEnd = 0;
+
+        if ( size >= sizeof( ParticleCacheFooter ) )
+        {
+          const ParticleCacheFooter& footer = *reinterpret_cast< const ParticleCacheFooter* >( data + size - sizeof( ParticleCacheFooter ) );
+          const unsigned long long   limit  = size - sizeof( ParticleCacheFooter );
+          if ( std::memcmp( footer.magic, ParticleCacheFooter::getMagic(), sizeof( footer.magic ) ) == 0 &&
+               footer.version == ParticleCacheFooter::VERSION && footer.indexOffset <= limit &&
+               footer.numFrames <= ( limit - footer.indexOffset ) / sizeof( ParticleCacheIndexEntry ) &&
+               footer.checksum == checksum( data + footer.indexOffset, size_t( footer.numFrames * sizeof( ParticleCacheIndexEntry ) ) ) )
+          {
+            const ParticleCacheIndexEntry* entries = reinterpret_cast< const ParticleCacheIndexEntry* >( data + footer.indexOffset );
+            index.assign( entries, entries + footer.numFrames );
+
+            bool valid = true;
+            for ( size_t i = 0; i < index.size() && valid; ++i )
+            {
+              valid = index[ i ].offset <= footer.indexOffset && index[ i ].size <= footer.indexOffset - index[ i ].offset &&
+                      ( i == 0 || index[ i - 1 ].frame < index[ i ].frame );
+            }
+            if ( valid )
+            {
+              dataEnd = footer.indexOffset;
+              return ( true );
+            }
+            index.clear();
+          }
+        }
+
+        // Walk the frames.
+        for ( unsigned long long bytes = frameSize( data, size, dataEnd ); bytes > 0; bytes = frameSize( data, size, dataEnd ) )
+        {
+          const ParticleCacheHeader& h = *reinterpret_cast< const ParticleCacheHeader* >( data + dataEnd );
+
+          ParticleCacheIndexEntry entry;
+          std::memset( &entry, 0, sizeof( entry ) );
+          entry.frame  = h.frame;
+          entry.offset = dataEnd;
+          entry.size   = bytes;
+          entry.stamp  = h.stamp;
+          addFrame( index, entry );
+
+          dataEnd = std::min( size, dataEnd + padded( bytes ) );
+        }
+        return ( false );
+      }
+
+      // checksum: FNV-1a of "size" bytes.
+      static unsigned long long checksum( const char* data, size_t size )
+      {
+        unsigned long long hash = 14695981039346656037ull;
+        for ( size_t i = 0; i < size; ++i )
+        {
+          hash = ( hash ^ static_cast< unsigned char >( data[ i ] ) ) * 1099511628211ull;
+        }
+        return ( hash );
+      }
+
+    private:
+
+      static bool byFrame( const ParticleCacheIndexEntry& a, const ParticleCacheIndexEntry& b )
+      {
+        return ( a.frame < b.frame );
+      }
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_PARTICLE_CACHE_FORMAT_H
@@ -0,0 +1,571 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_PARTICLE_CACHE_READER_H
+#define _RF_EXAMPLES_PARTICLE_CACHE_READER_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "mapped_file.h"
+#include "particle_cache_format.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: ParticleCacheReader
+    // Random frame access to the ParticleCacheContainer files
+    // of ParticleCacheWriter, "<directory>/<name>.rfpc". The
+    // container is mapped once and its footer index read, the
+    // column table of a frame says where every attribute is,
+    // and only the ids and the attributes asked for with
+    // setAttributes() are decompressed. A frame missing from
+    // the index maps the file again, so a cache still being
+    // written is followed as it grows.
+    //
+    // A delta frame needs its reference frame decoded first:
+    // the reader keeps the last frame it decoded, so stepping
+    // forward costs one frame, and otherwise walks the
+    // reference chain back to a keyframe ( at most the
+    // keyframe interval ) and decodes forward. A reference
+    // whose stamp differs from the one the delta frame was
+    // encoded against was re-simulated since: the frame is
+    // reported stale rather than decoded.
+    //
+    // With prefetch on, after every readFrame() a worker
+    // thread decodes the next frame in the direction of the
+    // last move, so playing or scrubbing finds it ready. The
+    // prefetch decodes serially, the foreground decode runs
+    // the columns on the pool. The worker is started by the
+    // first prefetch and kept until close(); call it from the
+    // simulation callbacks of the owning plugin, the
+    // destructor must not be the one joining it while a DLL
+    // unloads.
+    //--------------------------------------------------
+    class ParticleCacheReader
+    {
+    public:
+
+      struct Stats
+      {
+        Stats() : frames( 0 ), prefetchHits( 0 ), chainFrames( 0 ), decodeMs( 0.0 ) {};
+
+        unsigned int frames;
+        unsigned int prefetchHits;
+        unsigned int chainFrames;
+        double       decodeMs;
+      };
+
+    public:
+
+      /// Constructor, the pool is borrowed.
+      explicit ParticleCacheReader( ThreadPool& pool )
+        : pool_( pool ), prefetch_( true ), lastFrame_( 0 ), prefetchFrame_( 0 ), requested_( false ), busy_( false ),
+          quit_( false ), cancel_( false ) {};
+
+      /// Destructor, close() if the owner did not.
+      ~ParticleCacheReader( void )
+      {
+        close();
+      }
+
+      // getPath: container of an emitter.
+      static std::string getPath( const std::string& directory, const std::string& name )
+      {
+        return ( directory + "/" + name + ".rfpc" );
+      }
+
+      //--------------------------------------------------
+      // Function: open
+      // Cache of "name" in "directory". Nothing is read until
+      // readFrame().
+      //--------------------------------------------------
+      void open( const std::string& directory, const std::string& name )
+      {
+        if ( directory == directory_ && name == name_ )
+        {
+          return;
+        }
+
+        waitPrefetch();
+        directory_ = directory;
+        name_      = name;
+        current_   = Decoded();
+        next_      = Decoded();
+        file_.close();
+        index_.clear();
+      }
+
+      // close: joins the prefetch worker and unmaps, the next readFrame() maps the file again.
+      void close( void )
+      {
+        if ( worker_.joinable() )
+        {
+          {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            quit_      = true;
+            requested_ = false;
+            cancel_    = true;
+          }
+          wake_.notify_all();
+          worker_.join();
+          quit_   = false;
+          cancel_ = false;
+        }
+
+        directory_.clear();
+        name_.clear();
+        current_ = Decoded();
+        next_    = Decoded();
+        file_.close();
+        index_.clear();
+      }
+
+      // setAttributes: attributes to decode besides the ids, ATTRIBUTE_POSITION and so on.
+      void setAttributes( const std::vector< int >& attributes )
+      {
+        if ( attributes == attributes_ )
+        {
+          return;
+        }
+
+        waitPrefetch();
+        attributes_ = attributes;
+        current_    = Decoded();
+        next_       = Decoded();
+      }
+
+      void setPrefetch( bool prefetch ) { prefetch_ = prefetch; }
+
+      //--------------------------------------------------
+      // Function: readFrame
+      // Decodes "frame", false with getError() set when a frame
+      // of its chain is missing or corrupt.
+      //--------------------------------------------------
+      bool readFrame( unsigned int frame )
+      {
+        Stopwatch decodeTime;
+
+        // A prefetch of this very frame is left to finish.
+        waitPrefetch( prefetchFrame_ != frame );
+
+        const bool hit = next_.valid && next_.frame == frame;
+        if ( hit )
+        {
+          std::swap( current_, next_ );
+          ++stats_.prefetchHits;
+        }
+        else if ( !( current_.valid && current_.frame == frame ) )
+        {
+          if ( !file_.isOpen() || !ParticleCacheContainer::findFrame( index_, frame ) )
+          {
+            refresh();
+          }
+
+          Decoded decoded;
+          if ( !decodeChain( frame, current_, decoded, true ) )
+          {
+            error_ = decoded.error;
+            stats_.decodeMs += decodeTime.getElapsedMs();
+            return ( false );
+          }
+          std::swap( current_, decoded );
+        }
+        stats_.chainFrames += current_.chain;
+        current_.chain = 0;
+        next_.valid = false;
+
+        const int step = ( frame < lastFrame_ ) ? -1 : 1;
+        lastFrame_ = frame;
+        ++stats_.frames;
+        stats_.decodeMs += decodeTime.getElapsedMs();
+
+        if ( prefetch_ && ( step > 0 || frame > 0 ) )
+        {
+          startPrefetch( frame + step );
+        }
+        error_.clear();
+        return ( true );
+      }
+
+      size_t                          getNumParticles( void ) const { return ( current_.ids.size() ); }
+      const std::vector< long long >& getIds( void ) const          { return ( current_.ids ); }
+      const std::string&              getError( void ) const        { return ( error_ ); }
+      const Stats&                    getStats( void ) const        { return ( stats_ ); }
+
+      // getColumn: decoded values of a component, 0 when the frame does not have it.
+      const ParticleCacheColumnData* getColumn( int attribute, unsigned char component ) const
+      {
+        const int c = findColumn( current_.columns, attribute, component );
+        return ( c >= 0 ? &current_.columns[ c ] : 0 );
+      }
+
+      // getFloats: a float column, 0 when missing or not float.
+      const float* getFloats( int attribute, unsigned char component ) const
+      {
+        const ParticleCacheColumnData* column = getColumn( attribute, component );
+        return ( column && column->kind == KIND_FLOAT && column->width == 4 ?
+                 reinterpret_cast< const float* >( column->values.data() ) : 0 );
+      }
+
+    private:
+
+      // A decoded frame and the state the next one is decoded against.
+      struct Decoded
+      {
+        Decoded() : frame( 0 ), stamp( 0 ), chain( 0 ), valid( false ) {};
+
+        unsigned int                                frame;
+        unsigned long long                          stamp;
+        unsigned int                                chain;
+        bool                                        valid;
+        std::vector< long long >                    ids;
+        std::vector< ParticleCacheColumnData >      columns;
+        std::vector< std::vector< unsigned char > > states;
+        std::string                                 error;
+      };
+
+      static int findColumn( const std::vector< ParticleCacheColumnData >& columns, int attribute, unsigned char component )
+      {
+        for ( size_t c = 0; c < columns.size(); ++c )
+        {
+          if ( columns[ c ].attribute == attribute && columns[ c ].component == component )
+          {
+            return ( int( c ) );
+          }
+        }
+        return ( -1 );
+      }
+
+      bool wanted( int attribute ) const
+      {
+        return ( std::find( attributes_.begin(), attributes_.end(), attribute ) != attributes_.end() );
+      }
+
+      // refresh: maps the container again and reads its index.
+      void refresh( void )
+      {
+        file_.close();
+        index_.clear();
+
+        unsigned long long dataEnd = 0;
+        if ( file_.openRead( getPath( directory_, name_ ) ) )
+        {
+          ParticleCacheContainer::readIndex( file_.getData(), file_.getSize(), index_, dataEnd );
+        }
+      }
+
+      // findFrameData: start of a frame in the mapped container, after checking its header and column table.
+      const char* findFrameData( unsigned int frame, std::string& error ) const
+      {
+        const std::string path = getPath( directory_, name_ );
+        if ( !file_.isOpen() )
+        {
+          error = "cannot read " + path;
+          return ( 0 );
+        }
+
+        const ParticleCacheIndexEntry* entry = ParticleCacheContainer::findFrame( index_, frame );
+        if ( !entry )
+        {
+          std::stringstream missing;
+          missing << "frame " << frame << " is not in " << path;
+          error = missing.str();
+          return ( 0 );
+        }
+
+        const char* data = file_.getData() + entry->offset;
+        if ( ParticleCacheContainer::frameSize( file_.getData(), file_.getSize(), entry->offset ) != entry->size ||
+             header( data ).frame != frame || header( data ).stamp != entry->stamp )
+        {
+          std::stringstream corrupt;
+          corrupt << "corrupt frame " << frame << " in " << path;
+          error = corrupt.str();
+          return ( 0 );
+        }
+        return ( data );
+      }
+
+      static const ParticleCacheHeader& header( const char* frameData )
+      {
+        return ( *reinterpret_cast< const ParticleCacheHeader* >( frameData ) );
+      }
+
+      static const ParticleCacheColumn* columnTable( const char* frameData )
+      {
+        return ( reinterpret_cast< const ParticleCacheColumn* >( frameData + sizeof( ParticleCacheHeader ) ) );
+      }
+
+      //--------------------------------------------------
+      // Function: decodeChain
+      // "frame" into "out". Reference frames are followed back
+      // until a keyframe or "base", then decoded forward.
+      //--------------------------------------------------
+      bool decodeChain( unsigned int frame, const Decoded& base, Decoded& out, bool parallel )
+      {
+        std::vector< unsigned int > chain( 1, frame );
+        for ( ;; )
+        {
+          const char* frameData = findFrameData( chain.back(), out.error );
+          if ( !frameData )
+          {
+            return ( false );
+          }
+
+          const unsigned int reference = header( frameData ).reference;
+          if ( reference == ParticleCacheHeader::NO_REFERENCE ||
+               ( base.valid && base.frame == reference && base.stamp == header( frameData ).referenceStamp ) )
+          {
+            break;
+          }
+          if ( std::find( chain.begin(), chain.end(), reference ) != chain.end() )
+          {
+            out.error = "particle cache reference loop";
+            return ( false );
+          }
+          chain.push_back( reference );
+        }
+
+        const Decoded* previous = &base;
+        Decoded        step[ 2 ];
+        for ( size_t k = chain.size(); k-- > 0; )
+        {
+          Decoded&    target    = ( k == 0 ) ? out : step[ k & 1 ];
+          const char* frameData = findFrameData( chain[ k ], target.error );
+          if ( !frameData || !decodeFrame( frameData, *previous, target, parallel ) )
+          {
+            out.error = target.error;
+            return ( false );
+          }
+          previous = &target;
+        }
+        out.chain = static_cast< unsigned int >( chain.size() - 1 );
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: decodeFrame
+      // One mapped frame against "previous", which must be its
+      // reference frame unless it is a keyframe.
+      //--------------------------------------------------
+      bool decodeFrame( const char* frameData, const Decoded& previous, Decoded& out, bool parallel )
+      {
+        const ParticleCacheHeader& h      = header( frameData );
+        const ParticleCacheColumn* table  = columnTable( frameData );
+        const unsigned char*       data   = reinterpret_cast< const unsigned char* >( frameData );
+        const bool                 isDelta = ( h.reference != ParticleCacheHeader::NO_REFERENCE );
+        const size_t               count  = size_t( h.count );
+
+        out.valid = false;
+        out.frame = h.frame;
+        out.stamp = h.stamp;
+        out.columns.clear();
+        out.states.clear();
+
+        if ( isDelta && !( previous.valid && previous.frame == h.reference ) )
+        {
+          out.error = "missing reference frame";
+          return ( false );
+        }
+        if ( isDelta && previous.stamp != h.referenceStamp )
+        {
+          std::stringstream stale;
+          stale << "frame " << h.frame << " is stale, its reference frame " << h.reference << " was written again";
+          out.error = stale.str();
+          return ( false );
+        }
+
+        std::vector< unsigned char > scratch;
+        if ( !ParticleCacheCodec::decodeIds( table[ 0 ], data + table[ 0 ].offset, count, scratch, out.ids ) )
+        {
+          out.error = "corrupt particle ids";
+          return ( false );
+        }
+
+        std::vector< unsigned int > match;
+        if ( isDelta )
+        {
+          ParticleCacheCodec::matchIds( previous.ids, out.ids, match );
+        }
+
+        // Wanted columns and their reference states.
+        std::vector< unsigned int > selected;
+        std::vector< int >          previousColumn;
+        for ( unsigned int c = 1; c < h.numColumns; ++c )
+        {
+          if ( !wanted( table[ c ].attribute ) )
+          {
+            continue;
+          }
+
+          const int p = isDelta ? findColumn( previous.columns, table[ c ].attribute, table[ c ].component ) : -1;
+          if ( isDelta && p < 0 )
+          {
+            out.error = "reference frame lacks a column";
+            return ( false );
+          }
+          selected.push_back( c );
+          previousColumn.push_back( p );
+        }
+
+        out.columns.resize( selected.size() );
+        out.states.resize( selected.size() );
+
+        std::vector< char > failed( selected.size(), 0 );
+        const std::vector< unsigned char > none;
+        auto decodeColumns = [&]( size_t begin, size_t end, unsigned int )
+        {
+          std::vector< unsigned char > columnScratch;
+          for ( size_t s = begin; s < end && !cancel_; ++s )
+          {
+            const ParticleCacheColumn& column = table[ selected[ s ] ];
+            const std::vector< unsigned char >& reference = previousColumn[ s ] >= 0 ? previous.states[ previousColumn[ s ] ] : none;
+            failed[ s ] = ParticleCacheCodec::decodeColumn( column, data + column.offset, count, match, reference,
+                                                            out.states[ s ], columnScratch, out.columns[ s ] ) ? 0 : 1;
+          }
+        };
+
+        if ( parallel )
+        {
+          pool_.parallelFor( selected.size(), 1, decodeColumns );
+        }
+        else
+        {
+          decodeColumns( 0, selected.size(), 0 );
+        }
+
+        if ( cancel_ || std::find( failed.begin(), failed.end(), 1 ) != failed.end() )
+        {
+          out.error = cancel_ ? "cancelled" : "corrupt particle cache column";
+          return ( false );
+        }
+
+        out.valid = true;
+        return ( true );
+      }
+
+      // startPrefetch: has the worker decode "frame" into next_, starting it the first time.
+      void startPrefetch( unsigned int frame )
+      {
+        if ( !worker_.joinable() )
+        {
+          worker_ = std::thread( &ParticleCacheReader::prefetchLoop, this );
+        }
+
+        {
+          std::lock_guard< std::mutex > lock( mutex_ );
+          next_.valid    = false;
+          prefetchFrame_ = frame;
+          requested_     = true;
+        }
+        wake_.notify_one();
+      }
+
+      // waitPrefetch: until the worker is idle, keeping what it finished.
+      void waitPrefetch( bool cancel = true )
+      {
+        std::unique_lock< std::mutex > lock( mutex_ );
+        if ( cancel )
+        {
+          requested_ = false;
+          cancel_    = busy_;
+        }
+        while ( requested_ || busy_ )
+        {
+          idle_.wait( lock );
+        }
+        cancel_ = false;
+      }
+
+      void prefetchLoop( void )
+      {
+        for ( ;; )
+        {
+          unsigned int frame = 0;
+          {
+            std::unique_lock< std::mutex > lock( mutex_ );
+            while ( !requested_ && !quit_ )
+            {
+              wake_.wait( lock );
+            }
+            if ( quit_ )
+            {
+              return;
+            }
+            requested_ = false;
+            busy_      = true;
+            frame      = prefetchFrame_;
+          }
+
+          Decoded decoded;
+          if ( decodeChain( frame, current_, decoded, false ) )
+          {
+            std::swap( next_, decoded );
+          }
+
+          {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            busy_ = false;
+          }
+          idle_.notify_all();
+        }
+      }
+
+    private:
+
+      ParticleCacheReader( const ParticleCacheReader& );
+      ParticleCacheReader& operator =( const ParticleCacheReader& );
+
+    private:
+
+      ThreadPool&                   pool_;
+      std::string                   directory_;
+      std::string                   name_;
+      std::vector< int >            attributes_;
+      bool                          prefetch_;
+      unsigned int                  lastFrame_;
+      unsigned int                  prefetchFrame_;
+      Decoded                       current_;
+      Decoded                       next_;
+      std::string                   error_;
+      Stats                         stats_;
+      MappedFile                    file_;
+      ParticleCacheContainer::Index index_;
+
+      // Prefetch worker, the flags under "mutex_".
+      std::thread                   worker_;
+      std::mutex                    mutex_;
+      std::condition_variable       wake_;
+      std::condition_variable       idle_;
+      bool                          requested_;
+      bool                          busy_;
+      bool                          quit_;
+      std::atomic< bool >           cancel_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_PARTICLE_CACHE_READER_H
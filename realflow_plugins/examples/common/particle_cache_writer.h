@@ -0,0 +1,584 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_PARTICLE_CACHE_WRITER_H
+#define _RF_EXAMPLES_PARTICLE_CACHE_WRITER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "mapped_file.h"
+#include "particle_cache_format.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: ParticleCacheWriter
+    // Writes particle_cache_format.h frames from a background
+    // thread. submit() only moves the gathered frame into a
+    // queue; sorting, delta encoding, compression ( columns
+    // in parallel on the writer's own pool ) and the file
+    // write all happen on the writer thread, so the caller
+    // waits only when "maxPending" frames are already queued.
+    //
+    // Every "stream" ( an emitter ) appends to its own
+    // ParticleCacheContainer and keeps the ids and column
+    // states of its last written frame, the next frame is
+    // encoded against it unless the keyframe interval is
+    // reached, the columns changed, the frame does not come
+    // after it or the last write failed. A container that
+    // exists is appended to, unless the first frame written
+    // comes before all of its frames: then the simulation
+    // starts over and so does the file.
+    //
+    // The thread runs between start() and stop(), call them
+    // from the simulation callbacks of the plugin that owns
+    // the writer: a thread still running at destruction is
+    // joined by the destructor, which must not happen while
+    // a DLL unloads.
+    //--------------------------------------------------
+    class ParticleCacheWriter
+    {
+    public:
+
+      struct Stats
+      {
+        Stats() : frames( 0 ), failures( 0 ), rawBytes( 0 ), storedBytes( 0 ), encodeMs( 0.0 ), writeMs( 0.0 ), waitMs( 0.0 ) {};
+
+        unsigned int       frames;
+        unsigned int       failures;
+        unsigned long long rawBytes;
+        unsigned long long storedBytes;
+        double             encodeMs;
+        double             writeMs;
+        double             waitMs;
+      };
+
+    public:
+
+      /// Constructor, the thread waits for start().
+      explicit ParticleCacheWriter( size_t maxPending = 4 )
+        : maxPending_( std::max< size_t >( 1, maxPending ) ), keyframeInterval_( 10 ), encoderThreads_( 1 ),
+          busy_( false ), stop_( false ), reset_( false ), stamps_( 0 )
+      {
+        std::random_device random;
+        stampSeed_ = ( static_cast< unsigned long long >( random() ) << 32 ) ^
+                     static_cast< unsigned long long >( std::chrono::steady_clock::now().time_since_epoch().count() );
+      }
+
+      /// Destructor, stop() if the owner did not.
+      ~ParticleCacheWriter( void )
+      {
+        stop();
+      }
+
+      // start: runs the writer thread, nothing if it already runs.
+      void start( void )
+      {
+        if ( !thread_.joinable() )
+        {
+          stop_   = false;
+          thread_ = std::thread( &ParticleCacheWriter::writerLoop, this );
+        }
+      }
+
+      // stop: writes what is queued and joins the thread.
+      void stop( void )
+      {
+        if ( !thread_.joinable() )
+        {
+          return;
+        }
+
+        {
+          std::lock_guard< std::mutex > lock( mutex_ );
+          stop_ = true;
+        }
+        queued_.notify_all();
+        thread_.join();
+      }
+
+      // setKeyframeInterval: a keyframe every "interval" frames of a stream, 1 for keyframes only.
+      void setKeyframeInterval( unsigned int interval )
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        keyframeInterval_ = std::max( 1u, interval );
+      }
+
+      // setEncoderThreads: threads compressing the columns of a frame.
+      void setEncoderThreads( unsigned int threads )
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        encoderThreads_ = std::max( 1u, threads );
+      }
+
+      // setMaxPending: frames queued before submit() waits.
+      void setMaxPending( size_t maxPending )
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        maxPending_ = std::max< size_t >( 1, maxPending );
+      }
+
+      //--------------------------------------------------
+      // Function: submit
+      // Queues "frame" for "path", its contents are moved out.
+      // Only between start() and stop().
+      //--------------------------------------------------
+      void submit( const std::string& stream, const std::string& path, ParticleCacheFrame& frame )
+      {
+        Stopwatch waitTime;
+
+        std::unique_lock< std::mutex > lock( mutex_ );
+        while ( jobs_.size() >= maxPending_ )
+        {
+          done_.wait( lock );
+        }
+        stats_.waitMs += waitTime.getElapsedMs();
+
+        jobs_.push_back( Job() );
+        Job& job = jobs_.back();
+        job.stream = stream;
+        job.path   = path;
+        job.frame.frame = frame.frame;
+        job.frame.ids.swap( frame.ids );
+        job.frame.columns.swap( frame.columns );
+
+        lock.unlock();
+        queued_.notify_one();
+      }
+
+      // finish: waits until every submitted frame is written, the thread keeps running.
+      void finish( void )
+      {
+        std::unique_lock< std::mutex > lock( mutex_ );
+        while ( !jobs_.empty() || busy_ )
+        {
+          done_.wait( lock );
+        }
+      }
+
+      // reset: finish(), then the next frame of every stream is a keyframe and the stats restart.
+      void reset( void )
+      {
+        finish();
+
+        std::lock_guard< std::mutex > lock( mutex_ );
+        reset_ = true;
+        stats_ = Stats();
+        error_.clear();
+      }
+
+      Stats getStats( void ) const
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        return ( stats_ );
+      }
+
+      // getLastError: path of the last frame that could not be written.
+      std::string getLastError( void ) const
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        return ( error_ );
+      }
+
+    private:
+
+      struct Job
+      {
+        std::string        stream;
+        std::string        path;
+        ParticleCacheFrame frame;
+      };
+
+      // Last written frame of a stream and its open container.
+      struct Stream
+      {
+        Stream() : frame( 0 ), stamp( 0 ), sinceKeyframe( 0 ), valid( false ), file( 0 ), dataEnd( 0 ), fileSize( 0 ) {};
+
+        unsigned int                                frame;
+        unsigned long long                          stamp;
+        unsigned int                                sinceKeyframe;
+        bool                                        valid;
+        std::vector< long long >                    ids;
+        std::vector< ParticleCacheColumnData >      layout;
+        std::vector< std::vector< unsigned char > > states;
+
+        std::FILE*                                  file;
+        std::string                                 path;
+        ParticleCacheContainer::Index               index;
+        unsigned long long                          dataEnd;
+        unsigned long long                          fileSize;
+      };
+
+      // Encoded column and its buffers, one per column.
+      struct Encoded
+      {
+        ParticleCacheColumn          header;
+        std::vector< unsigned char > state;
+        std::vector< unsigned char > scratch;
+        std::vector< unsigned char > stored;
+      };
+
+      void writerLoop( void )
+      {
+        for ( ;; )
+        {
+          Job          job;
+          unsigned int keyframeInterval = 1;
+          unsigned int encoderThreads   = 1;
+          {
+            std::unique_lock< std::mutex > lock( mutex_ );
+            while ( jobs_.empty() && !stop_ )
+            {
+              queued_.wait( lock );
+            }
+            if ( jobs_.empty() )
+            {
+              closeContainers();
+              return;
+            }
+
+            if ( reset_ )
+            {
+              closeContainers();
+              streams_.clear();
+              reset_ = false;
+            }
+
+            job.stream.swap( jobs_.front().stream );
+            job.path.swap( jobs_.front().path );
+            job.frame.frame = jobs_.front().frame.frame;
+            job.frame.ids.swap( jobs_.front().frame.ids );
+            job.frame.columns.swap( jobs_.front().frame.columns );
+            jobs_.pop_front();
+
+            busy_            = true;
+            keyframeInterval = keyframeInterval_;
+            encoderThreads   = encoderThreads_;
+          }
+          done_.notify_all();
+
+          if ( pool_.getNumThreads() != encoderThreads )
+          {
+            pool_.resize( encoderThreads );
+          }
+
+          Stream& stream = streams_[ job.stream ];
+
+          Stopwatch encodeTime;
+          unsigned long long rawBytes = 0;
+          encodeFrame( stream, job.frame, keyframeInterval, rawBytes );
+          const double encodeMs = encodeTime.getElapsedMs();
+
+          Stopwatch writeTime;
+          const bool written = writeFrame( stream, job.path );
+          const double writeMs = writeTime.getElapsedMs();
+
+          if ( !written )
+          {
+            stream.valid = false;
+            closeContainer( stream );
+          }
+
+          {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            stats_.frames      += written ? 1 : 0;
+            stats_.failures    += written ? 0 : 1;
+            stats_.rawBytes    += rawBytes;
+            stats_.storedBytes += written ? file_.size() : 0;
+            stats_.encodeMs    += encodeMs;
+            stats_.writeMs     += writeMs;
+            error_              = written ? error_ : job.path;
+            busy_               = false;
+          }
+          done_.notify_all();
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: encodeFrame
+      // Builds the file image of "frame" in "file_" and makes
+      // it the stream's reference frame.
+      //--------------------------------------------------
+      void encodeFrame( Stream& stream, ParticleCacheFrame& frame, unsigned int keyframeInterval, unsigned long long& rawBytes )
+      {
+        const size_t count      = frame.ids.size();
+        const size_t numColumns = frame.columns.size();
+
+        ParticleCacheCodec::sortById( frame, order_, sortScratch_ );
+
+        bool keyframe = !stream.valid || stream.sinceKeyframe + 1 >= keyframeInterval || frame.frame <= stream.frame ||
+                        stream.layout.size() != numColumns;
+        for ( size_t c = 0; c < numColumns && !keyframe; ++c )
+        {
+          keyframe = !frame.columns[ c ].sameLayout( stream.layout[ c ] );
+        }
+
+        if ( keyframe )
+        {
+          match_.clear();
+        }
+        else
+        {
+          ParticleCacheCodec::matchIds( stream.ids, frame.ids, match_ );
+        }
+
+        // Column 0 is the ids.
+        encoded_.resize( numColumns + 1 );
+        stream.states.resize( numColumns );
+
+        pool_.parallelFor( numColumns + 1, 1, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t c = begin; c < end; ++c )
+          {
+            Encoded& column = encoded_[ c ];
+            if ( c == 0 )
+            {
+              ParticleCacheCodec::encodeIds( frame.ids, column.header, column.scratch, column.stored );
+            }
+            else
+            {
+              ParticleCacheCodec::encodeColumn( frame.columns[ c - 1 ], count, match_, stream.states[ c - 1 ], column.state,
+                                                column.header, column.scratch, column.stored );
+            }
+          }
+        } );
+
+        // File image.
+        size_t offset = sizeof( ParticleCacheHeader ) + ( numColumns + 1 ) * sizeof( ParticleCacheColumn );
+        rawBytes = 0;
+        for ( size_t c = 0; c <= numColumns; ++c )
+        {
+          encoded_[ c ].header.offset = offset;
+          offset   += encoded_[ c ].stored.size();
+          rawBytes += encoded_[ c ].header.rawSize;
+        }
+
+        file_.resize( offset );
+
+        ParticleCacheHeader header;
+        std::memset( &header, 0, sizeof( header ) );
+        std::memcpy( header.magic, ParticleCacheHeader::getMagic(), sizeof( header.magic ) );
+        header.version        = ParticleCacheHeader::VERSION;
+        header.frame          = frame.frame;
+        header.reference      = keyframe ? static_cast< unsigned int >( ParticleCacheHeader::NO_REFERENCE ) : stream.frame;
+        header.count          = count;
+        header.numColumns     = static_cast< unsigned int >( numColumns + 1 );
+        header.stamp          = nextStamp();
+        header.referenceStamp = keyframe ? 0ull : stream.stamp;
+        std::memcpy( file_.data(), &header, sizeof( header ) );
+
+        for ( size_t c = 0; c <= numColumns; ++c )
+        {
+          std::memcpy( file_.data() + sizeof( header ) + c * sizeof( ParticleCacheColumn ), &encoded_[ c ].header, sizeof( ParticleCacheColumn ) );
+          if ( !encoded_[ c ].stored.empty() )
+          {
+            std::memcpy( file_.data() + encoded_[ c ].header.offset, encoded_[ c ].stored.data(), encoded_[ c ].stored.size() );
+          }
+        }
+
+        // This frame becomes the reference.
+        stream.frame         = frame.frame;
+        stream.stamp         = header.stamp;
+        stream.sinceKeyframe = keyframe ? 0 : stream.sinceKeyframe + 1;
+        stream.valid         = true;
+        stream.ids.swap( frame.ids );
+        stream.layout.resize( numColumns );
+        for ( size_t c = 0; c < numColumns; ++c )
+        {
+          stream.layout[ c ].attribute = frame.columns[ c ].attribute;
+          stream.layout[ c ].component = frame.columns[ c ].component;
+          stream.layout[ c ].kind      = frame.columns[ c ].kind;
+          stream.layout[ c ].width     = frame.columns[ c ].width;
+          stream.layout[ c ].scale     = frame.columns[ c ].scale;
+          stream.states[ c ].swap( encoded_[ c + 1 ].state );
+        }
+      }
+
+      // nextStamp: a stamp no other write of any writer is likely to share ( splitmix64 ).
+      unsigned long long nextStamp( void )
+      {
+        unsigned long long z = stampSeed_ + ( ++stamps_ ) * 0x9E3779B97F4A7C15ull;
+        z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+        z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+        return ( z ^ ( z >> 31 ) );
+      }
+
+      //--------------------------------------------------
+      // Function: writeFrame
+      // Appends the frame image to the stream's container at
+      // "path", then its index and footer.
+      //--------------------------------------------------
+      bool writeFrame( Stream& stream, const std::string& path )
+      {
+        const ParticleCacheHeader& header = *reinterpret_cast< const ParticleCacheHeader* >( file_.data() );
+        if ( ( !stream.file || stream.path != path ) && !openContainer( stream, path, header.frame ) )
+        {
+          return ( false );
+        }
+
+        ParticleCacheIndexEntry entry;
+        std::memset( &entry, 0, sizeof( entry ) );
+        entry.frame  = header.frame;
+        entry.offset = stream.dataEnd;
+        entry.size   = file_.size();
+        entry.stamp  = header.stamp;
+        ParticleCacheContainer::addFrame( stream.index, entry );
+
+        const unsigned long long frameBytes  = ParticleCacheContainer::padded( file_.size() );
+        const unsigned long long indexOffset = stream.dataEnd + frameBytes;
+        const size_t             indexBytes  = stream.index.size() * sizeof( ParticleCacheIndexEntry );
+        const unsigned long long end         = std::max( indexOffset + indexBytes + sizeof( ParticleCacheFooter ), stream.fileSize );
+
+        ParticleCacheFooter footer;
+        std::memset( &footer, 0, sizeof( footer ) );
+        std::memcpy( footer.magic, ParticleCacheFooter::getMagic(), sizeof( footer.magic ) );
+        footer.version     = ParticleCacheFooter::VERSION;
+        footer.indexOffset = indexOffset;
+        footer.numFrames   = stream.index.size();
+        footer.checksum    = ParticleCacheContainer::checksum( reinterpret_cast< const char* >( stream.index.data() ), indexBytes );
+
+        file_.resize( size_t( frameBytes ), 0 );
+        const bool written = seek( stream.file, stream.dataEnd ) &&
+                             std::fwrite( file_.data(), 1, file_.size(), stream.file ) == file_.size() &&
+                             std::fwrite( stream.index.data(), 1, indexBytes, stream.file ) == indexBytes &&
+                             seek( stream.file, end - sizeof( ParticleCacheFooter ) ) &&
+                             std::fwrite( &footer, sizeof( footer ), 1, stream.file ) == 1 &&
+                             std::fflush( stream.file ) == 0;
+        if ( written )
+        {
+          stream.dataEnd  = indexOffset;
+          stream.fileSize = end;
+        }
+        return ( written );
+      }
+
+      //--------------------------------------------------
+      // Function: openContainer
+      // Opens "path" for a stream whose next frame is "frame",
+      // with the index already in it. When "frame" comes
+      // before all of its frames the file is replaced; where
+      // that is not possible ( a reader maps it on Windows ) it
+      // is appended to.
+      //--------------------------------------------------
+      bool openContainer( Stream& stream, const std::string& path, unsigned int frame )
+      {
+        closeContainer( stream );
+        stream.path     = path;
+        stream.dataEnd  = 0;
+        stream.fileSize = 0;
+        stream.index.clear();
+
+        MappedFile existing;
+        if ( existing.openRead( path ) )
+        {
+          ParticleCacheContainer::readIndex( existing.getData(), existing.getSize(), stream.index, stream.dataEnd );
+          stream.fileSize = existing.getSize();
+          existing.close();
+
+          const bool restart = stream.index.empty() || frame <= stream.index.front().frame;
+          if ( !restart || std::remove( path.c_str() ) != 0 )
+          {
+            stream.file = std::fopen( path.c_str(), "r+b" );
+            return ( stream.file != 0 );
+          }
+
+          stream.dataEnd  = 0;
+          stream.fileSize = 0;
+          stream.index.clear();
+        }
+
+        stream.file = std::fopen( path.c_str(), "w+b" );
+        return ( stream.file != 0 );
+      }
+
+      void closeContainer( Stream& stream )
+      {
+        if ( stream.file )
+        {
+          std::fclose( stream.file );
+          stream.file = 0;
+        }
+      }
+
+      // closeContainers: when the thread stops, other processes can then replace the files.
+      void closeContainers( void )
+      {
+        for ( std::map< std::string, Stream >::iterator it = streams_.begin(); it != streams_.end(); ++it )
+        {
+          closeContainer( it->second );
+        }
+      }
+
+      static bool seek( std::FILE* file, unsigned long long offset )
+      {
+      #ifdef _WIN32
+        return ( _fseeki64( file, static_cast< __int64 >( offset ), SEEK_SET ) == 0 );
+      #else
+        return ( fseeko( file, static_cast< off_t >( offset ), SEEK_SET ) == 0 );
+      #endif
+      }
+
+    private:
+
+      ParticleCacheWriter( const ParticleCacheWriter& );
+      ParticleCacheWriter& operator =( const ParticleCacheWriter& );
+
+    private:
+
+      // Shared with the caller, under "mutex_".
+      mutable std::mutex      mutex_;
+      std::condition_variable queued_;
+      std::condition_variable done_;
+      std::deque< Job >       jobs_;
+      size_t                  maxPending_;
+      unsigned int            keyframeInterval_;
+      unsigned int            encoderThreads_;
+      bool                    busy_;
+      bool                    stop_;
+      bool                    reset_;
+      Stats                   stats_;
+      std::string             error_;
+
+      // Writer thread only.
+      ThreadPool                                           pool_;
+      std::map< std::string, Stream >                      streams_;
+      std::vector< Encoded >                               encoded_;
+      std::vector< unsigned int >                          match_;
+      std::vector< std::pair< long long, unsigned int > > order_;
+      std::vector< unsigned char >                         sortScratch_;
+      std::vector< unsigned char >                         file_;
+      unsigned long long                                   stampSeed_;
+      unsigned long long                                   stamps_;
+
+      std::thread thread_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_PARTICLE_CACHE_WRITER_H
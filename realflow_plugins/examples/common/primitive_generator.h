@@ -0,0 +1,853 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_PRIMITIVE_GENERATOR_H
+#define _RF_EXAMPLES_PRIMITIVE_GENERATOR_H
+
+#include <vector>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/vertex.h>
+#include <rf_sdk/sdk/face.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+
+#include "thread_pool.h"
+#include "scratch_arena.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: PrimitiveGenerator
+    // Procedural meshes for command plugins, appended to an
+    // ArrSdkVertex / ArrSdkFaces pair ready for
+    // Scene::addObject:
+    //
+    //   addGrid      - XZ plane, any number of divisions
+    //   addSphere    - UV sphere, segments x rings
+    //   addGeoSphere - icosahedron split "frequency" times per
+    //                  edge, 10 f^2 + 2 vertices, any frequency
+    //   addCylinder  - Y axis, optional caps
+    //   addTorus     - Y axis
+    //   addRocks     - noise displaced geospheres, one per
+    //                  position, randomly squashed and turned
+    //
+    // Scene::addSphere, addCylinder and addTorus cap their
+    // resolutions; here the only bound is the int face
+    // indices of the SDK. Every mesh is closed, outward
+    // facing ( i, j, k counter clockwise from outside ) and
+    // shares its seam vertices, so the u of the texture
+    // coordinates wraps on the seam faces.
+    //
+    // The arrays grow once per call with template copies,
+    // then rows ( or rocks ) are written in parallel straight
+    // into the Vertex and Face slots each row owns; the only
+    // serial part is the resize. Sin / cos tables live in a
+    // scratch arena that is reused from call to call; the rock
+    // base mesh is kept until a call asks for another
+    // frequency, so a batch of single rock calls builds it
+    // once. The add functions return false and
+    // leave the arrays alone for invalid resolutions or a
+    // mesh too large for int indices.
+    //--------------------------------------------------
+    class PrimitiveGenerator
+    {
+    public:
+
+      // Sizes of a mesh, to reserve the arrays ahead of a batch.
+      struct MeshCounts
+      {
+        unsigned long long vertices;
+        unsigned long long faces;
+      };
+
+    public:
+
+      /// Constructor, the pool is borrowed.
+      explicit PrimitiveGenerator( ThreadPool& pool ) : pool_( pool ), rockFrequency_( 0 )
+      {
+        buildIcosahedron();
+      };
+
+      static MeshCounts gridCounts( int divX, int divZ )
+      {
+        return ( counts( ( divX + 1ull ) * ( divZ + 1ull ), 2ull * divX * divZ ) );
+      }
+
+      static MeshCounts sphereCounts( int segments, int rings )
+      {
+        return ( counts( 2ull + ( rings - 1ull ) * segments, 2ull * segments * ( rings - 1ull ) ) );
+      }
+
+      static MeshCounts geoSphereCounts( int frequency )
+      {
+        const unsigned long long f = frequency;
+        return ( counts( 10ull * f * f + 2ull, 20ull * f * f ) );
+      }
+
+      static MeshCounts cylinderCounts( int segments, int rings, bool caps )
+      {
+        return ( counts( ( rings + 1ull ) * segments + ( caps ? 2ull : 0ull ), 2ull * segments * rings + ( caps ? 2ull * segments : 0ull ) ) );
+      }
+
+      static MeshCounts torusCounts( int segments, int sides )
+      {
+        return ( counts( 1ull * segments * sides, 2ull * segments * sides ) );
+      }
+
+      //--------------------------------------------------
+      // Function: addGrid
+      // sizeX x sizeZ plane facing +Y, divX x divZ quads.
+      //--------------------------------------------------
+      bool addGrid( const Vector& center, float sizeX, float sizeZ, int divX, int divZ,
+                    ArrSdkVertex& vertices, ArrSdkFaces& faces )
+      {
+        MeshWriter out;
+        if ( divX < 1 || divZ < 1 || !grow( gridCounts( divX, divZ ), vertices, faces, out ) )
+        {
+          return ( false );
+        }
+
+        const float cx = center.getX(), cy = center.getY(), cz = center.getZ();
+        const int   rowSize = divX + 1;
+
+        pool_.parallelFor( size_t( divZ ) + 1, 16, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t row = begin; row < end; ++row )
+          {
+            const int   j = int( row );
+            const float v = float( j ) / float( divZ );
+
+            for ( int i = 0; i <= divX; ++i )
+            {
+              const float u = float( i ) / float( divX );
+              out.vertex( size_t( j ) * rowSize + i, cx + sizeX * ( u - 0.5f ), cy, cz + sizeZ * ( v - 0.5f ), 0.0f, 1.0f, 0.0f, u, v );
+            }
+
+            if ( j < divZ )
+            {
+              size_t f = 2 * size_t( j ) * divX;
+              for ( int i = 0; i < divX; ++i )
+              {
+                const int v00 = j * rowSize + i, v10 = v00 + 1, v01 = v00 + rowSize, v11 = v01 + 1;
+                out.face( f++, v00, v01, v10 );
+                out.face( f++, v10, v01, v11 );
+              }
+            }
+          }
+        } );
+
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: addSphere
+      // UV sphere: a vertex at each pole and rings - 1 rows of
+      // "segments" vertices. Row r writes its vertices and the
+      // faces down to row r + 1.
+      //--------------------------------------------------
+      bool addSphere( const Vector& center, float radius, int segments, int rings,
+                      ArrSdkVertex& vertices, ArrSdkFaces& faces )
+      {
+        MeshWriter out;
+        if ( segments < 3 || rings < 2 || !grow( sphereCounts( segments, rings ), vertices, faces, out ) )
+        {
+          return ( false );
+        }
+
+        arena_.reset();
+        float* sinTheta = arena_.allocate< float >( rings + 1 );
+        float* cosTheta = arena_.allocate< float >( rings + 1 );
+        float* sinPhi   = arena_.allocate< float >( segments );
+        float* cosPhi   = arena_.allocate< float >( segments );
+        angleTable( rings + 1, PI() / rings, sinTheta, cosTheta );
+        angleTable( segments, 2.0f * PI() / segments, sinPhi, cosPhi );
+
+        const float cx = center.getX(), cy = center.getY(), cz = center.getZ();
+        const int   south = 1 + ( rings - 1 ) * segments;
+
+        pool_.parallelFor( size_t( rings ) + 1, 8, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t row = begin; row < end; ++row )
+          {
+            const int r = int( row );
+            if ( r == 0 || r == rings )
+            {
+              const float y = ( r == 0 ) ? 1.0f : -1.0f;
+              out.vertex( ( r == 0 ) ? 0 : south, cx, cy + radius * y, cz, 0.0f, y, 0.0f, 0.5f, ( r == 0 ) ? 1.0f : 0.0f );
+            }
+            else
+            {
+              for ( int s = 0; s < segments; ++s )
+              {
+                const float nx = sinTheta[ r ] * cosPhi[ s ], ny = cosTheta[ r ], nz = sinTheta[ r ] * sinPhi[ s ];
+                out.vertex( ringVertex( r, s, segments ), cx + radius * nx, cy + radius * ny, cz + radius * nz, nx, ny, nz,
+                            float( s ) / float( segments ), 1.0f - float( r ) / float( rings ) );
+              }
+            }
+
+            if ( r == rings )
+            {
+              continue;
+            }
+
+            for ( int s = 0; s < segments; ++s )
+            {
+              const int next = ( s + 1 ) % segments;
+              if ( r == 0 )
+              {
+                out.face( s, 0, ringVertex( 1, next, segments ), ringVertex( 1, s, segments ) );
+              }
+              else if ( r == rings - 1 )
+              {
+                out.face( size_t( segments ) * ( 2 * r - 1 ) + s, ringVertex( r, s, segments ), ringVertex( r, next, segments ), south );
+              }
+              else
+              {
+                const size_t f = size_t( segments ) * ( 2 * r - 1 ) + 2 * s;
+                const int a = ringVertex( r, s, segments ), b = ringVertex( r, next, segments );
+                const int c = ringVertex( r + 1, s, segments ), d = ringVertex( r + 1, next, segments );
+                out.face( f,     a, b, c );
+                out.face( f + 1, b, d, c );
+              }
+            }
+          }
+        } );
+
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: addGeoSphere
+      // Every icosahedron face split in frequency^2 triangles
+      // on a barycentric lattice, pushed out to the sphere.
+      // Corners, edge and interior lattice points are numbered
+      // apart so the 20 faces share their borders without a
+      // search: 12 corners, then frequency - 1 points per edge,
+      // then the interior points face by face.
+      //--------------------------------------------------
+      bool addGeoSphere( const Vector& center, float radius, int frequency,
+                         ArrSdkVertex& vertices, ArrSdkFaces& faces )
+      {
+        MeshWriter out;
+        if ( frequency < 1 || !grow( geoSphereCounts( frequency ), vertices, faces, out ) )
+        {
+          return ( false );
+        }
+
+        SphereVertex place( center.getX(), center.getY(), center.getZ(), radius );
+        writeGeoSphere( frequency, place, out );
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: addCylinder
+      // Y axis, rings + 1 rows of "segments" vertices from
+      // -height / 2 to height / 2, and a center vertex per cap.
+      //--------------------------------------------------
+      bool addCylinder( const Vector& center, float radius, float height, int segments, int rings, bool caps,
+                        ArrSdkVertex& vertices, ArrSdkFaces& faces )
+      {
+        MeshWriter out;
+        if ( segments < 3 || rings < 1 || !grow( cylinderCounts( segments, rings, caps ), vertices, faces, out ) )
+        {
+          return ( false );
+        }
+
+        arena_.reset();
+        float* sinPhi = arena_.allocate< float >( segments );
+        float* cosPhi = arena_.allocate< float >( segments );
+        angleTable( segments, 2.0f * PI() / segments, sinPhi, cosPhi );
+
+        const float cx = center.getX(), cy = center.getY(), cz = center.getZ();
+        const int   bottomCenter = ( rings + 1 ) * segments;
+        const size_t capFaces    = 2 * size_t( segments ) * rings;
+
+        if ( caps )
+        {
+          out.vertex( bottomCenter,     cx, cy - 0.5f * height, cz, 0.0f, -1.0f, 0.0f, 0.5f, 0.5f );
+          out.vertex( bottomCenter + 1, cx, cy + 0.5f * height, cz, 0.0f,  1.0f, 0.0f, 0.5f, 0.5f );
+        }
+
+        pool_.parallelFor( size_t( rings ) + 1, 8, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t row = begin; row < end; ++row )
+          {
+            const int   r = int( row );
+            const float v = float( r ) / float( rings );
+            const float y = cy + height * ( v - 0.5f );
+
+            for ( int s = 0; s < segments; ++s )
+            {
+              out.vertex( size_t( r ) * segments + s, cx + radius * cosPhi[ s ], y, cz + radius * sinPhi[ s ],
+                          cosPhi[ s ], 0.0f, sinPhi[ s ], float( s ) / float( segments ), v );
+            }
+
+            for ( int s = 0; s < segments; ++s )
+            {
+              const int next = ( s + 1 ) % segments;
+              const int a = r * segments + s, b = r * segments + next;
+
+              if ( r < rings )
+              {
+                const size_t f = 2 * ( size_t( r ) * segments + s );
+                out.face( f,     a, a + segments, b );
+                out.face( f + 1, b, a + segments, b + segments );
+              }
+
+              if ( caps && r == 0 )
+              {
+                out.face( capFaces + s, bottomCenter, a, b );
+              }
+              else if ( caps && r == rings )
+              {
+                out.face( capFaces + segments + s, bottomCenter + 1, b, a );
+              }
+            }
+          }
+        } );
+
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: addTorus
+      // Around the Y axis, "segments" tube sections of "sides"
+      // vertices. Each section writes the faces to the next.
+      //--------------------------------------------------
+      bool addTorus( const Vector& center, float majorRadius, float minorRadius, int segments, int sides,
+                     ArrSdkVertex& vertices, ArrSdkFaces& faces )
+      {
+        MeshWriter out;
+        if ( segments < 3 || sides < 3 || !grow( torusCounts( segments, sides ), vertices, faces, out ) )
+        {
+          return ( false );
+        }
+
+        arena_.reset();
+        float* sinPhi   = arena_.allocate< float >( segments );
+        float* cosPhi   = arena_.allocate< float >( segments );
+        float* sinTheta = arena_.allocate< float >( sides );
+        float* cosTheta = arena_.allocate< float >( sides );
+        angleTable( segments, 2.0f * PI() / segments, sinPhi, cosPhi );
+        angleTable( sides, 2.0f * PI() / sides, sinTheta, cosTheta );
+
+        const float cx = center.getX(), cy = center.getY(), cz = center.getZ();
+
+        pool_.parallelFor( size_t( segments ), 8, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t section = begin; section < end; ++section )
+          {
+            const int i = int( section ), next = ( i + 1 ) % segments;
+
+            for ( int j = 0; j < sides; ++j )
+            {
+              const float nx = cosTheta[ j ] * cosPhi[ i ], ny = sinTheta[ j ], nz = cosTheta[ j ] * sinPhi[ i ];
+              const float ring = majorRadius + minorRadius * cosTheta[ j ];
+              out.vertex( size_t( i ) * sides + j, cx + ring * cosPhi[ i ], cy + minorRadius * ny, cz + ring * sinPhi[ i ],
+                          nx, ny, nz, float( i ) / float( segments ), float( j ) / float( sides ) );
+            }
+
+            for ( int j = 0; j < sides; ++j )
+            {
+              const int around = ( j + 1 ) % sides;
+              const int a = i * sides + j, b = next * sides + j, c = i * sides + around, d = next * sides + around;
+              const size_t f = 2 * ( size_t( i ) * sides + j );
+              out.face( f,     a, c, b );
+              out.face( f + 1, b, c, d );
+            }
+          }
+        } );
+
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: addRocks
+      // One rock per position: a unit geosphere of "frequency",
+      // shared by every call with that frequency, its radius
+      // displaced by "roughness" times three octaves of value
+      // noise, then squashed along two axes and turned at
+      // random. Rocks differ by "seed" and by their index, and
+      // are written in parallel, one rock per task. Normals are
+      // left at zero: the squash bends them and the SDK
+      // computes them again when the geometry is set.
+      //--------------------------------------------------
+      bool addRocks( const std::vector< Vector >& positions, float radius, int frequency, float roughness, unsigned int seed,
+                     ArrSdkVertex& vertices, ArrSdkFaces& faces )
+      {
+        const MeshCounts rock = geoSphereCounts( frequency );
+        MeshCounts all;
+        all.vertices = rock.vertices * positions.size();
+        all.faces    = rock.faces * positions.size();
+
+        MeshWriter out;
+        if ( frequency < 1 || positions.empty() || !grow( all, vertices, faces, out ) )
+        {
+          return ( false );
+        }
+
+        const size_t   baseVertices = size_t( rock.vertices );
+        const size_t   baseFaces    = size_t( rock.faces );
+        const BaseMesh base         = rockBase( frequency, baseVertices, baseFaces );
+
+        pool_.parallelFor( positions.size(), 1, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t k = begin; k < end; ++k )
+          {
+            writeRock( k, base, baseVertices, baseFaces, positions[ k ], radius, roughness, seed, out );
+          }
+        } );
+
+        return ( true );
+      }
+
+    private:
+
+      enum
+      {
+        ICO_VERTICES = 12,
+        ICO_FACES    = 20,
+        ICO_EDGES    = 30
+      };
+
+      //--------------------------------------------------
+      // Destination slots of one call: vertex and face i of
+      // the mesh, face indices shifted to the array.
+      //--------------------------------------------------
+      struct MeshWriter
+      {
+        Vertex* vertices;
+        Face*   faces;
+        int     firstVertex;
+
+        void vertex( size_t i, float x, float y, float z, float nx, float ny, float nz, float u, float v ) const
+        {
+          Vertex& vertex = vertices[ i ];
+          vertex.setPosition( Vector( x, y, z ) );
+          vertex.setNormal( Vector( nx, ny, nz ) );
+          vertex.setTextureCoordinates( Vector( u, v, 0.0f ) );
+        }
+
+        void face( size_t i, int a, int b, int c ) const
+        {
+          faces[ i ].setIndices( firstVertex + a, firstVertex + b, firstVertex + c );
+        }
+      };
+
+      // Unit geosphere, the rock template.
+      struct BaseMesh
+      {
+        float* x;
+        float* y;
+        float* z;
+        int*   indices;
+
+        void vertex( size_t i, float px, float py, float pz, float, float, float, float, float ) const
+        {
+          x[ i ] = px; y[ i ] = py; z[ i ] = pz;
+        }
+
+        void face( size_t i, int a, int b, int c ) const
+        {
+          indices[ 3 * i ] = a; indices[ 3 * i + 1 ] = b; indices[ 3 * i + 2 ] = c;
+        }
+      };
+
+      // Sphere placement of unit directions.
+      struct SphereVertex
+      {
+        SphereVertex( float cx, float cy, float cz, float radius ) : cx( cx ), cy( cy ), cz( cz ), radius( radius ) {};
+
+        template < class Writer >
+        void write( const Writer& out, size_t i, float dx, float dy, float dz ) const
+        {
+          const float u = 0.5f + std::atan2( dz, dx ) / ( 2.0f * PI() );
+          const float v = 0.5f + std::asin( std::max( -1.0f, std::min( dy, 1.0f ) ) ) / PI();
+          out.vertex( i, cx + radius * dx, cy + radius * dy, cz + radius * dz, dx, dy, dz, u, v );
+        }
+
+        float cx, cy, cz, radius;
+      };
+
+      static float PI( void )
+      {
+        return ( 3.14159265f );
+      }
+
+      static MeshCounts counts( unsigned long long numVertices, unsigned long long numFaces )
+      {
+        MeshCounts result;
+        result.vertices = numVertices;
+        result.faces    = numFaces;
+        return ( result );
+      }
+
+      //--------------------------------------------------
+      // Function: grow
+      // Appends the slots of a mesh, false when the arrays
+      // would pass the int index range.
+      //--------------------------------------------------
+      static bool grow( const MeshCounts& mesh, ArrSdkVertex& vertices, ArrSdkFaces& faces, MeshWriter& out )
+      {
+        const unsigned long long firstVertex = vertices.size();
+        if ( mesh.vertices == 0 || firstVertex + mesh.vertices > static_cast< unsigned long long >( INT_MAX ) ||
+             faces.size() + mesh.faces > static_cast< unsigned long long >( INT_MAX ) )
+        {
+          return ( false );
+        }
+
+        const size_t firstFace = faces.size();
+        vertices.resize( size_t( firstVertex + mesh.vertices ), Vertex( Vector( 0.0f, 0.0f, 0.0f ) ) );
+        faces.resize( firstFace + size_t( mesh.faces ), Face( 0, 0, 0 ) );
+
+        out.vertices    = vertices.data() + firstVertex;
+        out.faces       = faces.data() + firstFace;
+        out.firstVertex = int( firstVertex );
+        return ( true );
+      }
+
+      // angleTable: sin and cos of k * step, k in [ 0, count ).
+      static void angleTable( int count, float step, float* sines, float* cosines )
+      {
+        for ( int k = 0; k < count; ++k )
+        {
+          sines[ k ]   = std::sin( step * k );
+          cosines[ k ] = std::cos( step * k );
+        }
+      }
+
+      static int ringVertex( int ring, int segment, int segments )
+      {
+        return ( 1 + ( ring - 1 ) * segments + segment );
+      }
+
+      //--------------------------------------------------
+      // Function: buildIcosahedron
+      // Unit icosahedron, outward faces, and the edge of each
+      // face side ( AB, BC, CA ) with its lower vertex first.
+      //--------------------------------------------------
+      void buildIcosahedron( void )
+      {
+        const float t = 0.5f * ( 1.0f + std::sqrt( 5.0f ) );
+        const float corners[ ICO_VERTICES ][ 3 ] =
+        {
+          { -1,  t,  0 }, {  1,  t,  0 }, { -1, -t,  0 }, {  1, -t,  0 },
+          {  0, -1,  t }, {  0,  1,  t }, {  0, -1, -t }, {  0,  1, -t },
+          {  t,  0, -1 }, {  t,  0,  1 }, { -t,  0, -1 }, { -t,  0,  1 }
+        };
+
+        static const int triangles[ ICO_FACES ][ 3 ] =
+        {
+          { 0, 11,  5 }, { 0,  5,  1 }, {  0,  1,  7 }, {  0,  7, 10 }, { 0, 10, 11 },
+          { 1,  5,  9 }, { 5, 11,  4 }, { 11, 10,  2 }, { 10,  7,  6 }, { 7,  1,  8 },
+          { 3,  9,  4 }, { 3,  4,  2 }, {  3,  2,  6 }, {  3,  6,  8 }, { 3,  8,  9 },
+          { 4,  9,  5 }, { 2,  4, 11 }, {  6,  2, 10 }, {  8,  6,  7 }, { 9,  8,  1 }
+        };
+
+        const float scale = 1.0f / std::sqrt( 1.0f + t * t );
+        for ( int v = 0; v < ICO_VERTICES; ++v )
+        {
+          icoX_[ v ] = corners[ v ][ 0 ] * scale;
+          icoY_[ v ] = corners[ v ][ 1 ] * scale;
+          icoZ_[ v ] = corners[ v ][ 2 ] * scale;
+        }
+
+        int numEdges = 0;
+        for ( int f = 0; f < ICO_FACES; ++f )
+        {
+          for ( int side = 0; side < 3; ++side )
+          {
+            icoFaces_[ f ][ side ] = triangles[ f ][ side ];
+
+            const int a  = triangles[ f ][ side ], b = triangles[ f ][ ( side + 1 ) % 3 ];
+            const int lo = std::min( a, b ), hi = std::max( a, b );
+
+            int e = 0;
+            while ( e < numEdges && ( edgeLo_[ e ] != lo || edgeHi_[ e ] != hi ) )
+            {
+              ++e;
+            }
+            if ( e == numEdges )
+            {
+              edgeLo_[ e ] = lo;
+              edgeHi_[ e ] = hi;
+              ++numEdges;
+            }
+            faceEdges_[ f ][ side ] = e;
+          }
+        }
+      }
+
+      // edgeVertex: point k of n along edge e walking from corner "from".
+      int edgeVertex( int e, int from, int k, int n ) const
+      {
+        const int step = ( from == edgeLo_[ e ] ) ? k : n - k;
+        return ( ICO_VERTICES + e * ( n - 1 ) + step - 1 );
+      }
+
+      //--------------------------------------------------
+      // Function: latticeVertex
+      // Index of lattice point A + i / n AB + j / n AC of face f.
+      //--------------------------------------------------
+      int latticeVertex( int f, int i, int j, int n ) const
+      {
+        const int a = icoFaces_[ f ][ 0 ], b = icoFaces_[ f ][ 1 ], c = icoFaces_[ f ][ 2 ];
+
+        if ( j == 0 )
+        {
+          return ( ( i == 0 ) ? a : ( i == n ) ? b : edgeVertex( faceEdges_[ f ][ 0 ], a, i, n ) );
+        }
+        if ( i == 0 )
+        {
+          return ( ( j == n ) ? c : edgeVertex( faceEdges_[ f ][ 2 ], a, j, n ) );
+        }
+        if ( i + j == n )
+        {
+          return ( edgeVertex( faceEdges_[ f ][ 1 ], b, j, n ) );
+        }
+
+        // Interior rows j = 1 .. n - 2 hold i = 1 .. n - 1 - j.
+        const int rowStart = ( j - 1 ) * ( n - 1 ) - ( j - 1 ) * j / 2;
+        return ( ICO_VERTICES + ICO_EDGES * ( n - 1 ) + f * ( ( n - 1 ) * ( n - 2 ) / 2 ) + rowStart + i - 1 );
+      }
+
+      //--------------------------------------------------
+      // Function: writeGeoSphere
+      // Corners first, then edge points in parallel, then the
+      // lattice rows of all faces in parallel: a row writes
+      // its interior points and its 2 ( n - j ) - 1 triangles.
+      //--------------------------------------------------
+      template < class Writer >
+      void writeGeoSphere( const int n, const SphereVertex& place, const Writer& out )
+      {
+        for ( int v = 0; v < ICO_VERTICES; ++v )
+        {
+          place.write( out, v, icoX_[ v ], icoY_[ v ], icoZ_[ v ] );
+        }
+
+        const float invN = 1.0f / float( n );
+
+        pool_.parallelFor( size_t( ICO_EDGES ) * ( n - 1 ), 1024, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t p = begin; p < end; ++p )
+          {
+            const int e = int( p / ( n - 1 ) ), k = int( p % ( n - 1 ) ) + 1;
+            const int lo = edgeLo_[ e ], hi = edgeHi_[ e ];
+            const float t = k * invN;
+
+            float dx = icoX_[ lo ] + t * ( icoX_[ hi ] - icoX_[ lo ] );
+            float dy = icoY_[ lo ] + t * ( icoY_[ hi ] - icoY_[ lo ] );
+            float dz = icoZ_[ lo ] + t * ( icoZ_[ hi ] - icoZ_[ lo ] );
+            normalize( dx, dy, dz );
+            place.write( out, ICO_VERTICES + p, dx, dy, dz );
+          }
+        } );
+
+        pool_.parallelFor( size_t( ICO_FACES ) * n, 4, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t row = begin; row < end; ++row )
+          {
+            const int f = int( row / n ), j = int( row % n );
+            const int a = icoFaces_[ f ][ 0 ], b = icoFaces_[ f ][ 1 ], c = icoFaces_[ f ][ 2 ];
+
+            for ( int i = 1; j > 0 && i < n - j; ++i )
+            {
+              const float s = i * invN, t = j * invN;
+              float dx = icoX_[ a ] + s * ( icoX_[ b ] - icoX_[ a ] ) + t * ( icoX_[ c ] - icoX_[ a ] );
+              float dy = icoY_[ a ] + s * ( icoY_[ b ] - icoY_[ a ] ) + t * ( icoY_[ c ] - icoY_[ a ] );
+              float dz = icoZ_[ a ] + s * ( icoZ_[ b ] - icoZ_[ a ] ) + t * ( icoZ_[ c ] - icoZ_[ a ] );
+              normalize( dx, dy, dz );
+              place.write( out, latticeVertex( f, i, j, n ), dx, dy, dz );
+            }
+
+            size_t face = size_t( f ) * n * n + size_t( 2 * n - j ) * j;
+            for ( int i = 0; i < n - j; ++i )
+            {
+              const int p00 = latticeVertex( f, i, j, n ), p10 = latticeVertex( f, i + 1, j, n );
+              const int p01 = latticeVertex( f, i, j + 1, n );
+              out.face( face++, p00, p10, p01 );
+
+              if ( i + j <= n - 2 )
+              {
+                out.face( face++, p10, latticeVertex( f, i + 1, j + 1, n ), p01 );
+              }
+            }
+          }
+        } );
+      }
+
+      // rockBase: the unit geosphere of "frequency", built only when the frequency changes.
+      BaseMesh rockBase( int frequency, size_t baseVertices, size_t baseFaces )
+      {
+        if ( frequency != rockFrequency_ )
+        {
+          rockX_.resize( baseVertices );
+          rockY_.resize( baseVertices );
+          rockZ_.resize( baseVertices );
+          rockIndices_.resize( 3 * baseFaces );
+        }
+
+        BaseMesh base;
+        base.x       = rockX_.data();
+        base.y       = rockY_.data();
+        base.z       = rockZ_.data();
+        base.indices = rockIndices_.data();
+
+        if ( frequency != rockFrequency_ )
+        {
+          SphereVertex unit( 0.0f, 0.0f, 0.0f, 1.0f );
+          writeGeoSphere( frequency, unit, base );
+          rockFrequency_ = frequency;
+        }
+        return ( base );
+      }
+
+      //--------------------------------------------------
+      // Function: writeRock
+      // Rock k from the base mesh: displaced radius along each
+      // base direction, squash, turn, move.
+      //--------------------------------------------------
+      static void writeRock( size_t k, const BaseMesh& base, size_t baseVertices, size_t baseFaces, const Vector& position,
+                             float radius, float roughness, unsigned int seed, const MeshWriter& out )
+      {
+        const unsigned int rockSeed = hash( seed ^ hash( static_cast< unsigned int >( k ) + 0x9e3779b9u ) );
+
+        // Random rotation from a uniform unit quaternion.
+        const float u1 = unitRandom( rockSeed, 1 ), u2 = 2.0f * PI() * unitRandom( rockSeed, 2 ), u3 = 2.0f * PI() * unitRandom( rockSeed, 3 );
+        const float qw = std::sqrt( 1.0f - u1 ) * std::sin( u2 ), qx = std::sqrt( 1.0f - u1 ) * std::cos( u2 );
+        const float qy = std::sqrt( u1 ) * std::sin( u3 ),        qz = std::sqrt( u1 ) * std::cos( u3 );
+
+        const float r00 = 1 - 2 * ( qy * qy + qz * qz ), r01 = 2 * ( qx * qy - qz * qw ),     r02 = 2 * ( qx * qz + qy * qw );
+        const float r10 = 2 * ( qx * qy + qz * qw ),     r11 = 1 - 2 * ( qx * qx + qz * qz ), r12 = 2 * ( qy * qz - qx * qw );
+        const float r20 = 2 * ( qx * qz - qy * qw ),     r21 = 2 * ( qy * qz + qx * qw ),     r22 = 1 - 2 * ( qx * qx + qy * qy );
+
+        const float sy = 0.6f + 0.4f * unitRandom( rockSeed, 4 );
+        const float sz = 0.75f + 0.25f * unitRandom( rockSeed, 5 );
+
+        const float px = position.getX(), py = position.getY(), pz = position.getZ();
+        const float offset = 64.0f * unitRandom( rockSeed, 6 );
+
+        const size_t firstVertex = k * baseVertices;
+        for ( size_t v = 0; v < baseVertices; ++v )
+        {
+          const float dx = base.x[ v ], dy = base.y[ v ], dz = base.z[ v ];
+          const float r = radius * ( 1.0f + roughness * fractalNoise( 2.0f * dx + offset, 2.0f * dy, 2.0f * dz, rockSeed ) );
+
+          const float lx = r * dx, ly = r * dy * sy, lz = r * dz * sz;
+
+          out.vertex( firstVertex + v,
+                      px + r00 * lx + r01 * ly + r02 * lz,
+                      py + r10 * lx + r11 * ly + r12 * lz,
+                      pz + r20 * lx + r21 * ly + r22 * lz,
+                      0.0f, 0.0f, 0.0f,
+                      0.5f + std::atan2( dz, dx ) / ( 2.0f * PI() ), 0.5f + 0.5f * dy );
+        }
+
+        const int shift = int( firstVertex );
+        for ( size_t f = 0; f < baseFaces; ++f )
+        {
+          const int* ijk = base.indices + 3 * f;
+          out.face( k * baseFaces + f, shift + ijk[ 0 ], shift + ijk[ 1 ], shift + ijk[ 2 ] );
+        }
+      }
+
+      static void normalize( float& x, float& y, float& z )
+      {
+        const float scale = 1.0f / std::sqrt( x * x + y * y + z * z );
+        x *= scale; y *= scale; z *= scale;
+      }
+
+      // hash: integer finalizer, well mixed for consecutive keys.
+      static unsigned int hash( unsigned int h )
+      {
+        h ^= h >> 16; h *= 0x7feb352du;
+        h ^= h >> 15; h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return ( h );
+      }
+
+      // unitRandom: value in [ 0, 1 ) for a seed and a channel.
+      static float unitRandom( unsigned int seed, unsigned int channel )
+      {
+        return ( float( hash( seed + channel * 0x68e31da4u ) >> 8 ) * ( 1.0f / 16777216.0f ) );
+      }
+
+      // latticeValue: [ -1, 1 ] at an integer lattice point.
+      static float latticeValue( int x, int y, int z, unsigned int seed )
+      {
+        const unsigned int h = hash( seed ^ hash( unsigned( x ) * 0x8da6b343u + unsigned( y ) * 0xd8163841u + unsigned( z ) * 0xcb1ab31fu ) );
+        return ( float( h >> 8 ) * ( 2.0f / 16777216.0f ) - 1.0f );
+      }
+
+      // valueNoise: smoothly interpolated lattice values, [ -1, 1 ].
+      static float valueNoise( float x, float y, float z, unsigned int seed )
+      {
+        const float fx = std::floor( x ), fy = std::floor( y ), fz = std::floor( z );
+        const int   ix = int( fx ), iy = int( fy ), iz = int( fz );
+
+        float tx = x - fx, ty = y - fy, tz = z - fz;
+        tx = tx * tx * ( 3.0f - 2.0f * tx );
+        ty = ty * ty * ( 3.0f - 2.0f * ty );
+        tz = tz * tz * ( 3.0f - 2.0f * tz );
+
+        float plane[ 2 ];
+        for ( int dz = 0; dz < 2; ++dz )
+        {
+          const float v00 = latticeValue( ix, iy,     iz + dz, seed ), v10 = latticeValue( ix + 1, iy,     iz + dz, seed );
+          const float v01 = latticeValue( ix, iy + 1, iz + dz, seed ), v11 = latticeValue( ix + 1, iy + 1, iz + dz, seed );
+          const float low  = v00 + tx * ( v10 - v00 );
+          const float high = v01 + tx * ( v11 - v01 );
+          plane[ dz ] = low + ty * ( high - low );
+        }
+        return ( plane[ 0 ] + tz * ( plane[ 1 ] - plane[ 0 ] ) );
+      }
+
+      // fractalNoise: three octaves, normalized to [ -1, 1 ].
+      static float fractalNoise( float x, float y, float z, unsigned int seed )
+      {
+        return ( ( valueNoise( x, y, z, seed ) +
+                   0.5f  * valueNoise( 2.0f * x, 2.0f * y, 2.0f * z, seed + 1 ) +
+                   0.25f * valueNoise( 4.0f * x, 4.0f * y, 4.0f * z, seed + 2 ) ) / 1.75f );
+      }
+
+    private:
+
+      PrimitiveGenerator( const PrimitiveGenerator& );
+      PrimitiveGenerator& operator =( const PrimitiveGenerator& );
+
+    private:
+
+      ThreadPool&  pool_;
+      ScratchArena arena_;
+
+      // Rock base mesh of rockFrequency_, 0 before the first rock.
+      std::vector< float > rockX_, rockY_, rockZ_;
+      std::vector< int >   rockIndices_;
+      int                  rockFrequency_;
+
+      float icoX_[ ICO_VERTICES ], icoY_[ ICO_VERTICES ], icoZ_[ ICO_VERTICES ];
+      int   icoFaces_[ ICO_FACES ][ 3 ];
+      int   faceEdges_[ ICO_FACES ][ 3 ];
+      int   edgeLo_[ ICO_EDGES ], edgeHi_[ ICO_EDGES ];
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_PRIMITIVE_GENERATOR_H
@@ -0,0 +1,119 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_PROCESS_MEMORY_H
+#define _RF_EXAMPLES_PROCESS_MEMORY_H
+
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+  #include <psapi.h>
+  #pragma comment( lib, "psapi.lib" )
+#else
+  #include <sys/resource.h>
+  #include <unistd.h>
+  #include <cstdio>
+  #ifdef __APPLE__
+    #include <mach/mach.h>
+  #endif
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: ProcessMemory
+    // Resident memory of this process, now or its peak, and
+    // the peak of a finished child, in MB. A peak is the high
+    // water mark since the process started, it never goes
+    // down.
+    //--------------------------------------------------
+    class ProcessMemory
+    {
+    public:
+
+      // getPeakRssMb: of the calling process since it started.
+      static double getPeakRssMb( void )
+      {
+      #ifdef _WIN32
+        return ( getPeakRssMb( GetCurrentProcess() ) );
+      #else
+        struct rusage usage;
+        return ( getrusage( RUSAGE_SELF, &usage ) == 0 ? fromRusage( usage ) : 0.0 );
+      #endif
+      }
+
+      // getRssMb: resident memory of the calling process now.
+      static double getRssMb( void )
+      {
+      #if defined( _WIN32 )
+        PROCESS_MEMORY_COUNTERS counters;
+        if ( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+        {
+          return ( 0.0 );
+        }
+        return ( double( counters.WorkingSetSize ) / 1048576.0 );
+      #elif defined( __APPLE__ )
+        mach_task_basic_info_data_t info;
+        mach_msg_type_number_t      count = MACH_TASK_BASIC_INFO_COUNT;
+        if ( task_info( mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast< task_info_t >( &info ), &count ) != KERN_SUCCESS )
+        {
+          return ( 0.0 );
+        }
+        return ( double( info.resident_size ) / 1048576.0 );
+      #else
+        // Second field of statm, in pages.
+        std::FILE* statm = std::fopen( "/proc/self/statm", "r" );
+        if ( !statm )
+        {
+          return ( 0.0 );
+        }
+        unsigned long size = 0, resident = 0;
+        const bool read = std::fscanf( statm, "%lu %lu", &size, &resident ) == 2;
+        std::fclose( statm );
+        return ( read ? double( resident ) * double( sysconf( _SC_PAGESIZE ) ) / 1048576.0 : 0.0 );
+      #endif
+      }
+
+    #ifdef _WIN32
+      // getPeakRssMb: of a process handle opened with query access.
+      static double getPeakRssMb( HANDLE process )
+      {
+        PROCESS_MEMORY_COUNTERS counters;
+        if ( !GetProcessMemoryInfo( process, &counters, sizeof( counters ) ) )
+        {
+          return ( 0.0 );
+        }
+        return ( double( counters.PeakWorkingSetSize ) / 1048576.0 );
+      }
+    #else
+      // fromRusage: ru_maxrss is in KB on Linux and in bytes on OS X.
+      static double fromRusage( const struct rusage& usage )
+      {
+      #ifdef __APPLE__
+        return ( double( usage.ru_maxrss ) / 1048576.0 );
+      #else
+        return ( double( usage.ru_maxrss ) / 1024.0 );
+      #endif
+      }
+    #endif
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_PROCESS_MEMORY_H
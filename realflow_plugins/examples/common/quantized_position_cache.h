@@ -0,0 +1,289 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_QUANTIZED_POSITION_CACHE_H
+#define _RF_EXAMPLES_QUANTIZED_POSITION_CACHE_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: QuantizedPositionCache
+    // Particles sorted by grid cell, each position stored as
+    // three 16-bit fixed point offsets from the origin of its
+    // cell ( 6 bytes instead of the 12 of a float Vector ).
+    // Cells are exact ( no hash sharing ), so every entry of a
+    // cell decodes against the same origin, computed once per
+    // visited cell. The resolution is cellSize / 65536.
+    //--------------------------------------------------
+    class QuantizedPositionCache
+    {
+    public:
+
+      struct PackedPosition
+      {
+        unsigned short x, y, z;
+      };
+
+      struct Cell
+      {
+        unsigned long long key;
+        float              originX, originY, originZ;
+        unsigned int       begin, end;
+      };
+
+    public:
+
+      /// Constructor.
+      QuantizedPositionCache() : cellSize_( 1.0f ), invCellSize_( 1.0f ), tableMask_( 0 ) {};
+
+      //--------------------------------------------------
+      // Function: build
+      // Rebuilt every step from full precision positions.
+      //--------------------------------------------------
+      void build( const float* x, const float* y, const float* z,
+                  size_t count, float cellSize )
+      {
+        cellSize_    = cellSize;
+        invCellSize_ = 1.0f / cellSize;
+
+        order_.resize( count );
+        for ( size_t i = 0; i < count; ++i )
+        {
+          order_[ i ].first  = cellKey( cellCoord( x[ i ] ), cellCoord( y[ i ] ), cellCoord( z[ i ] ) );
+          order_[ i ].second = static_cast< unsigned int >( i );
+        }
+        std::sort( order_.begin(), order_.end() );
+
+        packed_.resize( count );
+        pointOfSlot_.resize( count );
+        slotOfPoint_.resize( count );
+        cells_.clear();
+
+        const float scale = 65536.0f * invCellSize_;
+
+        for ( size_t k = 0; k < count; ++k )
+        {
+          const unsigned long long key = order_[ k ].first;
+          const unsigned int       i   = order_[ k ].second;
+
+          if ( cells_.empty() || cells_.back().key != key )
+          {
+            Cell cell;
+            cell.key     = key;
+            cell.originX = cellCoord( x[ i ] ) * cellSize_;
+            cell.originY = cellCoord( y[ i ] ) * cellSize_;
+            cell.originZ = cellCoord( z[ i ] ) * cellSize_;
+            cell.begin   = static_cast< unsigned int >( k );
+            cell.end     = static_cast< unsigned int >( k );
+            cells_.push_back( cell );
+          }
+
+          Cell& cell = cells_.back();
+          ++cell.end;
+
+          packed_[ k ].x = quantize( ( x[ i ] - cell.originX ) * scale );
+          packed_[ k ].y = quantize( ( y[ i ] - cell.originY ) * scale );
+          packed_[ k ].z = quantize( ( z[ i ] - cell.originZ ) * scale );
+
+          pointOfSlot_[ k ] = i;
+          slotOfPoint_[ i ] = static_cast< unsigned int >( k );
+        }
+
+        // Open addressing table of cells, load factor <= 0.5.
+        size_t tableSize = 1;
+        while ( tableSize < 2 * cells_.size() )
+        {
+          tableSize <<= 1;
+        }
+        tableMask_ = tableSize - 1;
+        table_.assign( tableSize, -1 );
+
+        for ( size_t c = 0; c < cells_.size(); ++c )
+        {
+          size_t slot = hashKey( cells_[ c ].key );
+          while ( table_[ slot ] >= 0 )
+          {
+            slot = ( slot + 1 ) & tableMask_;
+          }
+          table_[ slot ] = int( c );
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: forEachNeighbor
+      // visitor( x, y, z ) with the decoded position of every
+      // other point of "point" closer than sqrt( radius2 ).
+      //--------------------------------------------------
+      template < class VISITOR >
+      void forEachNeighbor( size_t point, float px, float py, float pz,
+                            float radius2, VISITOR& visitor ) const
+      {
+        const float decode = cellSize_ * ( 1.0f / 65536.0f );
+        const unsigned int self = slotOfPoint_[ point ];
+
+        const int cx = cellCoord( px ), cy = cellCoord( py ), cz = cellCoord( pz );
+        for ( int dz = -1; dz <= 1; ++dz )
+        {
+          for ( int dy = -1; dy <= 1; ++dy )
+          {
+            for ( int dx = -1; dx <= 1; ++dx )
+            {
+              const Cell* cell = findCell( cx + dx, cy + dy, cz + dz );
+              if ( cell == NULL )
+              {
+                continue;
+              }
+
+              // Decode relative to the query point, cell origin folded once.
+              const float ox = cell->originX - px + 0.5f * decode;
+              const float oy = cell->originY - py + 0.5f * decode;
+              const float oz = cell->originZ - pz + 0.5f * decode;
+
+              for ( unsigned int k = cell->begin; k < cell->end; ++k )
+              {
+                const PackedPosition& q = packed_[ k ];
+                const float rx = ox + q.x * decode;
+                const float ry = oy + q.y * decode;
+                const float rz = oz + q.z * decode;
+                if ( k != self && rx * rx + ry * ry + rz * rz < radius2 )
+                {
+                  visitor( px + rx, py + ry, pz + rz );
+                }
+              }
+            }
+          }
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: forEachNeighborFloat
+      // Same traversal with the full precision positions, the
+      // reference the quantized path is measured against.
+      //--------------------------------------------------
+      template < class VISITOR >
+      void forEachNeighborFloat( size_t point, const float* x, const float* y, const float* z,
+                                 float radius2, VISITOR& visitor ) const
+      {
+        const float px = x[ point ], py = y[ point ], pz = z[ point ];
+
+        const int cx = cellCoord( px ), cy = cellCoord( py ), cz = cellCoord( pz );
+        for ( int dz = -1; dz <= 1; ++dz )
+        {
+          for ( int dy = -1; dy <= 1; ++dy )
+          {
+            for ( int dx = -1; dx <= 1; ++dx )
+            {
+              const Cell* cell = findCell( cx + dx, cy + dy, cz + dz );
+              if ( cell == NULL )
+              {
+                continue;
+              }
+
+              for ( unsigned int k = cell->begin; k < cell->end; ++k )
+              {
+                const unsigned int j = pointOfSlot_[ k ];
+                const float rx = x[ j ] - px, ry = y[ j ] - py, rz = z[ j ] - pz;
+                if ( j != point && rx * rx + ry * ry + rz * rz < radius2 )
+                {
+                  visitor( x[ j ], y[ j ], z[ j ] );
+                }
+              }
+            }
+          }
+        }
+      }
+
+      size_t getNumPoints( void ) const { return ( packed_.size() ); }
+      size_t getNumCells( void ) const { return ( cells_.size() ); }
+      float  getCellSize( void ) const { return ( cellSize_ ); }
+
+      // Bytes read per visited neighbor, quantized and full precision.
+      static size_t getBytesPerVisit( void ) { return ( sizeof( PackedPosition ) ); }
+      static size_t getFloatBytesPerVisit( void ) { return ( 3 * sizeof( float ) ); }
+
+    private:
+
+      // cellCoord
+      int cellCoord( float v ) const
+      {
+        return ( int( std::floor( v * invCellSize_ ) ) );
+      }
+
+      // quantize: clamps the rounding at the far cell border.
+      static unsigned short quantize( float v )
+      {
+        const int q = int( v );
+        return ( static_cast< unsigned short >( q < 0 ? 0 : ( q > 65535 ? 65535 : q ) ) );
+      }
+
+      // cellKey: 21 bits per axis.
+      static unsigned long long cellKey( int cx, int cy, int cz )
+      {
+        const unsigned long long mask = ( 1ull << 21 ) - 1;
+        return ( ( ( static_cast< unsigned long long >( cx ) & mask ) << 42 ) |
+                 ( ( static_cast< unsigned long long >( cy ) & mask ) << 21 ) |
+                 (   static_cast< unsigned long long >( cz ) & mask ) );
+      }
+
+      // hashKey
+      size_t hashKey( unsigned long long key ) const
+      {
+        return ( size_t( ( key * 0x9E3779B97F4A7C15ull ) >> 32 ) & tableMask_ );
+      }
+
+      // findCell
+      const Cell* findCell( int cx, int cy, int cz ) const
+      {
+        if ( table_.empty() )
+        {
+          return ( NULL );
+        }
+
+        const unsigned long long key = cellKey( cx, cy, cz );
+        for ( size_t slot = hashKey( key ); table_[ slot ] >= 0; slot = ( slot + 1 ) & tableMask_ )
+        {
+          const Cell& cell = cells_[ table_[ slot ] ];
+          if ( cell.key == key )
+          {
+            return ( &cell );
+          }
+        }
+        return ( NULL );
+      }
+
+    private:
+
+      float  cellSize_;
+      float  invCellSize_;
+      size_t tableMask_;
+
+      std::vector< std::pair< unsigned long long, unsigned int > > order_;
+      std::vector< PackedPosition > packed_;
+      std::vector< unsigned int >   pointOfSlot_;
+      std::vector< unsigned int >   slotOfPoint_;
+      std::vector< Cell >           cells_;
+      std::vector< int >            table_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_QUANTIZED_POSITION_CACHE_H
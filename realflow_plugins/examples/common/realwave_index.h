@@ -0,0 +1,460 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_REALWAVE_INDEX_H
+#define _RF_EXAMPLES_REALWAVE_INDEX_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "thread_pool.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: RealWaveIndex
+    // Nearest vertex and water height queries over a RealWave
+    // mesh, the vertices of RealWave::getVertices as SoA and
+    // the faces of getFaces as index triplets.
+    //
+    // Vertices and triangles are bucketed by xz in a uniform
+    // 2D grid of about one vertex per cell, built from the
+    // positions of the frame the topology was set ( the
+    // "rest" positions ). Later frames only copy positions
+    // and track how far any vertex drifted in xz since; the
+    // searches widen by that drift. The buckets are rebuilt
+    // when the topology changes, and otherwise only as a
+    // safeguard once the drift passes REBUILD_DRIFT_CELLS
+    // cells, e.g. a RealWave moved as a whole. Choppy waves
+    // move vertices a cell or two, so a normal frame costs
+    // one parallel copy and queries a few more cells.
+    //--------------------------------------------------
+    class RealWaveIndex
+    {
+    public:
+
+      enum
+      {
+        REBUILD_DRIFT_CELLS = 4
+      };
+
+      /// Constructor.
+      RealWaveIndex() : count_( 0 ), cellSize_( 1.0f ), invCellSize_( 1.0f ),
+                        originX_( 0.0f ), originZ_( 0.0f ), cellsX_( 0 ), cellsZ_( 0 ),
+                        drift_( 0.0f ), valid_( false ) {};
+
+      // needsTopology: true until setTopology() and after a vertex count change.
+      bool needsTopology( size_t vertexCount ) const
+      {
+        return ( !valid_ || vertexCount != count_ );
+      }
+
+      //--------------------------------------------------
+      // Function: setTopology
+      // Triangles as vertex index triplets. Call before
+      // update() whenever the RealWave mesh changes.
+      //--------------------------------------------------
+      void setTopology( size_t vertexCount, const int* triangles, size_t numTriangles )
+      {
+        count_ = vertexCount;
+        triangles_.assign( triangles, triangles + 3 * numTriangles );
+        valid_ = false;
+      }
+
+      //--------------------------------------------------
+      // Function: update
+      // Positions of this frame. Returns true when the buckets
+      // were rebuilt: after setTopology(), or when the drift
+      // passes REBUILD_DRIFT_CELLS cells.
+      //--------------------------------------------------
+      bool update( const float* x, const float* y, const float* z, ThreadPool& pool )
+      {
+        x_.resize( count_ );
+        y_.resize( count_ );
+        z_.resize( count_ );
+
+        const bool rebuild = !valid_;
+
+        std::vector< PaddedAccumulator< float > > drift( pool.getNumThreads() );
+        pool.parallelFor( count_, 4096, [&]( size_t begin, size_t end, unsigned int thread )
+        {
+          float maxDriftSq = 0.0f;
+          for ( size_t i = begin; i < end; ++i )
+          {
+            x_[ i ] = x[ i ];
+            y_[ i ] = y[ i ];
+            z_[ i ] = z[ i ];
+
+            if ( !rebuild )
+            {
+              const float dx = x[ i ] - restX_[ i ], dz = z[ i ] - restZ_[ i ];
+              maxDriftSq = std::max( maxDriftSq, dx * dx + dz * dz );
+            }
+          }
+          drift[ thread ].value = std::max( drift[ thread ].value, maxDriftSq );
+        } );
+
+        float maxDriftSq = 0.0f;
+        for ( size_t t = 0; t < drift.size(); ++t )
+        {
+          maxDriftSq = std::max( maxDriftSq, drift[ t ].value );
+        }
+        drift_ = std::sqrt( maxDriftSq );
+
+        if ( rebuild || drift_ > float( REBUILD_DRIFT_CELLS ) * cellSize_ )
+        {
+          buildBuckets( pool );
+          return ( true );
+        }
+        return ( false );
+      }
+
+      size_t getNumVertices( void ) const { return ( count_ ); }
+      float  getCellSize( void ) const    { return ( cellSize_ ); }
+
+      //--------------------------------------------------
+      // Function: nearestVertex
+      // Index of the vertex closest to ( px, py, pz ) in 3D,
+      // -1 for an empty mesh. Rings of cells are searched
+      // outwards until no closer vertex can be left.
+      //--------------------------------------------------
+      int nearestVertex( float px, float py, float pz ) const
+      {
+        if ( count_ == 0 || cellsX_ == 0 )
+        {
+          return ( -1 );
+        }
+
+        const int cx = clampCell( cellCoord( px - originX_ ), cellsX_ );
+        const int cz = clampCell( cellCoord( pz - originZ_ ), cellsZ_ );
+
+        int   best   = -1;
+        float bestSq = std::numeric_limits< float >::max();
+
+        const int maxRing = std::max( cellsX_, cellsZ_ );
+        for ( int ring = 0; ring <= maxRing; ++ring )
+        {
+          // Anything in this ring is at least this far in xz.
+          const float bound = float( ring - 1 ) * cellSize_ - drift_;
+          if ( best >= 0 && bound > 0.0f && bestSq <= bound * bound )
+          {
+            break;
+          }
+
+          for ( int dz = -ring; dz <= ring; ++dz )
+          {
+            const int z = cz + dz;
+            if ( z < 0 || z >= cellsZ_ )
+            {
+              continue;
+            }
+
+            // Only the ring border: every cell of the first and last rows, two of the others.
+            const int stepX = ( dz == -ring || dz == ring ) ? 1 : std::max( 2 * ring, 1 );
+            for ( int dx = -ring; dx <= ring; dx += stepX )
+            {
+              const int x = cx + dx;
+              if ( x < 0 || x >= cellsX_ )
+              {
+                continue;
+              }
+
+              const size_t cell = size_t( z ) * cellsX_ + x;
+              for ( unsigned int k = vertexStart_[ cell ]; k < vertexStart_[ cell + 1 ]; ++k )
+              {
+                const unsigned int i = vertexItems_[ k ];
+                const float ex = x_[ i ] - px, ey = y_[ i ] - py, ez = z_[ i ] - pz;
+                const float distSq = ex * ex + ey * ey + ez * ez;
+                if ( distSq < bestSq || ( distSq == bestSq && int( i ) < best ) )
+                {
+                  bestSq = distSq;
+                  best   = int( i );
+                }
+              }
+            }
+          }
+        }
+
+        return ( best );
+      }
+
+      //--------------------------------------------------
+      // Function: height
+      // Water height at ( px, pz ), interpolated inside the
+      // triangle under the point. False outside the mesh.
+      //--------------------------------------------------
+      bool height( float px, float pz, float& h ) const
+      {
+        if ( cellsX_ == 0 )
+        {
+          return ( false );
+        }
+
+        const int x0 = clampCell( cellCoord( px - drift_ - originX_ ), cellsX_ );
+        const int x1 = clampCell( cellCoord( px + drift_ - originX_ ), cellsX_ );
+        const int z0 = clampCell( cellCoord( pz - drift_ - originZ_ ), cellsZ_ );
+        const int z1 = clampCell( cellCoord( pz + drift_ - originZ_ ), cellsZ_ );
+
+        for ( int z = z0; z <= z1; ++z )
+        {
+          for ( int x = x0; x <= x1; ++x )
+          {
+            const size_t cell = size_t( z ) * cellsX_ + x;
+            for ( unsigned int k = triangleStart_[ cell ]; k < triangleStart_[ cell + 1 ]; ++k )
+            {
+              if ( triangleHeight( triangleItems_[ k ], px, pz, h ) )
+              {
+                return ( true );
+              }
+            }
+          }
+        }
+        return ( false );
+      }
+
+      // nearestVertices: batched nearestVertex(), points in parallel.
+      void nearestVertices( const float* px, const float* py, const float* pz, size_t numPoints,
+                            int* indices, ThreadPool& pool ) const
+      {
+        pool.parallelFor( numPoints, 256, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            indices[ i ] = nearestVertex( px[ i ], py[ i ], pz[ i ] );
+          }
+        } );
+      }
+
+      // heights: batched height(), "found" is 0 for points outside the mesh.
+      void heights( const float* px, const float* pz, size_t numPoints,
+                    float* h, unsigned char* found, ThreadPool& pool ) const
+      {
+        pool.parallelFor( numPoints, 256, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            float value = 0.0f;
+            found[ i ]  = height( px[ i ], pz[ i ], value ) ? 1 : 0;
+            h[ i ]      = value;
+          }
+        } );
+      }
+
+    private:
+
+      //--------------------------------------------------
+      // Function: buildBuckets
+      // Current positions become the rest positions. Cells of
+      // about one vertex over the xz bounds, vertices and
+      // triangle bounding boxes counting sorted into them.
+      //--------------------------------------------------
+      void buildBuckets( ThreadPool& pool )
+      {
+        restX_ = x_;
+        restZ_ = z_;
+        drift_ = 0.0f;
+        valid_ = true;
+
+        if ( count_ == 0 )
+        {
+          cellsX_ = cellsZ_ = 0;
+          return;
+        }
+
+        float minX = x_[ 0 ], maxX = x_[ 0 ], minZ = z_[ 0 ], maxZ = z_[ 0 ];
+        for ( size_t i = 1; i < count_; ++i )
+        {
+          minX = std::min( minX, x_[ i ] ); maxX = std::max( maxX, x_[ i ] );
+          minZ = std::min( minZ, z_[ i ] ); maxZ = std::max( maxZ, z_[ i ] );
+        }
+
+        const float width = std::max( maxX - minX, 1e-3f );
+        const float depth = std::max( maxZ - minZ, 1e-3f );
+
+        cellSize_    = std::max( std::sqrt( width * depth / float( count_ ) ), 1e-3f );
+        invCellSize_ = 1.0f / cellSize_;
+        originX_     = minX;
+        originZ_     = minZ;
+        cellsX_      = int( width * invCellSize_ ) + 1;
+        cellsZ_      = int( depth * invCellSize_ ) + 1;
+
+        const size_t numCells = size_t( cellsX_ ) * cellsZ_;
+
+        // Vertices.
+        vertexCell_.resize( count_ );
+        pool.parallelFor( count_, 4096, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            vertexCell_[ i ] = static_cast< unsigned int >( cellIndex( x_[ i ], z_[ i ] ) );
+          }
+        } );
+
+        vertexStart_.assign( numCells + 1, 0 );
+        for ( size_t i = 0; i < count_; ++i )
+        {
+          ++vertexStart_[ vertexCell_[ i ] + 1 ];
+        }
+        for ( size_t c = 0; c < numCells; ++c )
+        {
+          vertexStart_[ c + 1 ] += vertexStart_[ c ];
+        }
+
+        vertexItems_.resize( count_ );
+        std::vector< unsigned int > fill( vertexStart_.begin(), vertexStart_.end() - 1 );
+        for ( size_t i = 0; i < count_; ++i )
+        {
+          vertexItems_[ fill[ vertexCell_[ i ] ]++ ] = static_cast< unsigned int >( i );
+        }
+
+        // Triangles, in every cell their bounding box touches.
+        const size_t numTriangles = triangles_.size() / 3;
+        triangleStart_.assign( numCells + 1, 0 );
+
+        for ( int pass = 0; pass < 2; ++pass )
+        {
+          if ( pass == 1 )
+          {
+            for ( size_t c = 0; c < numCells; ++c )
+            {
+              triangleStart_[ c + 1 ] += triangleStart_[ c ];
+            }
+            triangleItems_.resize( triangleStart_[ numCells ] );
+            fill.assign( triangleStart_.begin(), triangleStart_.end() - 1 );
+          }
+
+          for ( size_t t = 0; t < numTriangles; ++t )
+          {
+            int x0, x1, z0, z1;
+            if ( !triangleCells( t, x0, x1, z0, z1 ) )
+            {
+              continue;
+            }
+
+            for ( int z = z0; z <= z1; ++z )
+            {
+              for ( int x = x0; x <= x1; ++x )
+              {
+                const size_t cell = size_t( z ) * cellsX_ + x;
+                if ( pass == 0 )
+                {
+                  ++triangleStart_[ cell + 1 ];
+                }
+                else
+                {
+                  triangleItems_[ fill[ cell ]++ ] = static_cast< unsigned int >( t );
+                }
+              }
+            }
+          }
+        }
+      }
+
+      // triangleCells: cell range of the xz bounds of triangle "t", false for bad indices.
+      bool triangleCells( size_t t, int& x0, int& x1, int& z0, int& z1 ) const
+      {
+        const int* v = &triangles_[ 3 * t ];
+        for ( int k = 0; k < 3; ++k )
+        {
+          if ( v[ k ] < 0 || size_t( v[ k ] ) >= count_ )
+          {
+            return ( false );
+          }
+        }
+
+        const float minX = std::min( x_[ v[ 0 ] ], std::min( x_[ v[ 1 ] ], x_[ v[ 2 ] ] ) );
+        const float maxX = std::max( x_[ v[ 0 ] ], std::max( x_[ v[ 1 ] ], x_[ v[ 2 ] ] ) );
+        const float minZ = std::min( z_[ v[ 0 ] ], std::min( z_[ v[ 1 ] ], z_[ v[ 2 ] ] ) );
+        const float maxZ = std::max( z_[ v[ 0 ] ], std::max( z_[ v[ 1 ] ], z_[ v[ 2 ] ] ) );
+
+        x0 = clampCell( cellCoord( minX - originX_ ), cellsX_ );
+        x1 = clampCell( cellCoord( maxX - originX_ ), cellsX_ );
+        z0 = clampCell( cellCoord( minZ - originZ_ ), cellsZ_ );
+        z1 = clampCell( cellCoord( maxZ - originZ_ ), cellsZ_ );
+        return ( true );
+      }
+
+      // triangleHeight: barycentric height of triangle "t" at the current positions.
+      bool triangleHeight( unsigned int t, float px, float pz, float& h ) const
+      {
+        const int* v = &triangles_[ 3 * t ];
+
+        const float ax = x_[ v[ 0 ] ], az = z_[ v[ 0 ] ];
+        const float bx = x_[ v[ 1 ] ], bz = z_[ v[ 1 ] ];
+        const float cx = x_[ v[ 2 ] ], cz = z_[ v[ 2 ] ];
+
+        const float area = ( bx - ax ) * ( cz - az ) - ( cx - ax ) * ( bz - az );
+        if ( std::fabs( area ) < 1e-12f )
+        {
+          return ( false );
+        }
+
+        const float inv = 1.0f / area;
+        const float wb  = ( ( px - ax ) * ( cz - az ) - ( cx - ax ) * ( pz - az ) ) * inv;
+        const float wc  = ( ( bx - ax ) * ( pz - az ) - ( px - ax ) * ( bz - az ) ) * inv;
+        const float wa  = 1.0f - wb - wc;
+
+        const float eps = -1e-5f;
+        if ( wa < eps || wb < eps || wc < eps )
+        {
+          return ( false );
+        }
+
+        h = wa * y_[ v[ 0 ] ] + wb * y_[ v[ 1 ] ] + wc * y_[ v[ 2 ] ];
+        return ( true );
+      }
+
+      int cellCoord( float offset ) const
+      {
+        return ( int( std::floor( offset * invCellSize_ ) ) );
+      }
+
+      static int clampCell( int c, int cells )
+      {
+        return ( std::min( std::max( c, 0 ), cells - 1 ) );
+      }
+
+      size_t cellIndex( float x, float z ) const
+      {
+        return ( size_t( clampCell( cellCoord( z - originZ_ ), cellsZ_ ) ) * cellsX_ +
+                 clampCell( cellCoord( x - originX_ ), cellsX_ ) );
+      }
+
+    private:
+
+      size_t count_;
+      float  cellSize_, invCellSize_;
+      float  originX_, originZ_;
+      int    cellsX_, cellsZ_;
+      float  drift_;
+      bool   valid_;
+
+      std::vector< float > x_, y_, z_;
+      std::vector< float > restX_, restZ_;
+      std::vector< int >   triangles_;
+
+      // CSR buckets over the cells.
+      std::vector< unsigned int > vertexCell_;
+      std::vector< unsigned int > vertexStart_, vertexItems_;
+      std::vector< unsigned int > triangleStart_, triangleItems_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_REALWAVE_INDEX_H
@@ -0,0 +1,327 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_SCENE_CONTENT_HASH_H
+#define _RF_EXAMPLES_SCENE_CONTENT_HASH_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/vertex.h>
+#include <rf_sdk/sdk/face.h>
+#include <rf_sdk/sdk/object.h>
+#include <rf_sdk/sdk/pb_particle.h>
+#include <rf_sdk/sdk/pb_emitter.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+
+#include "thread_pool.h"
+#include "content_hash.h"
+#include "content_hash_manifest.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: SceneContentHash
+    // Content hashes of the scene inputs, shared by the
+    // cache producers that write a ContentHashManifest and
+    // the command that checks one. Every object hashes its
+    // global vertex positions and face indices, every
+    // particle emitter the ids, positions and velocities of
+    // its particles, and both the parameters listed by name.
+    //
+    // The SDK is only called from the calling thread: each
+    // node's parameters are hashed and its geometry or
+    // particles copied into flat buffers there, one node
+    // after the other. Only the hash passes over the buffers
+    // run on the pool, one node per task.
+    //--------------------------------------------------
+    class SceneContentHash
+    {
+    public:
+
+      // A hashed node.
+      struct NodeHash
+      {
+        NodeHash() : elements( 0 ), bytes( 0 ) {};
+
+        std::string    name;
+        ContentHash128 hash;
+        size_t         elements;
+        size_t         bytes;
+      };
+
+    public:
+
+      // parseParameters: parameter names separated by spaces.
+      static std::vector< std::string > parseParameters( const std::string& text )
+      {
+        std::vector< std::string > parameters;
+        std::istringstream names( text );
+        for ( std::string name; names >> name; )
+        {
+          parameters.push_back( name );
+        }
+        return ( parameters );
+      }
+
+      // getSettings: what the hashes cover, stored with them in the manifest.
+      static std::string getSettings( const std::vector< std::string >& parameters, bool geometry, bool particles )
+      {
+        std::stringstream settings;
+        settings << "geometry " << ( geometry ? 1 : 0 ) << " particles " << ( particles ? 1 : 0 ) << " parameters";
+        for ( size_t k = 0; k < parameters.size(); ++k )
+        {
+          settings << " " << parameters[ k ];
+        }
+        return ( settings.str() );
+      }
+
+      //--------------------------------------------------
+      // Function: hashScene
+      // One NodeHash per object, then one per emitter.
+      //--------------------------------------------------
+      static void hashScene( Scene& scene, const std::vector< std::string >& parameters, bool geometry, bool particles,
+                             ThreadPool& pool, std::vector< NodeHash >& hashes )
+      {
+        std::vector< Object >     objects;
+        std::vector< PB_Emitter > emitters;
+        scene.getObjects( objects );
+        scene.get_PB_Emitters( emitters );
+
+        const size_t numNodes = objects.size() + emitters.size();
+        std::vector< NodeBuffers > buffers( numNodes );
+        hashes.assign( numNodes, NodeHash() );
+
+        for ( size_t k = 0; k < objects.size(); ++k )
+        {
+          gatherObject( objects[ k ], parameters, geometry, buffers[ k ], hashes[ k ] );
+        }
+        for ( size_t k = 0; k < emitters.size(); ++k )
+        {
+          gatherEmitter( emitters[ k ], parameters, particles, buffers[ objects.size() + k ], hashes[ objects.size() + k ] );
+        }
+
+        pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+        pool.parallelFor( numNodes, 1, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t k = begin; k < end; ++k )
+          {
+            hashBuffers( buffers[ k ], hashes[ k ] );
+          }
+        } );
+      }
+
+      // toManifest: the hashes and their settings as a manifest holding no other node.
+      static void toManifest( const std::vector< NodeHash >& hashes, const std::string& settings, ContentHashManifest& manifest )
+      {
+        manifest.clear();
+        manifest.setSettings( settings );
+        for ( size_t k = 0; k < hashes.size(); ++k )
+        {
+          manifest.set( hashes[ k ].name, hashes[ k ].hash );
+        }
+      }
+
+    private:
+
+      //--------------------------------------------------
+      // A node gathered on the calling thread: the hasher with
+      // its kind and parameters, and the flat buffers still to
+      // hash. Objects fill "floats" with positions and "ints"
+      // with face indices, emitters "ids" and "floats" with
+      // positions and velocities.
+      //--------------------------------------------------
+      struct NodeBuffers
+      {
+        NodeBuffers() : object( true ), count( 0 ), faces( 0 ) {};
+
+        ContentHasher            hasher;
+        bool                     object;
+        size_t                   count;
+        size_t                   faces;
+        std::vector< float >     floats;
+        std::vector< int >       ints;
+        std::vector< long long > ids;
+      };
+
+      //--------------------------------------------------
+      // Function: hashParameters
+      // Name, type and value of each parameter, so a renamed
+      // or retyped parameter changes the hash too.
+      //--------------------------------------------------
+      template< class NODE >
+      static void hashParameters( NODE& node, const std::vector< std::string >& names, ContentHasher& hasher )
+      {
+        for ( size_t k = 0; k < names.size(); ++k )
+        {
+          const std::string& name = names[ k ];
+          const int type = node.getParameterType( name );
+          hasher.updateString( name );
+          hasher.updateValue( type );
+
+          switch ( type )
+          {
+            case sdk_type::PARAM_TYPE_INT:
+            case sdk_type::PARAM_TYPE_LIST:
+              hasher.updateValue( node.template getParameter< int >( name ) );
+              break;
+            case sdk_type::PARAM_TYPE_BOOL:
+              hasher.updateValue( static_cast< unsigned char >( node.template getParameter< bool >( name ) ? 1 : 0 ) );
+              break;
+            case sdk_type::PARAM_TYPE_LONG:
+              hasher.updateValue( node.template getParameter< int64_t >( name ) );
+              break;
+            case sdk_type::PARAM_TYPE_FLOAT:
+              hasher.updateValue( node.template getParameter< float >( name ) );
+              break;
+            case sdk_type::PARAM_TYPE_DOUBLE:
+              hasher.updateValue( node.template getParameter< double >( name ) );
+              break;
+            case sdk_type::PARAM_TYPE_VECTOR:
+            {
+              const Vector value = node.template getParameter< Vector >( name );
+              const float  xyz[ 3 ] = { value.getX(), value.getY(), value.getZ() };
+              hasher.update( xyz, sizeof( xyz ) );
+              break;
+            }
+            case sdk_type::PARAM_TYPE_EDIT:
+            case sdk_type::PARAM_TYPE_BROWSE:
+              hasher.updateString( node.template getParameter< std::string >( name ) );
+              break;
+            default:
+              break;
+          }
+        }
+      }
+
+      // gatherObject: parameters, then the positions and indices as two flat buffers.
+      static void gatherObject( Object& object, const std::vector< std::string >& parameters, bool geometry,
+                                NodeBuffers& buffers, NodeHash& result )
+      {
+        buffers.object = true;
+        buffers.hasher.updateString( "object" );
+        hashParameters( object, parameters, buffers.hasher );
+        result.name = object.getName();
+
+        if ( !geometry )
+        {
+          return;
+        }
+
+        ArrSdkVertex vertices;
+        ArrSdkFaces  faces;
+        object.getVertices( vertices, REF_GLOBAL );
+        object.getFaces( faces );
+
+        buffers.count = vertices.size();
+        buffers.faces = faces.size();
+        buffers.floats.resize( 3 * vertices.size() );
+        for ( size_t v = 0; v < vertices.size(); ++v )
+        {
+          const Vector position = vertices[ v ].getPosition();
+          buffers.floats[ 3 * v ]     = position.getX();
+          buffers.floats[ 3 * v + 1 ] = position.getY();
+          buffers.floats[ 3 * v + 2 ] = position.getZ();
+        }
+
+        buffers.ints.resize( 3 * faces.size() );
+        for ( size_t f = 0; f < faces.size(); ++f )
+        {
+          buffers.ints[ 3 * f ]     = faces[ f ].getI();
+          buffers.ints[ 3 * f + 1 ] = faces[ f ].getJ();
+          buffers.ints[ 3 * f + 2 ] = faces[ f ].getK();
+        }
+      }
+
+      // gatherEmitter: parameters, then ids, positions and velocities in particle order.
+      static void gatherEmitter( PB_Emitter& emitter, const std::vector< std::string >& parameters, bool particles,
+                                 NodeBuffers& buffers, NodeHash& result )
+      {
+        buffers.object = false;
+        buffers.hasher.updateString( "emitter" );
+        hashParameters( emitter, parameters, buffers.hasher );
+        result.name = emitter.getName();
+
+        if ( !particles )
+        {
+          return;
+        }
+
+        std::vector< PB_Particle > all;
+        emitter.getParticles( all );
+
+        const size_t n = all.size();
+        buffers.count = n;
+        buffers.ids.resize( n );
+        buffers.floats.resize( 6 * n );
+        for ( size_t i = 0; i < n; ++i )
+        {
+          const Vector position = all[ i ].getPosition();
+          const Vector velocity = all[ i ].getVelocity();
+          buffers.ids[ i ]            = all[ i ].getId();
+          buffers.floats[ 6 * i ]     = position.getX();
+          buffers.floats[ 6 * i + 1 ] = position.getY();
+          buffers.floats[ 6 * i + 2 ] = position.getZ();
+          buffers.floats[ 6 * i + 3 ] = velocity.getX();
+          buffers.floats[ 6 * i + 4 ] = velocity.getY();
+          buffers.floats[ 6 * i + 5 ] = velocity.getZ();
+        }
+      }
+
+      // hashBuffers: the flat buffers of a gathered node, no SDK call, run on the pool.
+      static void hashBuffers( NodeBuffers& buffers, NodeHash& result )
+      {
+        ContentHasher& hasher = buffers.hasher;
+        if ( buffers.object )
+        {
+          if ( !buffers.floats.empty() || !buffers.ints.empty() )
+          {
+            hasher.updateValue( static_cast< unsigned long long >( buffers.count ) );
+            hasher.update( buffers.floats.data(), buffers.floats.size() * sizeof( float ) );
+            hasher.updateValue( static_cast< unsigned long long >( buffers.faces ) );
+            hasher.update( buffers.ints.data(), buffers.ints.size() * sizeof( int ) );
+          }
+          result.elements = buffers.count + buffers.faces;
+          result.bytes    = buffers.floats.size() * sizeof( float ) + buffers.ints.size() * sizeof( int );
+        }
+        else
+        {
+          if ( !buffers.ids.empty() )
+          {
+            hasher.updateValue( static_cast< unsigned long long >( buffers.count ) );
+            hasher.update( buffers.ids.data(), buffers.ids.size() * sizeof( long long ) );
+            hasher.update( buffers.floats.data(), buffers.floats.size() * sizeof( float ) );
+          }
+          result.elements = buffers.count;
+          result.bytes    = buffers.ids.size() * sizeof( long long ) + buffers.floats.size() * sizeof( float );
+        }
+        result.hash = hasher.finish();
+
+        // The buffers are only needed once.
+        std::vector< float >().swap( buffers.floats );
+        std::vector< int >().swap( buffers.ints );
+        std::vector< long long >().swap( buffers.ids );
+      }
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_SCENE_CONTENT_HASH_H
@@ -0,0 +1,133 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_SCRATCH_ARENA_H
+#define _RF_EXAMPLES_SCRATCH_ARENA_H
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: ScratchArena
+    // Bump allocator for the temporaries of one operation:
+    // tables, lattices, per call buffers. allocate() hands out
+    // cache line aligned slices of large blocks and reset()
+    // takes them all back at once, keeping the blocks, so a
+    // plugin member arena stops touching the heap after the
+    // first few calls. Only for trivially copyable types, no
+    // constructors or destructors are run. Not thread safe,
+    // use one arena per thread.
+    //--------------------------------------------------
+    class ScratchArena
+    {
+      enum
+      {
+        ALIGNMENT = 64
+      };
+
+    public:
+
+      /// Constructor.
+      explicit ScratchArena( size_t blockSize = 1 << 20 ) : blockSize_( blockSize ), current_( 0 ), used_( 0 ) {};
+
+      /// Destructor.
+      ~ScratchArena( void )
+      {
+        for ( size_t b = 0; b < blocks_.size(); ++b )
+        {
+          delete [] blocks_[ b ].memory;
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: allocate
+      // "count" uninitialized T, valid until reset(). A request
+      // larger than the block size gets a block of its own.
+      //--------------------------------------------------
+      template < class T >
+      T* allocate( size_t count )
+      {
+        const size_t bytes = std::max< size_t >( count * sizeof( T ), 1 );
+
+        while ( current_ < blocks_.size() )
+        {
+          Block& block = blocks_[ current_ ];
+          const size_t offset = ( used_ + ALIGNMENT - 1 ) & ~size_t( ALIGNMENT - 1 );
+          if ( offset + bytes <= block.size )
+          {
+            used_ = offset + bytes;
+            return ( reinterpret_cast< T* >( block.data + offset ) );
+          }
+          ++current_;
+          used_ = 0;
+        }
+
+        Block block;
+        block.size   = std::max( blockSize_, bytes );
+        block.memory = new char[ block.size + ALIGNMENT ];
+        block.data   = block.memory + ( ALIGNMENT - reinterpret_cast< size_t >( block.memory ) % ALIGNMENT ) % ALIGNMENT;
+        blocks_.push_back( block );
+
+        current_ = blocks_.size() - 1;
+        used_    = bytes;
+        return ( reinterpret_cast< T* >( block.data ) );
+      }
+
+      // reset: releases every allocation, the blocks are kept.
+      void reset( void )
+      {
+        current_ = 0;
+        used_    = 0;
+      }
+
+      // getCapacity: bytes held by the blocks.
+      size_t getCapacity( void ) const
+      {
+        size_t capacity = 0;
+        for ( size_t b = 0; b < blocks_.size(); ++b )
+        {
+          capacity += blocks_[ b ].size;
+        }
+        return ( capacity );
+      }
+
+    private:
+
+      ScratchArena( const ScratchArena& );
+      ScratchArena& operator =( const ScratchArena& );
+
+    private:
+
+      struct Block
+      {
+        char*  memory;
+        char*  data;
+        size_t size;
+      };
+
+      std::vector< Block > blocks_;
+      size_t               blockSize_;
+      size_t               current_;
+      size_t               used_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_SCRATCH_ARENA_H
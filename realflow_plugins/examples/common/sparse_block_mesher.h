@@ -0,0 +1,846 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_SPARSE_BLOCK_MESHER_H
+#define _RF_EXAMPLES_SPARSE_BLOCK_MESHER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+
+#include "thread_pool.h"
+#include "flat_hash_map.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: SparseBlockMesher
+    // Triangle mesh of the surface of a particle cloud, from a
+    // density field sampled on a grid that only exists where
+    // particles are: blocks of 8x8x8 samples, found through a
+    // FlatIndexMap from block coordinates.
+    //
+    // Every particle adds ( 1 - r²/R² )³ to the samples within
+    // R, four particle radii, of it. The sum is scaled so the
+    // inside of a fluid with particles two radii apart reads
+    // about 1, and the surface is where it crosses
+    // "threshold".
+    //
+    // build() runs in these steps:
+    //
+    //   1. particles are bucketed by block, counting sort,
+    //   2. the blocks next to them that their kernels reach
+    //      are added,
+    //   3. the blocks are meshed in parallel: each one sums
+    //      its 9x9x9 samples, its own and the first layer of
+    //      the next blocks, from the particles of the 27
+    //      blocks around, in a scratch array of the thread,
+    //      and runs marching cubes over its 8x8x8 cubes,
+    //   4. the vertices are numbered block by block and the
+    //      triangles welded across block borders.
+    //
+    // A vertex sits on a grid edge and belongs to the block
+    // holding the lower end of the edge. Cubes at the far
+    // border of a block refer to vertices of the next blocks
+    // by their edge there, resolved in step 4. The shared
+    // samples add the same particles in the same order in
+    // both blocks, so both see the same crossings.
+    //
+    // Only the cubes of a block are its own; blocks inside
+    // the fluid or outside it keep nothing. Memory beyond the
+    // particles and an entry per block grows with the surface.
+    //
+    // Marching cubes cases are built, not tabled: the
+    // crossings on each cube face are joined around the
+    // inside corners, which splits ambiguous faces the same
+    // way from both cubes, and the loops this makes are
+    // fanned into triangles.
+    //--------------------------------------------------
+    class SparseBlockMesher
+    {
+    public:
+
+      // Build statistics.
+      struct Stats
+      {
+        Stats() : blocks( 0 ), surfaceBlocks( 0 ), surfaceBytes( 0 ) {};
+
+        size_t blocks;
+        size_t surfaceBlocks;
+        size_t surfaceBytes;
+      };
+
+      /// Constructor, the pool is borrowed.
+      explicit SparseBlockMesher( ThreadPool& pool )
+        : pool_( pool ), support_( 0.0f ), cellSize_( 0.0f ), threshold_( 0.0f ), numParticleBlocks_( 0 )
+      {
+        buildCases();
+      };
+
+      //--------------------------------------------------
+      // Function: build
+      // "positions" xyz per particle. The cell size is raised
+      // to an eighth of the kernel support when smaller, so the
+      // 27 blocks around a block hold every particle that
+      // reaches it. False with getError() set on bad sizes or
+      // positions too far out for the cell size.
+      //--------------------------------------------------
+      bool build( const std::vector< float >& positions, float radius, float cellSize, float threshold )
+      {
+        positions_.clear();
+        triangles_.clear();
+        error_.clear();
+        stats_ = Stats();
+
+        if ( !( radius > 0.0f ) || !( cellSize > 0.0f ) || !( threshold > 0.0f ) )
+        {
+          error_ = "radius, cell size and threshold must be positive";
+          return ( false );
+        }
+
+        support_   = SUPPORT_RADII * radius;
+        cellSize_  = std::max( cellSize, support_ / BLOCK );
+        threshold_ = threshold;
+
+        if ( !bucketParticles( positions ) )
+        {
+          error_ = "particles too far from the origin for the cell size";
+          return ( false );
+        }
+        addNeighborBlocks();
+
+        const size_t numBlocks = keys_.size();
+        stats_.blocks = numBlocks;
+
+        slot_.assign( numBlocks, static_cast< unsigned int >( NO_SURFACE ) );
+        scratch_.resize( std::max( 1u, pool_.getNumThreads() ) );
+        for ( size_t t = 0; t < scratch_.size(); ++t )
+        {
+          scratch_[ t ].surfaces.clear();
+        }
+
+        pool_.parallelFor( numBlocks, 4, [&]( size_t begin, size_t end, unsigned int thread )
+        {
+          for ( size_t b = begin; b < end; ++b )
+          {
+            meshBlock( b, thread, scratch_[ thread ] );
+          }
+        } );
+
+        weld();
+
+        for ( size_t t = 0; t < scratch_.size(); ++t )
+        {
+          std::vector< BlockSurface >().swap( scratch_[ t ].surfaces );
+        }
+        return ( true );
+      }
+
+      const std::string&          getError( void ) const        { return ( error_ ); }
+      const Stats&                getStats( void ) const        { return ( stats_ ); }
+      float                       getCellSize( void ) const     { return ( cellSize_ ); }
+      size_t                      getNumVertices( void ) const  { return ( positions_.size() / 3 ); }
+      size_t                      getNumTriangles( void ) const { return ( triangles_.size() / 3 ); }
+      const std::vector< float >& getPositions( void ) const    { return ( positions_ ); }
+      const std::vector< int >&   getTriangles( void ) const    { return ( triangles_ ); }
+
+    private:
+
+      enum
+      {
+        BLOCK         = 8,
+        SAMPLES       = BLOCK + 1,
+        BLOCK_EDGES   = 3 * BLOCK * BLOCK * BLOCK,
+        KEY_BITS      = 21,
+        SUPPORT_RADII = 4,
+        SLOT_SHIFT    = 24,
+        MAX_CASE      = 31
+      };
+
+      static const unsigned int NO_SURFACE = ~0u;
+
+      // The triangles of a block. Corners are indices into
+      // "positions", or -1 - ( direction * BLOCK_EDGES + edge )
+      // for a vertex of the next block in "direction", one bit
+      // per axis.
+      struct BlockSurface
+      {
+        BlockSurface() : vertexOffset( 0 ), triangleOffset( 0 ), dropped( 0 ) {};
+
+        std::vector< float >          positions;
+        std::vector< unsigned short > edges;
+        std::vector< int >            corners;
+        size_t                        vertexOffset;
+        size_t                        triangleOffset;
+        size_t                        dropped;
+      };
+
+      // Per thread arrays.
+      struct Scratch
+      {
+        std::vector< float >        samples;
+        std::vector< int >          owned;
+        std::vector< BlockSurface > surfaces;
+      };
+
+      //--------------------------------------------------
+      // Block keys: three biased KEY_BITS coordinates.
+      //--------------------------------------------------
+      static unsigned long long encodeKey( int bx, int by, int bz )
+      {
+        const unsigned long long bias = 1ull << ( KEY_BITS - 1 );
+        return ( ( static_cast< unsigned long long >( bx + bias ) ) |
+                 ( static_cast< unsigned long long >( by + bias ) << KEY_BITS ) |
+                 ( static_cast< unsigned long long >( bz + bias ) << ( 2 * KEY_BITS ) ) );
+      }
+
+      static void decodeKey( unsigned long long key, int* b )
+      {
+        const unsigned long long mask = ( 1ull << KEY_BITS ) - 1;
+        const int                bias = 1 << ( KEY_BITS - 1 );
+        for ( int k = 0; k < 3; ++k )
+        {
+          b[ k ] = static_cast< int >( ( key >> ( k * KEY_BITS ) ) & mask ) - bias;
+        }
+      }
+
+      // floorToInt, ceilToInt: without the library calls, for values well in int range.
+      static int floorToInt( float v )
+      {
+        const int i = static_cast< int >( v );
+        return ( v < float( i ) ? i - 1 : i );
+      }
+
+      static int ceilToInt( float v )
+      {
+        const int i = static_cast< int >( v );
+        return ( v > float( i ) ? i + 1 : i );
+      }
+
+      // floorDiv: rounds down for negative cells too.
+      static int floorDiv( int cell )
+      {
+        return ( cell >= 0 ? cell / BLOCK : -( ( -cell + BLOCK - 1 ) / BLOCK ) );
+      }
+
+      //--------------------------------------------------
+      // Function: bucketParticles
+      // Block of every particle, then a counting sort that
+      // copies the positions grouped by block into "sorted_".
+      // The particle blocks are the first in "keys_".
+      //--------------------------------------------------
+      bool bucketParticles( const std::vector< float >& positions )
+      {
+        const size_t count = positions.size() / 3;
+        const float  limit = float( ( 1 << ( KEY_BITS - 1 ) ) - 2 ) * BLOCK;
+        const float  inv   = 1.0f / cellSize_;
+
+        std::vector< unsigned long long > particleKeys( count );
+        std::atomic< bool > outOfRange( false );
+        pool_.parallelFor( count, 4096, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            int b[ 3 ];
+            for ( int k = 0; k < 3; ++k )
+            {
+              const float cell = std::floor( positions[ 3 * i + k ] * inv );
+              if ( !( std::fabs( cell ) < limit ) )
+              {
+                outOfRange.store( true );
+                b[ 0 ] = b[ 1 ] = b[ 2 ] = 0;
+                break;
+              }
+              b[ k ] = floorDiv( static_cast< int >( cell ) );
+            }
+            particleKeys[ i ] = encodeKey( b[ 0 ], b[ 1 ], b[ 2 ] );
+          }
+        } );
+        if ( outOfRange.load() )
+        {
+          return ( false );
+        }
+
+        // Counting sort: block numbers and histogram, prefix sum, scatter.
+        map_.clear();
+        keys_.clear();
+        start_.assign( 1, 0 );
+        std::vector< unsigned int > blockOf( count );
+        for ( size_t i = 0; i < count; ++i )
+        {
+          bool inserted = false;
+          const unsigned int block = map_.insert( particleKeys[ i ], static_cast< unsigned int >( keys_.size() ), inserted );
+          if ( inserted )
+          {
+            keys_.push_back( particleKeys[ i ] );
+            start_.push_back( 0 );
+          }
+          blockOf[ i ] = block;
+          ++start_[ block + 1 ];
+        }
+        std::vector< unsigned long long >().swap( particleKeys );
+
+        numParticleBlocks_ = keys_.size();
+        for ( size_t b = 0; b < numParticleBlocks_; ++b )
+        {
+          start_[ b + 1 ] += start_[ b ];
+        }
+
+        sorted_.resize( 3 * count );
+        std::vector< size_t > fill( start_.begin(), start_.end() - 1 );
+        for ( size_t i = 0; i < count; ++i )
+        {
+          const size_t k = fill[ blockOf[ i ] ]++;
+          sorted_[ 3 * k ]     = positions[ 3 * i ];
+          sorted_[ 3 * k + 1 ] = positions[ 3 * i + 1 ];
+          sorted_[ 3 * k + 2 ] = positions[ 3 * i + 2 ];
+        }
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: addNeighborBlocks
+      // The blocks around a particle block that the kernels of
+      // its particles reach, tested against the bounds of the
+      // particles. They hold no particles.
+      //--------------------------------------------------
+      void addNeighborBlocks( void )
+      {
+        std::vector< float > bounds( 6 * numParticleBlocks_ );
+        pool_.parallelFor( numParticleBlocks_, 64, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t b = begin; b < end; ++b )
+          {
+            float* lo = &bounds[ 6 * b ];
+            float* hi = lo + 3;
+            for ( int k = 0; k < 3; ++k )
+            {
+              lo[ k ] = sorted_[ 3 * start_[ b ] + k ];
+              hi[ k ] = lo[ k ];
+            }
+            for ( size_t i = start_[ b ]; i < start_[ b + 1 ]; ++i )
+            {
+              for ( int k = 0; k < 3; ++k )
+              {
+                lo[ k ] = std::min( lo[ k ], sorted_[ 3 * i + k ] );
+                hi[ k ] = std::max( hi[ k ], sorted_[ 3 * i + k ] );
+              }
+            }
+          }
+        } );
+
+        const float blockSize = BLOCK * cellSize_;
+        for ( size_t b = 0; b < numParticleBlocks_; ++b )
+        {
+          int block[ 3 ];
+          decodeKey( keys_[ b ], block );
+          const float* lo = &bounds[ 6 * b ];
+          const float* hi = lo + 3;
+
+          // Per axis, whether the kernels reach the block below and above.
+          bool reach[ 3 ][ 3 ];
+          for ( int k = 0; k < 3; ++k )
+          {
+            reach[ k ][ 0 ] = lo[ k ] - support_ <= block[ k ] * blockSize;
+            reach[ k ][ 1 ] = true;
+            reach[ k ][ 2 ] = hi[ k ] + support_ >= ( block[ k ] + 1 ) * blockSize;
+          }
+
+          for ( int dz = -1; dz <= 1; ++dz )
+          {
+            for ( int dy = -1; dy <= 1; ++dy )
+            {
+              for ( int dx = -1; dx <= 1; ++dx )
+              {
+                if ( reach[ 0 ][ dx + 1 ] && reach[ 1 ][ dy + 1 ] && reach[ 2 ][ dz + 1 ] )
+                {
+                  bool inserted = false;
+                  map_.insert( encodeKey( block[ 0 ] + dx, block[ 1 ] + dy, block[ 2 ] + dz ), static_cast< unsigned int >( keys_.size() ), inserted );
+                  if ( inserted )
+                  {
+                    keys_.push_back( encodeKey( block[ 0 ] + dx, block[ 1 ] + dy, block[ 2 ] + dz ) );
+                    start_.push_back( start_.back() );
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: meshBlock
+      // Runs on a pool thread, "b" is only touched here. The
+      // surface, if any, goes to the scratch of the thread and
+      // "slot_" tells where.
+      //--------------------------------------------------
+      void meshBlock( size_t b, unsigned int thread, Scratch& scratch )
+      {
+        int block[ 3 ];
+        decodeKey( keys_[ b ], block );
+        const int origin[ 3 ] = { block[ 0 ] * BLOCK, block[ 1 ] * BLOCK, block[ 2 ] * BLOCK };
+
+        std::vector< float >& samples = scratch.samples;
+        samples.assign( SAMPLES * SAMPLES * SAMPLES, 0.0f );
+
+        // The blocks around in key order, so shared samples add up alike.
+        const float h       = cellSize_;
+        const float support = support_;
+        float near[ 3 ];
+        float far[ 3 ];
+        for ( int k = 0; k < 3; ++k )
+        {
+          near[ k ] = origin[ k ] * h - support - h;
+          far[ k ]  = ( origin[ k ] + BLOCK ) * h + support + h;
+        }
+
+        for ( int dz = -1; dz <= 1; ++dz )
+        {
+          for ( int dy = -1; dy <= 1; ++dy )
+          {
+            for ( int dx = -1; dx <= 1; ++dx )
+            {
+              const unsigned int n = map_.find( encodeKey( block[ 0 ] + dx, block[ 1 ] + dy, block[ 2 ] + dz ) );
+              if ( n == FlatIndexMap::NOT_FOUND )
+              {
+                continue;
+              }
+
+              for ( size_t i = start_[ n ]; i < start_[ n + 1 ]; ++i )
+              {
+                // Quick bounds with a cell of slack, splat() decides.
+                const float* p = &sorted_[ 3 * i ];
+                if ( p[ 0 ] >= near[ 0 ] && p[ 0 ] <= far[ 0 ] && p[ 1 ] >= near[ 1 ] && p[ 1 ] <= far[ 1 ] && p[ 2 ] >= near[ 2 ] && p[ 2 ] <= far[ 2 ] )
+                {
+                  splat( p, origin, h, support, samples.data() );
+                }
+              }
+            }
+          }
+        }
+
+        // Nothing to mesh when every sample is on one side.
+        bool inside  = false;
+        bool outside = false;
+        for ( size_t s = 0; s < samples.size() && !( inside && outside ); ++s )
+        {
+          inside  = inside || samples[ s ] > threshold_;
+          outside = outside || !( samples[ s ] > threshold_ );
+        }
+        if ( !inside || !outside )
+        {
+          return;
+        }
+
+        BlockSurface surface;
+
+        // Own vertices, edge numbers ascending.
+        std::vector< int >& owned = scratch.owned;
+        owned.assign( BLOCK_EDGES, -1 );
+        const int step[ 3 ] = { 1, SAMPLES, SAMPLES * SAMPLES };
+        for ( int z = 0; z < BLOCK; ++z )
+        {
+          for ( int y = 0; y < BLOCK; ++y )
+          {
+            for ( int x = 0; x < BLOCK; ++x )
+            {
+              const int   s  = ( z * SAMPLES + y ) * SAMPLES + x;
+              const float v0 = samples[ s ];
+              for ( int axis = 0; axis < 3; ++axis )
+              {
+                const float v1 = samples[ s + step[ axis ] ];
+                if ( ( v0 > threshold_ ) == ( v1 > threshold_ ) )
+                {
+                  continue;
+                }
+
+                const float t = ( threshold_ - v0 ) / ( v1 - v0 );
+                float position[ 3 ] = { float( origin[ 0 ] + x ), float( origin[ 1 ] + y ), float( origin[ 2 ] + z ) };
+                position[ axis ] += t;
+
+                const int edge = ( ( z * BLOCK + y ) * BLOCK + x ) * 3 + axis;
+                owned[ edge ] = static_cast< int >( surface.edges.size() );
+                surface.edges.push_back( static_cast< unsigned short >( edge ) );
+                surface.positions.push_back( position[ 0 ] * cellSize_ );
+                surface.positions.push_back( position[ 1 ] * cellSize_ );
+                surface.positions.push_back( position[ 2 ] * cellSize_ );
+              }
+            }
+          }
+        }
+
+        // Cubes.
+        for ( int z = 0; z < BLOCK; ++z )
+        {
+          for ( int y = 0; y < BLOCK; ++y )
+          {
+            for ( int x = 0; x < BLOCK; ++x )
+            {
+              const int s = ( z * SAMPLES + y ) * SAMPLES + x;
+              int mask = 0;
+              for ( int c = 0; c < 8; ++c )
+              {
+                const float v = samples[ s + ( c & 1 ) * step[ 0 ] + ( ( c >> 1 ) & 1 ) * step[ 1 ] + ( c >> 2 ) * step[ 2 ] ];
+                mask |= ( v > threshold_ ) ? ( 1 << c ) : 0;
+              }
+
+              const int cube[ 3 ] = { x, y, z };
+              for ( const signed char* e = cases_[ mask ]; *e >= 0; ++e )
+              {
+                surface.corners.push_back( cornerRef( cube, *e, owned ) );
+              }
+            }
+          }
+        }
+
+        slot_[ b ] = ( thread << SLOT_SHIFT ) | static_cast< unsigned int >( scratch.surfaces.size() );
+        scratch.surfaces.push_back( BlockSurface() );
+        scratch.surfaces.back().positions.swap( surface.positions );
+        scratch.surfaces.back().edges.swap( surface.edges );
+        scratch.surfaces.back().corners.swap( surface.corners );
+      }
+
+      //--------------------------------------------------
+      // Function: splat
+      // Adds the kernel of the particle at "p" to the samples
+      // of the block at "origin", row by row within the chord
+      // of the kernel sphere. Every sample is computed from its
+      // global coordinates, never stepped, so two blocks that
+      // share a sample add the same value to it.
+      //--------------------------------------------------
+      static void splat( const float* p, const int* origin, float h, float support, float* samples )
+      {
+        const float inv         = 1.0f / h;
+        const float support2    = support * support;
+        const float invSupport2 = 1.0f / support2;
+        const float scale       = 315.0f / ( 512.0f * 3.14159265f );
+        const float px = p[ 0 ], py = p[ 1 ], pz = p[ 2 ];
+
+        int lo[ 3 ];
+        int hi[ 3 ];
+        for ( int k = 0; k < 3; ++k )
+        {
+          lo[ k ] = std::max( 0, ceilToInt( ( p[ k ] - support ) * inv ) - origin[ k ] );
+          hi[ k ] = std::min( int( BLOCK ), floorToInt( ( p[ k ] + support ) * inv ) - origin[ k ] );
+        }
+
+        for ( int z = lo[ 2 ]; z <= hi[ 2 ]; ++z )
+        {
+          const float rz = ( origin[ 2 ] + z ) * h - pz;
+          for ( int y = lo[ 1 ]; y <= hi[ 1 ]; ++y )
+          {
+            const float ry   = ( origin[ 1 ] + y ) * h - py;
+            const float ryz2 = ry * ry + rz * rz;
+            if ( ryz2 >= support2 )
+            {
+              continue;
+            }
+
+            const float half = std::sqrt( support2 - ryz2 );
+            const int   x0   = std::max( lo[ 0 ], ceilToInt( ( px - half ) * inv ) - origin[ 0 ] );
+            const int   x1   = std::min( hi[ 0 ], floorToInt( ( px + half ) * inv ) - origin[ 0 ] );
+            float*      row  = samples + ( z * SAMPLES + y ) * SAMPLES;
+            for ( int x = x0; x <= x1; ++x )
+            {
+              const float rx = ( origin[ 0 ] + x ) * h - px;
+              const float r2 = rx * rx + ryz2;
+              if ( r2 < support2 )
+              {
+                const float w = 1.0f - r2 * invSupport2;
+                row[ x ] += scale * w * w * w;
+              }
+            }
+          }
+        }
+      }
+
+      // cornerRef: the vertex on cube edge "e", this block's or the next one's.
+      static int cornerRef( const int* cube, int e, const std::vector< int >& owned )
+      {
+        const int axis = e / 4;
+        int lower[ 3 ] = { cube[ 0 ], cube[ 1 ], cube[ 2 ] };
+        lower[ ( axis + 1 ) % 3 ] += e & 1;
+        lower[ ( axis + 2 ) % 3 ] += ( e >> 1 ) & 1;
+
+        int direction = 0;
+        for ( int k = 0; k < 3; ++k )
+        {
+          if ( lower[ k ] == BLOCK )
+          {
+            direction |= 1 << k;
+            lower[ k ] = 0;
+          }
+        }
+
+        const int edge = ( ( lower[ 2 ] * BLOCK + lower[ 1 ] ) * BLOCK + lower[ 0 ] ) * 3 + axis;
+        return ( direction == 0 ? owned[ edge ] : -1 - ( direction * BLOCK_EDGES + edge ) );
+      }
+
+      BlockSurface& getSurface( unsigned int slot )
+      {
+        return ( scratch_[ slot >> SLOT_SHIFT ].surfaces[ slot & ( ( 1u << SLOT_SHIFT ) - 1 ) ] );
+      }
+
+      //--------------------------------------------------
+      // Function: weld
+      // Numbers the vertices in block order, so the output does
+      // not depend on the threads, then resolves the corners in
+      // parallel. A corner whose block or edge is missing, which
+      // consistent samples rule out, drops its triangle.
+      //--------------------------------------------------
+      void weld( void )
+      {
+        std::vector< size_t > order;
+        size_t numVertices  = 0;
+        size_t numTriangles = 0;
+        for ( size_t b = 0; b < slot_.size(); ++b )
+        {
+          if ( slot_[ b ] != NO_SURFACE )
+          {
+            BlockSurface& surface = getSurface( slot_[ b ] );
+            surface.vertexOffset   = numVertices;
+            surface.triangleOffset = numTriangles;
+            numVertices  += surface.edges.size();
+            numTriangles += surface.corners.size() / 3;
+            stats_.surfaceBytes += surface.positions.capacity() * sizeof( float ) + surface.edges.capacity() * sizeof( unsigned short )
+                                 + surface.corners.capacity() * sizeof( int );
+            order.push_back( b );
+          }
+        }
+        stats_.surfaceBlocks = order.size();
+
+        positions_.resize( 3 * numVertices );
+        triangles_.resize( 3 * numTriangles );
+
+        pool_.parallelFor( order.size(), 16, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t k = begin; k < end; ++k )
+          {
+            int block[ 3 ];
+            decodeKey( keys_[ order[ k ] ], block );
+            BlockSurface& surface = getSurface( slot_[ order[ k ] ] );
+            std::copy( surface.positions.begin(), surface.positions.end(), positions_.begin() + 3 * surface.vertexOffset );
+
+            int* out = &triangles_[ 3 * surface.triangleOffset ];
+            for ( size_t c = 0; c < surface.corners.size(); c += 3 )
+            {
+              int  tri[ 3 ];
+              bool valid = true;
+              for ( int j = 0; j < 3; ++j )
+              {
+                tri[ j ] = resolve( block, surface, surface.corners[ c + j ] );
+                valid    = valid && tri[ j ] >= 0;
+              }
+              if ( valid )
+              {
+                out[ 0 ] = tri[ 0 ];
+                out[ 1 ] = tri[ 1 ];
+                out[ 2 ] = tri[ 2 ];
+                out += 3;
+              }
+              else
+              {
+                ++surface.dropped;
+              }
+            }
+          }
+        } );
+
+        // Close the gaps dropped triangles left, in block order.
+        size_t dropped = 0;
+        for ( size_t k = 0; k < order.size(); ++k )
+        {
+          dropped += getSurface( slot_[ order[ k ] ] ).dropped;
+        }
+        if ( dropped > 0 )
+        {
+          size_t write = 0;
+          for ( size_t k = 0; k < order.size(); ++k )
+          {
+            const BlockSurface& surface = getSurface( slot_[ order[ k ] ] );
+            const size_t        kept    = 3 * ( surface.corners.size() / 3 - surface.dropped );
+            std::copy( triangles_.begin() + 3 * surface.triangleOffset, triangles_.begin() + 3 * surface.triangleOffset + kept, triangles_.begin() + write );
+            write += kept;
+          }
+          triangles_.resize( write );
+        }
+      }
+
+      // resolve: output vertex of a corner, -1 when not found.
+      int resolve( const int* block, const BlockSurface& surface, int ref )
+      {
+        if ( ref >= 0 )
+        {
+          return ( static_cast< int >( surface.vertexOffset ) + ref );
+        }
+
+        const int direction = ( -1 - ref ) / BLOCK_EDGES;
+        const int edge      = ( -1 - ref ) % BLOCK_EDGES;
+        const unsigned int n = map_.find( encodeKey( block[ 0 ] + ( direction & 1 ), block[ 1 ] + ( ( direction >> 1 ) & 1 ), block[ 2 ] + ( direction >> 2 ) ) );
+        if ( n == FlatIndexMap::NOT_FOUND || slot_[ n ] == NO_SURFACE )
+        {
+          return ( -1 );
+        }
+
+        const BlockSurface& next = getSurface( slot_[ n ] );
+        std::vector< unsigned short >::const_iterator it = std::lower_bound( next.edges.begin(), next.edges.end(), static_cast< unsigned short >( edge ) );
+        if ( it == next.edges.end() || *it != edge )
+        {
+          return ( -1 );
+        }
+        return ( static_cast< int >( next.vertexOffset + ( it - next.edges.begin() ) ) );
+      }
+
+      //--------------------------------------------------
+      // Function: buildCases
+      // Corner c of a cube is at ( c & 1, c >> 1 & 1, c >> 2 ).
+      // Edge e runs along axis e / 4 from the corner with the
+      // next two axes set by the bits of e % 4. Each face is
+      // walked counterclockwise from outside; an edge where the
+      // walk enters the inside corners starts a segment that
+      // ends where it leaves them. Every crossed edge starts a
+      // segment in one of its faces and ends one in the other,
+      // so the segments chain into closed loops.
+      //
+      // A loop is fanned from a corner with no chord along a
+      // face: the cube on the other side could draw the same
+      // chord, and the edge would be shared by four triangles.
+      // Every loop of every case has such a corner.
+      //--------------------------------------------------
+      void buildCases( void )
+      {
+        for ( int mask = 0; mask < 256; ++mask )
+        {
+          int next[ 12 ];
+          int faces[ 12 ] = { 0 };
+          std::fill( next, next + 12, -1 );
+
+          for ( int axis = 0; axis < 3; ++axis )
+          {
+            const int u = ( axis + 1 ) % 3;
+            const int v = ( axis + 2 ) % 3;
+            for ( int side = 0; side < 2; ++side )
+            {
+              static const int square[ 4 ][ 2 ] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+              int corners[ 4 ];
+              for ( int i = 0; i < 4; ++i )
+              {
+                const int q = side == 1 ? i : 3 - i;
+                corners[ i ] = ( side << axis ) | ( square[ q ][ 0 ] << u ) | ( square[ q ][ 1 ] << v );
+              }
+
+              int  edges[ 4 ];
+              bool in[ 4 ];
+              for ( int i = 0; i < 4; ++i )
+              {
+                edges[ i ] = cubeEdge( corners[ i ], corners[ ( i + 1 ) % 4 ] );
+                in[ i ]    = ( mask >> corners[ i ] & 1 ) != 0;
+                faces[ edges[ i ] ] |= 1 << ( 2 * axis + side );
+              }
+
+              for ( int i = 0; i < 4; ++i )
+              {
+                if ( !in[ i ] && in[ ( i + 1 ) % 4 ] )
+                {
+                  int j = ( i + 1 ) % 4;
+                  while ( !( in[ j ] && !in[ ( j + 1 ) % 4 ] ) )
+                  {
+                    j = ( j + 1 ) % 4;
+                  }
+                  next[ edges[ i ] ] = edges[ j ];
+                }
+              }
+            }
+          }
+
+          int  count = 0;
+          bool done[ 12 ] = { false };
+          for ( int e = 0; e < 12; ++e )
+          {
+            if ( next[ e ] < 0 || done[ e ] )
+            {
+              continue;
+            }
+
+            int loop[ 12 ];
+            int length = 0;
+            for ( int f = e; !done[ f ]; f = next[ f ] )
+            {
+              done[ f ] = true;
+              loop[ length++ ] = f;
+            }
+            int fan = 0;
+            for ( int chord = 2; chord + 1 < length; ++chord )
+            {
+              if ( faces[ loop[ fan ] ] & faces[ loop[ ( fan + chord ) % length ] ] )
+              {
+                ++fan;
+                chord = 1;
+              }
+            }
+            for ( int i = 1; i + 1 < length; ++i )
+            {
+              cases_[ mask ][ count++ ] = static_cast< signed char >( loop[ fan ] );
+              cases_[ mask ][ count++ ] = static_cast< signed char >( loop[ ( fan + i ) % length ] );
+              cases_[ mask ][ count++ ] = static_cast< signed char >( loop[ ( fan + i + 1 ) % length ] );
+            }
+          }
+          cases_[ mask ][ count ] = -1;
+        }
+      }
+
+      // cubeEdge: the edge between two corners one axis apart.
+      static int cubeEdge( int a, int b )
+      {
+        const int lower = std::min( a, b );
+        const int axis  = ( a ^ b ) == 1 ? 0 : ( ( a ^ b ) == 2 ? 1 : 2 );
+        return ( axis * 4 + ( lower >> ( ( axis + 1 ) % 3 ) & 1 ) + 2 * ( lower >> ( ( axis + 2 ) % 3 ) & 1 ) );
+      }
+
+      // Not copyable.
+      SparseBlockMesher( const SparseBlockMesher& );
+      SparseBlockMesher& operator=( const SparseBlockMesher& );
+
+    private:
+
+      ThreadPool& pool_;
+      signed char cases_[ 256 ][ MAX_CASE ];
+
+      float support_;
+      float cellSize_;
+      float threshold_;
+
+      FlatIndexMap                      map_;
+      std::vector< unsigned long long > keys_;
+      std::vector< size_t >             start_;
+      size_t                            numParticleBlocks_;
+      std::vector< float >              sorted_;
+      std::vector< unsigned int >       slot_;
+      std::vector< Scratch >            scratch_;
+
+      std::vector< float > positions_;
+      std::vector< int >   triangles_;
+
+      Stats       stats_;
+      std::string error_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_SPARSE_BLOCK_MESHER_H
@@ -0,0 +1,96 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_SPH_KERNELS_H
+#define _RF_EXAMPLES_SPH_KERNELS_H
+
+#include <cmath>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: SphKernels
+    // Mueller et al. 2003 smoothing kernels for support h:
+    // poly6 for densities, spiky gradient for pressure and
+    // the viscosity laplacian. Constants are folded once.
+    //--------------------------------------------------
+    class SphKernels
+    {
+    public:
+
+      /// Constructor.
+      explicit SphKernels( float h = 1.0f )
+      {
+        setSupport( h );
+      }
+
+      // setSupport
+      void setSupport( float h )
+      {
+        const float pi = 3.14159265358979f;
+        const float h3 = h * h * h;
+        const float h6 = h3 * h3;
+
+        h_         = h;
+        h2_        = h * h;
+        poly6_     = 315.0f / ( 64.0f * pi * h6 * h3 );
+        spikyGrad_ = -45.0f / ( pi * h6 );
+        viscLapl_  =  45.0f / ( pi * h6 );
+      }
+
+      float getSupport( void ) const { return ( h_ ); }
+
+      // poly6 from the squared distance.
+      float poly6( float r2 ) const
+      {
+        if ( r2 >= h2_ )
+        {
+          return ( 0.0f );
+        }
+        const float d = h2_ - r2;
+        return ( poly6_ * d * d * d );
+      }
+
+      // Spiky gradient is spikyGradFactor( r ) * ( xi - xj ).
+      float spikyGradFactor( float r ) const
+      {
+        if ( r >= h_ || r <= 1e-12f )
+        {
+          return ( 0.0f );
+        }
+        const float d = h_ - r;
+        return ( spikyGrad_ * d * d / r );
+      }
+
+      // viscosityLaplacian
+      float viscosityLaplacian( float r ) const
+      {
+        return ( r < h_ ? viscLapl_ * ( h_ - r ) : 0.0f );
+      }
+
+    private:
+
+      float h_;
+      float h2_;
+      float poly6_;
+      float spikyGrad_;
+      float viscLapl_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_SPH_KERNELS_H
@@ -0,0 +1,58 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_STOPWATCH_H
+#define _RF_EXAMPLES_STOPWATCH_H
+
+#include <chrono>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: Stopwatch
+    // Wall clock timing for the per-step reports plugins
+    // print through Scene::message.
+    //--------------------------------------------------
+    class Stopwatch
+    {
+      typedef std::chrono::high_resolution_clock Clock;
+
+    public:
+
+      /// Constructor, starts counting.
+      Stopwatch() : start_( Clock::now() ) {};
+
+      // restart
+      void restart( void )
+      {
+        start_ = Clock::now();
+      }
+
+      // getElapsedMs
+      double getElapsedMs( void ) const
+      {
+        return ( std::chrono::duration< double, std::milli >( Clock::now() - start_ ).count() );
+      }
+
+    private:
+
+      Clock::time_point start_;
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_STOPWATCH_H
@@ -0,0 +1,297 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _RF_EXAMPLES_THREAD_POOL_H
+#define _RF_EXAMPLES_THREAD_POOL_H
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: ThreadPool
+    // Persistent workers for plugin passes that run outside
+    // the engine's own per-thread callbacks ( i.e. inside
+    // preComputeInternalForces, updateWave or a command ).
+    // parallelFor() blocks until the whole range is done and
+    // the calling thread works as thread 0, so a pool of N
+    // threads keeps N - 1 workers.
+    //
+    // Keep the pool as a plugin member: the destructor joins
+    // the workers, which must not happen while a DLL unloads.
+    //--------------------------------------------------
+    class ThreadPool
+    {
+    public:
+
+      // Task( begin, end, threadIdx ) over a sub range.
+      typedef std::function< void ( size_t, size_t, unsigned int ) > RangeTask;
+
+      // Room for per-thread accumulators without false sharing.
+      static const size_t CACHE_LINE_SIZE = 64;
+
+    public:
+
+      /// Constructor.
+      explicit ThreadPool( unsigned int numThreads = 1 )
+        : numThreads_( 0 ), generation_( 0 ), stop_( false ), task_( NULL ),
+          count_( 0 ), grain_( 1 ), pending_( 0 )
+      {
+        resize( numThreads );
+      }
+
+      /// Destructor.
+      ~ThreadPool( void )
+      {
+        stopWorkers();
+      }
+
+      // getNumThreads
+      unsigned int getNumThreads( void ) const
+      {
+        return ( numThreads_ );
+      }
+
+      // resize: 0 means hardware concurrency.
+      void resize( unsigned int numThreads )
+      {
+        if ( numThreads == 0 )
+        {
+          numThreads = std::max( 1u, std::thread::hardware_concurrency() );
+        }
+
+        if ( numThreads == numThreads_ )
+        {
+          return;
+        }
+
+        stopWorkers();
+
+        numThreads_ = numThreads;
+        stop_       = false;
+
+        for ( unsigned int i = 1; i < numThreads_; ++i )
+        {
+          workers_.push_back( std::thread( &ThreadPool::workerLoop, this, i, generation_ ) );
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: parallelFor
+      // Splits [ 0, count ) in chunks of "grain" items that
+      // threads pick dynamically. Chunk boundaries are multiples
+      // of "grain". std::vector does not line align its data, so
+      // threads may still share the line at each boundary; see
+      // parallelForAligned() when that matters.
+      //--------------------------------------------------
+      void parallelFor( size_t count, size_t grain, const RangeTask& task )
+      {
+        if ( count == 0 )
+        {
+          return;
+        }
+
+        grain = std::max< size_t >( grain, 1 );
+
+        if ( numThreads_ <= 1 || count <= grain )
+        {
+          task( 0, count, 0 );
+          return;
+        }
+
+        {
+          std::unique_lock< std::mutex > lock( mutex_ );
+          task_    = &task;
+          count_   = count;
+          grain_   = grain;
+          pending_ = numThreads_ - 1;
+          next_.store( 0 );
+          ++generation_;
+        }
+        wakeUp_.notify_all();
+
+        runChunks( 0 );
+
+        std::unique_lock< std::mutex > lock( mutex_ );
+        while ( pending_ != 0 )
+        {
+          done_.wait( lock );
+        }
+        task_ = NULL;
+      }
+
+      //--------------------------------------------------
+      // Function: parallelForAligned
+      // parallelFor() over the array at "base" of "itemSize"
+      // byte items, with every chunk boundary on the first item
+      // starting a cache line. The grain is rounded up to whole
+      // line periods ( items after which the line phase repeats )
+      // and the first chunk is shortened to reach the first
+      // aligned item, so no two threads write the same line of
+      // that array. Other arrays indexed alike get no guarantee.
+      //--------------------------------------------------
+      void parallelForAligned( size_t count, size_t grain, const void* base, size_t itemSize, const RangeTask& task )
+      {
+        const size_t period = linePeriod( itemSize );
+        grain = ( std::max< size_t >( grain, 1 ) + period - 1 ) / period * period;
+
+        const size_t address = reinterpret_cast< size_t >( base );
+        size_t       head    = 0;
+        while ( head < period && ( address + head * itemSize ) % CACHE_LINE_SIZE != 0 )
+        {
+          ++head;
+        }
+        const size_t shift = ( head < period && head != 0 ) ? grain - head : 0;
+
+        parallelFor( count + shift, grain, [&]( size_t begin, size_t end, unsigned int threadIdx )
+        {
+          begin = begin > shift ? begin - shift : 0;
+          end  -= shift;
+          if ( begin < end )
+          {
+            task( begin, end, threadIdx );
+          }
+        } );
+      }
+
+      // Helper for grains: items of "itemSize" bytes per cache line.
+      static size_t itemsPerCacheLine( size_t itemSize )
+      {
+        return ( std::max< size_t >( 1, CACHE_LINE_SIZE / std::max< size_t >( itemSize, 1 ) ) );
+      }
+
+      // linePeriod: fewest items of "itemSize" bytes that fill whole cache lines.
+      static size_t linePeriod( size_t itemSize )
+      {
+        size_t a = CACHE_LINE_SIZE, b = std::max< size_t >( itemSize, 1 ) % CACHE_LINE_SIZE;
+        while ( b != 0 )
+        {
+          const size_t r = a % b;
+          a = b;
+          b = r;
+        }
+        return ( CACHE_LINE_SIZE / a );
+      }
+
+    private:
+
+      ThreadPool( const ThreadPool& );
+      void operator =( const ThreadPool& );
+
+      // runChunks
+      void runChunks( unsigned int threadIdx )
+      {
+        const RangeTask& task = *task_;
+        for ( ;; )
+        {
+          const size_t begin = next_.fetch_add( grain_ );
+          if ( begin >= count_ )
+          {
+            break;
+          }
+          task( begin, std::min( begin + grain_, count_ ), threadIdx );
+        }
+      }
+
+      // workerLoop
+      void workerLoop( unsigned int threadIdx, size_t seenGeneration )
+      {
+        for ( ;; )
+        {
+          {
+            std::unique_lock< std::mutex > lock( mutex_ );
+            while ( !stop_ && generation_ == seenGeneration )
+            {
+              wakeUp_.wait( lock );
+            }
+            if ( stop_ )
+            {
+              return;
+            }
+            seenGeneration = generation_;
+          }
+
+          runChunks( threadIdx );
+
+          std::unique_lock< std::mutex > lock( mutex_ );
+          if ( --pending_ == 0 )
+          {
+            done_.notify_one();
+          }
+        }
+      }
+
+      // stopWorkers
+      void stopWorkers( void )
+      {
+        {
+          std::unique_lock< std::mutex > lock( mutex_ );
+          stop_ = true;
+        }
+        wakeUp_.notify_all();
+
+        for ( size_t i = 0; i < workers_.size(); ++i )
+        {
+          workers_[ i ].join();
+        }
+        workers_.clear();
+        numThreads_ = 0;
+      }
+
+    private:
+
+      std::vector< std::thread > workers_;
+      unsigned int               numThreads_;
+
+      std::mutex                 mutex_;
+      std::condition_variable    wakeUp_;
+      std::condition_variable    done_;
+      size_t                     generation_;
+      bool                       stop_;
+
+      const RangeTask*           task_;
+      size_t                     count_;
+      size_t                     grain_;
+      unsigned int               pending_;
+      std::atomic< size_t >      next_;
+    };
+
+
+    //--------------------------------------------------
+    // Struct: PaddedAccumulator
+    // One per thread. Two cache lines apart, so partial sums
+    // never share a line even when the array itself is not
+    // line aligned ( std::vector does not over-align ).
+    //--------------------------------------------------
+    template < class T >
+    struct PaddedAccumulator
+    {
+      PaddedAccumulator() : value() {};
+
+      T    value;
+      char padding[ 2 * ThreadPool::CACHE_LINE_SIZE > sizeof( T ) ? 2 * ThreadPool::CACHE_LINE_SIZE - sizeof( T ) : 1 ];
+    };
+
+  } // NameSpace rf_sdk...
+} // NameSpace NextLimit...
+
+#endif // _RF_EXAMPLES_THREAD_POOL_H
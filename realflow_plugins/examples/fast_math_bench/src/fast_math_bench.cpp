@@ -0,0 +1,208 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// fast_math_bench
+// Accuracy and throughput of every FastMath tier against
+// libm. No RealFlow dependency, it runs standalone:
+//
+//   make && ./fast_math_bench
+//
+// Errors are measured against libm in double precision:
+// "ulp" is in units of the spacing of the exact result
+// rounded to float, "abs" is the plain difference.
+//--------------------------------------------------
+
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+
+#include "fast_math.h"
+#include "stopwatch.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+static const size_t NUM_SAMPLES = 1 << 20;
+static const int    NUM_RUNS    = 20;
+
+// ulpError
+static double ulpError( float approx, double exact )
+{
+  const float  rounded = float( exact );
+  const double ulp     = double( nextafterf( fabsf( rounded ), FLT_MAX ) ) - double( fabsf( rounded ) );
+  return ( fabs( double( approx ) - exact ) / ulp );
+}
+
+// uniformRange: evenly spread samples of [ lo, hi ].
+static void uniformRange( std::vector<float>& x, double lo, double hi )
+{
+  for ( size_t i = 0; i < x.size(); ++i )
+  {
+    x[ i ] = float( lo + ( hi - lo ) * ( double( i ) + 0.5 ) / double( x.size() ) );
+  }
+}
+
+// logRange: samples evenly spread in log scale.
+static void logRange( std::vector<float>& x, double lo, double hi )
+{
+  for ( size_t i = 0; i < x.size(); ++i )
+  {
+    x[ i ] = float( lo * pow( hi / lo, ( double( i ) + 0.5 ) / double( x.size() ) ) );
+  }
+}
+
+// nsPerItem: best of NUM_RUNS.
+template < class TASK >
+static double nsPerItem( size_t count, TASK task )
+{
+  double best = 1e30;
+  for ( int run = 0; run < NUM_RUNS; ++run )
+  {
+    Stopwatch watch;
+    task();
+    best = std::min( best, watch.getElapsedMs() );
+  }
+  return ( best * 1e6 / double( count ) );
+}
+
+// checksum: keeps the optimizer from dropping a timed loop.
+static volatile float sink;
+
+static void benchSinCos( const char* range, double lo, double hi )
+{
+  std::vector<float> x( NUM_SAMPLES ), s( NUM_SAMPLES ), c( NUM_SAMPLES );
+  uniformRange( x, lo, hi );
+
+  printf( "sinCos on %s\n", range );
+
+  for ( int tier = FastMath::PRECISION_FAST; tier <= FastMath::PRECISION_PRECISE; ++tier )
+  {
+    const FastMath::Precision precision = FastMath::Precision( tier );
+    FastMath::sinCos( x.data(), s.data(), c.data(), x.size(), precision );
+
+    double maxUlp = 0.0, maxAbs = 0.0;
+    for ( size_t i = 0; i < x.size(); ++i )
+    {
+      const double es = sin( double( x[ i ] ) ), ec = cos( double( x[ i ] ) );
+      maxUlp = std::max( maxUlp, std::max( ulpError( s[ i ], es ), ulpError( c[ i ], ec ) ) );
+      maxAbs = std::max( maxAbs, std::max( fabs( s[ i ] - es ), fabs( c[ i ] - ec ) ) );
+    }
+
+    const double ns = nsPerItem( x.size(), [&]() { FastMath::sinCos( x.data(), s.data(), c.data(), x.size(), precision ); } );
+    sink = s[ 7 ] + c[ 7 ];
+
+    printf( "  %-9s max %10.1f ulp  %9.2e abs  %6.2f ns\n", FastMath::getPrecisionName( precision ), maxUlp, maxAbs, ns );
+  }
+
+  const double nsFloat = nsPerItem( x.size(), [&]()
+  {
+    for ( size_t i = 0; i < x.size(); ++i ) { s[ i ] = sinf( x[ i ] ); c[ i ] = cosf( x[ i ] ); }
+  } );
+  const double nsDouble = nsPerItem( x.size(), [&]()
+  {
+    for ( size_t i = 0; i < x.size(); ++i ) { s[ i ] = float( sin( double( x[ i ] ) ) ); c[ i ] = float( cos( double( x[ i ] ) ) ); }
+  } );
+  sink = s[ 7 ] + c[ 7 ];
+
+  printf( "  libm float %31.2f ns\n  libm double %30.2f ns\n", nsFloat, nsDouble );
+}
+
+static void benchExp( void )
+{
+  std::vector<float> x( NUM_SAMPLES ), y( NUM_SAMPLES );
+  uniformRange( x, -87.0, 88.0 );
+
+  printf( "exp on [ -87, 88 ]\n" );
+
+  for ( int tier = FastMath::PRECISION_FAST; tier <= FastMath::PRECISION_PRECISE; ++tier )
+  {
+    const FastMath::Precision precision = FastMath::Precision( tier );
+    FastMath::exp( x.data(), y.data(), x.size(), precision );
+
+    double maxUlp = 0.0, maxRel = 0.0;
+    for ( size_t i = 0; i < x.size(); ++i )
+    {
+      const double e = exp( double( x[ i ] ) );
+      maxUlp = std::max( maxUlp, ulpError( y[ i ], e ) );
+      maxRel = std::max( maxRel, fabs( y[ i ] - e ) / e );
+    }
+
+    const double ns = nsPerItem( x.size(), [&]() { FastMath::exp( x.data(), y.data(), x.size(), precision ); } );
+    sink = y[ 7 ];
+
+    printf( "  %-9s max %10.1f ulp  %9.2e rel  %6.2f ns\n", FastMath::getPrecisionName( precision ), maxUlp, maxRel, ns );
+  }
+
+  const double nsFloat  = nsPerItem( x.size(), [&]() { for ( size_t i = 0; i < x.size(); ++i ) { y[ i ] = expf( x[ i ] ); } } );
+  const double nsDouble = nsPerItem( x.size(), [&]() { for ( size_t i = 0; i < x.size(); ++i ) { y[ i ] = float( exp( double( x[ i ] ) ) ); } } );
+  sink = y[ 7 ];
+
+  printf( "  libm float %31.2f ns\n  libm double %30.2f ns\n", nsFloat, nsDouble );
+}
+
+static void benchRsqrt( void )
+{
+  std::vector<float> x( NUM_SAMPLES ), y( NUM_SAMPLES );
+  logRange( x, 1e-30, 1e30 );
+
+  printf( "rsqrt on [ 1e-30, 1e30 ]\n" );
+
+  for ( int tier = FastMath::PRECISION_FAST; tier <= FastMath::PRECISION_PRECISE; ++tier )
+  {
+    const FastMath::Precision precision = FastMath::Precision( tier );
+    FastMath::rsqrt( x.data(), y.data(), x.size(), precision );
+
+    double maxUlp = 0.0, maxRel = 0.0;
+    for ( size_t i = 0; i < x.size(); ++i )
+    {
+      const double e = 1.0 / sqrt( double( x[ i ] ) );
+      maxUlp = std::max( maxUlp, ulpError( y[ i ], e ) );
+      maxRel = std::max( maxRel, fabs( y[ i ] - e ) / e );
+    }
+
+    const double ns = nsPerItem( x.size(), [&]() { FastMath::rsqrt( x.data(), y.data(), x.size(), precision ); } );
+    sink = y[ 7 ];
+
+    printf( "  %-9s max %10.1f ulp  %9.2e rel  %6.2f ns\n", FastMath::getPrecisionName( precision ), maxUlp, maxRel, ns );
+  }
+
+  const double nsFloat  = nsPerItem( x.size(), [&]() { for ( size_t i = 0; i < x.size(); ++i ) { y[ i ] = 1.0f / sqrtf( x[ i ] ); } } );
+  const double nsDouble = nsPerItem( x.size(), [&]() { for ( size_t i = 0; i < x.size(); ++i ) { y[ i ] = float( 1.0 / sqrt( double( x[ i ] ) ) ); } } );
+  sink = y[ 7 ];
+
+  printf( "  libm float %31.2f ns\n  libm double %30.2f ns\n", nsFloat, nsDouble );
+}
+
+int main( void )
+{
+#if defined( RF_FAST_MATH_AVX2 )
+  printf( "FastMath lanes: AVX2 ( 8 )\n\n" );
+#elif defined( RF_FAST_MATH_SSE2 )
+  printf( "FastMath lanes: SSE2 ( 4 )\n\n" );
+#else
+  printf( "FastMath lanes: scalar\n\n" );
+#endif
+
+  benchSinCos( "[ -PI, PI ]", -3.14159265, 3.14159265 );
+  benchSinCos( "[ -8192, 8192 ]", -8192.0, 8192.0 );
+  benchSinCos( "[ -1e5, 1e5 ]", -1e5, 1e5 );
+  benchExp();
+  benchRsqrt();
+
+  return ( 0 );
+}
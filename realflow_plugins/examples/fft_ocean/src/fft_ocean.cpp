@@ -0,0 +1,933 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/object.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/waves/waveplgsdk.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <cstring>
+
+#include "thread_pool.h"
+#include "fft.h"
+#include "stopwatch.h"
+#include "fast_math.h"
+#include "mapped_file.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+namespace nextlimit
+{
+  namespace rf_sdk
+  {
+
+    //--------------------------------------------------
+    // Class: OceanTileCache
+    // One baked tile per frame of a periodic ocean, in a
+    // memory mapped file:
+    //
+    //   Header | frame scales, 4 floats per frame | padding to
+    //   a page | per frame N x N texels of 4 int16
+    //   ( height, dx, dz, 0 ), row major.
+    //
+    // Values are stored as int16 times a per frame, per
+    // channel scale. A texel is 8 bytes, so a bilinear lookup
+    // in two frames reads at most four cache lines, and the OS
+    // only loads the pages that get sampled. The header is
+    // marked complete after every frame is written, so an
+    // interrupted bake is never read back, and the file only
+    // replaces an older bake, which another process may have
+    // mapped, once it is complete.
+    //--------------------------------------------------
+    class OceanTileCache
+    {
+    public:
+
+      enum { VERSION = 1, PAGE_SIZE = 4096, CHANNELS = 4 };
+
+      struct Header
+      {
+        char               magic[ 8 ];
+        unsigned int       version;
+        unsigned int       complete;
+        unsigned long long key;
+        unsigned int       size;
+        unsigned int       frames;
+        float              tileSize;
+        float              period;
+        unsigned long long dataOffset;
+      };
+
+    public:
+
+      /// Constructor.
+      OceanTileCache() : key_( 0 ) {};
+
+      bool               isOpen( void ) const { return ( file_.isOpen() ); }
+      unsigned long long getKey( void ) const { return ( key_ ); }
+      unsigned int       getNumFrames( void ) const { return ( header().frames ); }
+
+      // open: maps "path", false unless it is a complete cache for "key".
+      bool open( const std::string& path, unsigned long long key )
+      {
+        key_ = 0;
+        if ( !file_.openRead( path ) || file_.getSize() < sizeof( Header ) )
+        {
+          file_.close();
+          return ( false );
+        }
+
+        const Header& h = header();
+        if ( std::memcmp( h.magic, magic(), sizeof( h.magic ) ) != 0 || h.version != VERSION || !h.complete ||
+             h.key != key || h.frames == 0 || h.dataOffset != getDataOffset( h.frames ) ||
+             file_.getSize() != getFileSize( h.size, h.frames ) )
+        {
+          file_.close();
+          return ( false );
+        }
+
+        key_ = key;
+        return ( true );
+      }
+
+      // close
+      void close( void )
+      {
+        file_.close();
+        key_ = 0;
+      }
+
+      // beginBake: creates the file, frames are then written with writeFrame().
+      bool beginBake( const std::string& path, unsigned long long key, unsigned int size, unsigned int frames,
+                      float tileSize, float period )
+      {
+        key_ = 0;
+        if ( !file_.create( path, getFileSize( size, frames ) ) )
+        {
+          return ( false );
+        }
+
+        Header& h = *reinterpret_cast< Header* >( file_.getWritableData() );
+        std::memcpy( h.magic, magic(), sizeof( h.magic ) );
+        h.version    = VERSION;
+        h.complete   = 0;
+        h.key        = key;
+        h.size       = size;
+        h.frames     = frames;
+        h.tileSize   = tileSize;
+        h.period     = period;
+        h.dataOffset = getDataOffset( frames );
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: writeFrame
+      // Quantizes one transformed tile: "fieldHX" holds height
+      // and x displacement, "fieldZ" the z displacement.
+      //--------------------------------------------------
+      void writeFrame( unsigned int frame, const FftComplex* fieldHX, const FftComplex* fieldZ, ThreadPool& pool )
+      {
+        char*         base  = file_.getWritableData();
+        const Header& h     = *reinterpret_cast< const Header* >( base );
+        const size_t  texels = size_t( h.size ) * h.size;
+
+        // Per thread maxima, then the scales.
+        std::vector< float > maxima( 3 * pool.getNumThreads(), 0.0f );
+        pool.parallelFor( texels, 4096, [&]( size_t begin, size_t end, unsigned int thread )
+        {
+          float mh = 0.0f, mx = 0.0f, mz = 0.0f;
+          for ( size_t i = begin; i < end; ++i )
+          {
+            mh = std::max( mh, std::fabs( fieldHX[ i ].re ) );
+            mx = std::max( mx, std::fabs( fieldHX[ i ].im ) );
+            mz = std::max( mz, std::fabs( fieldZ[ i ].re ) );
+          }
+          float* m = &maxima[ 3 * thread ];
+          m[ 0 ] = std::max( m[ 0 ], mh );
+          m[ 1 ] = std::max( m[ 1 ], mx );
+          m[ 2 ] = std::max( m[ 2 ], mz );
+        } );
+
+        float* scales = reinterpret_cast< float* >( base + sizeof( Header ) ) + CHANNELS * frame;
+        float  inverse[ 3 ];
+        for ( int c = 0; c < 3; ++c )
+        {
+          float m = 0.0f;
+          for ( unsigned int t = 0; t < pool.getNumThreads(); ++t )
+          {
+            m = std::max( m, maxima[ 3 * t + c ] );
+          }
+          scales[ c ]  = m / 32767.0f;
+          inverse[ c ] = ( m > 0.0f ) ? 32767.0f / m : 0.0f;
+        }
+        scales[ 3 ] = 0.0f;
+
+        short* texel = reinterpret_cast< short* >( base + h.dataOffset ) + CHANNELS * texels * frame;
+        pool.parallelFor( texels, 4096, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            short* t = texel + CHANNELS * i;
+            t[ 0 ] = short( std::floor( fieldHX[ i ].re * inverse[ 0 ] + 0.5f ) );
+            t[ 1 ] = short( std::floor( fieldHX[ i ].im * inverse[ 1 ] + 0.5f ) );
+            t[ 2 ] = short( std::floor( fieldZ[ i ].re * inverse[ 2 ] + 0.5f ) );
+            t[ 3 ] = 0;
+          }
+        } );
+      }
+
+      // endBake: marks the file complete, renames it over "path" and maps it back read only.
+      bool endBake( const std::string& path )
+      {
+        Header& h = *reinterpret_cast< Header* >( file_.getWritableData() );
+        const unsigned long long key = h.key;
+
+        file_.flush();
+        h.complete = 1;
+        const bool committed = file_.commit();
+
+        return ( committed && open( path, key ) );
+      }
+
+      //--------------------------------------------------
+      // Function: sample
+      // Bilinear in space, linear in time between the two
+      // frames around "time", the loop wraps.
+      //--------------------------------------------------
+      void sample( double time, float choppiness, std::vector<Vertex>& vertices,
+                   const std::vector<Vector>& initPosVrtxs, ThreadPool& pool ) const
+      {
+        const Header& h       = header();
+        const int     n       = int( h.size );
+        const size_t  texels  = size_t( n ) * n;
+        const float   toCells = float( n ) / h.tileSize;
+
+        const double turns = time / double( h.period );
+        const double frame = ( turns - std::floor( turns ) ) * h.frames;
+        const unsigned int f0 = std::min( static_cast< unsigned int >( frame ), h.frames - 1 );
+        const unsigned int f1 = ( f0 + 1 ) % h.frames;
+        const float        tf = float( frame - double( f0 ) );
+
+        const float* scales = reinterpret_cast< const float* >( file_.getData() + sizeof( Header ) );
+        const short* data   = reinterpret_cast< const short* >( file_.getData() + h.dataOffset );
+        const short* frame0 = data + CHANNELS * texels * f0;
+        const short* frame1 = data + CHANNELS * texels * f1;
+
+        // Time weights folded into the scales.
+        float s0[ 3 ], s1[ 3 ];
+        for ( int c = 0; c < 3; ++c )
+        {
+          s0[ c ] = ( 1.0f - tf ) * scales[ CHANNELS * f0 + c ];
+          s1[ c ] = tf * scales[ CHANNELS * f1 + c ];
+        }
+        s0[ 1 ] *= choppiness; s0[ 2 ] *= choppiness;
+        s1[ 1 ] *= choppiness; s1[ 2 ] *= choppiness;
+
+        const size_t length = std::min( vertices.size(), initPosVrtxs.size() );
+
+        pool.parallelFor( length, 1024, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            const Vector& rest = initPosVrtxs[ i ];
+
+            const float u  = rest.getX() * toCells;
+            const float v  = rest.getZ() * toCells;
+            const float fu = std::floor( u );
+            const float fv = std::floor( v );
+            const float tu = u - fu;
+            const float tv = v - fv;
+
+            const int x0 = int( fu ) & ( n - 1 ), x1 = ( int( fu ) + 1 ) & ( n - 1 );
+            const int z0 = int( fv ) & ( n - 1 ), z1 = ( int( fv ) + 1 ) & ( n - 1 );
+
+            const float  w[ 4 ]   = { ( 1.0f - tu ) * ( 1.0f - tv ), tu * ( 1.0f - tv ), ( 1.0f - tu ) * tv, tu * tv };
+            const size_t cell[ 4 ] = { size_t( z0 ) * n + x0, size_t( z0 ) * n + x1, size_t( z1 ) * n + x0, size_t( z1 ) * n + x1 };
+
+            float a0[ 3 ] = { 0.0f, 0.0f, 0.0f }, a1[ 3 ] = { 0.0f, 0.0f, 0.0f };
+            for ( int k = 0; k < 4; ++k )
+            {
+              const short* t0 = frame0 + CHANNELS * cell[ k ];
+              const short* t1 = frame1 + CHANNELS * cell[ k ];
+              for ( int c = 0; c < 3; ++c )
+              {
+                a0[ c ] += w[ k ] * float( t0[ c ] );
+                a1[ c ] += w[ k ] * float( t1[ c ] );
+              }
+            }
+
+            const float height = s0[ 0 ] * a0[ 0 ] + s1[ 0 ] * a1[ 0 ];
+            const float dx     = s0[ 1 ] * a0[ 1 ] + s1[ 1 ] * a1[ 1 ];
+            const float dz     = s0[ 2 ] * a0[ 2 ] + s1[ 2 ] * a1[ 2 ];
+
+            vertices[ i ].setPosition( rest + Vector( dx, height, dz ) );
+          }
+        } );
+      }
+
+      static size_t getDataOffset( unsigned int frames )
+      {
+        const size_t bytes = sizeof( Header ) + sizeof( float ) * CHANNELS * frames;
+        return ( ( bytes + PAGE_SIZE - 1 ) / PAGE_SIZE * PAGE_SIZE );
+      }
+
+      static size_t getFileSize( unsigned int size, unsigned int frames )
+      {
+        return ( getDataOffset( frames ) + sizeof( short ) * CHANNELS * size_t( size ) * size * frames );
+      }
+
+    private:
+
+      const Header& header( void ) const
+      {
+        return ( *reinterpret_cast< const Header* >( file_.getData() ) );
+      }
+
+      static const char* magic( void )
+      {
+        return ( "RFOCEAN\0" );
+      }
+
+    private:
+
+      MappedFile         file_;
+      unsigned long long key_;
+    };
+
+
+    //--------------------------------------------------
+    // Class: FftOceanWaveSDK
+    // Tessendorf ocean. A periodic N x N tile of "TileSize"
+    // meters is synthesized every frame from a Phillips
+    // spectrum with inverse FFTs and sampled bilinearly at the
+    // rest position of every vertex, so the cost per vertex
+    // does not depend on the N^2 waves in the tile.
+    //
+    //   h( k, t ) = h0( k ) e^( -iwt ) + conj( h0( -k ) ) e^( iwt )
+    //   D( k, t ) = i k / |k| h( k, t ), w^2 = g |k|
+    //
+    // Height and the x displacement are real fields, so both
+    // go in one complex transform ( H + i Dx ), the z
+    // displacement in a second one.
+    //--------------------------------------------------
+    class FftOceanWaveSDK : public WavePlgSdk
+    {
+    public:
+
+      /// Constructor.
+      FftOceanWaveSDK() : spectrumValid( false ), failedCacheKey( 0 ), loopWarningShown( false ) {};
+
+      /// Destructor.
+      virtual ~FftOceanWaveSDK( void ) {};
+
+      /// Class id.
+      virtual NL_INT32 getClassId() const
+      {
+        return ( 1704375193 );
+      };
+
+      // getSdkVersion
+      virtual NL_INDEX32 getSdkVersion() const
+      {
+        return ( SdkVersion::SDK_VERSION );
+      }
+
+      /// Get plugin name.
+      virtual std::string getNameId() const
+      {
+        return ( "FFTOcean" );
+      };
+
+      // getCopyRight()
+      virtual std::string getCopyRight() const
+      {
+        return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+      }
+
+      // getCopyRight()
+      virtual std::string getLongDescription() const
+      {
+        return std::string( "Simulates an ocean with a periodic FFT tile ( Tessendorf )." );
+      }
+
+      // getCopyRight()
+      virtual std::string getShortDescription() const
+      {
+        return std::string( "FFT ocean." );
+      }
+
+      /// Initialize plugin, add properties, etc.
+      virtual void initialize( PlgDescriptor* plgDesc )
+      {
+        std::vector<std::string> lstNames;
+        std::vector<int>         lstValues;
+        for ( int n = 64; n <= 1024; n *= 2 )
+        {
+          std::stringstream name;
+          name << n;
+          lstNames.push_back( name.str() );
+          lstValues.push_back( n );
+        }
+
+        Ppty resolution = Ppty::createPpty( "TileResolution", lstNames, lstValues );
+        plgDesc->addPpty( resolution );
+
+        // Side of the periodic tile in scene units ( meters ).
+        Ppty tileSize = Ppty::createPpty( "TileSize", 200.0f, 1.0f );
+        plgDesc->addPpty( tileSize );
+
+        Ppty windSpeed = Ppty::createPpty( "WindSpeed", 10.0f, 0.01f );
+        plgDesc->addPpty( windSpeed );
+
+        Ppty dirWave = Ppty::createPpty( "DirWave", 20.0f );
+        plgDesc->addPpty( dirWave );
+
+        // Waves shorter than this length are damped.
+        Ppty cutoff = Ppty::createPpty( "SmallWaveCutoff", 0.1f, 0.0f );
+        plgDesc->addPpty( cutoff );
+
+        Ppty spectrumScale = Ppty::createPpty( "SpectrumScale", 1.0f, 0.0f );
+        plgDesc->addPpty( spectrumScale );
+
+        Ppty choppiness = Ppty::createPpty( "Choppiness", 1.0f, 0.0f );
+        plgDesc->addPpty( choppiness );
+
+        Ppty seed = Ppty::createPpty( "Seed", 1, 0 );
+        plgDesc->addPpty( seed );
+
+        // Accuracy of the per frame phase rotation, Balanced first as the default.
+        std::vector<std::string> lstPrecisions;
+        lstPrecisions.push_back( FastMath::getPrecisionName( FastMath::PRECISION_BALANCED ) );
+        lstPrecisions.push_back( FastMath::getPrecisionName( FastMath::PRECISION_FAST ) );
+        lstPrecisions.push_back( FastMath::getPrecisionName( FastMath::PRECISION_PRECISE ) );
+
+        std::vector<int> lstPrecisionValues;
+        lstPrecisionValues.push_back( FastMath::PRECISION_BALANCED );
+        lstPrecisionValues.push_back( FastMath::PRECISION_FAST );
+        lstPrecisionValues.push_back( FastMath::PRECISION_PRECISE );
+
+        Ppty mathPrecision = Ppty::createPpty( "MathPrecision", lstPrecisions, lstPrecisionValues );
+        plgDesc->addPpty( mathPrecision );
+
+        // > 0: every frequency is snapped to a multiple of 2 PI / LoopPeriod,
+        // so the ocean repeats every "LoopPeriod" seconds. Needed by the cache.
+        Ppty loopPeriod = Ppty::createPpty( "LoopPeriod", 0.0f, 0.0f );
+        plgDesc->addPpty( loopPeriod );
+
+        // Auto reads the cache baked for the current properties, or bakes it
+        // first. Rebake bakes once per session and property set. Both need a
+        // LoopPeriod > 0; without one the plugin says so and synthesizes.
+        std::vector<std::string> lstCacheModes;
+        lstCacheModes.push_back( "Off" );
+        lstCacheModes.push_back( "Auto" );
+        lstCacheModes.push_back( "Rebake" );
+
+        std::vector<int> lstCacheModeValues;
+        lstCacheModeValues.push_back( CACHE_OFF );
+        lstCacheModeValues.push_back( CACHE_AUTO );
+        lstCacheModeValues.push_back( CACHE_REBAKE );
+
+        Ppty cache = Ppty::createPpty( "Cache", lstCacheModes, lstCacheModeValues );
+        plgDesc->addPpty( cache );
+
+        // Tiles baked per loop, played back with linear interpolation.
+        Ppty cacheFrames = Ppty::createPpty( "CacheFrames", 128, 2, 4096 );
+        plgDesc->addPpty( cacheFrames );
+
+        // Empty: the scene root path.
+        Ppty cacheDirectory = Ppty::createPpty( "CacheDirectory", std::string( "" ), Ppty::SELECTION_DIRECTORY );
+        plgDesc->addPpty( cacheDirectory );
+
+        Ppty reportStats = Ppty::createPpty( "ReportStats", false );
+        plgDesc->addPpty( reportStats );
+      }
+
+      //#--------------------------------------------------
+      //# Function: updateWave
+      //# This function is called by the simulation engine
+      //# when it is time to update the wave.
+      //#--------------------------------------------------
+
+      virtual void updateWave( Wave* plgThis                           ,
+                               std::vector<Vertex>& vertices           ,
+                               const std::vector<Vector>& initPosVrtxs   )
+      {
+        Scene& scene = AppManager::instance()->getCurrentScene();
+        pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+
+        Stopwatch stageTime;
+
+        Settings current;
+        current.size       = plgThis->getParameter<int>  ( "TileResolution" );
+        current.tileSize   = plgThis->getParameter<float>( "TileSize" );
+        current.windSpeed  = plgThis->getParameter<float>( "WindSpeed" );
+        current.windDir    = plgThis->getParameter<float>( "DirWave" );
+        current.cutoff     = plgThis->getParameter<float>( "SmallWaveCutoff" );
+        current.scale      = plgThis->getParameter<float>( "SpectrumScale" );
+        current.seed       = plgThis->getParameter<int>  ( "Seed" );
+        current.loopPeriod = plgThis->getParameter<float>( "LoopPeriod" );
+
+        if ( !Fft2D::isPowerOfTwo( size_t( std::max( current.size, 0 ) ) ) || current.tileSize <= 0.0f )
+        {
+          return;
+        }
+
+        if ( !spectrumValid || !( current == settings ) )
+        {
+          settings         = current;
+          spectrumValid    = true;
+          loopWarningShown = false;
+          generateSpectrum();
+        }
+
+        const double spectrumMs = stageTime.getElapsedMs();
+
+        const int cacheMode = plgThis->getParameter<int>( "Cache" );
+        if ( cacheMode != CACHE_OFF && settings.loopPeriod <= 0.0f && !loopWarningShown )
+        {
+          scene.message( "FFTOcean: the cache needs a LoopPeriod > 0 to bake a loop, synthesizing every frame." );
+          loopWarningShown = true;
+        }
+        if ( cacheMode != CACHE_OFF && settings.loopPeriod > 0.0f && updateCache( plgThis, scene, cacheMode ) )
+        {
+          stageTime.restart();
+          cache.sample( double( scene.getCurrentTime() ), plgThis->getParameter<float>( "Choppiness" ), vertices, initPosVrtxs, pool );
+          const double sampleMs = stageTime.getElapsedMs();
+
+          if ( plgThis->getParameter<bool>( "ReportStats" ) )
+          {
+            std::stringstream msg;
+            msg << "FFTOcean: frame " << scene.getCurrentFrame() << ", " << settings.size << "x" << settings.size
+                << " tile from cache ( " << cache.getNumFrames() << " frames ), " << vertices.size() << " vertices, "
+                << pool.getNumThreads() << " threads, sampling " << sampleMs << " ms";
+            scene.message( msg.str() );
+          }
+          return;
+        }
+
+        stageTime.restart();
+        evolveSpectrum( double( scene.getCurrentTime() ), FastMath::Precision( plgThis->getParameter<int>( "MathPrecision" ) ) );
+        fft.inverse( fieldHX.data(), pool );
+        fft.inverse( fieldZ.data(), pool );
+        const double fftMs = stageTime.getElapsedMs();
+
+        stageTime.restart();
+        sampleTile( plgThis->getParameter<float>( "Choppiness" ), vertices, initPosVrtxs );
+        const double sampleMs = stageTime.getElapsedMs();
+
+        if ( plgThis->getParameter<bool>( "ReportStats" ) )
+        {
+          std::stringstream msg;
+          msg << "FFTOcean: frame " << scene.getCurrentFrame() << ", " << settings.size << "x" << settings.size
+              << " tile, " << vertices.size() << " vertices, " << pool.getNumThreads() << " threads, spectrum "
+              << spectrumMs << " ms, fft " << fftMs << " ms, sampling " << sampleMs << " ms";
+          scene.message( msg.str() );
+        }
+      }
+
+    protected:
+
+      struct Settings
+      {
+        int   size;
+        float tileSize;
+        float windSpeed;
+        float windDir;
+        float cutoff;
+        float scale;
+        int   seed;
+        float loopPeriod;
+
+        bool operator ==( const Settings& other ) const
+        {
+          return ( size == other.size && tileSize == other.tileSize && windSpeed == other.windSpeed &&
+                   windDir == other.windDir && cutoff == other.cutoff && scale == other.scale &&
+                   seed == other.seed && loopPeriod == other.loopPeriod );
+        }
+      };
+
+      enum CacheMode
+      {
+        CACHE_OFF  ,
+        CACHE_AUTO ,
+        CACHE_REBAKE
+      };
+
+      //--------------------------------------------------
+      // Function: updateCache
+      // Makes "cache" the baked loop of the current settings,
+      // opening or baking it as "mode" says. False when there
+      // is no cache to read, the caller then synthesizes the
+      // frame. A failed bake is not retried until the settings
+      // change.
+      //--------------------------------------------------
+      bool updateCache( Wave* plgThis, Scene& scene, int mode )
+      {
+        const unsigned int       frames = static_cast< unsigned int >( std::max( 2, plgThis->getParameter<int>( "CacheFrames" ) ) );
+        const unsigned long long key    = cacheKey( frames );
+
+        if ( cache.isOpen() && cache.getKey() == key )
+        {
+          return ( true );
+        }
+        if ( key == failedCacheKey )
+        {
+          return ( false );
+        }
+
+        std::string directory = plgThis->getParameter<std::string>( "CacheDirectory" );
+        if ( directory.empty() )
+        {
+          directory = scene.getRootPath();
+        }
+
+        std::stringstream path;
+        path << directory;
+        if ( !directory.empty() && directory[ directory.size() - 1 ] != '/' && directory[ directory.size() - 1 ] != '\\' )
+        {
+          path << "/";
+        }
+        path << "fft_ocean_" << std::hex;
+        path.width( 16 );
+        path.fill( '0' );
+        path << key << ".rfoc";
+
+        if ( mode == CACHE_AUTO && cache.open( path.str(), key ) )
+        {
+          return ( true );
+        }
+
+        Stopwatch bakeTime;
+        if ( !bakeCache( path.str(), key, frames ) )
+        {
+          cache.close();
+          failedCacheKey = key;
+          scene.message( "FFTOcean: cannot write the cache " + path.str() + ", synthesizing every frame." );
+          return ( false );
+        }
+
+        std::stringstream msg;
+        msg << "FFTOcean: baked " << frames << " frames to " << path.str() << " in " << bakeTime.getElapsedMs() << " ms";
+        scene.message( msg.str() );
+        return ( true );
+      }
+
+      //--------------------------------------------------
+      // Function: bakeCache
+      // One loop, "frames" evenly spaced tiles, each through the
+      // same synthesis as a live frame at the Precise tier.
+      //--------------------------------------------------
+      bool bakeCache( const std::string& path, unsigned long long key, unsigned int frames )
+      {
+        if ( !cache.beginBake( path, key, static_cast< unsigned int >( settings.size ), frames, settings.tileSize, settings.loopPeriod ) )
+        {
+          return ( false );
+        }
+
+        for ( unsigned int frame = 0; frame < frames; ++frame )
+        {
+          evolveSpectrum( double( settings.loopPeriod ) * frame / frames, FastMath::PRECISION_PRECISE );
+          fft.inverse( fieldHX.data(), pool );
+          fft.inverse( fieldZ.data(), pool );
+          cache.writeFrame( frame, fieldHX.data(), fieldZ.data(), pool );
+        }
+
+        return ( cache.endBake( path ) );
+      }
+
+      //--------------------------------------------------
+      // Function: cacheKey
+      // FNV-1a of everything a baked tile depends on. Choppiness
+      // is applied when sampling and is not part of it.
+      //--------------------------------------------------
+      unsigned long long cacheKey( unsigned int frames ) const
+      {
+        unsigned long long hash = 14695981039346656037ull;
+
+        const unsigned int version = OceanTileCache::VERSION;
+        hashValue( hash, version );
+        hashValue( hash, settings.size );
+        hashValue( hash, settings.tileSize );
+        hashValue( hash, settings.windSpeed );
+        hashValue( hash, settings.windDir );
+        hashValue( hash, settings.cutoff );
+        hashValue( hash, settings.scale );
+        hashValue( hash, settings.seed );
+        hashValue( hash, settings.loopPeriod );
+        hashValue( hash, frames );
+        return ( hash );
+      }
+
+      // hashValue: adds the bytes of "value" to an FNV-1a hash.
+      template< class T >
+      static void hashValue( unsigned long long& hash, const T& value )
+      {
+        const unsigned char* bytes = reinterpret_cast< const unsigned char* >( &value );
+        for ( size_t i = 0; i < sizeof( T ); ++i )
+        {
+          hash = ( hash ^ bytes[ i ] ) * 1099511628211ull;
+        }
+      }
+
+      // PI_D
+      static double PI_D()
+      {
+        return ( 3.14159265358979323846 );
+      }
+
+      // gravity
+      static double gravity()
+      {
+        return ( 9.81 );
+      }
+
+      //--------------------------------------------------
+      // Function: generateSpectrum
+      // h0( k ) = ( xr + i xi ) / 2 sqrt( P( k ) ) dk, with xr, xi
+      // normal deviates and the saturated Phillips spectrum
+      //
+      //   P( k ) = a / 2 k^-4 exp( -1 / ( k L )^2 ) exp( -( k l )^2 ) D( theta ),
+      //
+      // a = 0.0081, L = U^2 / g, D = 2 / PI cos^2 downwind and
+      // 0 upwind. The k = 0 and Nyquist rows carry no energy,
+      // so every field stays real. With a loop period w is
+      // rounded to the nearest multiple of 2 PI / period.
+      //--------------------------------------------------
+      void generateSpectrum( void )
+      {
+        const size_t n      = size_t( settings.size );
+        const double dk     = 2.0 * PI_D() / double( settings.tileSize );
+        const double L      = double( settings.windSpeed ) * double( settings.windSpeed ) / gravity();
+        const double l      = double( settings.cutoff );
+        const double angle  = double( settings.windDir ) * PI_D() / 180.0;
+        const double windX  = std::cos( angle );
+        const double windZ  = std::sin( angle );
+        const double alpha  = 0.0081;
+
+        // Frequencies of a loop of "loopPeriod" seconds.
+        const double loopOmega = ( settings.loopPeriod > 0.0f ) ? 2.0 * PI_D() / double( settings.loopPeriod ) : 0.0;
+
+        fft.setSize( n );
+
+        h0.assign( n * n, FftComplex() );
+        h0MinusConj.resize( n * n );
+        omega.resize( n * n );
+        dirX.resize( n * n );
+        dirZ.resize( n * n );
+        fieldHX.resize( n * n );
+        fieldZ.resize( n * n );
+
+        std::mt19937 random( static_cast< unsigned int >( settings.seed ) );
+
+        for ( size_t jz = 0; jz < n; ++jz )
+        {
+          for ( size_t jx = 0; jx < n; ++jx )
+          {
+            const size_t idx = jz * n + jx;
+
+            // Deviates drawn for every mode, so the sequence does not depend on the wind.
+            const double xr = gaussian( random );
+            const double xi = gaussian( random );
+
+            const double kx = dk * double( waveIndex( jx, n ) );
+            const double kz = dk * double( waveIndex( jz, n ) );
+            const double k  = std::sqrt( kx * kx + kz * kz );
+
+            omega[ idx ] = std::sqrt( gravity() * k );
+            if ( loopOmega > 0.0 )
+            {
+              omega[ idx ] = loopOmega * std::floor( omega[ idx ] / loopOmega + 0.5 );
+            }
+            dirX[ idx ]  = ( k > 0.0 ) ? float( kx / k ) : 0.0f;
+            dirZ[ idx ]  = ( k > 0.0 ) ? float( kz / k ) : 0.0f;
+
+            if ( k == 0.0 || jx == n / 2 || jz == n / 2 )
+            {
+              continue;
+            }
+
+            const double cosTheta = ( kx * windX + kz * windZ ) / k;
+            if ( cosTheta <= 0.0 )
+            {
+              continue;
+            }
+
+            const double kL      = k * L;
+            const double phillips = 0.5 * alpha / ( k * k * k * k ) * std::exp( -1.0 / ( kL * kL ) )
+                                  * std::exp( -k * k * l * l ) * ( 2.0 / PI_D() ) * cosTheta * cosTheta;
+
+            const double a = 0.5 * settings.scale * std::sqrt( phillips ) * dk;
+            h0[ idx ] = FftComplex( float( xr * a ), float( xi * a ) );
+          }
+        }
+
+        for ( size_t jz = 0; jz < n; ++jz )
+        {
+          for ( size_t jx = 0; jx < n; ++jx )
+          {
+            const size_t minus = ( ( n - jz ) % n ) * n + ( n - jx ) % n;
+            h0MinusConj[ jz * n + jx ] = h0[ minus ].conj();
+          }
+        }
+      }
+
+      //--------------------------------------------------
+      // Function: evolveSpectrum
+      // Fills the two transforms for "time". The phases w t are
+      // reduced in double before going to float, then every row
+      // of phases goes through FastMath in one call.
+      //--------------------------------------------------
+      void evolveSpectrum( double time, FastMath::Precision precision )
+      {
+        const size_t n        = size_t( settings.size );
+        const double inv2PI   = 1.0 / ( 2.0 * PI_D() );
+
+        phaseSin.resize( n * n );
+        phaseCos.resize( n * n );
+
+        pool.parallelFor( n, 8, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t idx = begin * n; idx < end * n; ++idx )
+          {
+            const double turns = omega[ idx ] * time * inv2PI;
+            phaseCos[ idx ] = float( 2.0 * PI_D() * ( turns - std::floor( turns ) ) );
+          }
+
+          FastMath::sinCos( &phaseCos[ begin * n ], &phaseSin[ begin * n ], &phaseCos[ begin * n ], ( end - begin ) * n, precision );
+
+          for ( size_t idx = begin * n; idx < end * n; ++idx )
+          {
+            const float c = phaseCos[ idx ], s = phaseSin[ idx ];
+
+            const FftComplex h = h0[ idx ] * FftComplex( c, -s ) + h0MinusConj[ idx ] * FftComplex( c, s );
+
+            // H + i Dx = h + i ( i dirX h ) = ( 1 - dirX ) h.
+            fieldHX[ idx ] = h * ( 1.0f - dirX[ idx ] );
+            fieldZ[ idx ]  = FftComplex( -h.im, h.re ) * dirZ[ idx ];
+          }
+        } );
+      }
+
+      //--------------------------------------------------
+      // Function: sampleTile
+      // Bilinear lookup of the periodic tile at every rest
+      // position, vertices in parallel.
+      //--------------------------------------------------
+      void sampleTile( const float choppiness, std::vector<Vertex>& vertices, const std::vector<Vector>& initPosVrtxs )
+      {
+        const size_t length   = std::min( vertices.size(), initPosVrtxs.size() );
+        const int    n        = settings.size;
+        const float  toCells  = float( n ) / settings.tileSize;
+
+        pool.parallelFor( length, 1024, [&]( size_t begin, size_t end, unsigned int )
+        {
+          for ( size_t i = begin; i < end; ++i )
+          {
+            const Vector& rest = initPosVrtxs[ i ];
+
+            const float u  = rest.getX() * toCells;
+            const float v  = rest.getZ() * toCells;
+            const float fu = std::floor( u );
+            const float fv = std::floor( v );
+            const float tu = u - fu;
+            const float tv = v - fv;
+
+            const int x0 = wrap( int( fu ), n ), x1 = wrap( int( fu ) + 1, n );
+            const int z0 = wrap( int( fv ), n ), z1 = wrap( int( fv ) + 1, n );
+
+            const float w00 = ( 1.0f - tu ) * ( 1.0f - tv ), w10 = tu * ( 1.0f - tv );
+            const float w01 = ( 1.0f - tu ) * tv,            w11 = tu * tv;
+
+            const FftComplex& a00 = fieldHX[ z0 * n + x0 ];
+            const FftComplex& a10 = fieldHX[ z0 * n + x1 ];
+            const FftComplex& a01 = fieldHX[ z1 * n + x0 ];
+            const FftComplex& a11 = fieldHX[ z1 * n + x1 ];
+
+            const float height = w00 * a00.re + w10 * a10.re + w01 * a01.re + w11 * a11.re;
+            const float dx     = w00 * a00.im + w10 * a10.im + w01 * a01.im + w11 * a11.im;
+            const float dz     = w00 * fieldZ[ z0 * n + x0 ].re + w10 * fieldZ[ z0 * n + x1 ].re +
+                                 w01 * fieldZ[ z1 * n + x0 ].re + w11 * fieldZ[ z1 * n + x1 ].re;
+
+            vertices[ i ].setPosition( rest + Vector( choppiness * dx, height, choppiness * dz ) );
+          }
+        } );
+      }
+
+      // waveIndex: grid index to signed wave number, [ -N/2, N/2 ).
+      static int waveIndex( size_t j, size_t n )
+      {
+        return ( j < n / 2 ? int( j ) : int( j ) - int( n ) );
+      }
+
+      // wrap: periodic cell index.
+      static int wrap( int i, int n )
+      {
+        return ( i & ( n - 1 ) );
+      }
+
+      // gaussian: Box-Muller over the raw generator, same sequence on every platform.
+      static double gaussian( std::mt19937& random )
+      {
+        const double u1 = ( double( random() ) + 1.0 ) * ( 1.0 / 4294967297.0 );
+        const double u2 = double( random() ) * ( 1.0 / 4294967296.0 );
+        return ( std::sqrt( -2.0 * std::log( u1 ) ) * std::cos( 2.0 * PI_D() * u2 ) );
+      }
+
+    protected:
+
+      ThreadPool pool;
+      Fft2D      fft;
+
+      Settings   settings;
+      bool       spectrumValid;
+
+      // Per wave vector, row major [ kz ][ kx ].
+      std::vector< FftComplex > h0;
+      std::vector< FftComplex > h0MinusConj;
+      std::vector< double >     omega;
+      std::vector< float >      dirX, dirZ;
+
+      // Per frame sin / cos of w t.
+      std::vector< float >      phaseSin, phaseCos;
+
+      // Transformed in place: ( height, dx ) and ( dz, 0 ).
+      std::vector< FftComplex > fieldHX;
+      std::vector< FftComplex > fieldZ;
+
+      // Baked loop.
+      OceanTileCache     cache;
+      unsigned long long failedCacheKey;
+      bool               loopWarningShown;
+    };
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_WAVE_PLUGIN( FftOceanWaveSDK );
+
+/////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,573 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/daemon.h>
+#include <rf_sdk/sdk/object.h>
+#include <rf_sdk/sdk/nodeaccesor.h>
+#include <rf_sdk/sdk/pb_particle.h>
+#include <rf_sdk/sdk/pb_emitter.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/daemons/daemonplgsdk.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "thread_pool.h"
+#include "neighbor_grid.h"
+#include "sph_kernels.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+//--------------------------------------------------
+// Heat transfer daemon.
+//
+// Temperature diffuses between neighbor particles with SPH
+// laplacian weights, w_ij = V * lapl W( r_ij ), and towards
+// the "HotObjects" temperature for particles close to their
+// bounding boxes:
+//
+//   dT_i/dt = a * sum_j w_ij ( T_j - T_i ) + k_i ( T_obj - T_i )
+//
+// Explicit mode takes forward Euler substeps, as many as the
+// fastest particle rate needs to stay stable. Implicit mode
+// solves the backward Euler system with Jacobi iterations,
+// which stays stable for any time step. Explicit steps that
+// would need more than MAX_EXPLICIT_SUBSTEPS fall back to the
+// implicit solve, reported once per simulation.
+//
+// Daemons are not handed the solver time step, so the step is
+// the scene time elapsed since the daemon last ran for the
+// emitter, or since the simulation began or resumed.
+//
+// The daemon is not MT: the engine calls it once per emitter
+// and step, it builds the neighbor grid once and runs every
+// pass on its own thread pool over two temperature buffers.
+//--------------------------------------------------
+class HeatDiffusionDaemonSDK : public DaemonPlgSdk
+{
+
+  enum SolverType
+  {
+    SOLVER_EXPLICIT ,
+    SOLVER_IMPLICIT
+  };
+
+  // Explicit substeps per step; beyond it the step is solved implicitly.
+  enum
+  {
+    MAX_EXPLICIT_SUBSTEPS = 64
+  };
+
+  // Bounding box of a hot object.
+  struct HotBox
+  {
+    Vector boundsMin;
+    Vector boundsMax;
+  };
+
+  public:
+
+  /// Constructor.
+  HeatDiffusionDaemonSDK() : resumeTime( 0.0f ), resumed( false ), fallbackReported( false ) {};
+
+  /// Destructor.
+  virtual ~HeatDiffusionDaemonSDK() {};
+
+  /// Class id.
+  virtual NL_INT32 getClassId() const
+  {
+    return ( 1672508601 );
+  };
+
+  // getSdkVersion
+  virtual NL_INDEX32 getSdkVersion() const
+  {
+    return ( SdkVersion::SDK_VERSION );
+  }
+
+  /// Threads are managed by the daemon itself.
+  virtual bool isMT( void ) const { return NL_false; };
+
+  /// Get plugin name.
+  virtual std::string getNameId() const
+  {
+    return ( "HeatDiffusion" );
+  };
+
+  // getCopyRight()
+  virtual std::string getCopyRight() const
+  {
+    return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+  }
+
+  // getCopyRight()
+  virtual std::string getLongDescription() const
+  {
+    return std::string( "Diffuses particle temperature between neighbors and from hot objects." );
+  }
+
+  // getCopyRight()
+  virtual std::string getShortDescription() const
+  {
+    return std::string( "Heat diffusion" );
+  }
+
+  /// Initialize plugin, add properties, etc.
+  virtual void initialize( PlgDescriptor* plgDesc )
+  {
+    // Thermal diffusivity between particles.
+    Ppty diffusivity = Ppty::createPpty( "Diffusivity", 0.01f, 0.0f );
+    plgDesc->addPpty( diffusivity );
+
+    // 0 means twice the mean spacing given by the emitter "Resolution".
+    Ppty radius = Ppty::createPpty( "Radius", 0.0f, 0.0f );
+    plgDesc->addPpty( radius );
+
+    std::vector<std::string> lstNames;
+    lstNames.push_back( "Explicit" );
+    lstNames.push_back( "Implicit" );
+
+    std::vector<int> lstValues;
+    lstValues.push_back( SOLVER_EXPLICIT );
+    lstValues.push_back( SOLVER_IMPLICIT );
+
+    Ppty solver = Ppty::createPpty( "Solver", lstNames, lstValues );
+    plgDesc->addPpty( solver );
+
+    Ppty jacobiIterations = Ppty::createPpty( "JacobiIterations", 20, 1 );
+    plgDesc->addPpty( jacobiIterations );
+
+    // Largest temperature change between Jacobi sweeps that stops the solve.
+    Ppty jacobiTolerance = Ppty::createPpty( "JacobiTolerance", 0.001f, 0.0f );
+    plgDesc->addPpty( jacobiTolerance );
+
+    std::vector<std::string> noNodes;
+    Ppty hotObjects = Ppty::createPpty( "HotObjects", noNodes, node_type::TYPE_OBJECT, Ppty::SELECTION_MULTIPLE );
+    plgDesc->addPpty( hotObjects );
+
+    Ppty objectTemperature = Ppty::createPpty( "ObjectTemperature", 373.0f );
+    plgDesc->addPpty( objectTemperature );
+
+    // Exchange rate with the objects ( 1/s ) and the distance it fades over.
+    Ppty objectTransfer = Ppty::createPpty( "ObjectTransfer", 1.0f, 0.0f );
+    plgDesc->addPpty( objectTransfer );
+
+    Ppty objectRange = Ppty::createPpty( "ObjectRange", 0.1f, 0.0f );
+    plgDesc->addPpty( objectRange );
+  }
+
+  virtual void applyForceToEmitter( Daemon* thisPlg, PB_Emitter* emitter, PB_Emitter::iterator iter )
+  {
+    applyForceToEmitter( thisPlg, emitter, 0, iter );
+  }
+
+  //--------------------------------------------------
+  //  Function: applyForceToEmitter
+  //  Called once per step and emitter ( isMT() is false ).
+  //  No force is applied, only temperatures change.
+  //--------------------------------------------------
+  virtual void applyForceToEmitter( Daemon* thisPlg, PB_Emitter* emitter, int nThread, PB_Emitter::iterator iter )
+  {
+    NL_VARIABLE_MAYBE_NOT_REFERENCED2( nThread, iter );
+
+    Scene& scene = AppManager::instance()->getCurrentScene();
+    pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+
+    const float dt = stepTime( scene, emitter->getId() );
+
+    const float diffusivity      = thisPlg->getParameter<float>( "Diffusivity" );
+    const float userRadius       = thisPlg->getParameter<float>( "Radius" );
+    const int   solver           = thisPlg->getParameter<int>  ( "Solver" );
+    const int   jacobiIterations = thisPlg->getParameter<int>  ( "JacobiIterations" );
+    const float jacobiTolerance  = thisPlg->getParameter<float>( "JacobiTolerance" );
+
+    emitter->getParticles( particles );
+    const size_t n = particles.size();
+    if ( n == 0 || dt <= 0.0f )
+    {
+      return;
+    }
+
+    float resolution = emitter->getParameter<float>( "Resolution" );
+    if ( resolution <= 0.0f )
+    {
+      resolution = 1.0f;
+    }
+    const float spacing = 0.1f / resolution;
+    const float h       = ( userRadius > 0.0f ) ? userRadius : 2.0f * spacing;
+    kernels.setSupport( h );
+
+    gatherParticles();
+
+    grid.build( px.data(), py.data(), pz.data(), n, h, pool );
+    grid.buildNeighborLists( px.data(), py.data(), pz.data(), h, pool );
+
+    computeObjectRates( thisPlg );
+
+    const float volume = spacing * spacing * spacing;
+    const float alphaDt = diffusivity * volume * dt;
+
+    bool implicit = ( solver == SOLVER_IMPLICIT );
+    if ( !implicit && !stepExplicit( alphaDt, dt ) )
+    {
+      if ( !fallbackReported )
+      {
+        std::stringstream msg;
+        msg << "HeatDiffusion: explicit steps need more than " << int( MAX_EXPLICIT_SUBSTEPS )
+            << " substeps to stay stable, solving them implicitly";
+        scene.message( msg.str() );
+        fallbackReported = true;
+      }
+      implicit = true;
+    }
+
+    if ( implicit )
+    {
+      solveImplicit( alphaDt, dt, jacobiIterations, jacobiTolerance );
+    }
+
+    pool.parallelFor( n, 1024, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        particles[ i ].setTemperature( temperature[ i ] );
+      }
+    } );
+  }
+
+  //--------------------------------------------------
+  // Function: onSimulationBegin
+  // Forgets the last step times, so the first step after a
+  // reset does not see a negative time step, and measures
+  // the first step from here.
+  //--------------------------------------------------
+  virtual void onSimulationBegin( Daemon* plgThis )
+  {
+    NL_VARIABLE_MAYBE_NOT_REFERENCED( plgThis );
+    restartClock();
+    fallbackReported = false;
+  }
+
+  // onSimulationResume
+  virtual void onSimulationResume( Daemon* plgThis )
+  {
+    NL_VARIABLE_MAYBE_NOT_REFERENCED( plgThis );
+    restartClock();
+  }
+
+  protected:
+
+  // restartClock: step times are measured from the current time.
+  void restartClock( void )
+  {
+    lastTimes.clear();
+    resumeTime = AppManager::instance()->getCurrentScene().getCurrentTime();
+    resumed    = true;
+  }
+
+  //--------------------------------------------------
+  // Function: stepTime
+  // Scene time elapsed since the last call for the emitter,
+  // or since the simulation began for its first call. 0 when
+  // the time did not advance, or for a first call with no
+  // start time, so no step ever gets a whole frame of
+  // diffusion it did not simulate.
+  //--------------------------------------------------
+  float stepTime( Scene& scene, const int emitterId )
+  {
+    const float currTime = scene.getCurrentTime();
+
+    std::map< int, float >::iterator last = lastTimes.find( emitterId );
+    float dt = 0.0f;
+    if ( last != lastTimes.end() )
+    {
+      dt = currTime - last->second;
+    }
+    else if ( resumed )
+    {
+      dt = currTime - resumeTime;
+    }
+
+    lastTimes[ emitterId ] = currTime;
+    return ( std::max( dt, 0.0f ) );
+  }
+
+  // gatherParticles
+  void gatherParticles( void )
+  {
+    const size_t n = particles.size();
+
+    px.resize( n ); py.resize( n ); pz.resize( n );
+    temperature.resize( n );
+    nextTemperature.resize( n );
+    objectRate.resize( n );
+
+    pool.parallelFor( n, 1024, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        const Vector position = particles[ i ].getPosition();
+        px[ i ] = position.getX(); py[ i ] = position.getY(); pz[ i ] = position.getZ();
+        temperature[ i ] = particles[ i ].getTemperature();
+      }
+    } );
+  }
+
+  //--------------------------------------------------
+  // Function: computeObjectRates
+  // k_i: "ObjectTransfer" fading linearly to 0 at "ObjectRange"
+  // from the nearest hot object bounding box.
+  //--------------------------------------------------
+  void computeObjectRates( Daemon* thisPlg )
+  {
+    const float transfer = thisPlg->getParameter<float>( "ObjectTransfer" );
+    const float range    = thisPlg->getParameter<float>( "ObjectRange" );
+    objectTemperature    = thisPlg->getParameter<float>( "ObjectTemperature" );
+
+    hotBoxes.clear();
+    ArrSdkNodeAccesors nodes = thisPlg->getParameter<ArrSdkNodeAccesors>( "HotObjects" );
+    for ( size_t k = 0; k < nodes.size(); ++k )
+    {
+      if ( nodes[ k ].isNull() || nodes[ k ].getType() != node_type::TYPE_OBJECT )
+      {
+        continue;
+      }
+
+      const std::pair< Vector, Vector > bounds = nodes[ k ].asRFObject().getBoundingBox();
+      HotBox box;
+      box.boundsMin = bounds.first;
+      box.boundsMax = bounds.second;
+      hotBoxes.push_back( box );
+    }
+
+    const bool active = !hotBoxes.empty() && transfer > 0.0f && range > 0.0f;
+
+    pool.parallelFor( particles.size(), 4096, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        float rate = 0.0f;
+        if ( active )
+        {
+          float nearest = range;
+          for ( size_t k = 0; k < hotBoxes.size(); ++k )
+          {
+            nearest = std::min( nearest, boxDistance( hotBoxes[ k ], px[ i ], py[ i ], pz[ i ] ) );
+          }
+          rate = transfer * ( 1.0f - nearest / range );
+        }
+        objectRate[ i ] = rate;
+      }
+    } );
+  }
+
+  // boxDistance: 0 inside the box.
+  static float boxDistance( const HotBox& box, float x, float y, float z )
+  {
+    const float dx = std::max( std::max( box.boundsMin.getX() - x, x - box.boundsMax.getX() ), 0.0f );
+    const float dy = std::max( std::max( box.boundsMin.getY() - y, y - box.boundsMax.getY() ), 0.0f );
+    const float dz = std::max( std::max( box.boundsMin.getZ() - z, z - box.boundsMax.getZ() ), 0.0f );
+    return ( std::sqrt( dx * dx + dy * dy + dz * dz ) );
+  }
+
+  // weight: w_ij / V, symmetric.
+  float weight( size_t i, unsigned int j ) const
+  {
+    const float dx = px[ i ] - px[ j ], dy = py[ i ] - py[ j ], dz = pz[ i ] - pz[ j ];
+    return ( kernels.viscosityLaplacian( std::sqrt( dx * dx + dy * dy + dz * dz ) ) );
+  }
+
+  //--------------------------------------------------
+  // Function: stepExplicit
+  // Forward Euler keeps every new temperature a convex mix of
+  // old ones while dt ( a sum w_ij + k_i ) <= 1, so the step is
+  // split into as many substeps as the fastest particle needs.
+  // Returns false, without stepping, when that is more than
+  // MAX_EXPLICIT_SUBSTEPS.
+  //--------------------------------------------------
+  bool stepExplicit( const float alphaDt, const float dt )
+  {
+    const size_t n = particles.size();
+    std::vector< PaddedAccumulator< float > > maxRate( pool.getNumThreads() );
+
+    pool.parallelFor( n, 1024, [&]( size_t begin, size_t end, unsigned int thread )
+    {
+      float rate = 0.0f;
+      for ( size_t i = begin; i < end; ++i )
+      {
+        float sumWeights = 0.0f;
+        for ( const unsigned int* j = grid.getNeighborsBegin( i ), *last = grid.getNeighborsEnd( i ); j != last; ++j )
+        {
+          sumWeights += weight( i, *j );
+        }
+        rate = std::max( rate, alphaDt * sumWeights + dt * objectRate[ i ] );
+      }
+      maxRate[ thread ].value = std::max( maxRate[ thread ].value, rate );
+    } );
+
+    float stepRate = 0.0f;
+    for ( size_t t = 0; t < maxRate.size(); ++t )
+    {
+      stepRate = std::max( stepRate, maxRate[ t ].value );
+    }
+
+    if ( stepRate > float( MAX_EXPLICIT_SUBSTEPS ) )
+    {
+      return ( false );
+    }
+
+    const int   substeps = std::max( 1, int( std::ceil( stepRate ) ) );
+    const float fraction = 1.0f / float( substeps );
+    for ( int s = 0; s < substeps; ++s )
+    {
+      substepExplicit( alphaDt * fraction, dt * fraction );
+    }
+    return ( true );
+  }
+
+  // substepExplicit: one forward Euler step, reads temperature, writes nextTemperature.
+  void substepExplicit( const float alphaDt, const float dt )
+  {
+    pool.parallelFor( particles.size(), 1024, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        const float ti = temperature[ i ];
+
+        float flux = 0.0f;
+        for ( const unsigned int* j = grid.getNeighborsBegin( i ), *last = grid.getNeighborsEnd( i ); j != last; ++j )
+        {
+          flux += weight( i, *j ) * ( temperature[ *j ] - ti );
+        }
+
+        nextTemperature[ i ] = ti + alphaDt * flux + dt * objectRate[ i ] * ( objectTemperature - ti );
+      }
+    } );
+
+    temperature.swap( nextTemperature );
+  }
+
+  //--------------------------------------------------
+  // Function: solveImplicit
+  // Backward Euler,
+  //   ( 1 + a dt sum w_ij + dt k_i ) T'_i - a dt sum w_ij T'_j
+  //     = T_i + dt k_i T_obj,
+  // by Jacobi sweeps. The system is diagonally dominant, so
+  // the sweeps converge. The diagonal is computed once; the
+  // sweeps ping-pong between the two buffers while the right
+  // hand side keeps the step's initial temperatures.
+  //--------------------------------------------------
+  void solveImplicit( const float alphaDt, const float dt, const int iterations, const float tolerance )
+  {
+    const size_t n = particles.size();
+
+    rhs.resize( n );
+    diagonal.resize( n );
+
+    pool.parallelFor( n, 1024, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        float sumWeights = 0.0f;
+        for ( const unsigned int* j = grid.getNeighborsBegin( i ), *last = grid.getNeighborsEnd( i ); j != last; ++j )
+        {
+          sumWeights += weight( i, *j );
+        }
+
+        diagonal[ i ] = 1.0f + alphaDt * sumWeights + dt * objectRate[ i ];
+        rhs[ i ]      = temperature[ i ] + dt * objectRate[ i ] * objectTemperature;
+      }
+    } );
+
+    for ( int iteration = 0; iteration < iterations; ++iteration )
+    {
+      std::vector< PaddedAccumulator< float > > maxChange( pool.getNumThreads() );
+
+      pool.parallelFor( n, 1024, [&]( size_t begin, size_t end, unsigned int thread )
+      {
+        float change = 0.0f;
+        for ( size_t i = begin; i < end; ++i )
+        {
+          float offDiagonal = 0.0f;
+          for ( const unsigned int* j = grid.getNeighborsBegin( i ), *last = grid.getNeighborsEnd( i ); j != last; ++j )
+          {
+            offDiagonal += weight( i, *j ) * temperature[ *j ];
+          }
+
+          nextTemperature[ i ] = ( rhs[ i ] + alphaDt * offDiagonal ) / diagonal[ i ];
+          change = std::max( change, std::fabs( nextTemperature[ i ] - temperature[ i ] ) );
+        }
+        maxChange[ thread ].value = std::max( maxChange[ thread ].value, change );
+      } );
+
+      temperature.swap( nextTemperature );
+
+      float change = 0.0f;
+      for ( size_t t = 0; t < maxChange.size(); ++t )
+      {
+        change = std::max( change, maxChange[ t ].value );
+      }
+      if ( change <= tolerance )
+      {
+        break;
+      }
+    }
+  }
+
+  protected:
+
+  ThreadPool    pool;
+  NeighborGrid  grid;
+  SphKernels    kernels;
+
+  std::vector< PB_Particle > particles;
+
+  std::vector< float > px, py, pz;
+
+  // Double buffered temperatures.
+  std::vector< float > temperature;
+  std::vector< float > nextTemperature;
+
+  std::vector< float > objectRate;
+  std::vector< float > rhs;
+  std::vector< float > diagonal;
+
+  std::vector< HotBox > hotBoxes;
+  float                 objectTemperature;
+
+  std::map< int, float > lastTimes;
+  float                  resumeTime;
+  bool                   resumed;
+  bool                   fallbackReported;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_DAEMON_PLUGIN( HeatDiffusionDaemonSDK );
+
+/////////////////////////////////////////////////////////////////////////////////////////
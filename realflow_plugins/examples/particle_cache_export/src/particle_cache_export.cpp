@@ -0,0 +1,509 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/daemon.h>
+#include <rf_sdk/sdk/nodeaccesor.h>
+#include <rf_sdk/sdk/pb_particle.h>
+#include <rf_sdk/sdk/pb_emitter.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/daemons/daemonplgsdk.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "particle_cache_writer.h"
+#include "content_hash_manifest.h"
+#include "scene_content_hash.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+//--------------------------------------------------
+// Columnar particle cache exporter.
+//
+// Every frame the particles of the "Emitters" are added to
+// "Directory"/<emitter>.rfpc, a container of frames in the
+// column format of particle_cache_format.h: ids, position,
+// velocity and the custom attributes listed in "Attributes"
+// as "id:type" pairs ( float, double, int, char, bool or
+// vector ), e.g. "3:float 4:vector".
+//
+// Positions, velocities and float attributes are quantized to
+// their tolerance, 0 keeps them lossless. Frames between
+// keyframes store deltas against the previous frame. A
+// simulation restarted at frame N replaces N and the frames
+// after it, one started before the first cached frame
+// replaces the whole file.
+//
+// When the simulation begins the content hashes of the scene
+// inputs, geometry, particles and the "HashParameters" of
+// every node, replace the ContentHashManifest of
+// "Directory"; CmdContentHash checks a scene against it,
+// with the same settings, to tell whether the cache is
+// still valid.
+//
+// The simulation thread only gathers the particles, in
+// parallel; encoding, compression and the disk write run on
+// the ParticleCacheWriter thread.
+//--------------------------------------------------
+class ParticleCacheExportDaemonSDK : public DaemonPlgSdk
+{
+
+  // A custom attribute column.
+  struct AttributeSpec
+  {
+    int           id;
+    int           type;
+    unsigned char kind;
+    unsigned char width;
+    unsigned char components;
+  };
+
+  public:
+
+  /// Constructor.
+  ParticleCacheExportDaemonSDK() : gatherMs( 0.0 ) {};
+
+  /// Destructor.
+  virtual ~ParticleCacheExportDaemonSDK() {};
+
+  /// Class id.
+  virtual NL_INT32 getClassId() const
+  {
+    return ( 1684210519 );
+  };
+
+  // getSdkVersion
+  virtual NL_INDEX32 getSdkVersion() const
+  {
+    return ( SdkVersion::SDK_VERSION );
+  }
+
+  /// Threads are managed by the daemon itself.
+  virtual bool isMT( void ) const { return NL_false; };
+
+  /// Get plugin name.
+  virtual std::string getNameId() const
+  {
+    return ( "ParticleCacheExport" );
+  };
+
+  // getCopyRight()
+  virtual std::string getCopyRight() const
+  {
+    return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+  }
+
+  // getCopyRight()
+  virtual std::string getLongDescription() const
+  {
+    return std::string( "Writes compressed columnar particle caches from a background thread." );
+  }
+
+  // getCopyRight()
+  virtual std::string getShortDescription() const
+  {
+    return std::string( "Particle cache export" );
+  }
+
+  /// Initialize plugin, add properties, etc.
+  virtual void initialize( PlgDescriptor* plgDesc )
+  {
+    std::vector<std::string> noNodes;
+    Ppty emitters = Ppty::createPpty( "Emitters", noNodes, node_type::TYPE_PB_EMITTER, Ppty::SELECTION_MULTIPLE );
+    plgDesc->addPpty( emitters );
+
+    Ppty directory = Ppty::createPpty( "Directory", std::string( "" ), Ppty::SELECTION_DIRECTORY );
+    plgDesc->addPpty( directory );
+
+    // Quantization steps, 0 for lossless.
+    Ppty positionTolerance = Ppty::createPpty( "PositionTolerance", 0.0001f, 0.0f );
+    plgDesc->addPpty( positionTolerance );
+
+    Ppty velocityTolerance = Ppty::createPpty( "VelocityTolerance", 0.001f, 0.0f );
+    plgDesc->addPpty( velocityTolerance );
+
+    // Custom attributes, "id:type" separated by spaces.
+    Ppty attributes = Ppty::createPpty( "Attributes", std::string( "" ) );
+    plgDesc->addPpty( attributes );
+
+    Ppty attributeTolerance = Ppty::createPpty( "AttributeTolerance", 0.0f, 0.0f );
+    plgDesc->addPpty( attributeTolerance );
+
+    Ppty keyframeInterval = Ppty::createPpty( "KeyframeInterval", 10, 1 );
+    plgDesc->addPpty( keyframeInterval );
+
+    // Frames queued for the writer thread before the simulation waits.
+    Ppty maxPendingFrames = Ppty::createPpty( "MaxPendingFrames", 4, 1 );
+    plgDesc->addPpty( maxPendingFrames );
+
+    // Parameter names hashed into the manifest, as in CmdContentHash.
+    Ppty hashParameters = Ppty::createPpty( "HashParameters", std::string( "Position Rotation Scale" ) );
+    plgDesc->addPpty( hashParameters );
+
+    Ppty reportStats = Ppty::createPpty( "ReportStats", false );
+    plgDesc->addPpty( reportStats );
+  }
+
+  //--------------------------------------------------
+  // Function: onSimulationBegin
+  // Writes the manifest of the inputs and starts the writer
+  // thread, the first frame of every emitter is a keyframe.
+  //--------------------------------------------------
+  virtual void onSimulationBegin( Daemon* plgThis )
+  {
+    writer.reset();
+    writer.start();
+
+    writeManifest( plgThis );
+  }
+
+  // onSimulationResume: the writer thread again, the streams carry on.
+  virtual void onSimulationResume( Daemon* plgThis )
+  {
+    NL_VARIABLE_MAYBE_NOT_REFERENCED( plgThis );
+
+    writer.start();
+  }
+
+  //--------------------------------------------------
+  // Function: onSimulationStop
+  // Waits until every frame is on disk and stops the writer
+  // thread, so none is left running when the plugin unloads.
+  //--------------------------------------------------
+  virtual void onSimulationStop( Daemon* plgThis )
+  {
+    writer.stop();
+    report( plgThis, "finished" );
+  }
+
+  //--------------------------------------------------
+  // Function: onSimulationFrame
+  // Gathers and queues a frame of every emitter.
+  //--------------------------------------------------
+  virtual void onSimulationFrame( Daemon* plgThis, const unsigned int& frame )
+  {
+    Scene& scene = AppManager::instance()->getCurrentScene();
+
+    const std::string directory = plgThis->getParameter<std::string>( "Directory" );
+    if ( directory.empty() )
+    {
+      return;
+    }
+
+    pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+    // Half the threads compress, the simulation keeps running on the others.
+    writer.setEncoderThreads( std::max( 1u, pool.getNumThreads() / 2 ) );
+    writer.setKeyframeInterval( static_cast< unsigned int >( std::max( 1, plgThis->getParameter<int>( "KeyframeInterval" ) ) ) );
+    writer.setMaxPending( size_t( std::max( 1, plgThis->getParameter<int>( "MaxPendingFrames" ) ) ) );
+
+    const double positionTolerance  = plgThis->getParameter<float>( "PositionTolerance" );
+    const double velocityTolerance  = plgThis->getParameter<float>( "VelocityTolerance" );
+    const double attributeTolerance = plgThis->getParameter<float>( "AttributeTolerance" );
+
+    std::vector< AttributeSpec > attributes;
+    if ( !parseAttributes( plgThis->getParameter<std::string>( "Attributes" ), attributes ) )
+    {
+      scene.message( "ParticleCacheExport: \"Attributes\" must be \"id:type\" pairs, type float, double, int, char, bool or vector." );
+      return;
+    }
+
+    Stopwatch gatherTime;
+
+    ArrSdkNodeAccesors nodes = plgThis->getParameter<ArrSdkNodeAccesors>( "Emitters" );
+    for ( size_t k = 0; k < nodes.size(); ++k )
+    {
+      PB_Emitter emitter = nodes[ k ].asRFPB_Emitter();
+      const std::string name = nodes[ k ].getName();
+
+      ParticleCacheFrame cacheFrame;
+      cacheFrame.frame = frame;
+      gatherFrame( emitter, attributes, positionTolerance, velocityTolerance, attributeTolerance, cacheFrame );
+
+      writer.submit( name, directory + "/" + name + ".rfpc", cacheFrame );
+    }
+
+    gatherMs = gatherTime.getElapsedMs();
+
+    std::stringstream label;
+    label << "frame " << frame;
+    report( plgThis, label.str() );
+  }
+
+  protected:
+
+  // writeManifest: the scene hashes, nodes no longer in the scene dropped.
+  void writeManifest( Daemon* plgThis )
+  {
+    const std::string directory = plgThis->getParameter<std::string>( "Directory" );
+    if ( directory.empty() )
+    {
+      return;
+    }
+
+    Scene& scene = AppManager::instance()->getCurrentScene();
+    const std::vector< std::string > parameters = SceneContentHash::parseParameters( plgThis->getParameter<std::string>( "HashParameters" ) );
+
+    std::vector< SceneContentHash::NodeHash > hashes;
+    SceneContentHash::hashScene( scene, parameters, true, true, pool, hashes );
+
+    ContentHashManifest manifest;
+    SceneContentHash::toManifest( hashes, SceneContentHash::getSettings( parameters, true, true ), manifest );
+
+    const std::string path = ContentHashManifest::getPath( directory );
+    if ( !manifest.save( path ) )
+    {
+      scene.message( "ParticleCacheExport: cannot write " + path );
+    }
+  }
+
+  //--------------------------------------------------
+  // Function: parseAttributes
+  // "id:type" pairs, false for anything else.
+  //--------------------------------------------------
+  static bool parseAttributes( const std::string& text, std::vector< AttributeSpec >& attributes )
+  {
+    std::string spaced( text );
+    std::replace( spaced.begin(), spaced.end(), ',', ' ' );
+    std::replace( spaced.begin(), spaced.end(), ':', ' ' );
+
+    std::istringstream words( spaced );
+    int         id = 0;
+    std::string type;
+    while ( words >> id )
+    {
+      if ( !( words >> type ) )
+      {
+        return ( false );
+      }
+
+      AttributeSpec spec;
+      spec.id         = id;
+      spec.components = 1;
+      if ( type == "float" )
+      {
+        spec.type = PB_Emitter::PARTICLE_ATTR_TYPE_FLOAT;  spec.kind = KIND_FLOAT;  spec.width = 4;
+      }
+      else if ( type == "vector" )
+      {
+        spec.type = PB_Emitter::PARTICLE_ATTR_TYPE_VECTOR; spec.kind = KIND_FLOAT;  spec.width = 4; spec.components = 3;
+      }
+      else if ( type == "double" )
+      {
+        spec.type = PB_Emitter::PARTICLE_ATTR_TYPE_DOUBLE; spec.kind = KIND_DOUBLE; spec.width = 8;
+      }
+      else if ( type == "int" )
+      {
+        spec.type = PB_Emitter::PARTICLE_ATTR_TYPE_INT;    spec.kind = KIND_INT;    spec.width = 4;
+      }
+      else if ( type == "char" )
+      {
+        spec.type = PB_Emitter::PARTICLE_ATTR_TYPE_CHAR;   spec.kind = KIND_CHAR;   spec.width = 1;
+      }
+      else if ( type == "bool" )
+      {
+        spec.type = PB_Emitter::PARTICLE_ATTR_TYPE_BOOL;   spec.kind = KIND_CHAR;   spec.width = 1;
+      }
+      else
+      {
+        return ( false );
+      }
+      attributes.push_back( spec );
+    }
+    return ( words.eof() );
+  }
+
+  // addColumn: an empty column of "count" values.
+  static ParticleCacheColumnData& addColumn( ParticleCacheFrame& frame, int attribute, unsigned char component, unsigned char kind,
+                                             unsigned char width, double scale, size_t count )
+  {
+    frame.columns.push_back( ParticleCacheColumnData() );
+    ParticleCacheColumnData& column = frame.columns.back();
+    column.attribute = attribute;
+    column.component = component;
+    column.kind      = kind;
+    column.width     = width;
+    column.scale     = scale;
+    column.values.resize( count * width );
+    return ( column );
+  }
+
+  //--------------------------------------------------
+  // Function: gatherFrame
+  // One pass over the particles on the pool, each thread
+  // writing its own range of every column. The columns are
+  // created first, so no thread resizes anything.
+  //--------------------------------------------------
+  void gatherFrame( PB_Emitter& emitter, const std::vector< AttributeSpec >& attributes, double positionTolerance,
+                    double velocityTolerance, double attributeTolerance, ParticleCacheFrame& frame )
+  {
+    emitter.getParticles( particles );
+    const size_t n = particles.size();
+
+    frame.ids.resize( n );
+    frame.columns.reserve( 6 + 3 * attributes.size() );
+    for ( unsigned char c = 0; c < 3; ++c )
+    {
+      addColumn( frame, ATTRIBUTE_POSITION, c, KIND_FLOAT, 4, positionTolerance, n );
+    }
+    for ( unsigned char c = 0; c < 3; ++c )
+    {
+      addColumn( frame, ATTRIBUTE_VELOCITY, c, KIND_FLOAT, 4, velocityTolerance, n );
+    }
+    for ( size_t a = 0; a < attributes.size(); ++a )
+    {
+      const AttributeSpec& spec = attributes[ a ];
+      for ( unsigned char c = 0; c < spec.components; ++c )
+      {
+        addColumn( frame, spec.id, c, spec.kind, spec.width, spec.kind == KIND_FLOAT ? attributeTolerance : 0.0, n );
+      }
+    }
+
+    std::vector< unsigned char* > columns( frame.columns.size() );
+    for ( size_t c = 0; c < columns.size(); ++c )
+    {
+      columns[ c ] = frame.columns[ c ].values.data();
+    }
+
+    pool.parallelFor( n, 1024, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        const PB_Particle& particle = particles[ i ];
+        frame.ids[ i ] = particle.getId();
+
+        const Vector position = particle.getPosition();
+        const Vector velocity = particle.getVelocity();
+        putVector( columns.data(), i, position );
+        putVector( columns.data() + 3, i, velocity );
+
+        unsigned char** column = columns.data() + 6;
+        for ( size_t a = 0; a < attributes.size(); ++a )
+        {
+          column += getAttribute( particle, attributes[ a ], column, i );
+        }
+      }
+    } );
+  }
+
+  // putVector: x, y, z into three float columns.
+  static void putVector( unsigned char** columns, size_t i, const Vector& value )
+  {
+    const float xyz[ 3 ] = { value.getX(), value.getY(), value.getZ() };
+    for ( int c = 0; c < 3; ++c )
+    {
+      std::memcpy( columns[ c ] + 4 * i, &xyz[ c ], 4 );
+    }
+  }
+
+  // getAttribute: a custom attribute into its columns, 0 when missing. Returns the columns used.
+  static size_t getAttribute( const PB_Particle& particle, const AttributeSpec& spec, unsigned char** columns, size_t i )
+  {
+    switch ( spec.type )
+    {
+      case PB_Emitter::PARTICLE_ATTR_TYPE_VECTOR:
+      {
+        Vector value( 0.0f, 0.0f, 0.0f );
+        particle.getAttribute( spec.id, value );
+        putVector( columns, i, value );
+        return ( 3 );
+      }
+      case PB_Emitter::PARTICLE_ATTR_TYPE_FLOAT:
+      {
+        float value = 0.0f;
+        particle.getAttribute( spec.id, value );
+        std::memcpy( columns[ 0 ] + 4 * i, &value, 4 );
+        break;
+      }
+      case PB_Emitter::PARTICLE_ATTR_TYPE_DOUBLE:
+      {
+        double value = 0.0;
+        particle.getAttribute( spec.id, value );
+        std::memcpy( columns[ 0 ] + 8 * i, &value, 8 );
+        break;
+      }
+      case PB_Emitter::PARTICLE_ATTR_TYPE_INT:
+      {
+        int value = 0;
+        particle.getAttribute( spec.id, value );
+        std::memcpy( columns[ 0 ] + 4 * i, &value, 4 );
+        break;
+      }
+      case PB_Emitter::PARTICLE_ATTR_TYPE_BOOL:
+      {
+        bool value = false;
+        particle.getAttribute( spec.id, value );
+        columns[ 0 ][ i ] = value ? 1 : 0;
+        break;
+      }
+      default:
+      {
+        char value = 0;
+        particle.getAttribute( spec.id, value );
+        columns[ 0 ][ i ] = static_cast< unsigned char >( value );
+        break;
+      }
+    }
+    return ( 1 );
+  }
+
+  // report: writer totals when "ReportStats" is on.
+  void report( Daemon* plgThis, const std::string& label )
+  {
+    if ( !plgThis->getParameter<bool>( "ReportStats" ) )
+    {
+      return;
+    }
+
+    const ParticleCacheWriter::Stats stats = writer.getStats();
+    const std::string error = writer.getLastError();
+
+    std::stringstream msg;
+    msg << "ParticleCacheExport: " << label << ", gather " << gatherMs << " ms, " << stats.frames << " frames, "
+        << stats.rawBytes / 1048576.0 << " MB -> " << stats.storedBytes / 1048576.0 << " MB, encode "
+        << stats.encodeMs << " ms, write " << stats.writeMs << " ms, simulation waited " << stats.waitMs << " ms";
+    if ( stats.failures > 0 )
+    {
+      msg << ", " << stats.failures << " failed writes, last " << error;
+    }
+    AppManager::instance()->getCurrentScene().message( msg.str() );
+  }
+
+  protected:
+
+  ThreadPool                 pool;
+  ParticleCacheWriter        writer;
+  std::vector< PB_Particle > particles;
+  double                     gatherMs;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_DAEMON_PLUGIN( ParticleCacheExportDaemonSDK );
+
+/////////////////////////////////////////////////////////////////////////////////////////
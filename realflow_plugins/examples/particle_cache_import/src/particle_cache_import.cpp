@@ -0,0 +1,363 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/daemon.h>
+#include <rf_sdk/sdk/nodeaccesor.h>
+#include <rf_sdk/sdk/pb_particle.h>
+#include <rf_sdk/sdk/pb_emitter.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/daemons/daemonplgsdk.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "flat_hash_map.h"
+#include "particle_cache_reader.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+//--------------------------------------------------
+// Particle cache playback.
+//
+// Every frame the particles of "Emitter" are set to frame +
+// "FrameOffset" of the cache ParticleCacheExport wrote to
+// "Directory"/<"CacheName">.rfpc; an empty "CacheName" uses
+// the emitter name.
+//
+// Particles are updated in place by id: a cached particle
+// moves the emitter particle it was matched with on the
+// previous frame, or the one with its own id, so ids stay
+// what they were when cached. Particles without a match are
+// added, the emitter assigns their ids, and particles the
+// frame does not have are removed.
+//
+// Only the ids, positions and, with "Velocities" on, the
+// velocities are decompressed. With "Prefetch" on the next
+// frame is decoded in the background while the simulation
+// runs the current one.
+//--------------------------------------------------
+class ParticleCacheImportDaemonSDK : public DaemonPlgSdk
+{
+  public:
+
+  /// Constructor.
+  ParticleCacheImportDaemonSDK() : reader( pool ) {};
+
+  /// Destructor.
+  virtual ~ParticleCacheImportDaemonSDK() {};
+
+  /// Class id.
+  virtual NL_INT32 getClassId() const
+  {
+    return ( 1684210521 );
+  };
+
+  // getSdkVersion
+  virtual NL_INDEX32 getSdkVersion() const
+  {
+    return ( SdkVersion::SDK_VERSION );
+  }
+
+  /// Threads are managed by the daemon itself.
+  virtual bool isMT( void ) const { return NL_false; };
+
+  /// Get plugin name.
+  virtual std::string getNameId() const
+  {
+    return ( "ParticleCacheImport" );
+  };
+
+  // getCopyRight()
+  virtual std::string getCopyRight() const
+  {
+    return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+  }
+
+  // getCopyRight()
+  virtual std::string getLongDescription() const
+  {
+    return std::string( "Plays back columnar particle caches into an emitter." );
+  }
+
+  // getCopyRight()
+  virtual std::string getShortDescription() const
+  {
+    return std::string( "Particle cache import" );
+  }
+
+  /// Initialize plugin, add properties, etc.
+  virtual void initialize( PlgDescriptor* plgDesc )
+  {
+    std::vector<std::string> noNodes;
+    Ppty emitter = Ppty::createPpty( "Emitter", noNodes, node_type::TYPE_PB_EMITTER, Ppty::SELECTION_UNIQUE );
+    plgDesc->addPpty( emitter );
+
+    Ppty directory = Ppty::createPpty( "Directory", std::string( "" ), Ppty::SELECTION_DIRECTORY );
+    plgDesc->addPpty( directory );
+
+    Ppty cacheName = Ppty::createPpty( "CacheName", std::string( "" ) );
+    plgDesc->addPpty( cacheName );
+
+    Ppty frameOffset = Ppty::createPpty( "FrameOffset", 0 );
+    plgDesc->addPpty( frameOffset );
+
+    Ppty velocities = Ppty::createPpty( "Velocities", true );
+    plgDesc->addPpty( velocities );
+
+    Ppty prefetch = Ppty::createPpty( "Prefetch", true );
+    plgDesc->addPpty( prefetch );
+
+    Ppty reportStats = Ppty::createPpty( "ReportStats", false );
+    plgDesc->addPpty( reportStats );
+  }
+
+  //--------------------------------------------------
+  // Function: onSimulationBegin
+  // Maps the cache again, it may have been re-simulated,
+  // and forgets the particle matches of the last run.
+  //--------------------------------------------------
+  virtual void onSimulationBegin( Daemon* plgThis )
+  {
+    NL_VARIABLE_MAYBE_NOT_REFERENCED( plgThis );
+
+    reader.close();
+    emitterIdOf.clear();
+  }
+
+  // onSimulationStop: joins the prefetch thread while the plugin is still loaded.
+  virtual void onSimulationStop( Daemon* plgThis )
+  {
+    NL_VARIABLE_MAYBE_NOT_REFERENCED( plgThis );
+
+    reader.close();
+  }
+
+  //--------------------------------------------------
+  // Function: onSimulationFrame
+  // Decodes the cache frame and moves the emitter to it.
+  //--------------------------------------------------
+  virtual void onSimulationFrame( Daemon* plgThis, const unsigned int& frame )
+  {
+    Scene& scene = AppManager::instance()->getCurrentScene();
+
+    const std::string directory = plgThis->getParameter<std::string>( "Directory" );
+    ArrSdkNodeAccesors nodes = plgThis->getParameter<ArrSdkNodeAccesors>( "Emitter" );
+    if ( directory.empty() || nodes.empty() )
+    {
+      return;
+    }
+
+    const int cacheFrame = int( frame ) + plgThis->getParameter<int>( "FrameOffset" );
+    if ( cacheFrame < 0 )
+    {
+      return;
+    }
+
+    std::string name = plgThis->getParameter<std::string>( "CacheName" );
+    if ( name.empty() )
+    {
+      name = nodes[ 0 ].getName();
+    }
+
+    const bool withVelocities = plgThis->getParameter<bool>( "Velocities" );
+    std::vector< int > attributes( 1, ATTRIBUTE_POSITION );
+    if ( withVelocities )
+    {
+      attributes.push_back( ATTRIBUTE_VELOCITY );
+    }
+
+    pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+    if ( name != cacheName )
+    {
+      emitterIdOf.clear();
+      cacheName = name;
+    }
+    reader.open( directory, name );
+    reader.setAttributes( attributes );
+    reader.setPrefetch( plgThis->getParameter<bool>( "Prefetch" ) );
+
+    Stopwatch loadTime;
+
+    if ( !reader.readFrame( static_cast< unsigned int >( cacheFrame ) ) )
+    {
+      scene.message( "ParticleCacheImport: " + reader.getError() );
+      return;
+    }
+
+    const float* position[ 3 ] = { reader.getFloats( ATTRIBUTE_POSITION, 0 ), reader.getFloats( ATTRIBUTE_POSITION, 1 ),
+                                   reader.getFloats( ATTRIBUTE_POSITION, 2 ) };
+    const float* velocity[ 3 ] = { reader.getFloats( ATTRIBUTE_VELOCITY, 0 ), reader.getFloats( ATTRIBUTE_VELOCITY, 1 ),
+                                   reader.getFloats( ATTRIBUTE_VELOCITY, 2 ) };
+    if ( !position[ 0 ] || !position[ 1 ] || !position[ 2 ] )
+    {
+      scene.message( "ParticleCacheImport: the cache has no positions." );
+      return;
+    }
+    const bool hasVelocities = withVelocities && velocity[ 0 ] && velocity[ 1 ] && velocity[ 2 ];
+
+    PB_Emitter emitter = nodes[ 0 ].asRFPB_Emitter();
+    const size_t n = reader.getNumParticles();
+    matchParticles( emitter, reader.getIds() );
+
+    // Matched particles straight from the decoded columns.
+    pool.parallelFor( n, 4096, [&]( size_t begin, size_t end, unsigned int )
+    {
+      for ( size_t i = begin; i < end; ++i )
+      {
+        if ( target[ i ] != FlatIndexMap::NOT_FOUND )
+        {
+          PB_Particle& particle = particles[ target[ i ] ];
+          particle.setPosition( Vector( position[ 0 ][ i ], position[ 1 ][ i ], position[ 2 ][ i ] ) );
+          particle.setVelocity( hasVelocities ? Vector( velocity[ 0 ][ i ], velocity[ 1 ][ i ], velocity[ 2 ][ i ] ) : Vector( 0.0f, 0.0f, 0.0f ) );
+        }
+      }
+    } );
+
+    for ( size_t p = 0; p < particles.size(); ++p )
+    {
+      if ( !claimed[ p ] )
+      {
+        emitter.removeParticle( particles[ p ].getId() );
+      }
+    }
+
+    // The rest are born, the emitter gives them ids.
+    size_t born = 0;
+    for ( size_t i = 0; i < n; ++i )
+    {
+      if ( target[ i ] == FlatIndexMap::NOT_FOUND )
+      {
+        const Vector particleVelocity = hasVelocities ? Vector( velocity[ 0 ][ i ], velocity[ 1 ][ i ], velocity[ 2 ][ i ] ) : Vector( 0.0f, 0.0f, 0.0f );
+        PB_Particle particle = emitter.addParticle( Vector( position[ 0 ][ i ], position[ 1 ][ i ], position[ 2 ][ i ] ), particleVelocity );
+        emitterIds[ i ] = particle.isNull() ? FlatIndexMap::NOT_FOUND : static_cast< unsigned int >( particle.getId() );
+        ++born;
+      }
+    }
+
+    // Matches for the next frame.
+    const std::vector< long long >& ids = reader.getIds();
+    bool inserted = false;
+    emitterIdOf.clear();
+    emitterIdOf.reserve( n );
+    for ( size_t i = 0; i < n; ++i )
+    {
+      if ( emitterIds[ i ] != FlatIndexMap::NOT_FOUND )
+      {
+        emitterIdOf.insert( static_cast< unsigned long long >( ids[ i ] ), emitterIds[ i ], inserted );
+      }
+    }
+
+    if ( plgThis->getParameter<bool>( "ReportStats" ) )
+    {
+      const ParticleCacheReader::Stats stats = reader.getStats();
+
+      std::stringstream msg;
+      msg << "ParticleCacheImport: frame " << cacheFrame << ", " << n << " particles ( " << born << " added ) in "
+          << loadTime.getElapsedMs() << " ms, " << stats.frames << " frames read, " << stats.prefetchHits << " prefetched, "
+          << stats.chainFrames << " reference frames decoded, decode " << stats.decodeMs << " ms";
+      scene.message( msg.str() );
+    }
+  }
+
+  protected:
+
+  //--------------------------------------------------
+  // Function: matchParticles
+  // For every cached id the index of its emitter particle
+  // in "particles", or NOT_FOUND, and in "emitterIds" that
+  // particle's id. The particles matched on the previous
+  // frame go first, then those with the cached id itself;
+  // each emitter particle is "claimed" once.
+  //--------------------------------------------------
+  void matchParticles( PB_Emitter& emitter, const std::vector< long long >& ids )
+  {
+    emitter.getParticles( particles );
+
+    bool inserted = false;
+    indexOfId.clear();
+    indexOfId.reserve( particles.size() );
+    for ( size_t p = 0; p < particles.size(); ++p )
+    {
+      indexOfId.insert( static_cast< unsigned long long >( particles[ p ].getId() ), static_cast< unsigned int >( p ), inserted );
+    }
+
+    const size_t n = ids.size();
+    claimed.assign( particles.size(), 0 );
+    target.assign( n, FlatIndexMap::NOT_FOUND );
+    emitterIds.assign( n, FlatIndexMap::NOT_FOUND );
+
+    // First the particle matched on the previous frame, then the one with the cached id.
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+      for ( size_t i = 0; i < n; ++i )
+      {
+        if ( target[ i ] != FlatIndexMap::NOT_FOUND )
+        {
+          continue;
+        }
+
+        unsigned long long emitterId = static_cast< unsigned long long >( ids[ i ] );
+        if ( pass == 0 )
+        {
+          const unsigned int matched = emitterIdOf.find( emitterId );
+          if ( matched == FlatIndexMap::NOT_FOUND )
+          {
+            continue;
+          }
+          emitterId = matched;
+        }
+
+        const unsigned int p = indexOfId.find( emitterId );
+        if ( p != FlatIndexMap::NOT_FOUND && !claimed[ p ] )
+        {
+          claimed[ p ]    = 1;
+          target[ i ]     = p;
+          emitterIds[ i ] = static_cast< unsigned int >( emitterId );
+        }
+      }
+    }
+  }
+
+  protected:
+
+  ThreadPool                  pool;
+  ParticleCacheReader         reader;
+  std::string                 cacheName;
+  std::vector< PB_Particle >  particles;
+  FlatIndexMap                indexOfId;
+  FlatIndexMap                emitterIdOf;
+  std::vector< char >         claimed;
+  std::vector< unsigned int > target;
+  std::vector< unsigned int > emitterIds;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_DAEMON_PLUGIN( ParticleCacheImportDaemonSDK );
+
+/////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,565 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+#include <rf_sdk/sdk/appmanager.h>
+#include <rf_sdk/sdk/scene.h>
+#include <rf_sdk/sdk/vector.h>
+#include <rf_sdk/sdk/pb_particle.h>
+#include <rf_sdk/sdk/pb_emitter.h>
+#include <rf_sdk/sdk/ppty.h>
+#include <rf_sdk/sdk/plgdescriptor.h>
+#include <rf_sdk/particles/particlesolverplgsdk.h>
+#include <rf_sdk/sdk/rfsdklibdefs.h>
+#include <rf_sdk/sdk/sdkversion.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "thread_pool.h"
+#include "neighbor_grid.h"
+#include "sph_kernels.h"
+#include "stopwatch.h"
+#include "flat_hash_map.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// PCISPH ( Solenthaler & Pajarola 2009 ) pressure solver.
+//
+// The iterative correction needs a barrier between the
+// predict, density and pressure force passes, which the
+// per-thread computeInternalForces calls can not provide.
+// The whole solve therefore runs in preComputeInternalForces
+// over SoA copies of the particles, parallelized with the
+// plugin thread pool over a CSR neighbor list built once per
+// step. computeInternalForces only hands every particle its
+// pressure force.
+//
+// An optional XSPH / viscosity stage follows the pressure
+// solve. It reads the velocities after the pressure step from
+// one buffer and writes a velocity correction to another.
+// computeInternalForces adds that correction to the pressure
+// force as m * dv / dt, so RealFlow's own integration and
+// collision response apply it with the external forces.
+//--------------------------------------------------
+class PcisphSolverSDK : public ParticleSolverPlgSdk
+{
+  public:
+
+    /// Constructor.
+    PcisphSolverSDK() : smoothingActive( false ), smoothingDt( 0.0f ), averageMass( 0.0f ), lastIterations( 0 ), lastSolveTime( 0.0 ), lastDensityError( 0.0f ) {};
+
+    /// Destructor.
+    virtual ~PcisphSolverSDK( void ) {};
+
+    /// Class id.
+    virtual NL_INT32 getClassId() const
+    {
+      return ( 1580460117 );
+    };
+
+    // getSdkVersion
+    virtual NL_INDEX32 getSdkVersion() const
+    {
+      return ( SdkVersion::SDK_VERSION );
+    }
+
+    /// Get plugin name.
+    virtual std::string getNameId() const
+    {
+      return ( "PCISPH 1.0" );
+    };
+
+    // getCopyRight()
+    virtual std::string getCopyRight() const
+    {
+      return std::string( "Copyright (C) 2014 Next Limit Technologies. All rights reserved." );
+    }
+
+    // getCopyRight()
+    virtual std::string getLongDescription() const
+    {
+      return std::string( "Predictive-corrective incompressible SPH pressure solver." );
+    }
+
+    // getCopyRight()
+    virtual std::string getShortDescription() const
+    {
+      return std::string( "PCISPH pressure solver." );
+    }
+
+    /// Initialize plugin, add properties, etc.
+    virtual void initialize( PlgDescriptor* plgDesc )
+    {
+      Ppty restDensity = Ppty::createPpty( "RestDensity", 1000.0f, 1.0f );
+      plgDesc->addPpty( restDensity );
+
+      // 0 means twice the mean spacing given by the emitter "Resolution".
+      Ppty kernelRadius = Ppty::createPpty( "KernelRadius", 0.0f, 0.0f );
+      plgDesc->addPpty( kernelRadius );
+
+      // Average relative density error accepted, 0.01 = 1%.
+      Ppty tolerance = Ppty::createPpty( "Tolerance", 0.01f, 0.0f );
+      plgDesc->addPpty( tolerance );
+
+      Ppty minIterations = Ppty::createPpty( "MinIterations", 3, 1 );
+      plgDesc->addPpty( minIterations );
+
+      Ppty maxIterations = Ppty::createPpty( "MaxIterations", 50, 1 );
+      plgDesc->addPpty( maxIterations );
+
+      // Start from the pressures solved in the previous step.
+      Ppty warmStart = Ppty::createPpty( "WarmStart", true );
+      plgDesc->addPpty( warmStart );
+
+      // XSPH velocity smoothing ( epsilon ), animatable.
+      Ppty xsphFactor = Ppty::createPpty( "XSPHFactor", 0.0f, 0.0f, 1.0f );
+      plgDesc->addPpty( xsphFactor );
+
+      // Kinematic viscosity of the laplacian viscosity term, animatable.
+      Ppty viscosity = Ppty::createPpty( "Viscosity", 0.0f, 0.0f );
+      plgDesc->addPpty( viscosity );
+
+      // Prints iterations and solve time every step.
+      Ppty reportStats = Ppty::createPpty( "ReportStats", true );
+      plgDesc->addPpty( reportStats );
+    }
+
+    //--------------------------------------------------
+    // Function: preComputeInternalForces
+    // Gathers the emitter, builds the neighbor lists and runs
+    // the pressure iterations.
+    //--------------------------------------------------
+    virtual void preComputeInternalForces( ParticleSolver* particleSolver,
+                                           PB_Emitter* emitter )
+    {
+      Stopwatch solveTime;
+
+      Scene& scene = AppManager::instance()->getCurrentScene();
+      pool.resize( std::max( 1, scene.getNumberOfThreads() ) );
+
+      const float restDensity   = particleSolver->getParameter<float>( "RestDensity" );
+      const float userRadius    = particleSolver->getParameter<float>( "KernelRadius" );
+      const float tolerance     = particleSolver->getParameter<float>( "Tolerance" );
+      const int   minIterations = particleSolver->getParameter<int>  ( "MinIterations" );
+      const int   maxIterations = particleSolver->getParameter<int>  ( "MaxIterations" );
+      const bool  warmStart     = particleSolver->getParameter<bool> ( "WarmStart" );
+      const bool  reportStats   = particleSolver->getParameter<bool> ( "ReportStats" );
+      const float xsphFactor    = particleSolver->getParameter<float>( "XSPHFactor" );
+      const float viscosity     = particleSolver->getParameter<float>( "Viscosity" );
+      const float dt            = particleSolver->getIntegrationTime();
+
+      emitter->getParticles( particles );
+      const size_t n = particles.size();
+      smoothingActive = false;
+      if ( n == 0 || dt <= 0.0f )
+      {
+        indexOfId.clear();
+        return;
+      }
+
+      float resolution = emitter->getParameter<float>( "Resolution" );
+      if ( resolution <= 0.0f )
+      {
+        resolution = 1.0f;
+      }
+      const float spacing = 0.1f / resolution;
+      const float h       = ( userRadius > 0.0f ) ? userRadius : 2.0f * spacing;
+      kernels.setSupport( h );
+
+      gatherParticles( warmStart );
+
+      grid.build( px.data(), py.data(), pz.data(), n, h, pool );
+      grid.buildNeighborLists( px.data(), py.data(), pz.data(), h, pool );
+
+      const float delta = computeDelta( spacing, averageMass, restDensity, dt );
+
+      std::fill( pax.begin(), pax.end(), 0.0f );
+      std::fill( pay.begin(), pay.end(), 0.0f );
+      std::fill( paz.begin(), paz.end(), 0.0f );
+
+      int   iteration    = 0;
+      float densityError = 0.0f;
+      while ( iteration < maxIterations )
+      {
+        predictPositions( dt );
+        densityError = correctPressures( delta, restDensity ) / restDensity;
+        computePressureAccelerations();
+        ++iteration;
+
+        if ( iteration >= minIterations && densityError <= tolerance )
+        {
+          break;
+        }
+      }
+
+      smoothingActive = ( xsphFactor > 0.0f || viscosity > 0.0f );
+      if ( smoothingActive )
+      {
+        smoothVelocities( dt, xsphFactor, viscosity );
+      }
+      smoothingDt = dt;
+
+      buildIdLookup();
+
+      lastIterations   = iteration;
+      lastDensityError = densityError;
+      lastSolveTime    = solveTime.getElapsedMs();
+
+      if ( reportStats )
+      {
+        std::stringstream msg;
+        msg << "PCISPH " << emitter->getName() << ": frame " << scene.getCurrentFrame()
+            << ", " << n << " particles, " << lastIterations << " iterations, density error "
+            << lastDensityError * 100.0f << "%, solve " << lastSolveTime << " ms";
+        scene.message( msg.str() );
+      }
+    }
+
+    /// Compute internal forces.
+    virtual void computeInternalForces( ParticleSolver* particleSolver,
+                                        PB_Emitter* emitter,
+                                        int nThread,
+                                        PB_Emitter::iterator iter )
+    {
+      NL_VARIABLE_MAYBE_NOT_REFERENCED3( particleSolver, emitter, nThread );
+
+      while ( iter.hasNext() )
+      {
+        PB_Particle particle = iter.next();
+
+        const unsigned int i = indexOf( particle.getId() );
+        if ( i == FlatIndexMap::NOT_FOUND )
+        {
+          continue;
+        }
+
+        Vector acceleration( pax[ i ], pay[ i ], paz[ i ] );
+        if ( smoothingActive )
+        {
+          acceleration += Vector( dvx[ i ], dvy[ i ], dvz[ i ] ) / smoothingDt;
+        }
+        particle.setInternalForce( acceleration * mass[ i ] );
+        particle.setPressure( pressure[ i ] );
+        particle.setDensity( density[ i ] );
+      }
+    }
+
+  protected:
+
+    //--------------------------------------------------
+    // Function: gatherParticles
+    // SoA copies, in parallel over the particle handles. The
+    // external forces of this step are not computed yet, so
+    // getExternalForce() still holds those of the previous
+    // step; they are used on purpose as the estimate of a_ext
+    // in the prediction, which for gravity and slowly varying
+    // daemons is close, and keeps a resting fluid from sagging
+    // a step behind its pressure.
+    //--------------------------------------------------
+    void gatherParticles( const bool warmStart )
+    {
+      const size_t n = particles.size();
+
+      resizeArrays( n );
+
+      std::vector< PaddedAccumulator< double > > massSum( pool.getNumThreads() );
+
+      pool.parallelFor( n, 1024, [&]( size_t begin, size_t end, unsigned int thread )
+      {
+        for ( size_t i = begin; i < end; ++i )
+        {
+          PB_Particle& particle = particles[ i ];
+
+          const Vector position = particle.getPosition();
+          const Vector velocity = particle.getVelocity();
+          const Vector force    = particle.getExternalForce();
+          const float  m        = particle.getMass();
+
+          px[ i ] = position.getX(); py[ i ] = position.getY(); pz[ i ] = position.getZ();
+          vx[ i ] = velocity.getX(); vy[ i ] = velocity.getY(); vz[ i ] = velocity.getZ();
+
+          const float invMass = ( m > 0.0f ) ? 1.0f / m : 0.0f;
+          ax[ i ] = force.getX() * invMass; ay[ i ] = force.getY() * invMass; az[ i ] = force.getZ() * invMass;
+
+          mass[ i ]     = m;
+          pressure[ i ] = warmStart ? std::max( 0.0f, particle.getPressure() ) : 0.0f;
+          ids[ i ]      = particle.getId();
+
+          massSum[ thread ].value += m;
+        }
+      } );
+
+      double total = 0.0;
+      for ( size_t t = 0; t < massSum.size(); ++t )
+      {
+        total += massSum[ t ].value;
+      }
+      averageMass = float( total / double( n ) );
+    }
+
+    //--------------------------------------------------
+    // Function: computeDelta
+    // PCISPH scaling factor from a prototype particle with a
+    // full neighborhood on a cubic lattice of the rest spacing.
+    //--------------------------------------------------
+    float computeDelta( const float spacing, const float m, const float restDensity, const float dt ) const
+    {
+      const float h = kernels.getSupport();
+      const int   extent = int( std::ceil( h / spacing ) );
+
+      float sumGradX = 0.0f, sumGradY = 0.0f, sumGradZ = 0.0f;
+      float sumGradDot = 0.0f;
+
+      for ( int k = -extent; k <= extent; ++k )
+      {
+        for ( int j = -extent; j <= extent; ++j )
+        {
+          for ( int i = -extent; i <= extent; ++i )
+          {
+            const float x = i * spacing, y = j * spacing, z = k * spacing;
+            const float r = std::sqrt( x * x + y * y + z * z );
+            const float f = kernels.spikyGradFactor( r );
+
+            sumGradX += f * x; sumGradY += f * y; sumGradZ += f * z;
+            sumGradDot += f * f * ( x * x + y * y + z * z );
+          }
+        }
+      }
+
+      const float beta  = 2.0f * ( dt * m / restDensity ) * ( dt * m / restDensity );
+      const float denom = beta * ( sumGradX * sumGradX + sumGradY * sumGradY + sumGradZ * sumGradZ + sumGradDot );
+
+      return ( denom > 0.0f ? 1.0f / denom : 0.0f );
+    }
+
+    // predictPositions: x* = x + dt * ( v + dt * ( a_ext + a_p ) ).
+    void predictPositions( const float dt )
+    {
+      pool.parallelFor( particles.size(), 4096, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t i = begin; i < end; ++i )
+        {
+          qx[ i ] = px[ i ] + dt * ( vx[ i ] + dt * ( ax[ i ] + pax[ i ] ) );
+          qy[ i ] = py[ i ] + dt * ( vy[ i ] + dt * ( ay[ i ] + pay[ i ] ) );
+          qz[ i ] = pz[ i ] + dt * ( vz[ i ] + dt * ( az[ i ] + paz[ i ] ) );
+        }
+      } );
+    }
+
+    //--------------------------------------------------
+    // Function: correctPressures
+    // Predicted density and pressure update from the signed
+    // density error, so a warm started pressure relaxes once
+    // the compression is gone; the pressure itself is clamped
+    // at 0 ( free surface particles are never pulled ). The
+    // convergence measure is the average positive density
+    // error, reduced per thread.
+    //--------------------------------------------------
+    float correctPressures( const float delta, const float restDensity )
+    {
+      const float selfDensity = kernels.poly6( 0.0f );
+
+      std::vector< PaddedAccumulator< double > > errorSum( pool.getNumThreads() );
+
+      pool.parallelFor( particles.size(), 1024, [&]( size_t begin, size_t end, unsigned int thread )
+      {
+        double partialError = 0.0;
+        for ( size_t i = begin; i < end; ++i )
+        {
+          float rho = mass[ i ] * selfDensity;
+          for ( const unsigned int* j = grid.getNeighborsBegin( i ), *last = grid.getNeighborsEnd( i ); j != last; ++j )
+          {
+            const float dx = qx[ i ] - qx[ *j ], dy = qy[ i ] - qy[ *j ], dz = qz[ i ] - qz[ *j ];
+            rho += mass[ *j ] * kernels.poly6( dx * dx + dy * dy + dz * dz );
+          }
+
+          const float error = rho - restDensity;
+          pressure[ i ] = std::max( 0.0f, pressure[ i ] + delta * error );
+          density[ i ]  = std::max( rho, restDensity );
+
+          partialError += std::max( 0.0f, error );
+        }
+        errorSum[ thread ].value += partialError;
+      } );
+
+      double total = 0.0;
+      for ( size_t t = 0; t < errorSum.size(); ++t )
+      {
+        total += errorSum[ t ].value;
+      }
+      return ( float( total / double( particles.size() ) ) );
+    }
+
+    // computePressureAccelerations: symmetric SPH pressure gradient.
+    void computePressureAccelerations( void )
+    {
+      pool.parallelFor( particles.size(), 1024, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t i = begin; i < end; ++i )
+        {
+          const float termI = pressure[ i ] / ( density[ i ] * density[ i ] );
+
+          float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+          for ( const unsigned int* j = grid.getNeighborsBegin( i ), *last = grid.getNeighborsEnd( i ); j != last; ++j )
+          {
+            const float dx = qx[ i ] - qx[ *j ], dy = qy[ i ] - qy[ *j ], dz = qz[ i ] - qz[ *j ];
+            const float r  = std::sqrt( dx * dx + dy * dy + dz * dz );
+
+            const float termJ = pressure[ *j ] / ( density[ *j ] * density[ *j ] );
+            const float f     = -mass[ *j ] * ( termI + termJ ) * kernels.spikyGradFactor( r );
+
+            accX += f * dx; accY += f * dy; accZ += f * dz;
+          }
+
+          pax[ i ] = accX; pay[ i ] = accY; paz[ i ] = accZ;
+        }
+      } );
+    }
+
+    //--------------------------------------------------
+    // Function: smoothVelocities
+    // Front buffer: velocities after the pressure solve,
+    // v* = v + dt * a_p, written in one pass. Unlike the
+    // prediction, the previous step's external forces are
+    // left out: a uniform field like gravity cancels in the
+    // differences anyway.
+    // Back buffer: the XSPH average plus the viscosity term,
+    //   dv_i = eps * sum m_j / rho_ij * ( v*_j - v*_i ) W_ij
+    //        + dt * nu * sum m_j / rho_j * ( v*_j - v*_i ) lapl W_ij
+    // Threads only read the front buffer in the second pass, so
+    // no one sees a half updated neighbor.
+    //--------------------------------------------------
+    void smoothVelocities( const float dt, const float xsphFactor, const float viscosity )
+    {
+      const size_t n = particles.size();
+
+      pool.parallelFor( n, 4096, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t i = begin; i < end; ++i )
+        {
+          vsx[ i ] = vx[ i ] + dt * pax[ i ];
+          vsy[ i ] = vy[ i ] + dt * pay[ i ];
+          vsz[ i ] = vz[ i ] + dt * paz[ i ];
+        }
+      } );
+
+      const float viscosityDt = viscosity * dt;
+
+      pool.parallelFor( n, 1024, [&]( size_t begin, size_t end, unsigned int )
+      {
+        for ( size_t i = begin; i < end; ++i )
+        {
+          float sumX = 0.0f, sumY = 0.0f, sumZ = 0.0f;
+          for ( const unsigned int* j = grid.getNeighborsBegin( i ), *last = grid.getNeighborsEnd( i ); j != last; ++j )
+          {
+            const float dx = px[ i ] - px[ *j ], dy = py[ i ] - py[ *j ], dz = pz[ i ] - pz[ *j ];
+            const float r2 = dx * dx + dy * dy + dz * dz;
+
+            const float xsph = xsphFactor * 2.0f * mass[ *j ] / ( density[ i ] + density[ *j ] ) * kernels.poly6( r2 );
+            const float visc = viscosityDt * mass[ *j ] / density[ *j ] * kernels.viscosityLaplacian( std::sqrt( r2 ) );
+            const float w    = xsph + visc;
+
+            sumX += w * ( vsx[ *j ] - vsx[ i ] );
+            sumY += w * ( vsy[ *j ] - vsy[ i ] );
+            sumZ += w * ( vsz[ *j ] - vsz[ i ] );
+          }
+
+          dvx[ i ] = sumX; dvy[ i ] = sumY; dvz[ i ] = sumZ;
+        }
+      } );
+    }
+
+    // buildIdLookup: particle id -> SoA index for computeInternalForces,
+    // hashed so sparse or large ids cost no more than dense ones.
+    void buildIdLookup( void )
+    {
+      indexOfId.clear();
+      indexOfId.reserve( ids.size() );
+      for ( size_t i = 0; i < ids.size(); ++i )
+      {
+        if ( ids[ i ] >= 0 )
+        {
+          bool inserted;
+          indexOfId.insert( static_cast< unsigned long long >( ids[ i ] ), static_cast< unsigned int >( i ), inserted );
+        }
+      }
+    }
+
+    // indexOf: SoA index of a particle id, NOT_FOUND when it was not gathered.
+    unsigned int indexOf( const long id ) const
+    {
+      return ( id < 0 ? FlatIndexMap::NOT_FOUND : indexOfId.find( static_cast< unsigned long long >( id ) ) );
+    }
+
+    // resizeArrays: capacity is kept between steps.
+    void resizeArrays( const size_t n )
+    {
+      px.resize( n ); py.resize( n ); pz.resize( n );
+      vx.resize( n ); vy.resize( n ); vz.resize( n );
+      ax.resize( n ); ay.resize( n ); az.resize( n );
+      qx.resize( n ); qy.resize( n ); qz.resize( n );
+      pax.resize( n ); pay.resize( n ); paz.resize( n );
+      vsx.resize( n ); vsy.resize( n ); vsz.resize( n );
+      dvx.resize( n ); dvy.resize( n ); dvz.resize( n );
+      mass.resize( n ); pressure.resize( n ); density.resize( n );
+      ids.resize( n );
+    }
+
+  protected:
+
+    ThreadPool    pool;
+    NeighborGrid  grid;
+    SphKernels    kernels;
+
+    std::vector< PB_Particle > particles;
+
+    // Positions, velocities, non pressure accelerations, predicted
+    // positions and pressure accelerations.
+    std::vector< float > px, py, pz;
+    std::vector< float > vx, vy, vz;
+    std::vector< float > ax, ay, az;
+    std::vector< float > qx, qy, qz;
+    std::vector< float > pax, pay, paz;
+
+    // XSPH / viscosity double buffer: velocities after the pressure
+    // step and the correction computeInternalForces turns into a force.
+    std::vector< float > vsx, vsy, vsz;
+    std::vector< float > dvx, dvy, dvz;
+    bool                 smoothingActive;
+    float                smoothingDt;
+
+    std::vector< float > mass;
+    std::vector< float > pressure;
+    std::vector< float > density;
+    std::vector< long >  ids;
+    FlatIndexMap         indexOfId;
+
+    float  averageMass;
+
+    // Last step statistics.
+    int    lastIterations;
+    double lastSolveTime;
+    float  lastDensityError;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RF_SDK_DECLARE_PARTICLE_SOLVER_PLUGIN( PcisphSolverSDK );
+
+/////////////////////////////////////////////////////////////////////////////////////////
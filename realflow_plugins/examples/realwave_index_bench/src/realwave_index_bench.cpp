@@ -0,0 +1,225 @@
+/////////////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2008 Next Limit Technologies. All rights reserved.
+//
+// This file is just part of the C++ SDK examples provided with RealFlow(c).
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------
+// realwave_index_bench
+// Correctness and throughput of RealWaveIndex on a RealWave
+// like grid with choppy waves. No RealFlow dependency, it
+// runs standalone:
+//
+//   make && ./realwave_index_bench [ threads ]
+//
+// Every frame a sample of the queries is checked against a
+// brute force search over all vertices and triangles; the
+// program returns 1 on the first mismatch.
+//--------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "thread_pool.h"
+#include "stopwatch.h"
+#include "realwave_index.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace std;
+using namespace nextlimit::rf_sdk;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+static const int    GRID        = 512;
+static const float  SPACING     = 0.1f;
+static const size_t NUM_QUERIES = 1 << 18;
+static const size_t NUM_CHECKED = 2000;
+static const int    NUM_FRAMES  = 8;
+
+// Mesh: a GRID x GRID vertex sheet, two triangles per quad.
+struct Mesh
+{
+  std::vector< float > restX, restZ;
+  std::vector< float > x, y, z;
+  std::vector< int >   triangles;
+};
+
+static void buildMesh( Mesh& mesh )
+{
+  const size_t n = size_t( GRID ) * GRID;
+  mesh.restX.resize( n ); mesh.restZ.resize( n );
+  mesh.x.resize( n ); mesh.y.resize( n ); mesh.z.resize( n );
+
+  for ( int j = 0; j < GRID; ++j )
+  {
+    for ( int i = 0; i < GRID; ++i )
+    {
+      mesh.restX[ j * GRID + i ] = SPACING * i;
+      mesh.restZ[ j * GRID + i ] = SPACING * j;
+    }
+  }
+
+  for ( int j = 0; j + 1 < GRID; ++j )
+  {
+    for ( int i = 0; i + 1 < GRID; ++i )
+    {
+      const int a = j * GRID + i, b = a + 1, c = a + GRID, d = c + 1;
+      const int quad[ 6 ] = { a, b, d, a, d, c };
+      mesh.triangles.insert( mesh.triangles.end(), quad, quad + 6 );
+    }
+  }
+}
+
+// animate: one travelling Gerstner wave, "choppiness" times the
+// amplitude of horizontal motion, below the fold limit.
+static void animate( Mesh& mesh, float time, float choppiness )
+{
+  const float k = 2.0f * 3.14159265f / 3.0f, w = 2.0f, amplitude = 0.3f;
+  for ( size_t v = 0; v < mesh.x.size(); ++v )
+  {
+    const float phase = k * ( mesh.restX[ v ] + 0.5f * mesh.restZ[ v ] ) - w * time;
+    mesh.x[ v ] = mesh.restX[ v ] - choppiness * amplitude * std::sin( phase );
+    mesh.y[ v ] = amplitude * std::cos( phase );
+    mesh.z[ v ] = mesh.restZ[ v ] - 0.5f * choppiness * amplitude * std::sin( phase );
+  }
+}
+
+// bruteNearest: lowest index among the closest vertices.
+static int bruteNearest( const Mesh& mesh, float px, float py, float pz )
+{
+  int   best   = -1;
+  float bestSq = std::numeric_limits< float >::max();
+  for ( size_t v = 0; v < mesh.x.size(); ++v )
+  {
+    const float ex = mesh.x[ v ] - px, ey = mesh.y[ v ] - py, ez = mesh.z[ v ] - pz;
+    const float distSq = ex * ex + ey * ey + ez * ez;
+    if ( distSq < bestSq )
+    {
+      bestSq = distSq;
+      best   = int( v );
+    }
+  }
+  return ( best );
+}
+
+// bruteHeight: same barycentric test as the index, every triangle.
+static bool bruteHeight( const Mesh& mesh, float px, float pz, float& h )
+{
+  for ( size_t t = 0; t < mesh.triangles.size() / 3; ++t )
+  {
+    const int* v = &mesh.triangles[ 3 * t ];
+    const float ax = mesh.x[ v[ 0 ] ], az = mesh.z[ v[ 0 ] ];
+    const float bx = mesh.x[ v[ 1 ] ], bz = mesh.z[ v[ 1 ] ];
+    const float cx = mesh.x[ v[ 2 ] ], cz = mesh.z[ v[ 2 ] ];
+
+    const float area = ( bx - ax ) * ( cz - az ) - ( cx - ax ) * ( bz - az );
+    if ( std::fabs( area ) < 1e-12f )
+    {
+      continue;
+    }
+
+    const float inv = 1.0f / area;
+    const float wb  = ( ( px - ax ) * ( cz - az ) - ( cx - ax ) * ( pz - az ) ) * inv;
+    const float wc  = ( ( bx - ax ) * ( pz - az ) - ( px - ax ) * ( bz - az ) ) * inv;
+    const float wa  = 1.0f - wb - wc;
+    if ( wa >= -1e-5f && wb >= -1e-5f && wc >= -1e-5f )
+    {
+      h = wa * mesh.y[ v[ 0 ] ] + wb * mesh.y[ v[ 1 ] ] + wc * mesh.y[ v[ 2 ] ];
+      return ( true );
+    }
+  }
+  return ( false );
+}
+
+// distanceSq: from a point to vertex "v".
+static float distanceSq( const Mesh& mesh, int v, float px, float py, float pz )
+{
+  const float ex = mesh.x[ v ] - px, ey = mesh.y[ v ] - py, ez = mesh.z[ v ] - pz;
+  return ( ex * ex + ey * ey + ez * ez );
+}
+
+int main( int argc, char** argv )
+{
+  ThreadPool pool;
+  pool.resize( argc > 1 ? unsigned( std::max( 1, atoi( argv[ 1 ] ) ) ) : 0 );
+
+  Mesh mesh;
+  buildMesh( mesh );
+
+  // Queries over the sheet and a margin around it.
+  const float extent = SPACING * ( GRID - 1 );
+  std::vector< float > qx( NUM_QUERIES ), qy( NUM_QUERIES ), qz( NUM_QUERIES );
+  srand( 7 );
+  for ( size_t q = 0; q < NUM_QUERIES; ++q )
+  {
+    qx[ q ] = -0.5f + ( extent + 1.0f ) * float( rand() ) / float( RAND_MAX );
+    qy[ q ] = -0.5f + float( rand() ) / float( RAND_MAX );
+    qz[ q ] = -0.5f + ( extent + 1.0f ) * float( rand() ) / float( RAND_MAX );
+  }
+
+  std::vector< int >           nearest( NUM_QUERIES );
+  std::vector< float >         heights( NUM_QUERIES );
+  std::vector< unsigned char > found( NUM_QUERIES );
+
+  printf( "%d x %d vertices, %u queries, %u threads\n", GRID, GRID, unsigned( NUM_QUERIES ), pool.getNumThreads() );
+
+  RealWaveIndex index;
+  index.setTopology( mesh.x.size(), mesh.triangles.data(), mesh.triangles.size() / 3 );
+
+  for ( int frame = 0; frame < NUM_FRAMES; ++frame )
+  {
+    // Choppiness ramps up, so later frames drift a couple of cells and the searches widen.
+    animate( mesh, 0.1f * frame, 0.1f * frame );
+
+    Stopwatch updateTime;
+    const bool rebuilt = index.update( mesh.x.data(), mesh.y.data(), mesh.z.data(), pool );
+    const double updateMs = updateTime.getElapsedMs();
+
+    Stopwatch nearestTime;
+    index.nearestVertices( qx.data(), qy.data(), qz.data(), NUM_QUERIES, nearest.data(), pool );
+    const double nearestNs = nearestTime.getElapsedMs() * 1e6 / NUM_QUERIES;
+
+    Stopwatch heightTime;
+    index.heights( qx.data(), qz.data(), NUM_QUERIES, heights.data(), found.data(), pool );
+    const double heightNs = heightTime.getElapsedMs() * 1e6 / NUM_QUERIES;
+
+    for ( size_t c = 0; c < NUM_CHECKED; ++c )
+    {
+      const size_t q = c * ( NUM_QUERIES / NUM_CHECKED );
+
+      // Ties may pick another vertex at the same distance.
+      const int expected = bruteNearest( mesh, qx[ q ], qy[ q ], qz[ q ] );
+      if ( nearest[ q ] < 0 ||
+           distanceSq( mesh, nearest[ q ], qx[ q ], qy[ q ], qz[ q ] ) != distanceSq( mesh, expected, qx[ q ], qy[ q ], qz[ q ] ) )
+      {
+        printf( "FAILED frame %d: nearest vertex of query %u is %d, expected %d\n", frame, unsigned( q ), nearest[ q ], expected );
+        return ( 1 );
+      }
+
+      float h = 0.0f;
+      const bool inside = bruteHeight( mesh, qx[ q ], qz[ q ], h );
+      if ( inside != ( found[ q ] != 0 ) || ( inside && std::fabs( h - heights[ q ] ) > 1e-4f ) )
+      {
+        printf( "FAILED frame %d: height of query %u is %d %g, expected %d %g\n", frame, unsigned( q ),
+                int( found[ q ] ), heights[ q ], int( inside ), h );
+        return ( 1 );
+      }
+    }
+
+    printf( "  frame %d: update %6.2f ms%s, nearest %7.1f ns, height %7.1f ns per query\n",
+            frame, updateMs, rebuilt ? " ( rebuilt )" : "              ", nearestNs, heightNs );
+  }
+
+  printf( "ok: %u queries per frame checked against brute force\n", unsigned( NUM_CHECKED ) );
+  return ( 0 );
+}
@@ -22,6 +22,12 @@
 #include <rf_sdk/sdk/rfsdklibdefs.h>
 #include <rf_sdk/sdk/sdkversion.h>
 #include <iostream>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "quantized_position_cache.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
@@ -32,6 +38,47 @@ using namespace nextlimit::rf_sdk;
 
 class SurfaceTensionSDK : public ParticleSolverPlgSdk
 {
+  // Voxelization bookkeeping kept per emitter between substeps.
+  struct VoxelizationState
+  {
+    VoxelizationState() : numParticles( 0 ), lastNumParticles( 0 ), lastMaxId( -1 ), cellSize( 0.0f ), kernelRadius( 0.15f ), valid( false ) {};
+
+    unsigned int numParticles;
+    unsigned int lastNumParticles;
+    long         lastMaxId;
+    Vector       boundsMin;
+    Vector       boundsMax;
+    float        cellSize;
+    float        kernelRadius;
+    bool         valid;
+  };
+
+  // Compact neighbor position cache, rebuilt every step.
+  struct PositionCacheState
+  {
+    PositionCacheState() : active( false ) {};
+
+    QuantizedPositionCache cache;
+    std::vector< float >   x, y, z;
+    std::vector< int >     indexOfId;
+    bool                   active;
+  };
+
+  // Accumulates the neighbor center visited through the cache.
+  struct CenterAccumulator
+  {
+    CenterAccumulator() : x( 0.0f ), y( 0.0f ), z( 0.0f ), count( 0 ) {};
+
+    void operator()( float px, float py, float pz )
+    {
+      x += px; y += py; z += pz;
+      ++count;
+    }
+
+    float x, y, z;
+    int   count;
+  };
+
   public:
 
     /// Constructor.
@@ -76,6 +123,22 @@ class SurfaceTensionSDK : public ParticleSolverPlgSdk
     {
       Ppty factor = Ppty::createPpty( "Factor", 1.5f );  
       plgDesc->addPpty( factor );
+
+      // 0 means derived from the emitter "Resolution" parameter.
+      Ppty kernelRadius = Ppty::createPpty( "KernelRadius", 0.0f, 0.0f );
+      plgDesc->addPpty( kernelRadius );
+
+      // Relative growth in particle count or change in bounds that forces a full rebuild.
+      Ppty rebuildThreshold = Ppty::createPpty( "RebuildThreshold", 0.1f, 0.0f );
+      plgDesc->addPpty( rebuildThreshold );
+
+      // Neighbor loops read 16-bit cell relative positions instead of Vectors.
+      Ppty quantizedCache = Ppty::createPpty( "QuantizedCache", false );
+      plgDesc->addPpty( quantizedCache );
+
+      // Compares the quantized and full precision forces every step.
+      Ppty reportAccuracy = Ppty::createPpty( "ReportAccuracy", false );
+      plgDesc->addPpty( reportAccuracy );
     }
 
     /// Integration
@@ -119,10 +182,87 @@ class SurfaceTensionSDK : public ParticleSolverPlgSdk
       return ( 0.02f );
     }
 
+    //--------------------------------------------------
+    // Function: preComputeInternalForces
+    // The voxel length matches the neighbor search radius, which
+    // is derived from the emitter resolution ( RealFlow places
+    // 1000 * res^3 particles per cubic unit, so the mean spacing
+    // is 0.1 / res ). The data structure is recreated when
+    // particles were removed since the last step ( the SDK
+    // invalidates it then ), when the cell size changes, or when
+    // the particle count or the bounds drift more than
+    // "RebuildThreshold"; otherwise it is updated in place.
+    // Removals are counted from the ids: new particles get ids
+    // above the last step's largest, so the previous count plus
+    // those, less the current count, is how many were removed,
+    // even when as many were emitted in the same step. The
+    // QuantizedCache path does not use the voxelization, so it
+    // marks it stale for when the cache is switched off.
+    //--------------------------------------------------
     virtual void preComputeInternalForces( ParticleSolver* particleSolver,
                                            PB_Emitter* emitter )
     {
-      emitter->createVoxelization( true, 0.15f );
+      const float userRadius = particleSolver->getParameter<float>( "KernelRadius" );
+      const float threshold  = particleSolver->getParameter<float>( "RebuildThreshold" );
+
+      VoxelizationState& state = voxelStates[ emitter->getId() ];
+
+      float kernelRadius = userRadius;
+      if ( kernelRadius <= 0.0f )
+      {
+        float resolution = emitter->getParameter<float>( "Resolution" );
+        if ( resolution <= 0.0f )
+        {
+          resolution = 1.0f;
+        }
+
+        const float spacing = 0.1f / resolution;
+        kernelRadius = KERNEL_SPACING_RATIO * spacing;
+      }
+
+      state.kernelRadius = kernelRadius;
+
+      PositionCacheState& cacheState = cacheStates[ emitter->getId() ];
+      cacheState.active = particleSolver->getParameter<bool>( "QuantizedCache" );
+      if ( cacheState.active )
+      {
+        const float factor = particleSolver->getParameter<float>( "Factor" );
+        buildPositionCache( emitter, cacheState, kernelRadius );
+        if ( particleSolver->getParameter<bool>( "ReportAccuracy" ) )
+        {
+          reportCacheAccuracy( emitter, cacheState, kernelRadius, factor );
+        }
+        state.valid = false;
+        return;
+      }
+
+      const unsigned int numParticles = emitter->getNumberOfParticles();
+
+      Vector       boundsMin;
+      Vector       boundsMax;
+      long         maxId   = state.lastMaxId;
+      unsigned int emitted = 0;
+      scanParticles( emitter, state.lastMaxId, boundsMin, boundsMax, maxId, emitted );
+
+      const bool removed = ( size_t( state.lastNumParticles ) + emitted > numParticles );
+      const bool rebuild = !state.valid ||
+                           removed ||
+                           kernelRadius != state.cellSize ||
+                           relativeChange( float( state.numParticles ), float( numParticles ) ) > threshold ||
+                           boundsChanged( state, boundsMin, boundsMax, threshold );
+      state.lastNumParticles = numParticles;
+      state.lastMaxId        = maxId;
+
+      if ( rebuild )
+      {
+        state.numParticles = numParticles;
+        state.boundsMin    = boundsMin;
+        state.boundsMax    = boundsMax;
+        state.cellSize     = kernelRadius;
+        state.valid        = true;
+      }
+
+      emitter->createVoxelization( rebuild, state.cellSize );
     }
 
     /// Compute internal forces.
@@ -132,13 +272,24 @@ class SurfaceTensionSDK : public ParticleSolverPlgSdk
                                         PB_Emitter::iterator iter )
     {
       const float factor = particleSolver->getParameter<float>( "Factor" );
+      // Read-only lookup: computeInternalForces runs on several threads.
+      std::map< int, VoxelizationState >::const_iterator state = voxelStates.find( emitter->getId() );
+      const float kernelRadius = ( state != voxelStates.end() ) ? state->second.kernelRadius : 0.15f;
+
+      std::map< int, PositionCacheState >::const_iterator cacheState = cacheStates.find( emitter->getId() );
+      if ( cacheState != cacheStates.end() && cacheState->second.active )
+      {
+        computeInternalForcesCached( cacheState->second, factor, kernelRadius, iter );
+        return;
+      }
+
       Vector center( 0.0f, 0.0f, 0.0f );
       Vector force( 0.0f, 0.0f, 0.0f );      
       while ( iter.hasNext() )
       {
         PB_Particle particle = iter.next();
         std::vector< PB_Particle > neighbors;
-        particle.getNeighbors( neighbors, 0.15f );
+        particle.getNeighbors( neighbors, kernelRadius );
         if ( neighbors.size() > 0 )
         {        
           center.set( 0.0f, 0.0f, 0.0f );
@@ -160,8 +311,223 @@ class SurfaceTensionSDK : public ParticleSolverPlgSdk
         }            
       }
     }
+
+  protected:
+
+    //--------------------------------------------------
+    // Function: computeInternalForcesCached
+    // Same force as the default path, with the neighbor
+    // positions decoded from the quantized cache: 6 bytes read
+    // per neighbor visit instead of a 12 byte Vector ( and no
+    // PB_Particle list per particle ).
+    //--------------------------------------------------
+    void computeInternalForcesCached( const PositionCacheState& cacheState,
+                                      const float factor,
+                                      const float kernelRadius,
+                                      PB_Emitter::iterator iter ) const
+    {
+      const float radius2 = kernelRadius * kernelRadius;
+
+      while ( iter.hasNext() )
+      {
+        PB_Particle particle = iter.next();
+
+        const long id = particle.getId();
+        if ( id < 0 || size_t( id ) >= cacheState.indexOfId.size() || cacheState.indexOfId[ id ] < 0 )
+        {
+          continue;
+        }
+
+        const size_t i = size_t( cacheState.indexOfId[ id ] );
+        const float  px = cacheState.x[ i ], py = cacheState.y[ i ], pz = cacheState.z[ i ];
+
+        CenterAccumulator center;
+        cacheState.cache.forEachNeighbor( i, px, py, pz, radius2, center );
+        if ( center.count > 0 )
+        {
+          const float invCount = 1.0f / center.count;
+          particle.setInternalForce( Vector( ( center.x * invCount - px ) * factor,
+                                             ( center.y * invCount - py ) * factor,
+                                             ( center.z * invCount - pz ) * factor ) );
+        }
+      }
+    }
+
+    // buildPositionCache
+    static void buildPositionCache( PB_Emitter* emitter,
+                                    PositionCacheState& cacheState,
+                                    const float kernelRadius )
+    {
+      cacheState.x.clear();
+      cacheState.y.clear();
+      cacheState.z.clear();
+
+      std::vector< long > ids;
+      ids.reserve( emitter->getNumberOfParticles() );
+
+      long maxId = -1;
+      PB_Emitter::iterator iter = emitter->getIterator();
+      while ( iter.hasNext() )
+      {
+        PB_Particle particle = iter.next();
+        const Vector position = particle.getPosition();
+
+        cacheState.x.push_back( position.getX() );
+        cacheState.y.push_back( position.getY() );
+        cacheState.z.push_back( position.getZ() );
+
+        ids.push_back( particle.getId() );
+        maxId = std::max( maxId, ids.back() );
+      }
+
+      cacheState.indexOfId.assign( size_t( maxId + 1 ), -1 );
+      for ( size_t i = 0; i < ids.size(); ++i )
+      {
+        if ( ids[ i ] >= 0 )
+        {
+          cacheState.indexOfId[ ids[ i ] ] = int( i );
+        }
+      }
+
+      cacheState.cache.build( cacheState.x.data(), cacheState.y.data(), cacheState.z.data(),
+                              cacheState.x.size(), kernelRadius );
+    }
+
+    //--------------------------------------------------
+    // Function: reportCacheAccuracy
+    // Force error of the quantized path against the float
+    // path over a sample of up to 1000 particles.
+    //--------------------------------------------------
+    static void reportCacheAccuracy( PB_Emitter* emitter,
+                                     const PositionCacheState& cacheState,
+                                     const float kernelRadius,
+                                     const float factor )
+    {
+      const size_t n = cacheState.x.size();
+      if ( n == 0 )
+      {
+        return;
+      }
+
+      const float  radius2 = kernelRadius * kernelRadius;
+      const size_t stride  = std::max< size_t >( 1, n / 1000 );
+
+      double maxError  = 0.0;
+      double sumError  = 0.0;
+      double sumForce  = 0.0;
+      size_t samples   = 0;
+      size_t mismatch  = 0;
+
+      for ( size_t i = 0; i < n; i += stride )
+      {
+        CenterAccumulator quantized;
+        CenterAccumulator reference;
+        cacheState.cache.forEachNeighbor( i, cacheState.x[ i ], cacheState.y[ i ], cacheState.z[ i ], radius2, quantized );
+        cacheState.cache.forEachNeighborFloat( i, cacheState.x.data(), cacheState.y.data(), cacheState.z.data(), radius2, reference );
+
+        if ( quantized.count != reference.count )
+        {
+          // A neighbor right at the radius fell on the other side.
+          ++mismatch;
+          continue;
+        }
+        if ( reference.count == 0 )
+        {
+          continue;
+        }
+
+        const float invCount = 1.0f / reference.count;
+        const Vector force( ( reference.x * invCount - cacheState.x[ i ] ) * factor,
+                            ( reference.y * invCount - cacheState.y[ i ] ) * factor,
+                            ( reference.z * invCount - cacheState.z[ i ] ) * factor );
+        const Vector error( ( quantized.x - reference.x ) * invCount * factor,
+                            ( quantized.y - reference.y ) * invCount * factor,
+                            ( quantized.z - reference.z ) * invCount * factor );
+
+        maxError = std::max( maxError, double( error.module() ) );
+        sumError += error.module();
+        sumForce += force.module();
+        ++samples;
+      }
+
+      Scene& scene = AppManager::instance()->getCurrentScene();
+      std::stringstream msg;
+      msg << "SurfaceTension " << emitter->getName() << " quantized cache: "
+          << samples << " samples, max force error " << maxError
+          << ", mean relative error " << ( sumForce > 0.0 ? sumError / sumForce : 0.0 )
+          << ", " << mismatch << " neighbor count mismatches, "
+          << QuantizedPositionCache::getBytesPerVisit() << " bytes per neighbor visit ( float path "
+          << QuantizedPositionCache::getFloatBytesPerVisit() << " )";
+      scene.message( msg.str() );
+    }
+
+    // scanParticles: bounds, largest id and how many ids are above "lastMaxId".
+    static void scanParticles( PB_Emitter* emitter, const long lastMaxId, Vector& boundsMin, Vector& boundsMax,
+                               long& maxId, unsigned int& emitted )
+    {
+      boundsMin.set( 0.0f, 0.0f, 0.0f );
+      boundsMax.set( 0.0f, 0.0f, 0.0f );
+
+      PB_Emitter::iterator iter = emitter->getIterator();
+      bool first = true;
+      while ( iter.hasNext() )
+      {
+        const PB_Particle particle = iter.next();
+        const Vector      position = particle.getPosition();
+        const long        id       = particle.getId();
+        maxId    = std::max( maxId, id );
+        emitted += ( id > lastMaxId ) ? 1 : 0;
+
+        if ( first )
+        {
+          boundsMin = position;
+          boundsMax = position;
+          first = false;
+          continue;
+        }
+
+        for ( int axis = 0; axis < 3; ++axis )
+        {
+          if ( position[ axis ] < boundsMin[ axis ] ) boundsMin[ axis ] = position[ axis ];
+          if ( position[ axis ] > boundsMax[ axis ] ) boundsMax[ axis ] = position[ axis ];
+        }
+      }
+    }
+
+    // relativeChange
+    static float relativeChange( const float oldValue, const float newValue )
+    {
+      const float reference = std::max( std::fabs( oldValue ), 1e-6f );
+      return ( std::fabs( newValue - oldValue ) / reference );
+    }
+
+    // boundsChanged: corners measured against the largest extent of the old box.
+    static bool boundsChanged( const VoxelizationState& state,
+                               const Vector& boundsMin,
+                               const Vector& boundsMax,
+                               const float threshold )
+    {
+      const Vector extent = state.boundsMax - state.boundsMin;
+      const float  size   = std::max( std::max( extent.getX(), extent.getY() ),
+                                      std::max( extent.getZ(), state.cellSize ) );
+
+      const float drift = std::max( ( boundsMin - state.boundsMin ).module(),
+                                    ( boundsMax - state.boundsMax ).module() );
+
+      return ( drift > threshold * size );
+    }
+
+  protected:
+
+    // Neighbor radius in units of mean particle spacing ( 0.15 at resolution 1 ).
+    static const float KERNEL_SPACING_RATIO;
+
+    std::map< int, VoxelizationState > voxelStates;
+    std::map< int, PositionCacheState > cacheStates;
 };
 
+const float SurfaceTensionSDK::KERNEL_SPACING_RATIO = 1.5f;
+
 /////////////////////////////////////////////////////////////////////////////////////////
 
 RF_SDK_DECLARE_PARTICLE_SOLVER_PLUGIN( SurfaceTensionSDK );